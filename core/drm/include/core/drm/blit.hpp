@@ -0,0 +1,53 @@
+#pragma once
+
+// ----------------------------------------------------------------
+// Blitting and pixel format conversion.
+// ----------------------------------------------------------------
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace drm_core {
+
+enum class BlitFormat {
+	xrgb8888,
+	argb8888,
+	rgb565
+};
+
+// Instruction set used by the blitting kernels. By default, the best
+// instruction set that is supported by the CPU is selected at runtime.
+enum class BlitIsa {
+	scalar,
+	sse2,
+	avx2
+};
+
+size_t blitFormatBytes(BlitFormat format);
+
+BlitIsa bestBlitIsa();
+BlitIsa currentBlitIsa();
+// Overrides the runtime selection (e.g., for benchmarking).
+// Selecting an instruction set that is not supported by the CPU is not allowed.
+void forceBlitIsa(BlitIsa isa);
+
+/**
+ * Copies a rectangle of width x height pixels, converting between formats if necessary.
+ *
+ * If nonTemporal is set, stores bypass the cache where possible. This should be used
+ * for write-combined destinations (e.g., framebuffers in VRAM) that are not read back.
+ *
+ * @return false if the conversion is not supported.
+ */
+bool blitRect(void *dst, size_t dstPitch, BlitFormat dstFormat,
+		const void *src, size_t srcPitch, BlitFormat srcFormat,
+		uint32_t width, uint32_t height, bool nonTemporal = false);
+
+/**
+ * Blends a rectangle of premultiplied ARGB8888 pixels (e.g., a cursor image)
+ * over a XRGB8888 or ARGB8888 destination.
+ */
+void blendRect(void *dst, size_t dstPitch, const void *src, size_t srcPitch,
+		uint32_t width, uint32_t height);
+
+} // namespace drm_core
@@ -17,6 +17,7 @@
 
 #include "fwd-decls.hpp"
 
+#include "blit.hpp"
 #include "device.hpp"
 #include "range-allocator.hpp"
 #include "property.hpp"
@@ -183,6 +184,8 @@ std::optional<FormatInfo> getFormatInfo(uint32_t fourcc);
 uint8_t getFormatBlockHeight(const FormatInfo &info, size_t plane);
 uint8_t getFormatBlockWidth(const FormatInfo &info, size_t plane);
 uint8_t getFormatBpp(const FormatInfo &info, size_t plane);
+// Returns the format that the blitting kernels (see blit.hpp) use for a DRM format.
+std::optional<BlitFormat> blitFormatFromFourcc(uint32_t fourcc);
 
 drm_mode_modeinfo makeModeInfo(const char *name, uint32_t type,
 		uint32_t clock, unsigned int hdisplay, unsigned int hsync_start,
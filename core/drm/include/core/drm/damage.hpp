@@ -0,0 +1,132 @@
+#pragma once
+
+// ----------------------------------------------------------------
+// Damage tracking.
+// ----------------------------------------------------------------
+
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+namespace drm_core {
+
+/**
+ * A rectangle in framebuffer coordinates; x2 and y2 are exclusive.
+ * This matches the semantics of struct drm_clip_rect.
+ */
+struct DamageRect {
+	uint32_t x1;
+	uint32_t y1;
+	uint32_t x2;
+	uint32_t y2;
+
+	uint32_t width() const {
+		return x2 - x1;
+	}
+
+	uint32_t height() const {
+		return y2 - y1;
+	}
+
+	bool empty() const {
+		return x1 >= x2 || y1 >= y2;
+	}
+
+	uint64_t area() const {
+		if(empty())
+			return 0;
+		return uint64_t{width()} * height();
+	}
+
+	DamageRect unite(const DamageRect &other) const {
+		return {std::min(x1, other.x1), std::min(y1, other.y1),
+				std::max(x2, other.x2), std::max(y2, other.y2)};
+	}
+
+	DamageRect intersect(const DamageRect &other) const {
+		return {std::max(x1, other.x1), std::max(y1, other.y1),
+				std::min(x2, other.x2), std::min(y2, other.y2)};
+	}
+};
+
+/**
+ * Accumulates damaged rectangles of a framebuffer until the driver flushes them.
+ *
+ * Rectangles are merged whenever their union does not cover more pixels than
+ * the two rectangles do separately (i.e., for overlapping or adjacent rectangles).
+ * To bound the cost of a flush, the region collapses to its bounding box
+ * once it contains more than maxRects rectangles.
+ */
+struct DamageRegion {
+	static constexpr size_t maxRects = 8;
+
+	bool empty() const {
+		return _rects.empty();
+	}
+
+	const std::vector<DamageRect> &rects() const {
+		return _rects;
+	}
+
+	DamageRect bounds() const {
+		if(_rects.empty())
+			return {0, 0, 0, 0};
+		DamageRect r = _rects.front();
+		for(auto &rect : _rects)
+			r = r.unite(rect);
+		return r;
+	}
+
+	void add(DamageRect rect) {
+		if(rect.empty())
+			return;
+
+		// Keep merging until no more rectangles can be absorbed.
+		bool merged;
+		do {
+			merged = false;
+			for(auto it = _rects.begin(); it != _rects.end(); ++it) {
+				auto u = rect.unite(*it);
+				if(u.area() <= rect.area() + it->area()) {
+					rect = u;
+					_rects.erase(it);
+					merged = true;
+					break;
+				}
+			}
+		} while(merged);
+
+		_rects.push_back(rect);
+
+		if(_rects.size() > maxRects) {
+			auto r = bounds();
+			_rects.clear();
+			_rects.push_back(r);
+		}
+	}
+
+	void addAll(uint32_t width, uint32_t height) {
+		_rects.clear();
+		add({0, 0, width, height});
+	}
+
+	// Restricts all rectangles to [0, width) x [0, height).
+	void clipTo(uint32_t width, uint32_t height) {
+		std::vector<DamageRect> rects;
+		for(auto &rect : _rects) {
+			auto r = rect.intersect({0, 0, width, height});
+			if(!r.empty())
+				rects.push_back(r);
+		}
+		_rects = std::move(rects);
+	}
+
+	void clear() {
+		_rects.clear();
+	}
+
+private:
+	std::vector<DamageRect> _rects;
+};
+
+} // namespace drm_core
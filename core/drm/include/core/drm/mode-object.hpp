@@ -2,9 +2,11 @@
 
 #include <core/id-allocator.hpp>
 #include <libdrm/drm_fourcc.h>
+#include <span>
 
 #include "fwd-decls.hpp"
 
+#include "damage.hpp"
 #include "device.hpp"
 #include "range-allocator.hpp"
 #include "property.hpp"
@@ -225,11 +227,24 @@ protected:
 
 private:
 	uint32_t _format = DRM_FORMAT_XRGB8888;
+	DamageRegion _damage;
 
 public:
 	uint32_t format();
 	void setFormat(uint32_t format);
 
+	/**
+	 * Adds the clip rectangles to the damage region and calls notifyDirty().
+	 * An empty list of clips damages the entire framebuffer.
+	 */
+	void markDirty(std::span<const DamageRect> clips);
+
+	/**
+	 * Returns the accumulated damage (clipped to the framebuffer size) and resets it.
+	 * Drivers call this from notifyDirty() to flush only the damaged parts.
+	 */
+	DamageRegion takeDamage();
+
 	virtual void notifyDirty() = 0;
 	virtual uint32_t getWidth() = 0;
 	virtual uint32_t getHeight() = 0;
@@ -0,0 +1,476 @@
+#include <assert.h>
+#include <string.h>
+
+#include <core/drm/blit.hpp>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace drm_core {
+
+namespace {
+
+// ----------------------------------------------------------------
+// Scalar kernels.
+// ----------------------------------------------------------------
+
+inline uint16_t packRgb565(uint32_t p) {
+	return ((p >> 8) & 0xF800) | ((p >> 5) & 0x07E0) | ((p >> 3) & 0x001F);
+}
+
+inline uint32_t unpackRgb565(uint16_t v) {
+	uint32_t r = (v >> 11) & 0x1F;
+	uint32_t g = (v >> 5) & 0x3F;
+	uint32_t b = v & 0x1F;
+	r = (r << 3) | (r >> 2);
+	g = (g << 2) | (g >> 4);
+	b = (b << 3) | (b >> 2);
+	return 0xFF000000 | (r << 16) | (g << 8) | b;
+}
+
+// Computes x / 255 (rounded) for x <= 255 * 255.
+inline uint32_t div255(uint32_t x) {
+	x += 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+inline uint32_t blendPixel(uint32_t d, uint32_t s) {
+	uint32_t inv = 255 - (s >> 24);
+	uint32_t out = 0;
+	for(int shift = 0; shift < 32; shift += 8) {
+		uint32_t c = ((s >> shift) & 0xFF) + div255(((d >> shift) & 0xFF) * inv);
+		out |= (c > 255 ? 255 : c) << shift;
+	}
+	return out;
+}
+
+void copyRowScalar(void *dst, const void *src, size_t size, bool) {
+	memcpy(dst, src, size);
+}
+
+void setAlphaRowScalar(uint32_t *dst, const uint32_t *src, size_t n, bool) {
+	for(size_t i = 0; i < n; i++)
+		dst[i] = src[i] | 0xFF000000;
+}
+
+void toRgb565RowScalar(uint16_t *dst, const uint32_t *src, size_t n) {
+	for(size_t i = 0; i < n; i++)
+		dst[i] = packRgb565(src[i]);
+}
+
+void fromRgb565RowScalar(uint32_t *dst, const uint16_t *src, size_t n) {
+	for(size_t i = 0; i < n; i++)
+		dst[i] = unpackRgb565(src[i]);
+}
+
+void blendRowScalar(uint32_t *dst, const uint32_t *src, size_t n) {
+	for(size_t i = 0; i < n; i++) {
+		if((src[i] >> 24) == 0xFF) {
+			dst[i] = src[i];
+		}else{
+			dst[i] = blendPixel(dst[i], src[i]);
+		}
+	}
+}
+
+#if defined(__x86_64__)
+
+// ----------------------------------------------------------------
+// SSE2 kernels.
+// ----------------------------------------------------------------
+
+// SSE2 is part of the x86_64 baseline, hence no target attributes are necessary.
+
+void copyRowSse2(void *dst, const void *src, size_t size, bool nonTemporal) {
+	if(!nonTemporal) {
+		memcpy(dst, src, size);
+		return;
+	}
+
+	auto d = reinterpret_cast<char *>(dst);
+	auto s = reinterpret_cast<const char *>(src);
+
+	// Align the destination for the streaming stores.
+	size_t head = (-reinterpret_cast<uintptr_t>(d)) & 15;
+	if(head > size)
+		head = size;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	size -= head;
+
+	while(size >= 64) {
+		auto x0 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+		auto x1 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 16));
+		auto x2 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 32));
+		auto x3 = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s + 48));
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d), x0);
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d + 16), x1);
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d + 32), x2);
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d + 48), x3);
+		d += 64;
+		s += 64;
+		size -= 64;
+	}
+	while(size >= 16) {
+		auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(s));
+		_mm_stream_si128(reinterpret_cast<__m128i *>(d), x);
+		d += 16;
+		s += 16;
+		size -= 16;
+	}
+	memcpy(d, s, size);
+}
+
+void setAlphaRowSse2(uint32_t *dst, const uint32_t *src, size_t n, bool nonTemporal) {
+	auto alpha = _mm_set1_epi32(0xFF000000);
+	size_t i = 0;
+	if(nonTemporal) {
+		for(; i < n && (reinterpret_cast<uintptr_t>(dst + i) & 15); i++)
+			dst[i] = src[i] | 0xFF000000;
+		for(; i + 4 <= n; i += 4) {
+			auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+			_mm_stream_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(x, alpha));
+		}
+	}else{
+		for(; i + 4 <= n; i += 4) {
+			auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(x, alpha));
+		}
+	}
+	for(; i < n; i++)
+		dst[i] = src[i] | 0xFF000000;
+}
+
+inline __m128i packRgb565Sse2(__m128i p) {
+	auto r = _mm_and_si128(_mm_srli_epi32(p, 8), _mm_set1_epi32(0xF800));
+	auto g = _mm_and_si128(_mm_srli_epi32(p, 5), _mm_set1_epi32(0x07E0));
+	auto b = _mm_and_si128(_mm_srli_epi32(p, 3), _mm_set1_epi32(0x001F));
+	auto v = _mm_or_si128(_mm_or_si128(r, g), b);
+	// Sign-extend such that the signed saturation of packs_epi32 preserves the low 16 bits.
+	return _mm_srai_epi32(_mm_slli_epi32(v, 16), 16);
+}
+
+void toRgb565RowSse2(uint16_t *dst, const uint32_t *src, size_t n) {
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8) {
+		auto lo = packRgb565Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)));
+		auto hi = packRgb565Sse2(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i + 4)));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(lo, hi));
+	}
+	for(; i < n; i++)
+		dst[i] = packRgb565(src[i]);
+}
+
+inline __m128i unpackRgb565Sse2(__m128i v) {
+	auto r = _mm_and_si128(_mm_srli_epi32(v, 11), _mm_set1_epi32(0x1F));
+	auto g = _mm_and_si128(_mm_srli_epi32(v, 5), _mm_set1_epi32(0x3F));
+	auto b = _mm_and_si128(v, _mm_set1_epi32(0x1F));
+	r = _mm_or_si128(_mm_slli_epi32(r, 3), _mm_srli_epi32(r, 2));
+	g = _mm_or_si128(_mm_slli_epi32(g, 2), _mm_srli_epi32(g, 4));
+	b = _mm_or_si128(_mm_slli_epi32(b, 3), _mm_srli_epi32(b, 2));
+	return _mm_or_si128(_mm_or_si128(_mm_set1_epi32(0xFF000000), _mm_slli_epi32(r, 16)),
+			_mm_or_si128(_mm_slli_epi32(g, 8), b));
+}
+
+void fromRgb565RowSse2(uint32_t *dst, const uint16_t *src, size_t n) {
+	auto zero = _mm_setzero_si128();
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8) {
+		auto v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		auto lo = unpackRgb565Sse2(_mm_unpacklo_epi16(v, zero));
+		auto hi = unpackRgb565Sse2(_mm_unpackhi_epi16(v, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i + 4), hi);
+	}
+	for(; i < n; i++)
+		dst[i] = unpackRgb565(src[i]);
+}
+
+// Blends two pixels that are unpacked to 16 bits per channel.
+inline __m128i blendPairSse2(__m128i d, __m128i s) {
+	auto a = _mm_shufflehi_epi16(_mm_shufflelo_epi16(s, 0xFF), 0xFF);
+	auto inv = _mm_sub_epi16(_mm_set1_epi16(255), a);
+	auto t = _mm_add_epi16(_mm_mullo_epi16(d, inv), _mm_set1_epi16(128));
+	t = _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+	return _mm_add_epi16(s, t);
+}
+
+void blendRowSse2(uint32_t *dst, const uint32_t *src, size_t n) {
+	auto zero = _mm_setzero_si128();
+	size_t i = 0;
+	for(; i + 4 <= n; i += 4) {
+		auto s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+		auto d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+		auto lo = blendPairSse2(_mm_unpacklo_epi8(d, zero), _mm_unpacklo_epi8(s, zero));
+		auto hi = blendPairSse2(_mm_unpackhi_epi8(d, zero), _mm_unpackhi_epi8(s, zero));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(lo, hi));
+	}
+	blendRowScalar(dst + i, src + i, n - i);
+}
+
+// ----------------------------------------------------------------
+// AVX2 kernels.
+// ----------------------------------------------------------------
+
+[[gnu::target("avx2")]]
+void copyRowAvx2(void *dst, const void *src, size_t size, bool nonTemporal) {
+	if(!nonTemporal) {
+		memcpy(dst, src, size);
+		return;
+	}
+
+	auto d = reinterpret_cast<char *>(dst);
+	auto s = reinterpret_cast<const char *>(src);
+
+	// Align the destination for the streaming stores.
+	size_t head = (-reinterpret_cast<uintptr_t>(d)) & 31;
+	if(head > size)
+		head = size;
+	memcpy(d, s, head);
+	d += head;
+	s += head;
+	size -= head;
+
+	while(size >= 128) {
+		auto y0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+		auto y1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 32));
+		auto y2 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 64));
+		auto y3 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s + 96));
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(d), y0);
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(d + 32), y1);
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(d + 64), y2);
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(d + 96), y3);
+		d += 128;
+		s += 128;
+		size -= 128;
+	}
+	while(size >= 32) {
+		auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(s));
+		_mm256_stream_si256(reinterpret_cast<__m256i *>(d), y);
+		d += 32;
+		s += 32;
+		size -= 32;
+	}
+	memcpy(d, s, size);
+}
+
+[[gnu::target("avx2")]]
+void setAlphaRowAvx2(uint32_t *dst, const uint32_t *src, size_t n, bool nonTemporal) {
+	auto alpha = _mm256_set1_epi32(0xFF000000);
+	size_t i = 0;
+	if(nonTemporal) {
+		for(; i < n && (reinterpret_cast<uintptr_t>(dst + i) & 31); i++)
+			dst[i] = src[i] | 0xFF000000;
+		for(; i + 8 <= n; i += 8) {
+			auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+			_mm256_stream_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(y, alpha));
+		}
+	}else{
+		for(; i + 8 <= n; i += 8) {
+			auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_or_si256(y, alpha));
+		}
+	}
+	for(; i < n; i++)
+		dst[i] = src[i] | 0xFF000000;
+}
+
+[[gnu::target("avx2")]]
+inline __m256i packRgb565Avx2(__m256i p) {
+	auto r = _mm256_and_si256(_mm256_srli_epi32(p, 8), _mm256_set1_epi32(0xF800));
+	auto g = _mm256_and_si256(_mm256_srli_epi32(p, 5), _mm256_set1_epi32(0x07E0));
+	auto b = _mm256_and_si256(_mm256_srli_epi32(p, 3), _mm256_set1_epi32(0x001F));
+	auto v = _mm256_or_si256(_mm256_or_si256(r, g), b);
+	return _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+[[gnu::target("avx2")]]
+void toRgb565RowAvx2(uint16_t *dst, const uint32_t *src, size_t n) {
+	size_t i = 0;
+	for(; i + 16 <= n; i += 16) {
+		auto lo = packRgb565Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)));
+		auto hi = packRgb565Avx2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 8)));
+		// packs_epi32 operates per 128-bit lane; restore the pixel order afterwards.
+		auto packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), packed);
+	}
+	toRgb565RowSse2(dst + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]]
+inline __m256i blendPairAvx2(__m256i d, __m256i s) {
+	auto a = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(s, 0xFF), 0xFF);
+	auto inv = _mm256_sub_epi16(_mm256_set1_epi16(255), a);
+	auto t = _mm256_add_epi16(_mm256_mullo_epi16(d, inv), _mm256_set1_epi16(128));
+	t = _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+	return _mm256_add_epi16(s, t);
+}
+
+[[gnu::target("avx2")]]
+void blendRowAvx2(uint32_t *dst, const uint32_t *src, size_t n) {
+	auto zero = _mm256_setzero_si256();
+	size_t i = 0;
+	for(; i + 8 <= n; i += 8) {
+		auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+		auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+		// Unpacking and packing both operate per 128-bit lane, hence the order is preserved.
+		auto lo = blendPairAvx2(_mm256_unpacklo_epi8(d, zero), _mm256_unpacklo_epi8(s, zero));
+		auto hi = blendPairAvx2(_mm256_unpackhi_epi8(d, zero), _mm256_unpackhi_epi8(s, zero));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_packus_epi16(lo, hi));
+	}
+	blendRowSse2(dst + i, src + i, n - i);
+}
+
+#endif // defined(__x86_64__)
+
+// ----------------------------------------------------------------
+// Runtime dispatch.
+// ----------------------------------------------------------------
+
+struct BlitKernels {
+	void (*copyRow)(void *dst, const void *src, size_t size, bool nonTemporal);
+	void (*setAlphaRow)(uint32_t *dst, const uint32_t *src, size_t n, bool nonTemporal);
+	void (*toRgb565Row)(uint16_t *dst, const uint32_t *src, size_t n);
+	void (*fromRgb565Row)(uint32_t *dst, const uint16_t *src, size_t n);
+	void (*blendRow)(uint32_t *dst, const uint32_t *src, size_t n);
+};
+
+constexpr BlitKernels scalarKernels{
+	.copyRow = &copyRowScalar,
+	.setAlphaRow = &setAlphaRowScalar,
+	.toRgb565Row = &toRgb565RowScalar,
+	.fromRgb565Row = &fromRgb565RowScalar,
+	.blendRow = &blendRowScalar,
+};
+
+#if defined(__x86_64__)
+constexpr BlitKernels sse2Kernels{
+	.copyRow = &copyRowSse2,
+	.setAlphaRow = &setAlphaRowSse2,
+	.toRgb565Row = &toRgb565RowSse2,
+	.fromRgb565Row = &fromRgb565RowSse2,
+	.blendRow = &blendRowSse2,
+};
+
+constexpr BlitKernels avx2Kernels{
+	.copyRow = &copyRowAvx2,
+	.setAlphaRow = &setAlphaRowAvx2,
+	.toRgb565Row = &toRgb565RowAvx2,
+	// The conversion is dominated by the stores; AVX2 does not help here.
+	.fromRgb565Row = &fromRgb565RowSse2,
+	.blendRow = &blendRowAvx2,
+};
+#endif
+
+const BlitKernels *kernelsFor(BlitIsa isa) {
+	switch(isa) {
+#if defined(__x86_64__)
+	case BlitIsa::avx2:
+		return &avx2Kernels;
+	case BlitIsa::sse2:
+		return &sse2Kernels;
+#endif
+	default:
+		return &scalarKernels;
+	}
+}
+
+BlitIsa activeIsa = bestBlitIsa();
+const BlitKernels *activeKernels = kernelsFor(activeIsa);
+
+void fence(bool nonTemporal) {
+#if defined(__x86_64__)
+	// Streaming stores are weakly ordered.
+	if(nonTemporal && activeIsa != BlitIsa::scalar)
+		_mm_sfence();
+#else
+	(void)nonTemporal;
+#endif
+}
+
+} // anonymous namespace
+
+size_t blitFormatBytes(BlitFormat format) {
+	switch(format) {
+	case BlitFormat::xrgb8888:
+	case BlitFormat::argb8888:
+		return 4;
+	case BlitFormat::rgb565:
+		return 2;
+	}
+	__builtin_unreachable();
+}
+
+BlitIsa bestBlitIsa() {
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return BlitIsa::avx2;
+	return BlitIsa::sse2;
+#else
+	return BlitIsa::scalar;
+#endif
+}
+
+BlitIsa currentBlitIsa() {
+	return activeIsa;
+}
+
+void forceBlitIsa(BlitIsa isa) {
+	assert(static_cast<int>(isa) <= static_cast<int>(bestBlitIsa()));
+	activeIsa = isa;
+	activeKernels = kernelsFor(isa);
+}
+
+bool blitRect(void *dst, size_t dstPitch, BlitFormat dstFormat,
+		const void *src, size_t srcPitch, BlitFormat srcFormat,
+		uint32_t width, uint32_t height, bool nonTemporal) {
+	auto d = reinterpret_cast<char *>(dst);
+	auto s = reinterpret_cast<const char *>(src);
+	auto k = activeKernels;
+
+	bool srcIs32 = srcFormat != BlitFormat::rgb565;
+	bool dstIs32 = dstFormat != BlitFormat::rgb565;
+
+	if(srcFormat == dstFormat
+			|| (srcFormat == BlitFormat::argb8888 && dstFormat == BlitFormat::xrgb8888)) {
+		// The X channel is undefined, so we can simply copy ARGB to XRGB.
+		size_t rowSize = width * blitFormatBytes(srcFormat);
+		if(srcPitch == rowSize && dstPitch == rowSize) {
+			k->copyRow(d, s, rowSize * height, nonTemporal);
+		}else{
+			for(uint32_t y = 0; y < height; y++)
+				k->copyRow(d + y * dstPitch, s + y * srcPitch, rowSize, nonTemporal);
+		}
+	}else if(srcFormat == BlitFormat::xrgb8888 && dstFormat == BlitFormat::argb8888) {
+		for(uint32_t y = 0; y < height; y++)
+			k->setAlphaRow(reinterpret_cast<uint32_t *>(d + y * dstPitch),
+					reinterpret_cast<const uint32_t *>(s + y * srcPitch), width, nonTemporal);
+	}else if(srcIs32 && !dstIs32) {
+		for(uint32_t y = 0; y < height; y++)
+			k->toRgb565Row(reinterpret_cast<uint16_t *>(d + y * dstPitch),
+					reinterpret_cast<const uint32_t *>(s + y * srcPitch), width);
+	}else if(!srcIs32 && dstIs32) {
+		for(uint32_t y = 0; y < height; y++)
+			k->fromRgb565Row(reinterpret_cast<uint32_t *>(d + y * dstPitch),
+					reinterpret_cast<const uint16_t *>(s + y * srcPitch), width);
+	}else{
+		return false;
+	}
+
+	fence(nonTemporal);
+	return true;
+}
+
+void blendRect(void *dst, size_t dstPitch, const void *src, size_t srcPitch,
+		uint32_t width, uint32_t height) {
+	auto d = reinterpret_cast<char *>(dst);
+	auto s = reinterpret_cast<const char *>(src);
+	for(uint32_t y = 0; y < height; y++)
+		activeKernels->blendRow(reinterpret_cast<uint32_t *>(d + y * dstPitch),
+				reinterpret_cast<const uint32_t *>(s + y * srcPitch), width);
+}
+
+} // namespace drm_core
@@ -55,4 +55,17 @@ uint8_t getFormatBpp(const FormatInfo &info, size_t plane) {
 	return info.char_per_block[plane] * 8 / (getFormatBlockWidth(info, plane) * getFormatBlockHeight(info, plane));
 }
 
+std::optional<BlitFormat> blitFormatFromFourcc(uint32_t fourcc) {
+	switch(fourcc) {
+	case DRM_FORMAT_XRGB8888:
+		return BlitFormat::xrgb8888;
+	case DRM_FORMAT_ARGB8888:
+		return BlitFormat::argb8888;
+	case DRM_FORMAT_RGB565:
+		return BlitFormat::rgb565;
+	default:
+		return std::nullopt;
+	}
+}
+
 } // namespace drm_core
@@ -651,7 +651,7 @@ drm_core::File::ioctl(void *object, uint32_t id, helix_ng::RecvInlineResult msg,
 			managarm::fs::GenericIoctlReply resp;
 
 			if(logDrmRequests)
-				std::cout << "core/drm: DIRTYFB()" << std::endl;
+				std::cout << "core/drm: DIRTYFB(" << req->drm_clips_size() << " clips)" << std::endl;
 
 			resp.set_error(managarm::fs::Errors::SUCCESS);
 
@@ -661,7 +661,22 @@ drm_core::File::ioctl(void *object, uint32_t id, helix_ng::RecvInlineResult msg,
 			} else {
 				auto fb = obj->asFrameBuffer();
 				assert(fb);
-				fb->notifyDirty();
+
+				std::vector<drm_core::DamageRect> clips;
+				for(size_t i = 0; i < req->drm_clips_size(); i++) {
+					auto &clip = req->drm_clips(i);
+					if(clip.x1() < 0 || clip.y1() < 0 || clip.x2() < clip.x1() || clip.y2() < clip.y1())
+						continue;
+					clips.push_back({static_cast<uint32_t>(clip.x1()), static_cast<uint32_t>(clip.y1()),
+							static_cast<uint32_t>(clip.x2()), static_cast<uint32_t>(clip.y2())});
+				}
+
+				// Do not turn a list of invalid clips into a full damage.
+				if(clips.empty() && req->drm_clips_size()) {
+					resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+				}else{
+					fb->markDirty(clips);
+				}
 			}
 
 			auto ser = resp.SerializeAsString();
@@ -181,6 +181,23 @@ void drm_core::FrameBuffer::setFormat(uint32_t format) {
 	_format = format;
 }
 
+void drm_core::FrameBuffer::markDirty(std::span<const DamageRect> clips) {
+	if(clips.empty()) {
+		_damage.addAll(getWidth(), getHeight());
+	}else{
+		for(auto &clip : clips)
+			_damage.add(clip);
+	}
+	notifyDirty();
+}
+
+drm_core::DamageRegion drm_core::FrameBuffer::takeDamage() {
+	auto damage = std::move(_damage);
+	_damage.clear();
+	damage.clipTo(getWidth(), getHeight());
+	return damage;
+}
+
 // ----------------------------------------------------------------
 // Plane
 // ----------------------------------------------------------------
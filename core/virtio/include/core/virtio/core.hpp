@@ -68,15 +68,36 @@ enum {
 	DEVICE_NEEDS_RESET = 64
 };
 
+// Feature bits that concern the transport and the virtqs (rather than the device type).
+// Transports negotiate them on their own in Transport::finalizeFeatures().
+enum {
+	VIRTIO_F_INDIRECT_DESC = 28,
+	VIRTIO_F_EVENT_IDX = 29,
+	VIRTIO_F_VERSION_1 = 32,
+	VIRTIO_F_RING_PACKED = 34
+};
+
 enum {
 	// Bits of the spec::Descriptor::flags field.
 	VIRTQ_DESC_F_NEXT = 1, // descriptor is part of a chain
 	VIRTQ_DESC_F_WRITE = 2, // buffer is written by device
+	VIRTQ_DESC_F_INDIRECT = 4, // buffer contains a table of descriptors
+
+	// Additional bits of the spec::PackedDescriptor::flags field.
+	VIRTQ_DESC_F_AVAIL = 1 << 7,
+	VIRTQ_DESC_F_USED = 1 << 15,
 
 	// Bits of the spec::UsedRing::flags field.
 	VIRTQ_USED_F_NO_NOTIFY = 1 // no need to notify the device
 };
 
+// Values of the spec::EventSuppression::flags field.
+enum {
+	RING_EVENT_FLAGS_ENABLE = 0,
+	RING_EVENT_FLAGS_DISABLE = 1,
+	RING_EVENT_FLAGS_DESC = 2 // only send events for the descriptor in offWrap
+};
+
 namespace spec {
 	struct Descriptor {
 		arch::scalar_variable<uint64_t> address;
@@ -122,6 +143,24 @@ namespace spec {
 
 		arch::scalar_variable<uint16_t> eventIndex;
 	};
+
+	// Descriptors of packed virtqs. These are also used for indirect tables of packed virtqs.
+	struct PackedDescriptor {
+		arch::scalar_variable<uint64_t> address;
+		arch::scalar_variable<uint32_t> length;
+		arch::scalar_variable<uint16_t> id;
+		arch::scalar_variable<uint16_t> flags;
+	};
+	static_assert(sizeof(PackedDescriptor) == 16);
+
+	// Driver and device event suppression areas of packed virtqs.
+	struct EventSuppression {
+		// Ring offset (bits 0 to 14) and wrap counter (bit 15) of the descriptor
+		// that an event is requested for (if flags is RING_EVENT_FLAGS_DESC).
+		arch::scalar_variable<uint16_t> offWrap;
+		arch::scalar_variable<uint16_t> flags;
+	};
+	static_assert(sizeof(EventSuppression) == 4);
 };
 
 struct DeviceSpace;
@@ -136,14 +175,25 @@ struct QueueInfo {
 	ptrdiff_t notifyOffset;
 };
 
+// Virtq features that the transport negotiated; they apply to all virtqs of a device.
+struct RingFeatures {
+	// VIRTIO_F_EVENT_IDX: the driver and the device only notify each other
+	// when the other side asks for it.
+	bool eventIdx = false;
+	// VIRTIO_F_INDIRECT_DESC: long chains only take a single descriptor of the virtq.
+	bool indirect = false;
+	// VIRTIO_F_RING_PACKED: the virtq uses the packed layout instead of the split layout.
+	bool packed = false;
+};
+
 /* This class represents a virtio device.
  * 
  * Usual initialization works as follows:
  * - Call discover() to obtain a transport.
  * - Negotiate features via Transport::checkDeviceFeature() / acknowledgeDriverFeature().
- * - Call Transport::finalizeFeatures().
+ * - Call Transport::finalizeFeatures(); this also negotiates the RingFeatures.
  * - Call Transport::claimQueues().
- * - Call Transport::setupQueue() for each virtq.
+ * - Call Transport::setupQueue() for each virtq that is used; the others stay disabled.
  * - Call Transport::runDevice().
  */
 struct Transport {
@@ -166,6 +216,17 @@ struct Transport {
 	virtual Queue *setupQueue(unsigned int index) = 0;
 
 	virtual void runDevice() = 0;
+
+	const RingFeatures &ringFeatures() {
+		return _ringFeatures;
+	}
+
+protected:
+	// Acknowledges the virtq features that the device offers.
+	// Called by finalizeFeatures(); packed virtqs need VIRTIO_F_VERSION_1.
+	void _negotiateRingFeatures(bool allowPacked);
+
+	RingFeatures _ringFeatures;
 };
 
 struct DeviceSpace {
@@ -290,12 +351,28 @@ struct Request {
 	size_t len = 0;
 };
 
+struct QueueStats {
+	// Number of notify() calls that notified the device,
+	// and number of calls that were suppressed by the device.
+	uint64_t notifications = 0;
+	uint64_t suppressedNotifications = 0;
+	// Number of processInterrupt() calls that found completed requests
+	// (i.e., interrupts that concerned this virtq), and number of completed requests.
+	uint64_t interrupts = 0;
+	uint64_t completions = 0;
+	// Number of chains that were posted as indirect tables.
+	uint64_t indirectChains = 0;
+};
+
 // Represents a single virtq.
 struct Queue {
 	friend struct Handle;
 
-	Queue(unsigned int queue_index, size_t queue_size, spec::Descriptor *table,
-			spec::AvailableRing *available, spec::UsedRing *used);
+	// For split virtqs, descriptors points to the descriptor table, driver_area to the
+	// available ring and device_area to the used ring. For packed virtqs, they point to
+	// the descriptor ring and the driver and device event suppression areas.
+	Queue(unsigned int queue_index, size_t queue_size, RingFeatures features,
+			void *descriptors, void *driver_area, void *device_area);
 protected:
 	~Queue() = default;
 
@@ -313,11 +390,14 @@ public:
 	// The descriptor is automatically freed when the device returns it.
 	async::result<Handle> obtainDescriptor();
 
-	// Posts a descriptor to the virtq's available ring.
+	// Makes a descriptor chain available to the device. With VIRTIO_F_INDIRECT_DESC,
+	// chains of more than two descriptors are moved to an indirect table; all but the
+	// first descriptor are freed immediately.
 	void postDescriptor(Handle descriptor, Request *request,
 			void (*complete)(Request *));
 
-	// Notifies the device that new descriptors have been posted.
+	// Notifies the device that new descriptors have been posted
+	// (unless the device does not need a notification).
 	void notify();
 
 	async::result<size_t> submitDescriptor(Handle descriptor) {
@@ -337,25 +417,57 @@ public:
 	}
 
 	// Processes interrupts for this virtq.
-	// Calls retrieveDescriptor() to complete individual requests.
+	// Calls the completion handlers of all requests that the device has completed.
 	void processInterrupt();
 
+	const QueueStats &stats() {
+		return _stats;
+	}
+
 protected:
 	virtual void notifyTransport() = 0;
 
 private:
+	// Number of descriptors that fit into an indirect table (one page).
+	static constexpr size_t indirectTableSize = 0x1000 / sizeof(spec::Descriptor);
+
+	// Replaces the chain of the given length that starts at head by an indirect table.
+	void _makeIndirect(size_t head, size_t length);
+	void _postPacked(size_t head, size_t length);
+	bool _completeSplit();
+	bool _completePacked();
+	void _complete(size_t head, size_t len);
+
 	// Index of this queue as part of its owning device.
 	unsigned int _queueIndex;
 
 	// Number of descriptors in this queue.
 	size_t _queueSize;
 
-	// Pointers to different data structures of this virtq.
+	RingFeatures _features;
+
+	// Descriptor table that Handles refer to. For split virtqs, this is the virtq's
+	// descriptor table; packed virtqs copy the descriptors into the ring when they
+	// are posted and use the table index of the first descriptor as the buffer ID.
 	spec::Descriptor *_table;
-	spec::AvailableRing *_availableRing;
-	spec::UsedRing *_usedRing;
-	spec::AvailableExtra *_availableExtra;
-	spec::UsedExtra *_usedExtra;
+	std::unique_ptr<spec::Descriptor[]> _packedTable;
+
+	// Pointers to different data structures of split virtqs.
+	spec::AvailableRing *_availableRing = nullptr;
+	spec::UsedRing *_usedRing = nullptr;
+	spec::AvailableExtra *_availableExtra = nullptr;
+	spec::UsedExtra *_usedExtra = nullptr;
+
+	// Pointers to different data structures of packed virtqs.
+	spec::PackedDescriptor *_ring = nullptr;
+	spec::EventSuppression *_driverEvent = nullptr;
+	spec::EventSuppression *_deviceEvent = nullptr;
+	// Next ring entry that we write, and the wrap counters of the driver and the device.
+	uint16_t _nextAvailable = 0;
+	bool _availableWrap = true;
+	bool _usedWrap = true;
+	// Number of ring entries that each posted chain takes (indexed by buffer ID).
+	std::vector<uint16_t> _chainLengths;
 
 	// Keeps track of unused descriptor indices.
 	std::vector<uint16_t> _descriptorStack;
@@ -364,8 +476,17 @@ private:
 
 	std::vector<Request *> _activeRequests;
 
-	// Keeps track of which entries in the used ring have already been processed.
+	// Indirect tables (indexed by the first descriptor of the chain); allocated on first use.
+	std::vector<void *> _indirectTables;
+
+	// Keeps track of which entries in the used ring (or in the descriptor ring of
+	// packed virtqs) have already been processed.
 	uint16_t _progressHead;
+
+	// Number of ring entries that were made available since the last notification.
+	uint16_t _unnotified = 0;
+
+	QueueStats _stats;
 };
 
 } // namespace virtio_core
@@ -1,5 +1,6 @@
 
 #include <assert.h>
+#include <atomic>
 #include <iostream>
 #include <unordered_map>
 #include <optional>
@@ -67,6 +68,77 @@ private:
 	size_t _size;
 };
 
+namespace {
+
+// Memory of a virtq, see the Queue constructor.
+struct RingMemory {
+	void *descriptors;
+	void *driverArea;
+	void *deviceArea;
+};
+
+// Allocates physically contiguous memory for a virtq.
+// Legacy transports require the used ring to be page aligned.
+RingMemory allocateRing(size_t queue_size, bool packed, size_t used_align) {
+	size_t driver_offset;
+	size_t device_offset;
+	size_t region_size;
+	if(packed) {
+		driver_offset = queue_size * sizeof(spec::PackedDescriptor);
+		device_offset = driver_offset + sizeof(spec::EventSuppression);
+		region_size = device_offset + sizeof(spec::EventSuppression);
+	}else{
+		constexpr size_t available_align = 2;
+
+		driver_offset = (queue_size * sizeof(spec::Descriptor)
+					+ (available_align - 1))
+				& ~size_t(available_align - 1);
+		device_offset = (driver_offset + sizeof(spec::AvailableRing)
+					+ queue_size * sizeof(spec::AvailableRing::Element)
+					+ sizeof(spec::AvailableExtra) + (used_align - 1))
+				& ~size_t(used_align - 1);
+		region_size = device_offset + sizeof(spec::UsedRing)
+				+ queue_size * sizeof(spec::UsedRing::Element)
+				+ sizeof(spec::UsedExtra);
+	}
+
+	// Allocate physical memory for the virtq structs.
+	auto memory_size = (region_size + 0xFFF) & ~size_t(0xFFF);
+	HelHandle memory;
+	void *window;
+	HEL_CHECK(helAllocateMemory(memory_size, kHelAllocContinuous, nullptr, &memory));
+	HEL_CHECK(helMapMemory(memory, kHelNullHandle, nullptr,
+			0, memory_size, kHelMapProtRead | kHelMapProtWrite, &window));
+	HEL_CHECK(helCloseDescriptor(kHelThisUniverse, memory));
+
+	return {
+		window,
+		reinterpret_cast<char *>(window) + driver_offset,
+		reinterpret_cast<char *>(window) + device_offset
+	};
+}
+
+} // anonymous namespace
+
+// --------------------------------------------------------
+// Transport
+// --------------------------------------------------------
+
+void Transport::_negotiateRingFeatures(bool allowPacked) {
+	if(checkDeviceFeature(VIRTIO_F_INDIRECT_DESC)) {
+		acknowledgeDriverFeature(VIRTIO_F_INDIRECT_DESC);
+		_ringFeatures.indirect = true;
+	}
+	if(checkDeviceFeature(VIRTIO_F_EVENT_IDX)) {
+		acknowledgeDriverFeature(VIRTIO_F_EVENT_IDX);
+		_ringFeatures.eventIdx = true;
+	}
+	if(allowPacked && checkDeviceFeature(VIRTIO_F_RING_PACKED)) {
+		acknowledgeDriverFeature(VIRTIO_F_RING_PACKED);
+		_ringFeatures.packed = true;
+	}
+}
+
 // --------------------------------------------------------
 // LegacyPciTransport
 // --------------------------------------------------------
@@ -112,8 +184,8 @@ private:
 
 struct LegacyPciQueue final : Queue {
 	LegacyPciQueue(LegacyPciTransport *transport,
-			unsigned int queue_index, size_t queue_size,
-			spec::Descriptor *table, spec::AvailableRing *available, spec::UsedRing *used);
+			unsigned int queue_index, size_t queue_size, RingFeatures features,
+			RingMemory memory);
 
 protected:
 	void notifyTransport() override;
@@ -155,7 +227,8 @@ void LegacyPciTransport::acknowledgeDriverFeature(unsigned int feature) {
 }
 
 void LegacyPciTransport::finalizeFeatures() {
-	// Does nothing for now.
+	// Legacy devices cannot offer VIRTIO_F_RING_PACKED.
+	_negotiateRingFeatures(false);
 }
 
 void LegacyPciTransport::claimQueues(unsigned int max_index) {
@@ -172,39 +245,13 @@ Queue *LegacyPciTransport::setupQueue(unsigned int queue_index) {
 
 	// TODO: Ensure that the queue size is indeed a power of 2.
 
-	// Determine the queue size in bytes.
-	constexpr size_t available_align = 2;
-	constexpr size_t used_align = 4096;
-
-	auto available_offset = (queue_size * sizeof(spec::Descriptor)
-				+ (available_align - 1))
-			& ~size_t(available_align - 1);
-	auto used_offset = (available_offset + queue_size * sizeof(spec::AvailableRing::Element)
-				+ sizeof(spec::AvailableExtra) + (used_align - 1))
-			& ~size_t(used_align - 1);
-
-	auto region_size = used_offset + queue_size * sizeof(spec::UsedRing::Element)
-				+ sizeof(spec::UsedExtra);
-
-	// Allocate physical memory for the virtq structs.
-	assert(region_size < 0x4000); // FIXME: do not hardcode 0x4000
-	HelHandle memory;
-	void *window;
-	HEL_CHECK(helAllocateMemory(0x4000, kHelAllocContinuous, nullptr, &memory));
-	HEL_CHECK(helMapMemory(memory, kHelNullHandle, nullptr,
-			0, 0x4000, kHelMapProtRead | kHelMapProtWrite, &window));
-	HEL_CHECK(helCloseDescriptor(kHelThisUniverse, memory));
-
-	// Setup the memory region.
-	auto table = reinterpret_cast<spec::Descriptor *>((char *)window);
-	auto available = reinterpret_cast<spec::AvailableRing *>((char *)window + available_offset);
-	auto used = reinterpret_cast<spec::UsedRing *>((char *)window + used_offset);
+	auto memory = allocateRing(queue_size, false, 0x1000);
 	_queues[queue_index] = std::make_unique<LegacyPciQueue>(this, queue_index, queue_size,
-			table, available, used);
+			_ringFeatures, memory);
 
 	// Hand the queue to the device.
 	uintptr_t table_physical;
-	HEL_CHECK(helPointerPhysical(table, &table_physical));
+	HEL_CHECK(helPointerPhysical(memory.descriptors, &table_physical));
 	_legacySpace.store(PCI_L_QUEUE_ADDRESS, table_physical >> 12);
 
 	return _queues[queue_index].get();
@@ -245,14 +292,17 @@ async::detached LegacyPciTransport::_processIrqs() {
 		}
 		if(isr & 1)
 			for(auto &queue : _queues)
-				queue->processInterrupt();
+				if(queue)
+					queue->processInterrupt();
 	}
 }
 
 LegacyPciQueue::LegacyPciQueue(LegacyPciTransport *transport,
-		unsigned int queue_index, size_t queue_size,
-		spec::Descriptor *table, spec::AvailableRing *available, spec::UsedRing *used)
-: Queue{queue_index, queue_size, table, available, used}, _transport{transport} { }
+		unsigned int queue_index, size_t queue_size, RingFeatures features,
+		RingMemory memory)
+: Queue{queue_index, queue_size, features,
+		memory.descriptors, memory.driverArea, memory.deviceArea},
+		_transport{transport} { }
 
 void LegacyPciQueue::notifyTransport() {
 	_transport->_legacySpace.store(PCI_L_QUEUE_NOTIFY, queueIndex());
@@ -322,9 +372,8 @@ private:
 
 struct StandardPciQueue final : Queue {
 	StandardPciQueue(StandardPciTransport *transport,
-			unsigned int queue_index, size_t queue_size,
-			spec::Descriptor *table, spec::AvailableRing *available, spec::UsedRing *used,
-			arch::scalar_register<uint16_t> notify_register);
+			unsigned int queue_index, size_t queue_size, RingFeatures features,
+			RingMemory memory, arch::scalar_register<uint16_t> notify_register);
 
 protected:
 	void notifyTransport() override;
@@ -372,8 +421,9 @@ void StandardPciTransport::acknowledgeDriverFeature(unsigned int feature) {
 }
 
 void StandardPciTransport::finalizeFeatures() {
-	assert(checkDeviceFeature(32));
-	acknowledgeDriverFeature(32);
+	assert(checkDeviceFeature(VIRTIO_F_VERSION_1));
+	acknowledgeDriverFeature(VIRTIO_F_VERSION_1);
+	_negotiateRingFeatures(true);
 
 	_commonSpace().store(PCI_DEVICE_STATUS, _commonSpace().load(PCI_DEVICE_STATUS) | FEATURES_OK);
 	auto confirm = _commonSpace().load(PCI_DEVICE_STATUS);
@@ -393,44 +443,18 @@ Queue *StandardPciTransport::setupQueue(unsigned int queue_index) {
 	auto notify_index = _commonSpace().load(PCI_QUEUE_NOTIFY);
 	assert(queue_size);
 
-	// TODO: Ensure that the queue size is indeed a power of 2.
-
-	// Determine the queue size in bytes.
-	constexpr size_t available_align = 2;
-	constexpr size_t used_align = 4;
-
-	auto available_offset = (queue_size * sizeof(spec::Descriptor)
-				+ (available_align - 1))
-			& ~size_t(available_align - 1);
-	auto used_offset = (available_offset + queue_size * sizeof(spec::AvailableRing::Element)
-				+ sizeof(spec::AvailableExtra) + (used_align - 1))
-			& ~size_t(used_align - 1);
+	// TODO: For split virtqs, ensure that the queue size is indeed a power of 2.
 
-	auto region_size = used_offset + queue_size * sizeof(spec::UsedRing::Element)
-				+ sizeof(spec::UsedExtra);
-
-	// Allocate physical memory for the virtq structs.
-	assert(region_size < 0x4000); // FIXME: do not hardcode 0x4000
-	HelHandle memory;
-	void *window;
-	HEL_CHECK(helAllocateMemory(0x4000, kHelAllocContinuous, nullptr, &memory));
-	HEL_CHECK(helMapMemory(memory, kHelNullHandle, nullptr,
-			0, 0x4000, kHelMapProtRead | kHelMapProtWrite, &window));
-	HEL_CHECK(helCloseDescriptor(kHelThisUniverse, memory));
-
-	// Setup the memory region.
-	auto table = reinterpret_cast<spec::Descriptor *>((char *)window);
-	auto available = reinterpret_cast<spec::AvailableRing *>((char *)window + available_offset);
-	auto used = reinterpret_cast<spec::UsedRing *>((char *)window + used_offset);
+	auto memory = allocateRing(queue_size, _ringFeatures.packed, 4);
 	_queues[queue_index] = std::make_unique<StandardPciQueue>(this, queue_index, queue_size,
-			table, available, used,
+			_ringFeatures, memory,
 			arch::scalar_register<uint16_t>{_notifyMultiplier * notify_index});
 
 	// Hand the queue to the device.
 	uintptr_t table_physical, available_physical, used_physical;
-	HEL_CHECK(helPointerPhysical(table, &table_physical));
-	HEL_CHECK(helPointerPhysical(available, &available_physical));
-	HEL_CHECK(helPointerPhysical(used, &used_physical));
+	HEL_CHECK(helPointerPhysical(memory.descriptors, &table_physical));
+	HEL_CHECK(helPointerPhysical(memory.driverArea, &available_physical));
+	HEL_CHECK(helPointerPhysical(memory.deviceArea, &used_physical));
 	_commonSpace().store(PCI_QUEUE_TABLE[0], table_physical);
 	_commonSpace().store(PCI_QUEUE_TABLE[1], table_physical >> 32);
 	_commonSpace().store(PCI_QUEUE_AVAILABLE[0], available_physical);
@@ -526,7 +550,8 @@ async::detached StandardPciTransport::_processIrqs() {
 
 		if(await.bitset() & 1)
 			for(auto &queue : _queues)
-				queue->processInterrupt();
+				if(queue)
+					queue->processInterrupt();
 	}
 #else
 	co_await _hwDevice.enableBusIrq();
@@ -558,7 +583,8 @@ async::detached StandardPciTransport::_processIrqs() {
 
 		if(isr & 1)
 			for(auto &queue : _queues)
-				queue->processInterrupt();
+				if(queue)
+					queue->processInterrupt();
 	}
 #endif
 }
@@ -573,15 +599,16 @@ async::detached StandardPciTransport::_processQueueMsi() {
 		HEL_CHECK(helAcknowledgeIrq(_queueMsi.getHandle(), kHelAckAcknowledge, sequence));
 
 		for(auto &queue : _queues)
-			queue->processInterrupt();
+			if(queue)
+				queue->processInterrupt();
 	}
 }
 
 StandardPciQueue::StandardPciQueue(StandardPciTransport *transport,
-		unsigned int queue_index, size_t queue_size,
-		spec::Descriptor *table, spec::AvailableRing *available, spec::UsedRing *used,
-		arch::scalar_register<uint16_t> notify_register)
-: Queue{queue_index, queue_size, table, available, used},
+		unsigned int queue_index, size_t queue_size, RingFeatures features,
+		RingMemory memory, arch::scalar_register<uint16_t> notify_register)
+: Queue{queue_index, queue_size, features,
+		memory.descriptors, memory.driverArea, memory.deviceArea},
 		_transport{transport}, _notifyRegister{notify_register} { }
 
 void StandardPciQueue::notifyTransport() {
@@ -782,35 +809,66 @@ async::result<void> scatterGather(DeviceToHostType, Chain &chain, Queue *queue,
 // Queue
 // --------------------------------------------------------
 
-Queue::Queue(unsigned int queue_index, size_t queue_size, spec::Descriptor *table,
-		spec::AvailableRing *available, spec::UsedRing *used)
-: _queueIndex{queue_index}, _queueSize{queue_size}, _progressHead{0} {
+Queue::Queue(unsigned int queue_index, size_t queue_size, RingFeatures features,
+		void *descriptors, void *driver_area, void *device_area)
+: _queueIndex{queue_index}, _queueSize{queue_size}, _features{features}, _progressHead{0} {
 	// Construct the hardware state.
-	_table = new (table) spec::Descriptor[_queueSize];
-	_availableRing = new (available) spec::AvailableRing;
-	_usedRing = new (used) spec::UsedRing;
-	_availableExtra = new (spec::AvailableExtra::get(available, _queueSize)) spec::AvailableExtra;
-	_usedExtra = new (spec::UsedExtra::get(used, _queueSize)) spec::UsedExtra;
-
-	// Initializing the table as 0xFFFF helps debugging
-	// as qemu complains if it encounters illegal values.
+	if(_features.packed) {
+		_ring = new (descriptors) spec::PackedDescriptor[_queueSize];
+		_driverEvent = new (driver_area) spec::EventSuppression;
+		_deviceEvent = new (device_area) spec::EventSuppression;
+
+		// Neither the AVAIL nor the USED bit is set, i.e., the device does not
+		// consider the descriptors available until we wrap around once.
+		for(size_t i = 0; i < _queueSize; i++) {
+			_ring[i].address.store(0);
+			_ring[i].length.store(0);
+			_ring[i].id.store(0);
+			_ring[i].flags.store(0);
+		}
 
-	_availableRing->flags.store(0);
-	_availableRing->headIndex.store(0);
-	for(size_t i = 0; i < _queueSize; i++)
-		_availableRing->elements[i].tableIndex.store(0xFFFF);
-	_availableExtra->eventIndex.store(0);
+		// With VIRTIO_F_EVENT_IDX, processInterrupt() moves the event forward.
+		if(_features.eventIdx) {
+			_driverEvent->offWrap.store(1 << 15);
+			_driverEvent->flags.store(RING_EVENT_FLAGS_DESC);
+		}else{
+			_driverEvent->offWrap.store(0);
+			_driverEvent->flags.store(RING_EVENT_FLAGS_ENABLE);
+		}
 
-	_usedRing->flags.store(0);
-	_usedRing->headIndex.store(0);
-	for(size_t i = 0; i < _queueSize; i++)
-		_usedRing->elements[i].tableIndex.store(0xFFFF);
-	_usedExtra->eventIndex.store(0);
+		_packedTable = std::make_unique<spec::Descriptor[]>(_queueSize);
+		_table = _packedTable.get();
+		_chainLengths.resize(_queueSize);
+	}else{
+		_table = new (descriptors) spec::Descriptor[_queueSize];
+		_availableRing = new (driver_area) spec::AvailableRing;
+		_usedRing = new (device_area) spec::UsedRing;
+		_availableExtra = new (spec::AvailableExtra::get(_availableRing, _queueSize))
+				spec::AvailableExtra;
+		_usedExtra = new (spec::UsedExtra::get(_usedRing, _queueSize)) spec::UsedExtra;
+
+		// Initializing the table as 0xFFFF helps debugging
+		// as qemu complains if it encounters illegal values.
+
+		_availableRing->flags.store(0);
+		_availableRing->headIndex.store(0);
+		for(size_t i = 0; i < _queueSize; i++)
+			_availableRing->elements[i].tableIndex.store(0xFFFF);
+		_availableExtra->eventIndex.store(0);
+
+		_usedRing->flags.store(0);
+		_usedRing->headIndex.store(0);
+		for(size_t i = 0; i < _queueSize; i++)
+			_usedRing->elements[i].tableIndex.store(0xFFFF);
+		_usedExtra->eventIndex.store(0);
+	}
 
 	// Construct the software state.
 	for(size_t i = 0; i < _queueSize; i++)
 		_descriptorStack.push_back(i);
 	_activeRequests.resize(_queueSize);
+	if(_features.indirect)
+		_indirectTables.resize(_queueSize);
 }
 
 async::result<Handle> Queue::obtainDescriptor() {
@@ -834,60 +892,263 @@ async::result<Handle> Queue::obtainDescriptor() {
 
 void Queue::postDescriptor(Handle handle, Request *request,
 		void (*complete)(Request *)) {
+	assert(request);
 	request->complete = complete;
 
-	assert(request);
-	assert(!_activeRequests[handle.tableIndex()]);
-	_activeRequests[handle.tableIndex()] = request;
+	auto head = handle.tableIndex();
+	assert(!_activeRequests[head]);
+	_activeRequests[head] = request;
+
+	size_t length = 1;
+	for(auto index = head; _table[index].flags.load() & VIRTQ_DESC_F_NEXT;
+			index = _table[index].next.load())
+		length++;
+
+	// For short chains, the additional indirection costs more than the descriptors that it saves.
+	bool indirect = _features.indirect && length > 2 && length <= indirectTableSize;
+	if(indirect) {
+		_makeIndirect(head, length);
+		length = 1;
+	}
+
+	if(_features.packed) {
+		_postPacked(head, length);
+	}else{
+		auto enqueue_head = _availableRing->headIndex.load();
+		auto ring_index = enqueue_head & (_queueSize - 1);
+		_availableRing->elements[ring_index].tableIndex.store(head);
+
+		asm volatile ( "" : : : "memory" );
+		_availableRing->headIndex.store(enqueue_head + 1);
+		_unnotified++;
+	}
+
+	// Wake up waiters for the descriptors that _makeIndirect() freed only now
+	// such that they do not interfere with posting this chain.
+	if(indirect)
+		_descriptorDoorbell.raise();
+}
+
+void Queue::_makeIndirect(size_t head, size_t length) {
+	auto &table = _indirectTables[head];
+	if(!table) {
+		HelHandle memory;
+		HEL_CHECK(helAllocateMemory(0x1000, kHelAllocContinuous, nullptr, &memory));
+		HEL_CHECK(helMapMemory(memory, kHelNullHandle, nullptr,
+				0, 0x1000, kHelMapProtRead | kHelMapProtWrite, &table));
+		HEL_CHECK(helCloseDescriptor(kHelThisUniverse, memory));
+	}
+
+	// Copy the chain into the table and free all descriptors but the first one.
+	auto index = head;
+	for(size_t i = 0; i < length; i++) {
+		auto descriptor = _table + index;
+		auto flags = descriptor->flags.load();
+		if(_features.packed) {
+			// Entries of packed indirect tables are chained implicitly.
+			auto entry = static_cast<spec::PackedDescriptor *>(table) + i;
+			entry->address.store(descriptor->address.load());
+			entry->length.store(descriptor->length.load());
+			entry->id.store(0);
+			entry->flags.store(flags & VIRTQ_DESC_F_WRITE);
+		}else{
+			auto entry = static_cast<spec::Descriptor *>(table) + i;
+			entry->address.store(descriptor->address.load());
+			entry->length.store(descriptor->length.load());
+			entry->flags.store(flags & (VIRTQ_DESC_F_NEXT | VIRTQ_DESC_F_WRITE));
+			entry->next.store(i + 1);
+		}
+
+		auto successor = descriptor->next.load();
+		if(index != head)
+			_descriptorStack.push_back(index);
+		index = successor;
+	}
+
+	uintptr_t physical;
+	HEL_CHECK(helPointerPhysical(table, &physical));
+	_table[head].address.store(physical);
+	_table[head].length.store(length * sizeof(spec::Descriptor));
+	_table[head].flags.store(VIRTQ_DESC_F_INDIRECT);
+	_stats.indirectChains++;
+}
 
-	auto enqueue_head = _availableRing->headIndex.load();
-	auto ring_index = enqueue_head & (_queueSize - 1);
-	_availableRing->elements[ring_index].tableIndex.store(handle.tableIndex());
+void Queue::_postPacked(size_t head, size_t length) {
+	// The device may start processing the chain as soon as its first descriptor
+	// is available; hence, that descriptor's flags are written last.
+	auto first = _ring + _nextAvailable;
+	uint16_t first_flags = 0;
+
+	auto index = head;
+	for(size_t i = 0; i < length; i++) {
+		auto descriptor = _table + index;
+		auto entry = _ring + _nextAvailable;
+		uint16_t flags = descriptor->flags.load()
+				& (VIRTQ_DESC_F_NEXT | VIRTQ_DESC_F_WRITE | VIRTQ_DESC_F_INDIRECT);
+		flags |= _availableWrap ? VIRTQ_DESC_F_AVAIL : VIRTQ_DESC_F_USED;
+
+		entry->address.store(descriptor->address.load());
+		entry->length.store(descriptor->length.load());
+		entry->id.store(head);
+		if(i) {
+			entry->flags.store(flags);
+		}else{
+			first_flags = flags;
+		}
+
+		index = descriptor->next.load();
+		if(++_nextAvailable == _queueSize) {
+			_nextAvailable = 0;
+			_availableWrap = !_availableWrap;
+		}
+	}
+	_chainLengths[head] = length;
+	_unnotified += length;
 
 	asm volatile ( "" : : : "memory" );
-	_availableRing->headIndex.store(enqueue_head + 1);
+	first->flags.store(first_flags);
 }
 
 void Queue::notify() {
-	asm volatile ( "" : : : "memory" );
-	if(!(_usedRing->flags.load() & VIRTQ_USED_F_NO_NOTIFY))
+	auto added = _unnotified;
+	if(!added)
+		return;
+	_unnotified = 0;
+
+	// The device must see the new descriptors before we read whether it wants a notification.
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	// With VIRTIO_F_EVENT_IDX, the device asks to be notified once a given descriptor
+	// becomes available; otherwise, it can only turn notifications off entirely.
+	bool needed;
+	if(_features.packed) {
+		auto flags = _deviceEvent->flags.load();
+		if(flags == RING_EVENT_FLAGS_DESC) {
+			auto off_wrap = _deviceEvent->offWrap.load();
+			uint16_t event = off_wrap & 0x7FFF;
+			if(bool(off_wrap >> 15) != _availableWrap)
+				event -= _queueSize;
+			needed = uint16_t(_nextAvailable - event - 1) < added;
+		}else{
+			needed = flags != RING_EVENT_FLAGS_DISABLE;
+		}
+	}else if(_features.eventIdx) {
+		uint16_t head = _availableRing->headIndex.load();
+		needed = uint16_t(head - _usedExtra->eventIndex.load() - 1) < added;
+	}else{
+		needed = !(_usedRing->flags.load() & VIRTQ_USED_F_NO_NOTIFY);
+	}
+
+	if(needed) {
+		_stats.notifications++;
 		notifyTransport();
+	}else{
+		_stats.suppressedNotifications++;
+	}
 }
 
 void Queue::processInterrupt() {
+	bool progress = _features.packed ? _completePacked() : _completeSplit();
+	if(progress)
+		_stats.interrupts++;
+}
+
+bool Queue::_completeSplit() {
+	bool progress = false;
 	while(true) {
 		auto used_head = _usedRing->headIndex.load();
 
-		if((_progressHead & 0xFFFF) == used_head)
-			break;
+		if((_progressHead & 0xFFFF) == used_head) {
+			if(!_features.eventIdx)
+				break;
+
+			// Ask for an interrupt once the device uses the next entry. Entries that the
+			// device used before it saw the new event index do not trigger an interrupt,
+			// so check again afterwards.
+			_availableExtra->eventIndex.store(_progressHead);
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(_usedRing->headIndex.load() == used_head)
+				break;
+			continue;
+		}
 
 		asm volatile ( "" : : : "memory" );
 
 		auto ring_index = _progressHead & (_queueSize - 1);
 		auto table_index = _usedRing->elements[ring_index].tableIndex.load();
 		assert(table_index < _queueSize);
+		_complete(table_index, _usedRing->elements[ring_index].written.load());
+
+		_progressHead++;
+		progress = true;
+	}
+	return progress;
+}
+
+bool Queue::_completePacked() {
+	// The device marks a chain as used by writing its buffer ID into the ring entry
+	// of the chain's first descriptor and setting both the AVAIL and USED bits
+	// to its wrap counter.
+	auto isUsed = [this] (uint16_t flags) {
+		bool available = flags & VIRTQ_DESC_F_AVAIL;
+		bool used = flags & VIRTQ_DESC_F_USED;
+		return available == used && used == _usedWrap;
+	};
+
+	bool progress = false;
+	while(true) {
+		auto entry = _ring + _progressHead;
+
+		if(!isUsed(entry->flags.load())) {
+			if(!_features.eventIdx)
+				break;
 
-		// Dequeue the Request object.
-		auto request = _activeRequests[table_index];
-		assert(request);
-		request->len = _usedRing->elements[ring_index].written.load();
-		_activeRequests[table_index] = nullptr;
-
-		// Free all descriptors in the descriptor chain.
-		auto chain_index = table_index;
-		while(_table[chain_index].flags.load() & VIRTQ_DESC_F_NEXT) {
-			auto successor = _table[chain_index].next.load();
-			_descriptorStack.push_back(chain_index);
-			chain_index = successor;
+			// See _completeSplit().
+			_driverEvent->offWrap.store(_progressHead | (_usedWrap << 15));
+			std::atomic_thread_fence(std::memory_order_seq_cst);
+			if(!isUsed(entry->flags.load()))
+				break;
 		}
-		_descriptorStack.push_back(chain_index);
-		_descriptorDoorbell.raise();
 
-		// Call the completion handler.
-		request->complete(request);
+		asm volatile ( "" : : : "memory" );
 
-		_progressHead++;
+		auto id = entry->id.load();
+		assert(id < _queueSize);
+		auto len = entry->length.load();
+
+		_progressHead += _chainLengths[id];
+		if(_progressHead >= _queueSize) {
+			_progressHead -= _queueSize;
+			_usedWrap = !_usedWrap;
+		}
+
+		_complete(id, len);
+		progress = true;
 	}
+	return progress;
+}
+
+void Queue::_complete(size_t head, size_t len) {
+	// Dequeue the Request object.
+	auto request = _activeRequests[head];
+	assert(request);
+	request->len = len;
+	_activeRequests[head] = nullptr;
+
+	// Free all descriptors in the descriptor chain.
+	// Indirect chains only consist of their first descriptor at this point.
+	auto chain_index = head;
+	while(_table[chain_index].flags.load() & VIRTQ_DESC_F_NEXT) {
+		auto successor = _table[chain_index].next.load();
+		_descriptorStack.push_back(chain_index);
+		chain_index = successor;
+	}
+	_descriptorStack.push_back(chain_index);
+	_descriptorDoorbell.raise();
+
+	// Call the completion handler.
+	_stats.completions++;
+	request->complete(request);
 }
 
 } // namespace virtio_core
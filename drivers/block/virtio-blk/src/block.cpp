@@ -2,6 +2,9 @@
 #include <stdlib.h>
 #include <iostream>
 
+#include <helix/timer.hpp>
+#include <protocols/ostrace/ostrace.hpp>
+
 #include "block.hpp"
 
 namespace block {
@@ -9,6 +12,29 @@ namespace virtio {
 
 static bool logInitiateRetire = false;
 
+namespace {
+
+// All counters are cumulative since the device was set up.
+constinit protocols::ostrace::Event ostEvtQueueStats{"virtio-blk.queueStats"};
+constinit protocols::ostrace::UintAttribute ostAttrNotifications{"notifications"};
+constinit protocols::ostrace::UintAttribute ostAttrSuppressed{"suppressedNotifications"};
+constinit protocols::ostrace::UintAttribute ostAttrInterrupts{"interrupts"};
+constinit protocols::ostrace::UintAttribute ostAttrCompletions{"completions"};
+constinit protocols::ostrace::UintAttribute ostAttrIndirectChains{"indirectChains"};
+
+protocols::ostrace::Vocabulary ostVocabulary{
+	ostEvtQueueStats,
+	ostAttrNotifications,
+	ostAttrSuppressed,
+	ostAttrInterrupts,
+	ostAttrCompletions,
+	ostAttrIndirectChains,
+};
+
+protocols::ostrace::Context ostContext{ostVocabulary};
+
+} // anonymous namespace
+
 // --------------------------------------------------------
 // UserRequest
 // --------------------------------------------------------
@@ -45,6 +71,7 @@ void Device::runDevice() {
 
 	// setup an interrupt for the device
 	_processRequests();
+	_reportStats();
 
 	blockfs::runDevice(this);
 }
@@ -156,4 +183,30 @@ async::detached Device::_processRequests() {
 	}
 }
 
+async::detached Device::_reportStats() {
+	co_await ostContext.create();
+	if(!ostContext.isActive())
+		co_return;
+
+	uint64_t lastCompletions = 0;
+	while(true) {
+		co_await helix::sleepFor(1'000'000'000);
+
+		// Do not emit anything while the device is idle.
+		auto &stats = _requestQueue->stats();
+		if(stats.completions == lastCompletions)
+			continue;
+		lastCompletions = stats.completions;
+
+		ostContext.emit(
+			ostEvtQueueStats,
+			ostAttrNotifications(stats.notifications),
+			ostAttrSuppressed(stats.suppressedNotifications),
+			ostAttrInterrupts(stats.interrupts),
+			ostAttrCompletions(stats.completions),
+			ostAttrIndirectChains(stats.indirectChains)
+		);
+	}
+}
+
 } } // namespace block::virtio
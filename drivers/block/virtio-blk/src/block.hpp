@@ -69,6 +69,9 @@ private:
 	// Submits requests from _pendingQueue to the device.
 	async::detached _processRequests();
 
+	// Periodically emits the statistics of the virtq to ostrace.
+	async::detached _reportStats();
+
 	std::unique_ptr<virtio_core::Transport> _transport;
 
 	// The single virtq of this device.
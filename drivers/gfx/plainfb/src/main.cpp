@@ -27,16 +27,11 @@
 
 GfxDevice::GfxDevice(protocols::hw::Device hw_device,
 		unsigned int screen_width, unsigned int screen_height,
-		size_t screen_pitch, helix::Mapping fb_mapping)
+		size_t screen_pitch, drm_core::BlitFormat screen_format, helix::Mapping fb_mapping)
 : _hwDevice{std::move(hw_device)},
 		_screenWidth{screen_width}, _screenHeight{screen_height},
-		_screenPitch{screen_pitch},_fbMapping{std::move(fb_mapping)} {
-	if((reinterpret_cast<uintptr_t>(_fbMapping.get()) & 15)) {
-		std::cout << "\e[31m" "gfx/plainfb: Hardware framebuffer is not aligned;"
-				" expect perfomance degradation!" "\e[39m" << std::endl;
-		_hardwareFbIsAligned = false;
-	}
-}
+		_screenPitch{screen_pitch}, _screenFormat{screen_format},
+		_fbMapping{std::move(fb_mapping)} { }
 
 async::result<std::unique_ptr<drm_core::Configuration>> GfxDevice::initialize() {
 	// Setup planes, encoders and CRTCs (i.e. the static entities).
@@ -219,27 +214,7 @@ async::detached GfxDevice::Configuration::_dispatch(std::unique_ptr<drm_core::At
 
 		if(plane_state->fb != nullptr) {
 			auto fb = static_pointer_cast<GfxDevice::FrameBuffer>(plane_state->fb);
-
-			auto bo = fb->getBufferObject();
-			auto dest = reinterpret_cast<char *>(_device->_fbMapping.get());
-			auto src = reinterpret_cast<char *>(bo->accessMapping());
-
-			auto minWidth = std::min(bo->getWidth(), _device->_screenWidth);
-			auto minHeight = std::min(bo->getHeight(), _device->_screenHeight);
-
-			if(fb->fastScanout()) {
-				for(unsigned int k = 0; k < minHeight; k++) {
-					drm_core::fastCopy16(dest, src, minWidth * 4);
-					dest += _device->_screenPitch;
-					src += fb->getPitch();
-				}
-			}else{
-				for(unsigned int k = 0; k < minHeight; k++) {
-					memcpy(dest, src, minWidth * 4);
-					dest += _device->_screenPitch;
-					src += fb->getPitch();
-				}
-			}
+			_device->_blit(fb.get(), {0, 0, fb->getWidth(), fb->getHeight()});
 		}
 	} else {
 		std::cout << "gfx/plainfb: Disable scanout" << std::endl;
@@ -248,6 +223,28 @@ async::detached GfxDevice::Configuration::_dispatch(std::unique_ptr<drm_core::At
 	complete();
 }
 
+void GfxDevice::_blit(FrameBuffer *fb, drm_core::DamageRect rect) {
+	auto bo = fb->getBufferObject();
+
+	rect = rect.intersect({0, 0, std::min(bo->getWidth(), _screenWidth),
+			std::min(bo->getHeight(), _screenHeight)});
+	if(rect.empty())
+		return;
+
+	auto srcFormat = drm_core::blitFormatFromFourcc(fb->format())
+			.value_or(drm_core::BlitFormat::xrgb8888);
+
+	auto dest = reinterpret_cast<char *>(_fbMapping.get())
+			+ rect.y1 * _screenPitch + rect.x1 * drm_core::blitFormatBytes(_screenFormat);
+	auto src = reinterpret_cast<char *>(bo->accessMapping())
+			+ rect.y1 * fb->getPitch() + rect.x1 * drm_core::blitFormatBytes(srcFormat);
+
+	// The hardware framebuffer is usually write-combined and never read back.
+	if(!drm_core::blitRect(dest, _screenPitch, _screenFormat, src, fb->getPitch(), srcFormat,
+			rect.width(), rect.height(), true))
+		std::cout << "\e[31m" "gfx/plainfb: Unsupported format conversion" "\e[39m" << std::endl;
+}
+
 // ----------------------------------------------------------------
 // GfxDevice::Connector.
 // ----------------------------------------------------------------
@@ -285,15 +282,7 @@ drm_core::Plane *GfxDevice::Crtc::primaryPlane() {
 GfxDevice::FrameBuffer::FrameBuffer(GfxDevice *device,
 		std::shared_ptr<GfxDevice::BufferObject> bo, size_t pitch)
 : drm_core::FrameBuffer{device, device->allocator.allocate()},
-		_device{device}, _bo{std::move(bo)}, _pitch{pitch} {
-	if(!_device->_hardwareFbIsAligned) {
-		_fastScanout = false;
-	}else if((reinterpret_cast<uintptr_t>(_bo->accessMapping()) & 15)
-			|| ((_bo->getWidth() * 4) & 15)) {
-		std::cout << "\e[31m" "gfx/plainfb: Framebuffer is not aligned!" "\e[39m" << std::endl;
-		_fastScanout = false;
-	}
-}
+		_device{device}, _bo{std::move(bo)}, _pitch{pitch} { }
 
 size_t GfxDevice::FrameBuffer::getPitch() {
 	return _pitch;
@@ -304,8 +293,17 @@ GfxDevice::BufferObject *GfxDevice::FrameBuffer::getBufferObject() {
 }
 
 void GfxDevice::FrameBuffer::notifyDirty() {
-	// TODO: Re-blit the FrameBuffer if it is currently displayed.
-	std::cout << "gfx/plainfb: notifyDirty() is not implemented correctly" << std::endl;
+	auto damage = takeDamage();
+
+	// Only re-blit if we are currently being scanned out.
+	auto plane_state = _device->_plane->drmState();
+	if(!plane_state || plane_state->fb.get() != this)
+		return;
+	if(!_device->_theCrtc->drmState()->mode)
+		return;
+
+	for(auto &rect : damage.rects())
+		_device->_blit(this, rect);
 }
 
 uint32_t GfxDevice::FrameBuffer::getWidth() {
@@ -363,10 +361,18 @@ async::detached bindController(mbus_ng::Entity hwEntity) {
 	std::cout << "gfx/plainfb: Resolution " << info.width
 			<< "x" << info.height << " (" << info.bpp
 			<< " bpp, pitch: " << info.pitch << ")" << std::endl;
-	assert(info.bpp == 32);
+	drm_core::BlitFormat screenFormat;
+	if(info.bpp == 32) {
+		screenFormat = drm_core::BlitFormat::xrgb8888;
+	}else if(info.bpp == 16) {
+		screenFormat = drm_core::BlitFormat::rgb565;
+	}else{
+		std::cout << "\e[31m" "gfx/plainfb: Unsupported bpp" "\e[39m" << std::endl;
+		co_return;
+	}
 
 	auto gfxDevice = std::make_shared<GfxDevice>(std::move(hwDevice),
-			info.width, info.height, info.pitch,
+			info.width, info.height, info.pitch, screenFormat,
 			helix::Mapping{fbMemory, 0, info.pitch * info.height});
 	auto config = co_await gfxDevice->initialize();
 
@@ -9,6 +9,7 @@
 #include <async/oneshot-event.hpp>
 #include <async/mutex.hpp>
 #include <async/result.hpp>
+#include <core/drm/blit.hpp>
 #include <core/drm/device.hpp>
 #include <helix/ipc.hpp>
 #include <helix/memory.hpp>
@@ -73,7 +74,6 @@ struct GfxDevice final : drm_core::Device, std::enable_shared_from_this<GfxDevic
 				size_t pitch);
 
 		size_t getPitch();
-		bool fastScanout() { return _fastScanout; }
 
 		GfxDevice::BufferObject *getBufferObject();
 		void notifyDirty() override;
@@ -84,12 +84,12 @@ struct GfxDevice final : drm_core::Device, std::enable_shared_from_this<GfxDevic
 		GfxDevice *_device;
 		std::shared_ptr<GfxDevice::BufferObject> _bo;
 		size_t _pitch;
-		bool _fastScanout = true;
 	};
 
 	GfxDevice(protocols::hw::Device hw_device,
 			unsigned int screen_width, unsigned int screen_height,
-			size_t screen_pitch, helix::Mapping fb_mapping);
+			size_t screen_pitch, drm_core::BlitFormat screen_format,
+			helix::Mapping fb_mapping);
 
 	async::result<std::unique_ptr<drm_core::Configuration>> initialize();
 	std::unique_ptr<drm_core::Configuration> createConfiguration() override;
@@ -103,10 +103,14 @@ struct GfxDevice final : drm_core::Device, std::enable_shared_from_this<GfxDevic
 	std::tuple<std::string, std::string, std::string> driverInfo() override;
 
 private:
+	// Copies the given rectangle of the framebuffer to the hardware framebuffer.
+	void _blit(FrameBuffer *fb, drm_core::DamageRect rect);
+
 	protocols::hw::Device _hwDevice;
 	unsigned int _screenWidth;
 	unsigned int _screenHeight;
 	size_t _screenPitch;
+	drm_core::BlitFormat _screenFormat;
 	helix::Mapping _fbMapping;
 
 	std::shared_ptr<Plane> _plane;
@@ -115,5 +119,4 @@ private:
 	std::shared_ptr<Connector> _theConnector;
 
 	bool _claimedDevice = false;
-	bool _hardwareFbIsAligned = true;
 };
@@ -34,13 +34,15 @@ private:
 };
 
 async::result<void> Cmd::transferToHost2d(uint32_t width, uint32_t height, uint32_t resourceId, GfxDevice *device) {
+	co_await transferToHost2d(spec::Rect{0, 0, width, height}, 0, resourceId, device);
+}
+
+async::result<void> Cmd::transferToHost2d(spec::Rect rect, uint64_t offset, uint32_t resourceId, GfxDevice *device) {
 	spec::XferToHost2d xfer;
 	memset(&xfer, 0, sizeof(spec::XferToHost2d));
 	xfer.header.type = spec::cmd::xferToHost2d;
-	xfer.rect.x = 0;
-	xfer.rect.y = 0;
-	xfer.rect.width = width;
-	xfer.rect.height = height;
+	xfer.rect = rect;
+	xfer.offset = offset;
 	xfer.resourceId = resourceId;
 
 	spec::Header xfer_result;
@@ -80,13 +82,14 @@ async::result<void> Cmd::setScanout(uint32_t width, uint32_t height, uint32_t sc
 }
 
 async::result<void> Cmd::resourceFlush(uint32_t width, uint32_t height, uint32_t resourceId, GfxDevice *device) {
+	co_await resourceFlush(spec::Rect{0, 0, width, height}, resourceId, device);
+}
+
+async::result<void> Cmd::resourceFlush(spec::Rect rect, uint32_t resourceId, GfxDevice *device) {
 	spec::ResourceFlush flush;
 	memset(&flush, 0, sizeof(spec::ResourceFlush));
 	flush.header.type = spec::cmd::resourceFlush;
-	flush.rect.x = 0;
-	flush.rect.y = 0;
-	flush.rect.width = width;
-	flush.rect.height = height;
+	flush.rect = rect;
 	flush.resourceId = resourceId;
 
 	spec::Header flush_result;
@@ -6,8 +6,11 @@
 
 struct Cmd {
 	static async::result<void> transferToHost2d(uint32_t width, uint32_t height, uint32_t resourceId, GfxDevice *device);
+	// Transfers only the given rectangle; offset is the byte offset of its first pixel in the backing.
+	static async::result<void> transferToHost2d(spec::Rect rect, uint64_t offset, uint32_t resourceId, GfxDevice *device);
 	static async::result<void> setScanout(uint32_t width, uint32_t height, uint32_t scanoutId, uint32_t resourceId, GfxDevice *device);
 	static async::result<void> resourceFlush(uint32_t width, uint32_t height, uint32_t resourceId, GfxDevice *device);
+	static async::result<void> resourceFlush(spec::Rect rect, uint32_t resourceId, GfxDevice *device);
 	static async::result<spec::DisplayInfo> getDisplayInfo(GfxDevice *device);
 	static async::result<void> create2d(uint32_t width, uint32_t height, uint32_t resourceId, GfxDevice *device);
 	static async::result<void> attachBacking(uint32_t resourceId, void *ptr, size_t size, GfxDevice *device);
@@ -393,8 +393,20 @@ uint32_t GfxDevice::FrameBuffer::getHeight() {
 }
 
 async::detached GfxDevice::FrameBuffer::_xferAndFlush() {
-	co_await Cmd::transferToHost2d(_bo->getWidth(), _bo->getHeight(), _bo->resourceId(), _device);
-	co_await Cmd::resourceFlush(_bo->getWidth(), _bo->getHeight(), _bo->resourceId(), _device);
+	auto damage = takeDamage();
+	if(damage.empty())
+		co_return;
+
+	// Dumb buffers are tightly packed with 4 bytes per pixel (see createDumb()).
+	size_t pitch = _bo->getWidth() * 4;
+	for(auto &rect : damage.rects()) {
+		co_await Cmd::transferToHost2d(spec::Rect{rect.x1, rect.y1, rect.width(), rect.height()},
+				rect.y1 * pitch + rect.x1 * 4, _bo->resourceId(), _device);
+	}
+
+	auto bounds = damage.bounds();
+	co_await Cmd::resourceFlush(spec::Rect{bounds.x1, bounds.y1, bounds.width(), bounds.height()},
+			_bo->resourceId(), _device);
 }
 
 // ----------------------------------------------------------------
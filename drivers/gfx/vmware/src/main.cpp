@@ -613,7 +613,9 @@ async::detached GfxDevice::Configuration::commitConfiguration(std::unique_ptr<dr
 	if (primary_plane_state->fb != nullptr) {
 		auto fb = static_pointer_cast<GfxDevice::FrameBuffer>(primary_plane_state->fb);
 		helix::Mapping user_fb{fb->getBufferObject()->getMemory().first, 0, fb->getBufferObject()->getSize()};
-		drm_core::fastCopy16(_device->_fbMapping.get(), user_fb.get(), fb->getBufferObject()->getSize());
+		drm_core::blitRect(_device->_fbMapping.get(), fb->getPixelPitch(), drm_core::BlitFormat::xrgb8888,
+				user_fb.get(), fb->getPixelPitch(), drm_core::BlitFormat::xrgb8888,
+				fb->getWidth(), fb->getHeight(), true);
 		int w = _device->readRegister(register_index::width),
 			h = _device->readRegister(register_index::height);
 
@@ -664,6 +666,7 @@ drm_core::Plane *GfxDevice::Crtc::Crtc::cursorPlane() {
 GfxDevice::FrameBuffer::FrameBuffer(GfxDevice *dev,
 		std::shared_ptr<GfxDevice::BufferObject> bo, uint32_t pixel_pitch)
 	: drm_core::FrameBuffer { dev, dev->allocator.allocate() } {
+	_device = dev;
 	_bo = bo;
 	_pixelPitch = pixel_pitch;
 }
@@ -677,7 +680,32 @@ uint32_t GfxDevice::FrameBuffer::getPixelPitch() {
 }
 
 void GfxDevice::FrameBuffer::notifyDirty() {
+	_copyAndUpdate();
+}
+
+async::detached GfxDevice::FrameBuffer::_copyAndUpdate() {
+	auto damage = takeDamage();
+
+	// Only copy to VRAM if we are currently being scanned out.
+	auto plane_state = _device->_primaryPlane->drmState();
+	if(damage.empty() || !plane_state || plane_state->fb.get() != this)
+		co_return;
+
+	if(!_mapping.get())
+		_mapping = helix::Mapping{_bo->getMemory().first, 0, _bo->getSize()};
+
+	// VRAM uses the same layout as the BO (see commitConfiguration()).
+	for(auto &rect : damage.rects()) {
+		size_t offset = rect.y1 * _pixelPitch + rect.x1 * 4;
+		drm_core::blitRect(reinterpret_cast<char *>(_device->_fbMapping.get()) + offset,
+				_pixelPitch, drm_core::BlitFormat::xrgb8888,
+				reinterpret_cast<const char *>(_mapping.get()) + offset,
+				_pixelPitch, drm_core::BlitFormat::xrgb8888,
+				rect.width(), rect.height(), true);
+	}
 
+	for(auto &rect : damage.rects())
+		co_await _device->_fifo.updateRectangle(rect.x1, rect.y1, rect.width(), rect.height());
 }
 
 uint32_t GfxDevice::FrameBuffer::getWidth() {
@@ -9,6 +9,7 @@
 #include <async/mutex.hpp>
 #include <async/result.hpp>
 #include <core/drm/device.hpp>
+#include <helix/memory.hpp>
 #include <protocols/hw/client.hpp>
 
 #include "spec.hpp"
@@ -81,8 +82,13 @@ struct GfxDevice final : drm_core::Device, std::enable_shared_from_this<GfxDevic
 		uint32_t getHeight() override;
 
 	private:
+		async::detached _copyAndUpdate();
+
+		GfxDevice *_device;
 		std::shared_ptr<GfxDevice::BufferObject> _bo;
 		uint32_t _pixelPitch;
+		// Mapping of the BO, established on the first partial update.
+		helix::Mapping _mapping;
 	};
 
 	struct DeviceFifo {
@@ -40,6 +40,12 @@ struct E1000Nic : nic::Link {
 
 	async::result<size_t> receive(arch::dma_buffer_view) override;
 	async::result<void> send(const arch::dma_buffer_view) override;
+	async::result<nic::RxFrame> receiveFrame(arch::dma_buffer_view) override;
+	async::result<void> sendWithChecksum(arch::dma_buffer_view, nic::TxChecksum) override;
+
+	size_t rxRingSize() override {
+		return RX_QUEUE_SIZE;
+	}
 
 	async::result<void> init();
 
@@ -57,8 +63,11 @@ private:
 	void em_eth_rx_ack();
 	void em_rxd_setup();
 	void reap_tx_buffers();
+	void transmit(arch::dma_buffer_view buf, uint32_t cmd, uint8_t cso, uint8_t css);
 
 	bool eth_rx_pop();
+	// Returns the descriptors consumed by eth_rx_pop() to the hardware.
+	void eth_rx_update_tail();
 
 	int setPromiscuousMode(struct e1000_hw *hw, int flags);
 
@@ -81,6 +90,13 @@ private:
 
 	std::queue<Request *> _requests;
 
+	// Last descriptor that was consumed by eth_rx_pop() but not yet returned via RDT.
+	uint32_t _rxTail;
+	bool _rxTailPending = false;
+
+	// Whether the hardware verifies TCP/UDP checksums of received frames.
+	bool _rxChecksumOffload = false;
+
 public:
 	struct e1000_hw _hw;
 	struct e1000_osdep _osdep;
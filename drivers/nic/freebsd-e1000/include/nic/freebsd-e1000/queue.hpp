@@ -9,4 +9,5 @@ struct Request {
 	async::oneshot_event event;
 	arch::dma_buffer_view frame;
 	size_t size;
+	bool checksumVerified = false;
 };
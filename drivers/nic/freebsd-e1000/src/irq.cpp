@@ -25,11 +25,15 @@ async::detached E1000Nic::processIrqs() {
 			status &= ~(E1000_ICR_TXQE | E1000_ICR_TXDW);
 
 		if(status & E1000_ICR_RXT0) {
-			printf("e1000: handling packet RX irq\n");
 			while(eth_rx_pop());
+			eth_rx_update_tail();
 			status &= ~E1000_ICR_RXT0;
 		}
 
+		// Frames that were dropped because no receive descriptors were available.
+		// The register is cleared on read.
+		stats_.rxDropped += E1000_READ_REG(&_hw, E1000_MPC);
+
 		status &= ~E1000_ICR_INT_ASSERTED;
 
 		if(status)
@@ -213,30 +213,53 @@ fail:
 }
 
 async::result<size_t> E1000Nic::receive(arch::dma_buffer_view frame) {
+	co_return (co_await receiveFrame(frame)).length;
+}
+
+async::result<nic::RxFrame> E1000Nic::receiveFrame(arch::dma_buffer_view frame) {
 	Request req{.frame = frame};
 	_requests.push(&req);
 
-	eth_rx_pop();
+	if(eth_rx_pop())
+		eth_rx_update_tail();
 
 	co_await req.event.wait();
 
-	co_return req.size;
+	co_return nic::RxFrame{req.size, req.checksumVerified};
 }
 
-async::result<void> E1000Nic::send(const arch::dma_buffer_view buf) {
+void E1000Nic::transmit(arch::dma_buffer_view buf, uint32_t cmd, uint8_t cso, uint8_t css) {
 	reap_tx_buffers();
 
 	memcpy(&_txdbuf[_txIndex], buf.data(), buf.size());
 	struct e1000_tx_desc* desc = &_txd[_txIndex];
-	desc->lower.data = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS | buf.size();
+	desc->lower.data = E1000_TXD_CMD_EOP | E1000_TXD_CMD_IFCS | E1000_TXD_CMD_RS | cmd
+		| (uint32_t{cso} << 16) | buf.size();
+	desc->upper.data = uint32_t{css} << 8;
 
 	++_txIndex;
 	E1000_WRITE_REG(&_hw, E1000_TDT(0), _txIndex);
+}
+
+async::result<void> E1000Nic::send(const arch::dma_buffer_view buf) {
+	transmit(buf, 0, 0, 0);
 
 	// TODO(no92): decide whether returning without waiting for the TX IRQ is optimal
 	co_return;
 }
 
+async::result<void> E1000Nic::sendWithChecksum(arch::dma_buffer_view buf, nic::TxChecksum csum) {
+	// Legacy descriptors can insert a checksum that covers the frame from CSS to its end
+	// at CSO; both offsets are limited to 8 bits.
+	size_t cso = csum.start + csum.offset;
+	if(cso > 0xFF) {
+		co_await nic::Link::sendWithChecksum(buf, csum);
+		co_return;
+	}
+
+	transmit(buf, E1000_TXD_CMD_IC, cso, csum.start);
+}
+
 async::result<void> E1000Nic::identifyHardware() {
 	_hw.vendor_id = co_await _device.loadPciSpace(0, 2);
 	_hw.device_id = co_await _device.loadPciSpace(2, 2);
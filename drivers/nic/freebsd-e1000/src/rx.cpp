@@ -71,6 +71,11 @@ bool E1000Nic::eth_rx_pop() {
 		memcpy(req->frame.data(), &_rxdbuf[_rxIndex], desc->wb.upper.length);
 		req->size = desc->wb.upper.length;
 
+		auto staterr = desc->wb.upper.status_error;
+		req->checksumVerified = _rxChecksumOffload
+			&& (staterr & (E1000_RXD_STAT_TCPCS | E1000_RXD_STAT_UDPCS))
+			&& !(staterr & E1000_RXDEXT_STATERR_TCPE);
+
 		em_eth_rx_ack();
 	} else {
 		struct e1000_rx_desc* desc = &_rxd[_rxIndex];
@@ -83,10 +88,16 @@ bool E1000Nic::eth_rx_pop() {
 		memcpy(req->frame.data(), &_rxdbuf[_rxIndex], desc->length);
 		req->size = desc->length;
 
+		req->checksumVerified = _rxChecksumOffload
+			&& !(desc->status & E1000_RXD_STAT_IXSM)
+			&& (desc->status & (E1000_RXD_STAT_TCPCS | E1000_RXD_STAT_UDPCS))
+			&& !(desc->errors & E1000_RXD_ERR_TCPE);
+
 		desc->status = 0;
 	}
 
-	E1000_WRITE_REG(&_hw, E1000_RDT(0), _rxIndex());
+	_rxTail = _rxIndex();
+	_rxTailPending = true;
 	++_rxIndex;
 
 	_requests.pop();
@@ -96,6 +107,14 @@ bool E1000Nic::eth_rx_pop() {
 	return true;
 }
 
+void E1000Nic::eth_rx_update_tail() {
+	if(!_rxTailPending)
+		return;
+
+	E1000_WRITE_REG(&_hw, E1000_RDT(0), _rxTail);
+	_rxTailPending = false;
+}
+
 #define EM_RADV 64
 #define EM_RDTR 0
 
@@ -163,8 +182,17 @@ async::result<void> E1000Nic::rxInit() {
 	}
 
 	E1000_WRITE_REG(&_hw, E1000_RFCTL, rfctl);
+	/*
+	 * Let the hardware verify TCP/UDP checksums. igb uses a different
+	 * descriptor write-back format that eth_rx_pop() does not decode.
+	 */
 	u32 rxcsum = E1000_READ_REG(&_hw, E1000_RXCSUM);
-	rxcsum &= ~E1000_RXCSUM_TUOFL;
+	if (_hw.mac.type >= e1000_82543 && _hw.mac.type < igb_mac_min) {
+		rxcsum |= E1000_RXCSUM_TUOFL;
+		_rxChecksumOffload = true;
+	} else {
+		rxcsum &= ~E1000_RXCSUM_TUOFL;
+	}
 	E1000_WRITE_REG(&_hw, E1000_RXCSUM, rxcsum);
 
 	/*
@@ -87,6 +87,11 @@ public:
 	async::result<size_t> receive(arch::dma_buffer_view) override;
 	async::result<void> send(const arch::dma_buffer_view) override;
 
+	// Each pending receive() is bound to one RX descriptor.
+	size_t rxRingSize() override {
+		return NUM_RX_DESCRIPTORS;
+	}
+
 	async::result<void> init();
 
 	void ringDoorbell();
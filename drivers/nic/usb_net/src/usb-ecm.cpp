@@ -110,13 +110,12 @@ async::result<void> UsbEcmNic::initialize() {
 }
 
 async::result<size_t> UsbEcmNic::receive(arch::dma_buffer_view frame) {
-	while(true) {
-		auto res = co_await data_in_.transfer(protocols::usb::BulkTransfer{protocols::usb::kXferToHost, frame});
-		assert(res);
+	auto res = co_await data_in_.transfer(protocols::usb::BulkTransfer{protocols::usb::kXferToHost, frame});
+	assert(res);
 
-		if(res.value() != 0)
-			co_return res.value();
-	}
+	// Zero-length packets are returned as empty frames (and ignored by runDevice()).
+	// Resubmitting here would reorder frames against the other pending transfers.
+	co_return res.value();
 }
 
 async::result<void> UsbEcmNic::send(const arch::dma_buffer_view payload) {
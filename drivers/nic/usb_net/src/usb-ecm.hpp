@@ -14,6 +14,12 @@ struct UsbEcmNic : UsbNic {
 
 	async::result<size_t> receive(arch::dma_buffer_view) override;
 	async::result<void> send(const arch::dma_buffer_view) override;
+
+	// Bulk IN transfers on the same endpoint complete in order,
+	// so we can keep a few of them queued at the host controller.
+	size_t rxRingSize() override {
+		return 8;
+	}
 private:
 	mbus_ng::EntityId entity_;
 };
@@ -1,7 +1,10 @@
 #include <nic/virtio/virtio.hpp>
 
+#include <algorithm>
 #include <arch/dma_pool.hpp>
 #include <core/virtio/core.hpp>
+#include <cstring>
+#include <netserver/rss.hpp>
 
 namespace {
 	constexpr bool logFrames = false;
@@ -11,12 +14,59 @@ namespace {
 // Device feature bits.
 constexpr size_t legacyHeaderSize = 10;
 enum {
-	VIRTIO_NET_F_MAC = 5
+	VIRTIO_NET_F_CSUM = 0,
+	VIRTIO_NET_F_GUEST_CSUM = 1,
+	VIRTIO_NET_F_MAC = 5,
+	VIRTIO_NET_F_HOST_TSO4 = 11,
+	VIRTIO_NET_F_HOST_TSO6 = 12,
+	VIRTIO_NET_F_CTRL_VQ = 17,
+	VIRTIO_NET_F_MQ = 22,
+	VIRTIO_NET_F_RSS = 60
 };
 
+// Offsets into the device configuration space.
+enum {
+	configMaxQueuePairs = 8,
+	configRssMaxKeySize = 17,
+	configRssMaxTableLength = 18,
+	configSupportedHashTypes = 20
+};
+
+// Classes and commands of the control virtq.
+enum {
+	VIRTIO_NET_CTRL_MQ = 4,
+	VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET = 0,
+	VIRTIO_NET_CTRL_MQ_RSS_CONFIG = 1
+};
+
+// Values of the ack field of control commands.
+enum {
+	VIRTIO_NET_OK = 0,
+	VIRTIO_NET_ERR = 1
+};
+
+// Bits for the RSS hash types.
+enum {
+	VIRTIO_NET_RSS_HASH_TYPE_IPv4 = 1,
+	VIRTIO_NET_RSS_HASH_TYPE_TCPv4 = 2,
+	VIRTIO_NET_RSS_HASH_TYPE_UDPv4 = 4,
+	VIRTIO_NET_RSS_HASH_TYPE_IPv6 = 8,
+	VIRTIO_NET_RSS_HASH_TYPE_TCPv6 = 0x10,
+	VIRTIO_NET_RSS_HASH_TYPE_UDPv6 = 0x20
+};
+
+// The hash types that nic::flowHash() implements.
+constexpr uint32_t rssHashTypes = VIRTIO_NET_RSS_HASH_TYPE_IPv4 | VIRTIO_NET_RSS_HASH_TYPE_TCPv4
+	| VIRTIO_NET_RSS_HASH_TYPE_UDPv4 | VIRTIO_NET_RSS_HASH_TYPE_IPv6
+	| VIRTIO_NET_RSS_HASH_TYPE_TCPv6 | VIRTIO_NET_RSS_HASH_TYPE_UDPv6;
+
+// Upper bound on the number of queue pairs that we use.
+constexpr size_t maxQueuePairs = 8;
+
 // Bits for VirtHeader::flags.
 enum {
-	VIRTIO_NET_HDR_F_NEEDS_CSUM = 1
+	VIRTIO_NET_HDR_F_NEEDS_CSUM = 1,
+	VIRTIO_NET_HDR_F_DATA_VALID = 2
 };
 
 // Values for VirtHeader::gsoType.
@@ -28,6 +78,11 @@ enum {
 	VIRTIO_NET_HDR_GSO_ECN = 0x80
 };
 
+struct ControlHeader {
+	uint8_t cls;
+	uint8_t command;
+};
+
 struct VirtHeader {
 	uint8_t flags;
 	uint8_t gsoType;
@@ -44,14 +99,51 @@ struct VirtioNic : nic::Link {
 
 	async::result<size_t> receive(arch::dma_buffer_view) override;
 	async::result<void> send(const arch::dma_buffer_view) override;
+	async::result<nic::RxFrame> receiveFrame(arch::dma_buffer_view) override;
+	async::result<nic::RxFrame> receiveFromQueue(size_t, arch::dma_buffer_view) override;
+	async::result<void> sendWithChecksum(arch::dma_buffer_view, nic::TxChecksum) override;
+	async::result<void> sendSegmented(arch::dma_buffer_view, nic::TxChecksum,
+			nic::TxSegmentation) override;
+
+	size_t rxQueueCount() override;
+	size_t rxRingSize() override;
+	void rxBatchBegin(size_t queue) override;
+	void rxBatchEnd(size_t queue) override;
 
 	~VirtioNic() override = default;
 private:
 	mbus_ng::EntityId entity_;
 	std::unique_ptr<virtio_core::Transport> transport_;
 	arch::contiguous_pool dmaPool_;
-	virtio_core::Queue *receiveVq_;
-	virtio_core::Queue *transmitVq_;
+	struct ReceiveQueue {
+		virtio_core::Queue *vq;
+		// While set, receiveFromQueue() does not notify the device about new buffers immediately.
+		bool batching = false;
+		bool notifyPending = false;
+	};
+
+	// Receive and transmit virtqs; the i-th entries form queue pair i.
+	std::vector<ReceiveQueue> receiveQueues_;
+	std::vector<virtio_core::Queue *> transmitVqs_;
+	virtio_core::Queue *controlVq_ = nullptr;
+
+	async::result<void> configureQueues_();
+	async::result<bool> control_(uint8_t cls, uint8_t command, arch::dma_buffer_view data);
+	async::result<void> transmit_(const arch::dma_buffer_view payload, VirtHeader header);
+
+	// Negotiated checksum offloads (VIRTIO_NET_F_CSUM and VIRTIO_NET_F_GUEST_CSUM).
+	bool txChecksumOffload_ = false;
+	bool rxChecksumOffload_ = false;
+	// Negotiated TCP segmentation offloads (VIRTIO_NET_F_HOST_TSO4 and VIRTIO_NET_F_HOST_TSO6).
+	bool tso4Offload_ = false;
+	bool tso6Offload_ = false;
+	// Negotiated multi-queue features (VIRTIO_NET_F_MQ and VIRTIO_NET_F_RSS).
+	bool mqOffload_ = false;
+	bool rssOffload_ = false;
+
+	// Steers received flows to the receive queues if rssOffload_ is set;
+	// outgoing frames are sent on the pair that their replies are received on.
+	nic::RssConfig rss_;
 };
 
 VirtioNic::VirtioNic(mbus_ng::EntityId entity, std::unique_ptr<virtio_core::Transport> transport)
@@ -70,10 +162,59 @@ VirtioNic::VirtioNic(mbus_ng::EntityId entity, std::unique_ptr<virtio_core::Tran
 		transport_->acknowledgeDriverFeature(VIRTIO_NET_F_MAC);
 	}
 
+	if(transport_->checkDeviceFeature(VIRTIO_NET_F_CSUM)) {
+		transport_->acknowledgeDriverFeature(VIRTIO_NET_F_CSUM);
+		txChecksumOffload_ = true;
+	}
+	if(transport_->checkDeviceFeature(VIRTIO_NET_F_GUEST_CSUM)) {
+		transport_->acknowledgeDriverFeature(VIRTIO_NET_F_GUEST_CSUM);
+		rxChecksumOffload_ = true;
+	}
+	// TSO depends on checksum offloading.
+	if(txChecksumOffload_ && transport_->checkDeviceFeature(VIRTIO_NET_F_HOST_TSO4)) {
+		transport_->acknowledgeDriverFeature(VIRTIO_NET_F_HOST_TSO4);
+		tso4Offload_ = true;
+	}
+	if(txChecksumOffload_ && transport_->checkDeviceFeature(VIRTIO_NET_F_HOST_TSO6)) {
+		transport_->acknowledgeDriverFeature(VIRTIO_NET_F_HOST_TSO6);
+		tso6Offload_ = true;
+	}
+
+	// Multiple queues are configured through the control virtq.
+	bool hasControlVq = false;
+	size_t devicePairs = 1;
+	if(transport_->checkDeviceFeature(VIRTIO_NET_F_CTRL_VQ)) {
+		transport_->acknowledgeDriverFeature(VIRTIO_NET_F_CTRL_VQ);
+		hasControlVq = true;
+
+		if(transport_->checkDeviceFeature(VIRTIO_NET_F_MQ)) {
+			transport_->acknowledgeDriverFeature(VIRTIO_NET_F_MQ);
+			mqOffload_ = true;
+		}
+		if(transport_->checkDeviceFeature(VIRTIO_NET_F_RSS)
+				&& transport_->loadConfig8(configRssMaxKeySize) >= nic::RssConfig::keySize
+				&& transport_->loadConfig16(configRssMaxTableLength) >= nic::RssConfig::tableSize
+				&& (transport_->loadConfig32(configSupportedHashTypes) & rssHashTypes)
+					== rssHashTypes) {
+			transport_->acknowledgeDriverFeature(VIRTIO_NET_F_RSS);
+			rssOffload_ = true;
+		}
+		if(mqOffload_ || rssOffload_)
+			devicePairs = std::max(transport_->loadConfig16(configMaxQueuePairs), uint16_t{1});
+	}
+
 	transport_->finalizeFeatures();
-	transport_->claimQueues(2);
-	receiveVq_ = transport_->setupQueue(0);
-	transmitVq_ = transport_->setupQueue(1);
+
+	// The control virtq follows the queue pairs (even those that we do not use).
+	size_t pairs = std::min(devicePairs, maxQueuePairs);
+	transport_->claimQueues(2 * devicePairs + (hasControlVq ? 1 : 0));
+	for(size_t i = 0; i < pairs; i++) {
+		receiveQueues_.push_back({transport_->setupQueue(2 * i)});
+		transmitVqs_.push_back(transport_->setupQueue(2 * i + 1));
+	}
+	if(hasControlVq)
+		controlVq_ = transport_->setupQueue(2 * devicePairs);
+	rss_ = nic::RssConfig::spread(pairs);
 
 	promiscuous_ = true;
 	all_multicast_ = true;
@@ -102,40 +243,212 @@ async::result<void> VirtioNic::initialize() {
 			(void)(co_await entity.serveRemoteLane(std::move(remoteLane)));
 		}
 	}(std::move(netClassEntity));
+
+	co_await configureQueues_();
+}
+
+// Enables all queue pairs that we set up. The device keeps the frames of each flow
+// on one receive queue; with RSS, we choose the queue, otherwise the device
+// follows the transmit queue that the flow was last sent on.
+async::result<void> VirtioNic::configureQueues_() {
+	if(receiveQueues_.size() < 2)
+		co_return;
+
+	if(rssOffload_) {
+		// struct virtio_net_rss_config with the indirection table and key appended.
+		size_t tableSize = nic::RssConfig::tableSize;
+		size_t size = 8 + 2 * tableSize + 3 + nic::RssConfig::keySize;
+		arch::dma_buffer config{&dmaPool_, size};
+		auto p = reinterpret_cast<uint8_t *>(config.data());
+		auto store16 = [&] (size_t offset, uint16_t value) {
+			std::memcpy(p + offset, &value, sizeof(value));
+		};
+
+		uint32_t hashTypes = rssHashTypes;
+		std::memcpy(p, &hashTypes, sizeof(hashTypes));
+		store16(4, tableSize - 1);
+		// Packets that cannot be hashed go to the first receive queue.
+		store16(6, 0);
+		for(size_t i = 0; i < tableSize; i++)
+			store16(8 + 2 * i, rss_.indirection[i]);
+		store16(8 + 2 * tableSize, transmitVqs_.size());
+		p[8 + 2 * tableSize + 2] = nic::RssConfig::keySize;
+		std::memcpy(p + 8 + 2 * tableSize + 3, rss_.key.data(), nic::RssConfig::keySize);
+
+		if(co_await control_(VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_RSS_CONFIG,
+				config)) {
+			std::cout << "virtio-driver: Using RSS with " << receiveQueues_.size()
+				<< " queue pairs" << std::endl;
+			co_return;
+		}
+		std::cout << "virtio-driver: Device rejected the RSS configuration" << std::endl;
+		rssOffload_ = false;
+	}
+
+	if(mqOffload_) {
+		arch::dma_object<uint16_t> pairs{&dmaPool_};
+		*pairs.data() = receiveQueues_.size();
+		if(co_await control_(VIRTIO_NET_CTRL_MQ, VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET,
+				pairs.view_buffer())) {
+			std::cout << "virtio-driver: Using " << receiveQueues_.size()
+				<< " queue pairs" << std::endl;
+			co_return;
+		}
+		std::cout << "virtio-driver: Device rejected the number of queue pairs" << std::endl;
+	}
+
+	// Only the first pair is active.
+	receiveQueues_.resize(1);
+	transmitVqs_.resize(1);
+}
+
+async::result<bool> VirtioNic::control_(uint8_t cls, uint8_t command,
+		arch::dma_buffer_view data) {
+	arch::dma_object<ControlHeader> header{&dmaPool_};
+	header->cls = cls;
+	header->command = command;
+	arch::dma_object<uint8_t> ack{&dmaPool_};
+	*ack.data() = VIRTIO_NET_ERR;
+
+	virtio_core::Chain chain;
+	chain.append(co_await controlVq_->obtainDescriptor());
+	chain.setupBuffer(virtio_core::hostToDevice, header.view_buffer());
+	co_await virtio_core::scatterGather(virtio_core::hostToDevice, chain, controlVq_, data);
+	chain.append(co_await controlVq_->obtainDescriptor());
+	chain.setupBuffer(virtio_core::deviceToHost, ack.view_buffer());
+
+	co_await controlVq_->submitDescriptor(chain.front());
+	co_return *ack.data() == VIRTIO_NET_OK;
 }
 
 async::result<size_t> VirtioNic::receive(arch::dma_buffer_view frame) {
+	co_return (co_await receiveFrame(frame)).length;
+}
+
+async::result<nic::RxFrame> VirtioNic::receiveFrame(arch::dma_buffer_view frame) {
+	co_return co_await receiveFromQueue(0, frame);
+}
+
+async::result<nic::RxFrame> VirtioNic::receiveFromQueue(size_t queue, arch::dma_buffer_view frame) {
+	auto &rq = receiveQueues_[queue];
 	arch::dma_object<VirtHeader> header { &dmaPool_ };
 
 	virtio_core::Chain chain;
-	chain.append(co_await receiveVq_->obtainDescriptor());
+	chain.append(co_await rq.vq->obtainDescriptor());
 	chain.setupBuffer(virtio_core::deviceToHost,
 			header.view_buffer().subview(0, legacyHeaderSize));
-	chain.append(co_await receiveVq_->obtainDescriptor());
+	chain.append(co_await rq.vq->obtainDescriptor());
 	chain.setupBuffer(virtio_core::deviceToHost, frame);
 
-	co_return (co_await receiveVq_->submitDescriptor(chain.front()) - legacyHeaderSize);
+	struct OneshotRequest : virtio_core::Request {
+		async::oneshot_event event;
+	} ev_req;
+
+	rq.vq->postDescriptor(chain.front(), &ev_req,
+			[] (virtio_core::Request *base_request) {
+		auto request = static_cast<OneshotRequest *>(base_request);
+		request->event.raise();
+	});
+	if(rq.batching) {
+		rq.notifyPending = true;
+	}else{
+		rq.vq->notify();
+	}
+
+	co_await ev_req.event.wait();
+
+	// NEEDS_CSUM is set for frames that originate from the host itself;
+	// like DATA_VALID, this means that the checksum needs no verification.
+	bool verified = rxChecksumOffload_
+		&& (header->flags & (VIRTIO_NET_HDR_F_NEEDS_CSUM | VIRTIO_NET_HDR_F_DATA_VALID));
+	co_return nic::RxFrame{ev_req.len - legacyHeaderSize, verified};
+}
+
+size_t VirtioNic::rxQueueCount() {
+	return receiveQueues_.size();
+}
+
+size_t VirtioNic::rxRingSize() {
+	// Each receive buffer takes two descriptors (header + frame).
+	return receiveQueues_[0].vq->numDescriptors() / 2;
+}
+
+void VirtioNic::rxBatchBegin(size_t queue) {
+	receiveQueues_[queue].batching = true;
+}
+
+void VirtioNic::rxBatchEnd(size_t queue) {
+	auto &rq = receiveQueues_[queue];
+	rq.batching = false;
+	if(rq.notifyPending) {
+		rq.notifyPending = false;
+		rq.vq->notify();
+	}
 }
 
 async::result<void> VirtioNic::send(const arch::dma_buffer_view payload) {
-	if (payload.size() > 1514) {
+	co_await transmit_(payload, VirtHeader{});
+}
+
+async::result<void> VirtioNic::sendWithChecksum(arch::dma_buffer_view payload, nic::TxChecksum csum) {
+	if(!txChecksumOffload_) {
+		co_await nic::Link::sendWithChecksum(payload, csum);
+		co_return;
+	}
+
+	co_await transmit_(payload, VirtHeader{
+		.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM,
+		.csumStart = csum.start,
+		.csumOffset = csum.offset,
+	});
+}
+
+async::result<void> VirtioNic::sendSegmented(arch::dma_buffer_view payload, nic::TxChecksum csum,
+		nic::TxSegmentation seg) {
+	auto version = reinterpret_cast<const uint8_t *>(payload.data())[seg.networkStart] >> 4;
+	bool ip6 = (version == 6);
+	if(ip6 ? !tso6Offload_ : !tso4Offload_) {
+		co_await nic::Link::sendSegmented(payload, csum, seg);
+		co_return;
+	}
+
+	co_await transmit_(payload, VirtHeader{
+		.flags = VIRTIO_NET_HDR_F_NEEDS_CSUM,
+		.gsoType = static_cast<uint8_t>(ip6 ? VIRTIO_NET_HDR_GSO_TCPV6 : VIRTIO_NET_HDR_GSO_TCPV4),
+		.hdrLen = seg.headerLength,
+		.gsoSize = seg.segmentSize,
+		.csumStart = csum.start,
+		.csumOffset = csum.offset,
+	});
+}
+
+async::result<void> VirtioNic::transmit_(const arch::dma_buffer_view payload, VirtHeader virtHeader) {
+	if (payload.size() > 1514 && virtHeader.gsoType == VIRTIO_NET_HDR_GSO_NONE) {
 		throw std::runtime_error("data exceeds mtu");
 	}
 
 	arch::dma_object<VirtHeader> header { &dmaPool_ };
-	memset(header.data(), 0, sizeof(VirtHeader));
+	*header.data() = virtHeader;
+
+	// Send the frame on the queue pair that the replies of its flow are received on.
+	// Without RSS, the device steers received flows based on this choice.
+	auto transmitVq = transmitVqs_[0];
+	if(transmitVqs_.size() > 1) {
+		if(auto hash = nic::flowHash(rss_, payload, 14, true); hash)
+			transmitVq = transmitVqs_[rss_.queueFor(*hash)];
+	}
 
 	virtio_core::Chain chain;
-	chain.append(co_await transmitVq_->obtainDescriptor());
+	chain.append(co_await transmitVq->obtainDescriptor());
 	chain.setupBuffer(virtio_core::hostToDevice,
 			header.view_buffer().subview(0, legacyHeaderSize));
-	chain.append(co_await transmitVq_->obtainDescriptor());
-	chain.setupBuffer(virtio_core::hostToDevice, payload);
+	// Super-segments span multiple pages.
+	co_await virtio_core::scatterGather(virtio_core::hostToDevice, chain, transmitVq, payload);
 
 	if(logFrames) {
 		std::cout << "virtio-driver: sending frame" << std::endl;
 	}
-	co_await transmitVq_->submitDescriptor(chain.front());
+	co_await transmitVq->submitDescriptor(chain.front());
 	if(logFrames) {
 		std::cout << "virtio-driver: sent frame" << std::endl;
 	}
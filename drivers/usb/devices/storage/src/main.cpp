@@ -1,4 +1,6 @@
 
+#include <algorithm>
+#include <array>
 #include <deque>
 #include <optional>
 #include <iostream>
@@ -7,6 +9,7 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <async/algorithm.hpp>
 #include <async/result.hpp>
 #include <protocols/mbus/client.hpp>
 #include <protocols/usb/usb.hpp>
@@ -26,34 +29,70 @@ namespace {
 
 namespace proto = protocols::usb;
 
-async::detached StorageDevice::run(int config_num, int intf_num) {
-	auto descriptor = (co_await _usbDevice.configurationDescriptor(0)).unwrap();
-
-	std::optional<int> in_endp_number;
-	std::optional<int> out_endp_number;
-
-	proto::walkConfiguration(descriptor, [&] (int type, size_t, void *, const auto &info) {
-		if(type == proto::descriptor_type::endpoint) {
-			if(info.endpointIn.value()) {
-				in_endp_number = info.endpointNumber.value();
-			}else if(!info.endpointIn.value()) {
-				out_endp_number = info.endpointNumber.value();
-			}else {
-				throw std::runtime_error("Illegal endpoint!\n");
-			}
+size_t StorageDevice::buildCdb(Request *req, uint8_t *cdb) {
+	assert(req->numSectors);
+	assert(req->numSectors <= 0xFFFF);
+
+	if(!req->isWrite) {
+		if(enableRead6 && req->sector <= 0x1FFFFF && req->numSectors <= 0xFF) {
+			scsi::Read6 command;
+			memset(&command, 0, sizeof(scsi::Read6));
+			command.opCode = 0x08;
+			command.lba[0] = req->sector >> 16;
+			command.lba[1] = (req->sector >> 8) & 0xFF;
+			command.lba[2] = req->sector & 0xFF;
+			command.transferLength = req->numSectors;
+
+			memcpy(cdb, &command, sizeof(scsi::Read6));
+			return sizeof(scsi::Read6);
+		}else if(req->sector <= 0xFFFFFFFF) {
+			scsi::Read10 command;
+			memset(&command, 0, sizeof(scsi::Read10));
+			command.opCode = 0x28;
+			command.lba[0] = req->sector >> 24;
+			command.lba[1] = (req->sector >> 16) & 0xFF;
+			command.lba[2] = (req->sector >> 8) & 0xFF;
+			command.lba[3] = req->sector & 0xFF;
+			command.transferLength[0] = req->numSectors >> 8;
+			command.transferLength[1] = req->numSectors & 0xFF;
+
+			memcpy(cdb, &command, sizeof(scsi::Read10));
+			return sizeof(scsi::Read10);
 		}else{
-			if(logEnumeration)
-				printf("block-usb: Unexpected descriptor type: %d!\n", type);
+			throw std::logic_error("USB storage does not currently support high LBAs!");
 		}
-	});
+	}else{
+		if(req->sector <= 0xFFFFFFFF) {
+			scsi::Write10 command;
+			memset(&command, 0, sizeof(scsi::Write10));
+			command.opCode = 0x2A;
+			command.lba[0] = req->sector >> 24;
+			command.lba[1] = (req->sector >> 16) & 0xFF;
+			command.lba[2] = (req->sector >> 8) & 0xFF;
+			command.lba[3] = req->sector & 0xFF;
+			command.transferLength[0] = req->numSectors >> 8;
+			command.transferLength[1] = req->numSectors & 0xFF;
+
+			memcpy(cdb, &command, sizeof(scsi::Write10));
+			return sizeof(scsi::Write10);
+		}else{
+			throw std::logic_error("USB storage does not currently support high LBAs!");
+		}
+	}
+}
+
+// ----------------------------------------------------------------
+// Bulk-Only Transport.
+// ----------------------------------------------------------------
 
+async::detached StorageDevice::runBot(int config_num, int intf_num, int alternative, BotPipes pipes) {
 	if(logSteps)
 		std::cout << "block-usb: Setting up configuration" << std::endl;
 
 	auto config = (co_await _usbDevice.useConfiguration(0, config_num)).unwrap();
-	auto intf = (co_await config.useInterface(intf_num, 0)).unwrap();
-	auto endp_in = (co_await intf.getEndpoint(proto::PipeType::in, in_endp_number.value())).unwrap();
-	auto endp_out = (co_await intf.getEndpoint(proto::PipeType::out, out_endp_number.value())).unwrap();
+	auto intf = (co_await config.useInterface(intf_num, alternative)).unwrap();
+	auto endp_in = (co_await intf.getEndpoint(proto::PipeType::in, pipes.in)).unwrap();
+	auto endp_out = (co_await intf.getEndpoint(proto::PipeType::out, pipes.out)).unwrap();
 
 	if(logSteps)
 		std::cout << "block-usb: Device is ready" << std::endl;
@@ -65,8 +104,6 @@ async::detached StorageDevice::run(int config_num, int intf_num) {
 
 			if(logRequests)
 				std::cout << "block-usb: Reading " << req->numSectors << " sectors" << std::endl;
-			assert(req->numSectors);
-			assert(req->numSectors <= 0xFFFF);
 
 			CommandBlockWrapper cbw;
 			memset(&cbw, 0, sizeof(CommandBlockWrapper));
@@ -79,53 +116,7 @@ async::detached StorageDevice::run(int config_num, int intf_num) {
 				cbw.flags = 0; // Direction: Host-to-Device.
 			}
 			cbw.lun = 0;
-
-			if(!req->isWrite) {
-				if(enableRead6 && req->sector <= 0x1FFFFF && req->numSectors <= 0xFF) {
-					scsi::Read6 command;
-					memset(&command, 0, sizeof(scsi::Read6));
-					command.opCode = 0x08;
-					command.lba[0] = req->sector >> 16;
-					command.lba[1] = (req->sector >> 8) & 0xFF;
-					command.lba[2] = req->sector & 0xFF;
-					command.transferLength = req->numSectors;
-
-					cbw.cmdLength = sizeof(scsi::Read6);
-					memcpy(cbw.cmdData, &command, sizeof(scsi::Read6));
-				}else if(req->sector <= 0xFFFFFFFF) {
-					scsi::Read10 command;
-					memset(&command, 0, sizeof(scsi::Read10));
-					command.opCode = 0x28;
-					command.lba[0] = req->sector >> 24;
-					command.lba[1] = (req->sector >> 16) & 0xFF;
-					command.lba[2] = (req->sector >> 8) & 0xFF;
-					command.lba[3] = req->sector & 0xFF;
-					command.transferLength[0] = req->numSectors >> 8;
-					command.transferLength[1] = req->numSectors & 0xFF;
-
-					cbw.cmdLength = sizeof(scsi::Read10);
-					memcpy(cbw.cmdData, &command, sizeof(scsi::Read10));
-				}else{
-					throw std::logic_error("USB storage does not currently support high LBAs!");
-				}
-			}else{
-				if(req->sector <= 0xFFFFFFFF) {
-					scsi::Write10 command;
-					memset(&command, 0, sizeof(scsi::Write10));
-					command.opCode = 0x2A;
-					command.lba[0] = req->sector >> 24;
-					command.lba[1] = (req->sector >> 16) & 0xFF;
-					command.lba[2] = (req->sector >> 8) & 0xFF;
-					command.lba[3] = req->sector & 0xFF;
-					command.transferLength[0] = req->numSectors >> 8;
-					command.transferLength[1] = req->numSectors & 0xFF;
-
-					cbw.cmdLength = sizeof(scsi::Write10);
-					memcpy(cbw.cmdData, &command, sizeof(scsi::Write10));
-				}else{
-					throw std::logic_error("USB storage does not currently support high LBAs!");
-				}
-			}
+			cbw.cmdLength = buildCdb(req, cbw.cmdData);
 
 			// TODO: Respect USB device DMA requirements.
 
@@ -177,6 +168,207 @@ async::detached StorageDevice::run(int config_num, int intf_num) {
 	}
 }
 
+// ----------------------------------------------------------------
+// USB Attached SCSI.
+// ----------------------------------------------------------------
+
+// At high speed, the device sends READ READY and WRITE READY IUs to request the data
+// phase of a command, and data and status IUs are transferred one at a time over the
+// shared pipes. At SuperSpeed, the data and status pipes use bulk streams instead:
+// all transfers of a command are queued at once on the stream that matches its tag,
+// and the device picks the stream that it wants to serve. In both cases, commands are
+// queued on the device (which may complete them in any order).
+
+async::result<bool> StorageDevice::startUas(int config_num, int intf_num, int alternative,
+		UasPipes pipes, bool superspeed) {
+	if(logSteps)
+		std::cout << "block-usb: Setting up configuration (UAS)" << std::endl;
+
+	auto config = (co_await _usbDevice.useConfiguration(0, config_num)).unwrap();
+	auto intf = (co_await config.useInterface(intf_num, alternative)).unwrap();
+	auto command = (co_await intf.getEndpoint(proto::PipeType::out, pipes.command)).unwrap();
+	auto status = (co_await intf.getEndpoint(proto::PipeType::in, pipes.status)).unwrap();
+	auto dataIn = (co_await intf.getEndpoint(proto::PipeType::in, pipes.dataIn)).unwrap();
+	auto dataOut = (co_await intf.getEndpoint(proto::PipeType::out, pipes.dataOut)).unwrap();
+
+	auto numStreams = std::min({status.numStreams(), dataIn.numStreams(), dataOut.numStreams()});
+	if(superspeed && !numStreams) {
+		std::cout << "block-usb: UAS at SuperSpeed requires streams,"
+				" but the host controller did not set any up" << std::endl;
+		co_return false;
+	}
+
+	if(logSteps)
+		std::cout << "block-usb: Device is ready (" << numStreams << " streams)" << std::endl;
+
+	if(numStreams) {
+		_runUas(command, status, dataIn, dataOut, std::min(numStreams, maxUasTags), true);
+	}else{
+		_receiveUasStatus(status, dataIn, dataOut);
+		_runUas(command, status, dataIn, dataOut, maxUasTags, false);
+	}
+	co_return true;
+}
+
+async::detached StorageDevice::_runUas(proto::Endpoint command, proto::Endpoint status,
+		proto::Endpoint dataIn, proto::Endpoint dataOut, size_t numTags, bool streams) {
+	while(true) {
+		if(_queue.empty() || _uasInFlight == numTags) {
+			co_await _doorbell.async_wait();
+			continue;
+		}
+
+		auto req = &_queue.front();
+		_queue.pop_front();
+
+		uint16_t tag = 1;
+		while(_uasTags[tag])
+			tag++;
+		assert(tag <= numTags);
+		_uasTags[tag] = req;
+		_uasInFlight++;
+
+		if(logRequests)
+			std::cout << "block-usb: Issuing " << (req->isWrite ? "write" : "read")
+					<< " of " << req->numSectors << " sectors with tag " << tag << std::endl;
+
+		if(streams) {
+			_runUasStreamCommand(command, status, req->isWrite ? dataOut : dataIn, tag);
+			continue;
+		}
+
+		uas::CommandIu iu;
+		buildCommandIu(req, tag, iu);
+
+		// TODO: Respect USB device DMA requirements.
+		(co_await command.transfer(proto::BulkTransfer{proto::XferFlags::kXferToDevice,
+				arch::dma_buffer_view{nullptr, &iu, sizeof(uas::CommandIu)}})).unwrap();
+	}
+}
+
+void StorageDevice::buildCommandIu(Request *req, uint16_t tag, uas::CommandIu &iu) {
+	memset(&iu, 0, sizeof(uas::CommandIu));
+	iu.iuId = uas::kIuCommand;
+	iu.tag[0] = tag >> 8;
+	iu.tag[1] = tag & 0xFF;
+	iu.taskAttribute = 0; // SIMPLE.
+	buildCdb(req, iu.cdb);
+}
+
+async::detached StorageDevice::_runUasStreamCommand(proto::Endpoint command,
+		proto::Endpoint status, proto::Endpoint data, uint16_t tag) {
+	auto req = _uasTags[tag];
+
+	uas::CommandIu commandIu;
+	buildCommandIu(req, tag, commandIu);
+
+	uas::SenseIu iu;
+	memset(&iu, 0, sizeof(uas::SenseIu));
+
+	proto::BulkTransfer status_info{proto::XferFlags::kXferToHost,
+			arch::dma_buffer_view{nullptr, &iu, sizeof(uas::SenseIu)}};
+	status_info.allowShortPackets = true;
+	status_info.streamId = tag;
+
+	proto::BulkTransfer data_info{req->isWrite ? proto::XferFlags::kXferToDevice
+				: proto::XferFlags::kXferToHost,
+			arch::dma_buffer_view{nullptr, req->buffer, req->numSectors * 512}};
+	data_info.streamId = tag;
+
+	// Post the status and data transfers before the command IU, such that they are
+	// already queued on the streams when the device starts to serve the command.
+	// TODO: Respect USB device DMA requirements.
+	co_await async::when_all(
+		async::transform(status.transfer(status_info), [] (auto result) {
+			result.unwrap();
+		}),
+		async::transform(data.transfer(data_info), [] (auto result) {
+			result.unwrap();
+		}),
+		async::transform(command.transfer(proto::BulkTransfer{proto::XferFlags::kXferToDevice,
+				arch::dma_buffer_view{nullptr, &commandIu, sizeof(uas::CommandIu)}}),
+				[] (auto result) {
+			result.unwrap();
+		})
+	);
+
+	uint16_t iu_tag = (iu.header.tag[0] << 8) | iu.header.tag[1];
+	if(iu.header.iuId != uas::kIuSense || iu_tag != tag) {
+		std::cout << "block-usb: Unexpected UAS IU 0x" << std::hex << (unsigned int)iu.header.iuId
+				<< std::dec << " with tag " << iu_tag << " on stream " << tag << std::endl;
+		throw std::runtime_error("block-usb: Giving up");
+	}
+	_completeUasCommand(tag, iu);
+}
+
+void StorageDevice::_completeUasCommand(uint16_t tag, const uas::SenseIu &iu) {
+	if(iu.status) {
+		std::cout << "block-usb: Error status 0x"
+				<< std::hex << (unsigned int)iu.status << std::dec
+				<<  " in sense IU for tag " << tag << std::endl;
+		throw std::runtime_error("block-usb: Giving up");
+	}
+
+	if(logSteps)
+		std::cout << "block-usb: Tag " << tag << " is complete" << std::endl;
+	auto req = std::exchange(_uasTags[tag], nullptr);
+	_uasInFlight--;
+	req->event.raise();
+	_doorbell.raise();
+}
+
+async::detached StorageDevice::_receiveUasStatus(proto::Endpoint status,
+		proto::Endpoint dataIn, proto::Endpoint dataOut) {
+	while(true) {
+		uas::SenseIu iu;
+		memset(&iu, 0, sizeof(uas::SenseIu));
+
+		proto::BulkTransfer status_info{proto::XferFlags::kXferToHost,
+				arch::dma_buffer_view{nullptr, &iu, sizeof(uas::SenseIu)}};
+		status_info.allowShortPackets = true;
+		(co_await status.transfer(status_info)).unwrap();
+
+		uint16_t tag = (iu.header.tag[0] << 8) | iu.header.tag[1];
+		if(!tag || tag > maxUasTags || !_uasTags[tag]) {
+			std::cout << "block-usb: UAS IU 0x" << std::hex << (unsigned int)iu.header.iuId
+					<< std::dec << " for unknown tag " << tag << std::endl;
+			continue;
+		}
+		auto req = _uasTags[tag];
+
+		switch(iu.header.iuId) {
+		case uas::kIuReadReady: {
+			if(logSteps)
+				std::cout << "block-usb: Tag " << tag << " is ready to read" << std::endl;
+			(co_await dataIn.transfer(proto::BulkTransfer{proto::XferFlags::kXferToHost,
+					arch::dma_buffer_view{nullptr, req->buffer, req->numSectors * 512}})).unwrap();
+			break;
+		}
+		case uas::kIuWriteReady: {
+			if(logSteps)
+				std::cout << "block-usb: Tag " << tag << " is ready to write" << std::endl;
+			(co_await dataOut.transfer(proto::BulkTransfer{proto::XferFlags::kXferToDevice,
+					arch::dma_buffer_view{nullptr, req->buffer, req->numSectors * 512}})).unwrap();
+			break;
+		}
+		case uas::kIuSense: {
+			_completeUasCommand(tag, iu);
+			break;
+		}
+		case uas::kIuResponse: {
+			auto response = reinterpret_cast<uas::ResponseIu *>(&iu);
+			std::cout << "block-usb: Unexpected response IU with code 0x"
+					<< std::hex << (unsigned int)response->responseCode << std::dec
+					<< " for tag " << tag << std::endl;
+			throw std::runtime_error("block-usb: Giving up");
+		}
+		default:
+			std::cout << "block-usb: Unexpected UAS IU 0x"
+					<< std::hex << (unsigned int)iu.header.iuId << std::dec << std::endl;
+		}
+	}
+}
+
 async::result<void> StorageDevice::readSectors(uint64_t sector,
 		void *buffer, size_t numSectors) {
 	Request req{false, sector, buffer, numSectors};
@@ -204,9 +396,19 @@ async::detached bindDevice(mbus_ng::Entity entity) {
 
 	std::optional<int> config_number;
 	std::optional<int> intf_number;
-	std::optional<int> intf_class;
-	std::optional<int> intf_subclass;
-	std::optional<int> intf_protocol;
+
+	// Alternate settings that implement BOT and UAS, respectively.
+	std::optional<int> bot_alternative;
+	std::optional<int> uas_alternative;
+	std::optional<int> bot_in;
+	std::optional<int> bot_out;
+	std::array<std::optional<int>, 5> uas_pipes;
+	// SuperSpeed endpoint companion descriptors indicate that the device
+	// is operating at SuperSpeed, where UAS uses bulk streams.
+	bool superspeed = false;
+
+	// Protocol of the alternate setting that we are currently walking.
+	std::optional<int> current_protocol;
 
 	if(logEnumeration)
 		std::cout << "block-usb: Getting configuration descriptor" << std::endl;
@@ -222,41 +424,88 @@ async::detached bindDevice(mbus_ng::Entity entity) {
 			assert(!config_number);
 			config_number = info.configNumber.value();
 		}else if(type == proto::descriptor_type::interface) {
-			if(intf_number) {
+			current_protocol = std::nullopt;
+			if(intf_number && intf_number.value() != info.interfaceNumber.value()) {
 				std::cout << "block-usb: Ignoring interface "
 						<< info.interfaceNumber.value() << std::endl;
 				return;
 			}
+
+			auto desc = (proto::InterfaceDescriptor *)p;
 			if(logEnumeration)
 				std::cout << "block-usb: Found interface: " << info.interfaceNumber.value()
-						<< ", alternative: " << info.interfaceAlternative.value() << std::endl;
-			intf_number = info.interfaceNumber.value();
+						<< ", alternative: " << info.interfaceAlternative.value()
+						<< ", class: 0x" << std::hex << (int)desc->interfaceClass
+						<< ", subclass: 0x" << (int)desc->interfaceSubClass
+						<< ", protocol: 0x" << (int)desc->interfaceProtocol
+						<< std::dec << std::endl;
+			if(desc->interfaceClass != protocols::usb::usb_class::mass_storage
+					|| desc->interfaceSubClass != 0x06)
+				return;
 
-			assert(!intf_class);
-			assert(!intf_subclass);
-			assert(!intf_protocol);
-			auto desc = (proto::InterfaceDescriptor *)p;
-			intf_class = desc->interfaceClass;
-			intf_subclass = desc->interfaceSubClass;
-			intf_protocol = desc->interfaceProtocol;
+			if(desc->interfaceProtocol == 0x50 && !bot_alternative) {
+				bot_alternative = info.interfaceAlternative.value();
+			}else if(desc->interfaceProtocol == 0x62 && !uas_alternative) {
+				uas_alternative = info.interfaceAlternative.value();
+			}else{
+				return;
+			}
+			intf_number = info.interfaceNumber.value();
+			current_protocol = desc->interfaceProtocol;
+		}else if(type == proto::descriptor_type::endpoint) {
+			if(current_protocol != 0x50)
+				return;
+			if(info.endpointIn.value()) {
+				bot_in = info.endpointNumber.value();
+			}else{
+				bot_out = info.endpointNumber.value();
+			}
+		}else if(type == proto::descriptor_type::cs_interface) {
+			// Pipe usage descriptor; it follows the endpoint that it describes.
+			if(current_protocol != 0x62)
+				return;
+			auto pipe_id = static_cast<uint8_t *>(p)[2];
+			if(pipe_id >= uas::kPipeCommand && pipe_id <= uas::kPipeDataOut)
+				uas_pipes[pipe_id] = info.endpointNumber.value();
+		}else if(type == proto::descriptor_type::ss_endpoint_companion) {
+			superspeed = true;
+		}else{
+			if(logEnumeration)
+				printf("block-usb: Unexpected descriptor type: %d!\n", type);
 		}
 	});
 
-	if(logEnumeration)
-		std::cout << "block-usb: Device class: 0x" << std::hex << intf_class.value()
-				<< ", subclass: 0x" << intf_subclass.value()
-				<< ", protocol: 0x" << intf_protocol.value()
-				<< std::dec << std::endl;
-	if(intf_class.value() != protocols::usb::usb_class::mass_storage
-			|| intf_subclass.value() != 0x06
-			|| intf_protocol.value() != 0x50)
-		co_return;
+	bool have_uas = uas_alternative && uas_pipes[uas::kPipeCommand] && uas_pipes[uas::kPipeStatus]
+			&& uas_pipes[uas::kPipeDataIn] && uas_pipes[uas::kPipeDataOut];
+	bool have_bot = bot_alternative && bot_in && bot_out;
 
-	if(logEnumeration)
-		std::cout << "block-usb: Detected USB device" << std::endl;
+	if(!have_uas && !have_bot)
+		co_return;
 
 	auto storage_device = new StorageDevice(device);
-	storage_device->run(config_number.value(), intf_number.value());
+	bool uas_started = false;
+	if(have_uas) {
+		uas_started = co_await storage_device->startUas(config_number.value(), intf_number.value(),
+				uas_alternative.value(),
+				UasPipes{uas_pipes[uas::kPipeCommand].value(), uas_pipes[uas::kPipeStatus].value(),
+					uas_pipes[uas::kPipeDataIn].value(), uas_pipes[uas::kPipeDataOut].value()},
+				superspeed);
+		if(uas_started) {
+			std::cout << "block-usb: Detected USB device (UAS)" << std::endl;
+		}else if(have_bot) {
+			std::cout << "block-usb: Falling back to BOT" << std::endl;
+		}
+	}
+	if(!uas_started) {
+		if(!have_bot) {
+			delete storage_device;
+			co_return;
+		}
+		if(logEnumeration)
+			std::cout << "block-usb: Detected USB device" << std::endl;
+		storage_device->runBot(config_number.value(), intf_number.value(), bot_alternative.value(),
+				BotPipes{bot_in.value(), bot_out.value()});
+	}
 	blockfs::runDevice(storage_device);
 }
 
@@ -1,9 +1,12 @@
 
+#include <array>
+
 #include <async/recurring-event.hpp>
 #include <async/oneshot-event.hpp>
 #include <async/result.hpp>
 #include <blockfs.hpp>
 #include <boost/intrusive/list.hpp>
+#include <protocols/usb/api.hpp>
 
 enum Signatures {
 	kSignCbw = 0x43425355,
@@ -29,6 +32,70 @@ struct [[ gnu::packed ]] CommandStatusWrapper {
 };
 static_assert(sizeof(CommandStatusWrapper) == 13);
 
+// ----------------------------------------------------------------
+// USB Attached SCSI (UAS) information units.
+// ----------------------------------------------------------------
+
+namespace uas {
+
+// Pipe IDs from the pipe usage descriptors.
+enum PipeId : uint8_t {
+	kPipeCommand = 1,
+	kPipeStatus = 2,
+	kPipeDataIn = 3,
+	kPipeDataOut = 4
+};
+
+enum IuId : uint8_t {
+	kIuCommand = 0x01,
+	kIuSense = 0x03,
+	kIuResponse = 0x04,
+	kIuTaskManagement = 0x05,
+	kIuReadReady = 0x06,
+	kIuWriteReady = 0x07
+};
+
+// Multi-byte fields of IUs are big endian.
+struct [[ gnu::packed ]] CommandIu {
+	uint8_t iuId;
+	uint8_t reserved0;
+	uint8_t tag[2];
+	uint8_t taskAttribute;
+	uint8_t reserved1;
+	uint8_t additionalCdbLength;
+	uint8_t reserved2;
+	uint8_t lun[8];
+	uint8_t cdb[16];
+};
+static_assert(sizeof(CommandIu) == 32);
+
+// Common prefix of all IUs that the device sends on the status pipe.
+struct [[ gnu::packed ]] IuHeader {
+	uint8_t iuId;
+	uint8_t reserved0;
+	uint8_t tag[2];
+};
+static_assert(sizeof(IuHeader) == 4);
+
+struct [[ gnu::packed ]] SenseIu {
+	IuHeader header;
+	uint8_t statusQualifier[2];
+	uint8_t status;
+	uint8_t reserved[7];
+	uint8_t senseLength[2];
+	uint8_t senseData[18];
+};
+static_assert(sizeof(SenseIu) == 34);
+
+struct [[ gnu::packed ]] ResponseIu {
+	IuHeader header;
+	uint8_t additionalResponseInfo[3];
+	uint8_t responseCode;
+};
+static_assert(sizeof(ResponseIu) == 8);
+
+} // namespace uas
+
 namespace scsi {
 
 struct Read6 {
@@ -95,12 +162,29 @@ struct Read32 {
 
 } // namespace scsi
 
+// Endpoint numbers of the Bulk-Only Transport interface.
+struct BotPipes {
+	int in;
+	int out;
+};
+
+// Endpoint numbers of the UAS interface, indexed by uas::PipeId.
+struct UasPipes {
+	int command;
+	int status;
+	int dataIn;
+	int dataOut;
+};
+
 struct StorageDevice : blockfs::BlockDevice {
 	//TODO(geert): hook up USB to sysfs too
 	StorageDevice(protocols::usb::Device usb_device)
 	: blockfs::BlockDevice(512, -1), _usbDevice(std::move(usb_device)) { }
 
-	async::detached run(int config_num, int intf_num);
+	async::detached runBot(int config_num, int intf_num, int alternative, BotPipes pipes);
+	// Returns false if UAS cannot be used with this host controller.
+	async::result<bool> startUas(int config_num, int intf_num, int alternative,
+			UasPipes pipes, bool superspeed);
 
 	async::result<void> readSectors(uint64_t sector,
 			void *buffer, size_t numSectors) override;
@@ -123,9 +207,32 @@ private:
 		boost::intrusive::list_member_hook<> requestHook;
 	};
 
+	// Maximal number of UAS commands that we keep in flight. Tags are 1-based;
+	// with streams, each tag is also the ID of the stream that the command uses.
+	static constexpr size_t maxUasTags = 32;
+
+	// Fills in the SCSI CDB for a request and returns its length.
+	static size_t buildCdb(Request *req, uint8_t *cdb);
+	static void buildCommandIu(Request *req, uint16_t tag, uas::CommandIu &iu);
+
+	async::detached _runUas(protocols::usb::Endpoint command, protocols::usb::Endpoint status,
+			protocols::usb::Endpoint dataIn, protocols::usb::Endpoint dataOut,
+			size_t numTags, bool streams);
+	// Without streams: receives the status IUs of all commands.
+	async::detached _receiveUasStatus(protocols::usb::Endpoint status,
+			protocols::usb::Endpoint dataIn, protocols::usb::Endpoint dataOut);
+	// With streams: runs the data and status phases of a single command.
+	async::detached _runUasStreamCommand(protocols::usb::Endpoint command,
+			protocols::usb::Endpoint status, protocols::usb::Endpoint data, uint16_t tag);
+	void _completeUasCommand(uint16_t tag, const uas::SenseIu &iu);
+
 	protocols::usb::Device _usbDevice;
 	async::recurring_event _doorbell;
 
+	// UAS commands that are currently in flight, indexed by tag.
+	std::array<Request *, maxUasTags + 1> _uasTags{};
+	size_t _uasInFlight = 0;
+
 	boost::intrusive::list<
 		Request,
 		boost::intrusive::member_hook<
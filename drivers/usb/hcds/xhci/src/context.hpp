@@ -157,6 +157,14 @@ namespace SlotFields {
 } // namespace SlotFields
 
 namespace EpFields {
+	constexpr ContextField maxPStreams(uint8_t v) {
+		return {0, uint32_t{v & 0x1Fu} << 10};
+	}
+
+	constexpr ContextField linearStreamArray(bool v) {
+		return {0, uint32_t{v} << 15};
+	}
+
 	constexpr ContextField interval(uint8_t v) {
 		return {0, uint32_t{v} << 16};
 	}
@@ -199,3 +207,34 @@ namespace EpFields {
 		return {4, uint32_t{v & 0xFFFF} << 16};
 	}
 } // namespace EpFields
+
+// Entry of a (linear) primary stream context array.
+struct alignas(16) StreamContext {
+	uint32_t val[4];
+};
+
+namespace StreamFields {
+	constexpr ContextField dequeCycle(bool v) {
+		return {0, uint32_t{v}};
+	}
+
+	// Stream context type; 1 denotes a primary transfer ring.
+	constexpr ContextField contextType(uint8_t v) {
+		return {0, uint32_t{v & 0b111u} << 1};
+	}
+
+	constexpr ContextField trPointerLo(uintptr_t v) {
+		assert(!(v & 0xF));
+		return {0, static_cast<uint32_t>(v & 0xFFFFFFF0u)};
+	}
+
+	constexpr ContextField trPointerHi(uintptr_t v) {
+		assert(!(v & 0xF));
+		return {1, static_cast<uint32_t>(v >> 32)};
+	}
+} // namespace StreamFields
+
+constexpr StreamContext &operator|=(StreamContext &ctx, ContextField field) {
+	ctx.val[field.word] |= field.value;
+	return ctx;
+}
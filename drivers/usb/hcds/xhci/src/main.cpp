@@ -1,7 +1,9 @@
 
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 #include <unistd.h>
+#include <algorithm>
 #include <optional>
 #include <functional>
 #include <memory>
@@ -35,12 +37,11 @@ namespace proto = protocols::usb;
 std::vector<std::shared_ptr<Controller>> globalControllers;
 
 Controller::Controller(protocols::hw::Device hw_device, mbus_ng::Entity entity, helix::Mapping mapping,
-		helix::UniqueDescriptor mmio, helix::UniqueIrq irq, std::string name)
+		helix::UniqueDescriptor mmio, std::vector<helix::UniqueIrq> irqs, std::string name)
 : _hw_device{std::move(hw_device)}, _mapping{std::move(mapping)},
-		_mmio{std::move(mmio)}, _irq{std::move(irq)},
+		_mmio{std::move(mmio)}, _irqs{std::move(irqs)},
 		_space{_mapping.get()}, _name{name}, _memoryPool{},
 		_dcbaa{&_memoryPool, 256}, _cmdRing{this},
-		_eventRing{this},
 		_enumerator{this}, _largeCtx{false},
 		_entity{std::move(entity)} {
 	auto doorbell_offset = _space.load(cap_regs::dboff);
@@ -122,6 +123,7 @@ async::detached Controller::initialize() {
 	std::cout << this << "Controller reset done" << std::endl;
 
 	_largeCtx = _space.load(cap_regs::hccparams1) & hccparams1::contextSize;
+	_maxPsaSize = _space.load(cap_regs::hccparams1) & hccparams1::maxPsaSize;
 
 	_maxDeviceSlots = _space.load(cap_regs::hcsparams1) & hcsparams1::maxDevSlots;
 	operational.store(op_regs::config, config::enabledDeviceSlots(_maxDeviceSlots));
@@ -159,16 +161,20 @@ async::detached Controller::initialize() {
 	// Tell the controller about our command ring
 	operational.store(op_regs::crcr, _cmdRing.getPtr() | 1);
 
-	// Set up interrupters
-	// TODO(qookie): MSIs let us use multiple interrupters to
-	// spread out the load (we probably want up to 1 per core?)
+	// Set up interrupters, one per IRQ that we got (bindController() already
+	// limited this to the number of CPUs and interrupters of the controller).
+	// Interrupter 0 receives command completion and port status change events,
+	// the others only receive transfer events of the endpoints assigned to them.
 	auto runtimeOffset = _space.load(cap_regs::rtsoff);
 	auto runtime = _space.subspace(runtimeOffset);
-	_interrupters.push_back(std::make_unique<Interrupter>(
-				&_eventRing,
-				interrupter::interrupterSpace(runtime, 0)));
-	_interrupters.back()->handleIrqs(_irq);
-	_interrupters.back()->initialize();
+	for (size_t i = 0; i < _irqs.size(); i++) {
+		_interrupters.push_back(std::make_unique<Interrupter>(
+					this, i,
+					interrupter::interrupterSpace(runtime, i)));
+		_interrupters.back()->handleIrqs(_irqs[i]);
+		_interrupters.back()->initialize();
+	}
+	std::cout << this << "Using " << _interrupters.size() << " interrupter(s)" << std::endl;
 
 	// Start the controller and enable interrupts
 	operational.store(op_regs::usbcmd, usbcmd::run(1) | usbcmd::intrEnable(1));
@@ -211,6 +217,30 @@ void Controller::ringDoorbell(uint8_t doorbell, uint8_t target, uint16_t stream_
 			target | (stream_id << 16));
 }
 
+uint16_t Controller::allocateInterrupter(proto::EndpointType type) {
+	// Default control endpoints stay on the primary interrupter, their traffic
+	// is mostly enumeration which also waits for command completions there.
+	if (_interrupters.size() == 1 || type == proto::EndpointType::control)
+		return 0;
+
+	// Otherwise, pick the least loaded secondary interrupter. This keeps
+	// e.g. HID interrupt endpoints from sharing an event ring with bulk
+	// endpoints of mass storage or network devices whenever possible.
+	auto it = std::min_element(_interrupters.begin() + 1, _interrupters.end(),
+			[] (const auto &a, const auto &b) {
+				return a->numEndpoints() < b->numEndpoints();
+			});
+	(*it)->attachEndpoint();
+	return (*it)->index();
+}
+
+void Controller::releaseInterrupter(uint16_t index) {
+	// The primary interrupter does not count its endpoints (see above).
+	if (!index)
+		return;
+	_interrupters[index]->detachEndpoint();
+}
+
 
 async::result<frg::expected<proto::UsbError>>
 Controller::enumerateDevice(std::shared_ptr<proto::Hub> parentHub, int port, proto::DeviceSpeed speed) {
@@ -327,7 +357,7 @@ void Controller::processEvent(Event ev) {
 
 		case transferEvent:
 			if (auto ep = _devices[ev.slotId]->endpoint(ev.endpointId))
-				ep->transferRing().processEvent(ev);
+				ep->processEvent(ev);
 			else
 				std::cout << this << "Event for missing endpoint ID " << ev.endpointId
 					<< " on slot " << ev.slotId << std::endl;
@@ -351,9 +381,9 @@ void Controller::processEvent(Event ev) {
 
 void Interrupter::initialize() {
 	// Initialize the event ring segment table
-	_space.store(interrupter::erstsz, _ring->getErstSize());
-	_space.store(interrupter::erstbaLow,_ring->getErstPtr() & 0xFFFFFFFF);
-	_space.store(interrupter::erstbaHi, _ring->getErstPtr() >> 32);
+	_space.store(interrupter::erstsz, _ring.getErstSize());
+	_space.store(interrupter::erstbaLow,_ring.getErstPtr() & 0xFFFFFFFF);
+	_space.store(interrupter::erstbaHi, _ring.getErstPtr() >> 32);
 
 	_updateDequeue();
 
@@ -376,15 +406,15 @@ async::detached Interrupter::handleIrqs(helix::UniqueIrq &irq) {
 		_clearPending();
 		HEL_CHECK(helAcknowledgeIrq(irq.getHandle(), kHelAckAcknowledge, sequence));
 
-		_ring->processRing();
+		_ring.processRing();
 		_updateDequeue();
 	}
 }
 
 void Interrupter::_updateDequeue() {
 	_space.store(interrupter::erdpLow,
-			(_ring->getEventRingPtr() & 0xFFFFFFF0) | (1 << 3));
-	_space.store(interrupter::erdpHi, _ring->getEventRingPtr() >> 32);
+			(_ring.getEventRingPtr() & 0xFFFFFFF0) | (1 << 3));
+	_space.store(interrupter::erdpHi, _ring.getEventRingPtr() >> 32);
 }
 
 bool Interrupter::_isBusy() {
@@ -597,39 +627,35 @@ async::result<frg::expected<proto::UsbError, proto::Configuration>>
 Device::useConfiguration(uint8_t index, uint8_t value) {
 	auto descriptor = FRG_CO_TRY(co_await configurationDescriptor(index));
 
-	struct EndpointInfo {
-		int pipe;
-		proto::PipeType dir;
-		int packetSize;
-		proto::EndpointType type;
-	};
-
-	std::vector<EndpointInfo> _eps = {};
+	std::vector<EndpointInfo> eps;
 
 	std::optional<uint8_t> valueByIndex;
 
 	proto::walkConfiguration(descriptor, [&] (int type, size_t length, void *p, const auto &info) {
-		(void)length;
-
 		if(type == proto::descriptor_type::configuration) {
 			auto desc = (proto::ConfigDescriptor *)p;
 			valueByIndex = desc->configValue;
 		}
 
+		if(type == proto::descriptor_type::ss_endpoint_companion) {
+			// The companion follows the endpoint descriptor that it belongs to.
+			// For bulk endpoints, bits 0-4 of bmAttributes encode MaxStreams.
+			if(!eps.empty() && length >= 4 && eps.back().type == proto::EndpointType::bulk)
+				eps.back().maxStreams = static_cast<uint8_t *>(p)[3] & 0x1F;
+			return;
+		}
+
 		if(type != proto::descriptor_type::endpoint)
 			return;
 		auto desc = (proto::EndpointDescriptor *)p;
 
-		// TODO: Pay attention to interface/alternative.
 		auto packetSize = desc->maxPacketSize & 0x7FF;
 		auto epType = info.endpointType.value();
 
-		int pipe = info.endpointNumber.value();
-		if (info.endpointIn.value()) {
-			_eps.push_back({pipe, proto::PipeType::in, packetSize, epType});
-		} else {
-			_eps.push_back({pipe, proto::PipeType::out, packetSize, epType});
-		}
+		eps.push_back({info.interfaceNumber.value(), info.interfaceAlternative.value(),
+				info.endpointNumber.value(),
+				info.endpointIn.value() ? proto::PipeType::in : proto::PipeType::out,
+				packetSize, epType, 0});
 	});
 
 	assert(valueByIndex);
@@ -640,11 +666,13 @@ Device::useConfiguration(uint8_t index, uint8_t value) {
 		co_return proto::UsbError::other;
 	}
 
-	for (auto &ep : _eps) {
-		std::cout << _controller << "Setting up " << (ep.dir == proto::PipeType::in ? "in" : "out")
-			<< " endpoint " << ep.pipe << " (max packet size: " << ep.packetSize << ")" << std::endl;
+	_endpointInfos = std::move(eps);
+	_alternatives.clear();
 
-		FRG_CO_TRY(co_await setupEndpoint(ep.pipe, ep.dir, ep.packetSize, ep.type));
+	// After SET_CONFIGURATION, all interfaces use their default alternate setting.
+	for (auto &ep : _endpointInfos) {
+		if (!_alternatives.contains(ep.interface))
+			FRG_CO_TRY(co_await useAlternative(ep.interface, 0));
 	}
 
 	arch::dma_object<proto::SetupPacket> setConfig{setupPool()};
@@ -666,9 +694,9 @@ Device::transfer(proto::ControlTransfer info) {
 	co_return co_await _endpoints[0]->transfer(info);
 }
 
-void Device::submit(int endpoint) {
+void Device::submit(int endpoint, uint16_t streamId) {
 	assert(_slotId != -1);
-	_controller->ringDoorbell(_slotId, endpoint);
+	_controller->ringDoorbell(_slotId, endpoint, streamId);
 }
 
 static inline uint8_t getHcdSpeedId(proto::DeviceSpeed speed) {
@@ -799,26 +827,56 @@ static inline uint32_t getDefaultAverageTrbLen(proto::EndpointType type) {
 
 
 async::result<frg::expected<proto::UsbError>>
-Device::setupEndpoint(int endpoint, proto::PipeType dir, size_t maxPacketSize, proto::EndpointType type) {
+Device::useAlternative(int interface, int alternative) {
 	InputContext inputCtx{_controller->largeCtx(), _controller->memoryPool()};
 
 	inputCtx.get(inputCtxCtrl) |= InputControlFields::add(0); // Slot Context
 	inputCtx.get(inputCtxSlot) = _devCtx.get(deviceCtxSlot);
 	inputCtx.get(inputCtxSlot) |= SlotFields::ctxEntries(31);
 
-	_initEpCtx(inputCtx, endpoint, dir, maxPacketSize, type);
+	// Endpoints that are both dropped and added are reconfigured.
+	std::vector<int> dropped;
+	if (auto it = _alternatives.find(interface); it != _alternatives.end()) {
+		for (auto &ep : _endpointInfos) {
+			if (ep.interface != interface || ep.alternative != it->second)
+				continue;
+			int endpointId = getEndpointIndex(ep.pipe, ep.dir);
+			inputCtx.get(inputCtxCtrl) |= InputControlFields::drop(endpointId);
+			dropped.push_back(endpointId);
+		}
+	}
+
+	for (auto &ep : _endpointInfos) {
+		if (ep.interface != interface || ep.alternative != alternative)
+			continue;
+
+		std::cout << _controller << "Setting up " << (ep.dir == proto::PipeType::in ? "in" : "out")
+			<< " endpoint " << ep.pipe << " (max packet size: " << ep.packetSize;
+		if (ep.maxStreams)
+			std::cout << ", max streams: " << (1 << ep.maxStreams);
+		std::cout << ")" << std::endl;
+
+		_initEpCtx(inputCtx, ep.pipe, ep.dir, ep.packetSize, ep.type, ep.maxStreams);
+		std::erase(dropped, getEndpointIndex(ep.pipe, ep.dir));
+	}
 
 	auto event = co_await _controller->submitCommand(
 			Command::configureEndpoint(_slotId,
 				helix::ptrToPhysical(inputCtx.rawData())));
 
 	if (event.completionCode != 1)
-		std::cout << _controller << "Failed to configure endpoint " << endpoint
+		std::cout << _controller << "Failed to configure endpoints of interface " << interface
+			<< " (alternate setting " << alternative << ")"
 			<< ", completion code: " << completionCodeNames[event.completionCode] << std::endl;
 
 	FRG_CO_TRY(completionToError(event));
 
-	std::cout << _controller << "Endpoint " << endpoint << " configured" << std::endl;
+	for (auto endpointId : dropped)
+		_endpoints[endpointId - 1] = nullptr;
+	_alternatives[interface] = alternative;
+
+	std::cout << _controller << "Interface " << interface << " (alternate setting "
+		<< alternative << ") configured" << std::endl;
 
 	co_return frg::success;
 }
@@ -852,15 +910,18 @@ Device::configureHub(std::shared_ptr<proto::Hub> hub, proto::DeviceSpeed speed)
 	co_return frg::success;
 }
 
-void Device::_initEpCtx(InputContext &ctx, int endpoint, proto::PipeType dir, size_t maxPacketSize, proto::EndpointType type) {
+void Device::_initEpCtx(InputContext &ctx, int endpoint, proto::PipeType dir, size_t maxPacketSize,
+		proto::EndpointType type, int maxStreams) {
 	int endpointId = getEndpointIndex(endpoint, dir);
 
 	ctx.get(inputCtxCtrl) |= InputControlFields::add(endpointId); // EP Context
 
-	auto ep = std::make_shared<EndpointState>(this, endpointId, type, maxPacketSize);
+	auto ep = std::make_shared<EndpointState>(this, endpointId, type, maxPacketSize,
+			_controller->allocateInterrupter(type));
 	_endpoints[endpointId - 1] = ep;
 
-	auto trPtr = ep->transferRing().getPtr();
+	if (type == proto::EndpointType::bulk && maxStreams && _controller->maxPsaSize())
+		ep->setupStreams(maxStreams);
 
 	auto &epCtx = ctx.get(inputCtxEp0 + endpointId - 1);
 
@@ -875,9 +936,19 @@ void Device::_initEpCtx(InputContext &ctx, int endpoint, proto::PipeType dir, si
 	// endpoint companion descriptor.
 	epCtx |= EpFields::maxEsitPayloadLo(maxPacketSize);
 	epCtx |= EpFields::maxEsitPayloadHi(maxPacketSize);
-	epCtx |= EpFields::dequeCycle(true);
-	epCtx |= EpFields::trPointerLo(trPtr);
-	epCtx |= EpFields::trPointerHi(trPtr);
+	if (ep->numStreams()) {
+		// The dequeue pointer field points to the stream context array instead.
+		auto streamPtr = ep->streamArrayPtr();
+		epCtx |= EpFields::maxPStreams(ep->maxPStreams());
+		epCtx |= EpFields::linearStreamArray(true);
+		epCtx |= EpFields::trPointerLo(streamPtr);
+		epCtx |= EpFields::trPointerHi(streamPtr);
+	} else {
+		auto trPtr = ep->transferRing().getPtr();
+		epCtx |= EpFields::dequeCycle(true);
+		epCtx |= EpFields::trPointerLo(trPtr);
+		epCtx |= EpFields::trPointerHi(trPtr);
+	}
 
 	// TODO(qookie): We should keep track of the average transfer sizes and
 	// update this every once in a while. Currently we just use the recommended
@@ -931,6 +1002,9 @@ ConfigurationState::useInterface(int number, int alternative) {
 	desc->index = number;
 	desc->length = 0;
 
+	// The xHC has to know about the new endpoints before the device switches.
+	FRG_CO_TRY(co_await _device->useAlternative(number, alternative));
+
 	// The device might stall if only the default setting is
 	// supported so just ignore that.
 	auto res = co_await _device->transfer({proto::kXferToDevice, desc, {}});
@@ -948,12 +1022,57 @@ ConfigurationState::useInterface(int number, int alternative) {
 // EndpointState
 // ------------------------------------------------------------------------
 
+EndpointState::~EndpointState() {
+	_controller->releaseInterrupter(_interrupter);
+}
+
+void EndpointState::setupStreams(int maxStreams) {
+	// MaxPStreams = n selects a primary stream array of 2^(n + 1) entries.
+	// Stream ID 0 is reserved, so 2^n streams fit into such an array.
+	_maxPStreams = std::min({maxStreams, int{_controller->maxPsaSize()}, maxStreamsLog2});
+	size_t arraySize = size_t{2} << _maxPStreams;
+	size_t count = std::min(size_t{1} << maxStreams, arraySize - 1);
+
+	_streamContexts = arch::dma_array<StreamContext>{_controller->memoryPool(), arraySize};
+	memset(_streamContexts.data(), 0, arraySize * sizeof(StreamContext));
+
+	_streamRings.resize(count + 1);
+	for (size_t i = 1; i <= count; i++) {
+		_streamRings[i] = std::make_unique<ProducerRing>(_controller);
+		auto trPtr = _streamRings[i]->getPtr();
+
+		auto &streamCtx = _streamContexts[i];
+		streamCtx |= StreamFields::dequeCycle(true);
+		streamCtx |= StreamFields::contextType(1);
+		streamCtx |= StreamFields::trPointerLo(trPtr);
+		streamCtx |= StreamFields::trPointerHi(trPtr);
+	}
+}
+
+void EndpointState::processEvent(Event ev) {
+	if (_streamRings.empty()) {
+		_transferRing.processEvent(ev);
+		return;
+	}
+
+	// Transfer events do not carry the stream ID, look up the ring by the TRB pointer.
+	for (size_t i = 1; i < _streamRings.size(); i++) {
+		if (_streamRings[i]->contains(ev.trbPointer)) {
+			_streamRings[i]->processEvent(ev);
+			return;
+		}
+	}
+
+	std::cout << _controller << "Transfer event for unknown stream of EP " << _endpointId
+		<< " on slot " << ev.slotId << ": " << completionCodeNames[ev.completionCode] << std::endl;
+}
+
 async::result<frg::expected<proto::UsbError, size_t>>
 EndpointState::transfer(proto::ControlTransfer info) {
 	ProducerRing::Transaction tx;
 
 	Transfer::buildControlChain([&] (RawTrb trb) {
-		_transferRing.pushRawTrb(trb, &tx);
+		_transferRing.pushRawTrb(Transfer::withInterrupterTarget(trb, _interrupter), &tx);
 	}, *info.setup.data(), info.buffer, info.flags == proto::kXferToHost,
 			_maxPacketSize);
 
@@ -965,7 +1084,7 @@ EndpointState::transfer(proto::ControlTransfer info) {
 	auto maybeResidue = co_await tx.control(info.buffer.size() != 0);
 
 	if (!maybeResidue && maybeResidue.error() == proto::UsbError::stall) {
-		auto res = co_await _resetAfterError(nextDequeue, nextCycle);
+		auto res = co_await _resetAfterError(_transferRing, 0, nextDequeue, nextCycle);
 		if (!res) {
 			std::cout << _device->controller() << "Failed to reset EP " << _endpointId
 				<< " after stall: " << (int)res.error() << std::endl;
@@ -976,22 +1095,27 @@ EndpointState::transfer(proto::ControlTransfer info) {
 }
 
 async::result<frg::expected<proto::UsbError, size_t>>
-EndpointState::_bulkOrInterruptXfer(arch::dma_buffer_view buffer) {
+EndpointState::_bulkOrInterruptXfer(arch::dma_buffer_view buffer, uint16_t streamId) {
+	// Endpoints with streams only accept transfers on one of their streams.
+	if (_streamRings.empty() ? streamId : (!streamId || streamId >= _streamRings.size()))
+		co_return proto::UsbError::other;
+	auto &ring = streamId ? *_streamRings[streamId] : _transferRing;
+
 	ProducerRing::Transaction tx;
 
 	Transfer::buildNormalChain([&] (RawTrb trb) {
-		_transferRing.pushRawTrb(trb, &tx);
+		ring.pushRawTrb(Transfer::withInterrupterTarget(trb, _interrupter), &tx);
 	}, buffer, _maxPacketSize);
 
-	size_t nextDequeue = _transferRing.enqueuePtr();
-	bool nextCycle = _transferRing.producerCycle();
+	size_t nextDequeue = ring.enqueuePtr();
+	bool nextCycle = ring.producerCycle();
 
-	_device->submit(_endpointId);
+	_device->submit(_endpointId, streamId);
 
 	auto maybeResidue = co_await tx.normal();
 
 	if (!maybeResidue && maybeResidue.error() == proto::UsbError::stall) {
-		auto res = co_await _resetAfterError(nextDequeue, nextCycle);
+		auto res = co_await _resetAfterError(ring, streamId, nextDequeue, nextCycle);
 		if (!res) {
 			std::cout << _device->controller() << "Failed to reset EP " << _endpointId
 				<< " after stall: " << (int)res.error() << std::endl;
@@ -1008,11 +1132,11 @@ EndpointState::transfer(proto::InterruptTransfer info) {
 
 async::result<frg::expected<proto::UsbError, size_t>>
 EndpointState::transfer(proto::BulkTransfer info) {
-	co_return co_await _bulkOrInterruptXfer(info.buffer);
+	co_return co_await _bulkOrInterruptXfer(info.buffer, info.streamId);
 }
 
 async::result<frg::expected<proto::UsbError>>
-EndpointState::_resetAfterError(size_t nextDequeue, bool cycle) {
+EndpointState::_resetAfterError(ProducerRing &ring, uint16_t streamId, size_t nextDequeue, bool cycle) {
 	// Issue the Reset Endpoint command to reset the xHC state
 	auto event = co_await _device->controller()->submitCommand(
 		Command::resetEndpoint(_device->slot(), _endpointId));
@@ -1043,11 +1167,14 @@ EndpointState::_resetAfterError(size_t nextDequeue, bool cycle) {
 	}
 
 	// Issue the Set TR Dequeue Pointer command to skip the failed
-	// transfer
-	auto dequeue = _transferRing.getPtr() + nextDequeue * sizeof(RawTrb);
+	// transfer. For streams, it also sets the type of the stream
+	// context (to a primary transfer ring).
+	auto dequeue = ring.getPtr() + nextDequeue * sizeof(RawTrb);
+	if (streamId)
+		dequeue |= 1 << 1;
 	event = co_await _device->controller()->submitCommand(
 		Command::setTransferRingDequeue(_device->slot(), _endpointId,
-				dequeue | cycle));
+				dequeue | cycle, streamId));
 
 	if (event.completionCode != 1)
 		std::cout << _device->controller() << "Failed to set TR dequeue pointer"
@@ -1056,7 +1183,7 @@ EndpointState::_resetAfterError(size_t nextDequeue, bool cycle) {
 	FRG_CO_TRY(completionToError(event));
 
 	// Ring the doorbell to restart the pipe
-	_device->submit(_endpointId);
+	_device->submit(_endpointId, streamId);
 
 	co_return frg::success;
 }
@@ -1071,23 +1198,40 @@ async::detached bindController(mbus_ng::Entity entity) {
 	assert(info.barInfo[0].ioType == protocols::hw::IoType::kIoTypeMemory);
 	auto bar = co_await device.accessBar(0);
 
-	helix::UniqueDescriptor irq;
+	helix::Mapping mapping{bar, info.barInfo[0].offset, info.barInfo[0].length};
+
+	std::vector<helix::UniqueIrq> irqs;
 
 	if (info.numMsis) {
 		co_await device.enableMsi();
-		irq = co_await device.installMsi(0);
+
+		// Only MSI-X lets us use multiple interrupters (plain MSI
+		// only supports a single vector). Use up to one per CPU.
+		size_t numIrqs = 1;
+		if (info.msiX) {
+			arch::mem_space space{mapping.get()};
+			size_t maxIntrs = space.load(cap_regs::hcsparams1) & hcsparams1::maxIntrs;
+			long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+
+			numIrqs = std::min({size_t{info.numMsis}, maxIntrs, maxInterrupters});
+			if (numCpus > 0)
+				numIrqs = std::min(numIrqs, static_cast<size_t>(numCpus));
+			numIrqs = std::max(numIrqs, size_t{1});
+		}
+
+		for (size_t i = 0; i < numIrqs; i++)
+			// Deliver each interrupter's IRQ to a different CPU.
+			irqs.push_back(co_await device.installMsi(i, i));
 	} else {
 		co_await device.enableBusIrq();
-		irq = co_await device.accessIrq();
+		irqs.push_back(co_await device.accessIrq());
 	}
 
 	co_await device.enableBusmaster();
 	co_await device.enableDma();
 
-	helix::Mapping mapping{bar, info.barInfo[0].offset, info.barInfo[0].length};
-
 	auto controller = std::make_shared<Controller>(std::move(device), std::move(entity), std::move(mapping),
-			std::move(bar), std::move(irq), std::format("pci.{:08x}", info.barInfo[0].address));
+			std::move(bar), std::move(irqs), std::format("pci.{:08x}", info.barInfo[0].address));
 	controller->initialize();
 	globalControllers.push_back(std::move(controller));
 }
@@ -193,7 +193,8 @@ void EventRing::processRing() {
 // ------------------------------------------------------------------------
 
 ProducerRing::ProducerRing(Controller *controller)
-: _transactions{}, _ring{controller->memoryPool()}, _controller{controller}, _enqueuePtr{0}, _pcs{true} {
+: _transactions{}, _ring{controller->memoryPool()}, _physical{helix::ptrToPhysical(_ring.data())},
+		_controller{controller}, _enqueuePtr{0}, _pcs{true} {
 	for (uint32_t i = 0; i < ringSize; i++) {
 		_ring->ent[i] = {{0, 0, 0, 0}};
 	}
@@ -202,7 +203,7 @@ ProducerRing::ProducerRing(Controller *controller)
 }
 
 uintptr_t ProducerRing::getPtr() {
-	return helix::ptrToPhysical(_ring.data());
+	return _physical;
 }
 
 void ProducerRing::pushRawTrb(RawTrb cmd, Transaction *tx) {
@@ -127,6 +127,10 @@ struct ProducerRing {
 	ProducerRing(Controller *controller);
 	uintptr_t getPtr();
 	size_t enqueuePtr() const { return _enqueuePtr; }
+	// Whether a TRB pointer (e.g., of a transfer event) points into this ring.
+	bool contains(uintptr_t trbPointer) const {
+		return trbPointer >= _physical && trbPointer < _physical + sizeof(RingEntries);
+	}
 	bool producerCycle() const { return _pcs; }
 
 	void pushRawTrb(RawTrb cmd, Transaction *tx);
@@ -136,6 +140,8 @@ struct ProducerRing {
 private:
 	std::array<Transaction *, ringSize> _transactions;
 	arch::dma_object<RingEntries> _ring;
+	// Physical address of _ring, cached since we look it up for every event.
+	uintptr_t _physical;
 	Controller *_controller;
 	size_t _enqueuePtr;
 
@@ -35,7 +35,7 @@ namespace cap_regs {
 
 namespace hcsparams1 {
 	inline constexpr arch::field<uint32_t, uint8_t> maxPorts(24, 8);
-	inline constexpr arch::field<uint32_t, uint16_t> maxIntrs(8, 10);
+	inline constexpr arch::field<uint32_t, uint16_t> maxIntrs(8, 11);
 	inline constexpr arch::field<uint32_t, uint8_t> maxDevSlots(0, 8);
 }
 
@@ -50,6 +50,7 @@ namespace hcsparams2 {
 namespace hccparams1 {
 	inline constexpr arch::field<uint32_t, uint16_t> extCapPtr(16, 16);
 	inline constexpr arch::field<uint32_t, bool> contextSize(2, 1);
+	inline constexpr arch::field<uint32_t, uint8_t> maxPsaSize(12, 4);
 }
 
 namespace usbcmd {
@@ -109,10 +109,12 @@ namespace Command {
 		};
 	}
 
-	constexpr RawTrb setTransferRingDequeue(uint8_t slotId, uint8_t endpointId, uintptr_t dequeue) {
+	// For endpoints with streams, dequeue also contains the stream context type.
+	constexpr RawTrb setTransferRingDequeue(uint8_t slotId, uint8_t endpointId, uintptr_t dequeue,
+			uint16_t streamId = 0) {
 		return RawTrb{
 			static_cast<uint32_t>(dequeue & 0xFFFFFFFF),
-			static_cast<uint32_t>(dequeue >> 32), 0,
+			static_cast<uint32_t>(dequeue >> 32), uint32_t{streamId} << 16,
 			(uint32_t{slotId} << 24) | (uint32_t{endpointId} << 16)
 			| (static_cast<uint32_t>(TrbType::setTrDequeuePtrCommand) << 10)
 		};
@@ -164,6 +166,12 @@ namespace Transfer {
 		return trb;
 	}
 
+	constexpr RawTrb withInterrupterTarget(RawTrb trb, uint16_t interrupter) {
+		assert(interrupter < 1024);
+		trb.val[2] = (trb.val[2] & 0x3FFFFF) | (uint32_t{interrupter} << 22);
+		return trb;
+	}
+
 	template <typename FU, typename FB, typename ...Ts>
 	inline void buildTransferChain(size_t maxPacketSize, FU use, arch::dma_buffer_view view, FB build, Ts ...ts) {
 		assert(std::popcount(maxPacketSize) == 1);
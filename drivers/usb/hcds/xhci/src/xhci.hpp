@@ -1,3 +1,5 @@
+#include <map>
+
 #include <arch/mem_space.hpp>
 #include <arch/dma_pool.hpp>
 #include <async/recurring-event.hpp>
@@ -64,20 +66,44 @@ struct Controller;
 // Interrupter
 // ----------------------------------------------------------------
 
+// Upper bound on the number of interrupters (and thus MSI-X vectors) that we
+// use per controller; IRQ vectors are a limited resource shared by all devices.
+constexpr size_t maxInterrupters = 8;
+
 struct Interrupter {
-	Interrupter(EventRing *ring, arch::mem_space space)
-	: _ring{ring}, _space{space} { }
+	Interrupter(Controller *controller, int index, arch::mem_space space)
+	: _ring{controller}, _index{index}, _space{space} { }
 
 	void initialize();
 	async::detached handleIrqs(helix::UniqueIrq &irq);
 
+	int index() const {
+		return _index;
+	}
+
+	// Number of endpoints whose transfer events target this interrupter.
+	size_t numEndpoints() const {
+		return _numEndpoints;
+	}
+
+	void attachEndpoint() {
+		_numEndpoints++;
+	}
+
+	void detachEndpoint() {
+		assert(_numEndpoints);
+		_numEndpoints--;
+	}
+
 private:
 	bool _isBusy();
 	void _clearPending();
 	void _updateDequeue();
 
-	EventRing *_ring;
+	EventRing _ring;
+	int _index;
 	arch::mem_space _space;
+	size_t _numEndpoints = 0;
 };
 
 // ----------------------------------------------------------------
@@ -121,7 +147,7 @@ struct Device final : proto::DeviceData, std::enable_shared_from_this<Device> {
 	transfer(proto::ControlTransfer info) override;
 
 
-	void submit(int endpoint);
+	void submit(int endpoint, uint16_t streamId = 0);
 
 	async::result<frg::expected<proto::UsbError>>
 	enumerate(size_t rootPort, size_t port, uint32_t route, std::shared_ptr<proto::Hub> hub, proto::DeviceSpeed speed, int slotType);
@@ -129,8 +155,10 @@ struct Device final : proto::DeviceData, std::enable_shared_from_this<Device> {
 	async::result<frg::expected<proto::UsbError>>
 	readDescriptor(arch::dma_buffer_view dest, uint16_t desc);
 
+	// Replaces the endpoints of the interface's current alternate setting
+	// by those of the given alternate setting.
 	async::result<frg::expected<proto::UsbError>>
-	setupEndpoint(int endpoint, proto::PipeType dir, size_t maxPacketSize, proto::EndpointType type);
+	useAlternative(int interface, int alternative);
 
 	async::result<frg::expected<proto::UsbError>>
 	configureHub(std::shared_ptr<proto::Hub> hub, proto::DeviceSpeed speed);
@@ -152,24 +180,49 @@ struct Device final : proto::DeviceData, std::enable_shared_from_this<Device> {
 	}
 
 private:
+	struct EndpointInfo {
+		int interface;
+		int alternative;
+		int pipe;
+		proto::PipeType dir;
+		int packetSize;
+		proto::EndpointType type;
+		// Log2 of the number of bulk streams; from the SuperSpeed endpoint companion.
+		int maxStreams;
+	};
+
 	int _slotId;
 
 	Controller *_controller;
 
 	DeviceContext _devCtx;
 
-	void _initEpCtx(InputContext &ctx, int endpoint, proto::PipeType dir, size_t maxPacketSize, proto::EndpointType type);
+	void _initEpCtx(InputContext &ctx, int endpoint, proto::PipeType dir, size_t maxPacketSize,
+			proto::EndpointType type, int maxStreams = 0);
 
 	std::array<std::shared_ptr<EndpointState>, 31> _endpoints;
+
+	// Endpoints of all alternate settings of the current configuration.
+	std::vector<EndpointInfo> _endpointInfos;
+	// Alternate setting that is currently configured for each interface.
+	std::map<int, int> _alternatives;
 };
 
 
+// Upper bound on the number of bulk streams per endpoint (as log2);
+// this bounds the memory that we spend on their transfer rings.
+constexpr int maxStreamsLog2 = 5;
+
 struct EndpointState final : proto::EndpointData {
 	friend struct Device;
 
-	explicit EndpointState(Device *device, int endpointId, proto::EndpointType type, size_t maxPacketSize)
-	: _device{device}, _endpointId{endpointId}, _type{type},
-		_maxPacketSize{maxPacketSize}, _transferRing{device->controller()} { }
+	explicit EndpointState(Device *device, int endpointId, proto::EndpointType type,
+			size_t maxPacketSize, uint16_t interrupter)
+	: _device{device}, _controller{device->controller()}, _endpointId{endpointId}, _type{type},
+		_maxPacketSize{maxPacketSize}, _interrupter{interrupter},
+		_transferRing{device->controller()} { }
+
+	~EndpointState();
 
 	async::result<frg::expected<proto::UsbError, size_t>>
 	transfer(proto::ControlTransfer info) override;
@@ -180,23 +233,52 @@ struct EndpointState final : proto::EndpointData {
 	async::result<frg::expected<proto::UsbError, size_t>>
 	transfer(proto::BulkTransfer info) override;
 
+	size_t numStreams() override {
+		return _streamRings.empty() ? 0 : _streamRings.size() - 1;
+	}
+
+	// Sets up a primary stream array for up to 2^maxStreams bulk streams.
+	// Must be called before the endpoint context is initialized.
+	void setupStreams(int maxStreams);
+
+	uintptr_t streamArrayPtr() {
+		return helix::ptrToPhysical(_streamContexts.data());
+	}
+
+	// Value of the MaxPStreams field of the endpoint context.
+	uint8_t maxPStreams() const {
+		return _maxPStreams;
+	}
+
 	ProducerRing &transferRing() {
 		return _transferRing;
 	}
 
+	void processEvent(Event ev);
+
 private:
 	Device *_device;
+	// Also kept here since the endpoint can outlive its device.
+	Controller *_controller;
 	int _endpointId;
 	proto::EndpointType _type;
 
 	size_t _maxPacketSize;
+	// Interrupter that receives the transfer events of this endpoint.
+	uint16_t _interrupter;
+	// Unused if the endpoint has streams.
 	ProducerRing _transferRing;
 
+	// Transfer rings of the bulk streams, indexed by stream ID (entry 0 is unused).
+	std::vector<std::unique_ptr<ProducerRing>> _streamRings;
+	arch::dma_array<StreamContext> _streamContexts;
+	uint8_t _maxPStreams = 0;
+
 	async::result<frg::expected<proto::UsbError, size_t>>
-	_bulkOrInterruptXfer(arch::dma_buffer_view buffer);
+	_bulkOrInterruptXfer(arch::dma_buffer_view buffer, uint16_t streamId = 0);
 
 	async::result<frg::expected<proto::UsbError>>
-	_resetAfterError(size_t nextDequeue, bool nextCycle);
+	_resetAfterError(ProducerRing &ring, uint16_t streamId, size_t nextDequeue, bool nextCycle);
 };
 
 
@@ -234,7 +316,7 @@ struct Controller final : proto::BaseController {
 			mbus_ng::Entity entity,
 			helix::Mapping mapping,
 			helix::UniqueDescriptor mmio,
-			helix::UniqueIrq irq,
+			std::vector<helix::UniqueIrq> irqs,
 			std::string name);
 
 	virtual ~Controller() = default;
@@ -252,6 +334,11 @@ struct Controller final : proto::BaseController {
 
 	void ringDoorbell(uint8_t doorbell, uint8_t target, uint16_t streamId = 0);
 
+	// Picks the interrupter that receives the transfer events of a new endpoint.
+	uint16_t allocateInterrupter(proto::EndpointType type);
+	// Called when an endpoint that was assigned an interrupter goes away.
+	void releaseInterrupter(uint16_t index);
+
 	async::result<Event> submitCommand(RawTrb trb) {
 		ProducerRing::Transaction tx;
 		_cmdRing.pushRawTrb(trb, &tx);
@@ -265,6 +352,11 @@ struct Controller final : proto::BaseController {
 		return _largeCtx;
 	}
 
+	// Log2 of the maximal primary stream array size, minus one (zero if streams are not supported).
+	uint8_t maxPsaSize() const {
+		return _maxPsaSize;
+	}
+
 	void setDeviceContext(size_t slot, DeviceContext &ctx) {
 		_dcbaa[slot] = helix::ptrToPhysical(ctx.rawData());
 	}
@@ -366,7 +458,8 @@ private:
 	protocols::hw::Device _hw_device;
 	helix::Mapping _mapping;
 	helix::UniqueDescriptor _mmio;
-	helix::UniqueIrq _irq;
+	// One IRQ per interrupter.
+	std::vector<helix::UniqueIrq> _irqs;
 	arch::mem_space _space;
 	arch::mem_space _doorbells;
 
@@ -387,7 +480,6 @@ private:
 	std::vector<std::shared_ptr<RootHub>> _rootHubs;
 
 	ProducerRing _cmdRing;
-	EventRing _eventRing;
 
 	int _numPorts;
 	int _maxDeviceSlots;
@@ -395,6 +487,7 @@ private:
 	proto::Enumerator _enumerator;
 
 	bool _largeCtx;
+	uint8_t _maxPsaSize = 0;
 
 	mbus_ng::Entity _entity;
 };
@@ -263,3 +263,26 @@ extern inline __attribute__ (( always_inline )) HelError helSyscall6_1 (int numb
 	*res0 = out0;
 	return error;
 }
+
+extern inline __attribute__ (( always_inline )) HelError helSyscall6_2 (int number,
+		HelWord arg0, HelWord arg1, HelWord arg2, HelWord arg3, HelWord arg4,
+		HelWord arg5, HelWord *res0, HelWord *res1) {
+	register HelWord error asm("a0");
+	register HelWord code asm("a0") = number;
+	register HelWord in0 asm("a1") = arg0;
+	register HelWord in1 asm("a2") = arg1;
+	register HelWord in2 asm("a3") = arg2;
+	register HelWord in3 asm("a4") = arg3;
+	register HelWord in4 asm("a5") = arg4;
+	register HelWord in5 asm("a6") = arg5;
+	register HelWord out0 asm("a1");
+	register HelWord out1 asm("a2");
+
+	asm volatile ( "ecall" : "=r" (error), "=r" (out0), "=r" (out1)
+			: "r" (code), "r" (in0), "r" (in1), "r" (in2), "r" (in3), "r" (in4), "r" (in5)
+			: "memory" );
+
+	*res0 = out0;
+	*res1 = out1;
+	return error;
+}
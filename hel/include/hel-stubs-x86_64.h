@@ -261,3 +261,26 @@ extern inline __attribute__ (( always_inline )) HelError helSyscall6_1(int numbe
 	*res0 = out0;
 	return error;
 }
+
+extern inline __attribute__ (( always_inline )) HelError helSyscall6_2(int number,
+		HelWord arg0, HelWord arg1, HelWord arg2, HelWord arg3, HelWord arg4,
+		HelWord arg5, HelWord *res0, HelWord *res1) {
+	register HelWord in0 asm("rsi") = arg0;
+	register HelWord in1 asm("rdx") = arg1;
+	register HelWord in2 asm("rax") = arg2;
+	register HelWord in3 asm("r8") = arg3;
+	register HelWord in4 asm("r9") = arg4;
+	register HelWord in5 asm("r10") = arg5;
+
+	HelWord error;
+	register HelWord out0 asm("rsi");
+	register HelWord out1 asm("rdx");
+
+	asm volatile ( "syscall" : "=D" (error), "=r" (out0), "=r" (out1)
+			: "D" (number), "r" (in0), "r" (in1), "r" (in2), "r" (in3), "r" (in4), "r" (in5)
+			: "rcx", "r11", "rbx", "memory" );
+
+	*res0 = out0;
+	*res1 = out1;
+	return error;
+}
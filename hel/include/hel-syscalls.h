@@ -88,6 +88,12 @@ extern inline __attribute__ (( always_inline )) HelError helResizeMemory(HelHand
 	return error;
 };
 
+extern inline __attribute__ (( always_inline )) HelError helDiscardMemory(HelHandle handle,
+		uintptr_t offset, size_t size) {
+	return helSyscall3(kHelCallDiscardMemory, (HelWord)handle, (HelWord)offset,
+			(HelWord)size);
+};
+
 extern inline __attribute__ (( always_inline )) HelError helCreateManagedMemory(size_t size,
 		uint32_t flags, HelHandle *backing_handle, HelHandle *frontal_handle) {
 	HelWord back_handle;
@@ -151,6 +157,12 @@ extern inline __attribute__ (( always_inline )) HelError helForkMemory(HelHandle
 	return error;
 };
 
+extern inline __attribute__ (( always_inline )) HelError helForkMappings(HelHandle space,
+		struct HelForkMapping *mappings, size_t count) {
+	return helSyscall3(kHelCallForkMappings, (HelWord)space, (HelWord)mappings,
+			(HelWord)count);
+};
+
 extern inline __attribute__ (( always_inline )) HelError helCreateSpace(HelHandle *handle) {
 	HelWord handle_word;
 	HelError error = helSyscall0_1(kHelCallCreateSpace, &handle_word);
@@ -209,6 +221,11 @@ extern inline __attribute__ (( always_inline )) HelError helUnmapMemory(HelHandl
 	return helSyscall3(kHelCallUnmapMemory, (HelWord)space, (HelWord)pointer, (HelWord)size);
 };
 
+extern inline __attribute__ (( always_inline )) HelError helQuerySpaceStats(HelHandle space,
+		struct HelSpaceStats *stats) {
+	return helSyscall2(kHelCallQuerySpaceStats, (HelWord)space, (HelWord)stats);
+};
+
 extern inline __attribute__ (( always_inline )) HelError helSubmitSynchronizeSpace(
 		HelHandle space, void *pointer, size_t size,
 		HelHandle queue, uintptr_t context) {
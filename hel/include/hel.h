@@ -18,7 +18,7 @@
 
 enum {
 	// largest system call number plus 1
-	kHelNumCalls = 105,
+	kHelNumCalls = 108,
 
 	kHelCallLog = 1,
 	kHelCallPanic = 10,
@@ -37,11 +37,13 @@ enum {
 
 	kHelCallAllocateMemory = 51,
 	kHelCallResizeMemory = 83,
+	kHelCallDiscardMemory = 107,
 	kHelCallCreateManagedMemory = 64,
 	kHelCallCopyOnWrite = 39,
 	kHelCallAccessPhysical = 30,
 	kHelCallCreateSliceView = 88,
 	kHelCallForkMemory = 40,
+	kHelCallForkMappings = 106,
 	kHelCallCreateSpace = 27,
 	kHelCallCreateIndirectMemory = 45,
 	kHelCallAlterMemoryIndirection = 52,
@@ -58,6 +60,7 @@ enum {
 	kHelCallSubmitLockMemoryView = 48,
 	kHelCallLoadahead = 49,
 	kHelCallCreateVirtualizedSpace = 50,
+	kHelCallQuerySpaceStats = 105,
 
 	kHelCallCreateThread = 67,
 	kHelCallQueryThreadStats = 95,
@@ -187,6 +190,11 @@ enum {
 	kHelWaitInfinite = -1
 };
 
+enum {
+	//! Maximal number of mappings per call to ::helForkMappings.
+	kHelMaxForkMappings = 256
+};
+
 enum {
 	kHelAbiSystemV = 1
 };
@@ -254,7 +262,8 @@ enum HelMapFlags {
 	kHelMapProtExecute = 1024,
 	kHelMapDontRequireBacking = 128,
 	kHelMapFixed = 2048,
-	kHelMapFixedNoReplace = 4096
+	kHelMapFixedNoReplace = 4096,
+	kHelMapPopulate = 8192
 };
 
 enum HelThreadFlags {
@@ -567,6 +576,33 @@ struct HelThreadStats {
 	uint64_t userTime;
 };
 
+struct HelSpaceStats {
+	uint64_t minorFaults;
+	uint64_t majorFaults;
+	uint64_t prefaultedPages;
+};
+
+//! Describes one mapping for ::helForkMappings.
+struct HelForkMapping {
+	//! Handle to the memory object that is mapped.
+	HelHandle memory;
+	//! If non-zero, @p memory is forked (see ::helForkMemory) and the fork is mapped instead.
+	int copyOnWrite;
+	//! Offset in bytes, relative to @p memory. Must be aligned to the system's page size.
+	uintptr_t offset;
+	//! Pointer to which the memory is mapped. Must be aligned to the system's page size.
+	void *pointer;
+	//! Size of the mapping in bytes. Must be aligned to the system's page size.
+	size_t size;
+	//! Protection and placement flags (see ::HelMapFlags).
+	uint32_t flags;
+	//! Set by the kernel: handle to the forked memory object
+	//! (or ::kHelNullHandle if @p copyOnWrite is zero).
+	HelHandle forkedMemory;
+	//! Set by the kernel: result of mapping the memory (see ::helMapMemory).
+	HelError error;
+};
+
 enum {
   kHelVmexitHlt = 0,
   kHelVmexitTranslationFault = 1,
@@ -700,6 +736,20 @@ HEL_C_LINKAGE HelError helAllocateMemory(size_t size, uint32_t flags,
 //!    	New size in bytes.
 HEL_C_LINKAGE HelError helResizeMemory(HelHandle handle, size_t newSize);
 
+//! Discards the contents of a range of a memory object.
+//!
+//! Afterwards, the range reads as zero. Memory objects that were
+//! created by ::helAllocateMemory release the pages of the range.
+//! @param[in] handle
+//!    	Handle to the memory object.
+//! @param[in] offset
+//!    	Offset of the range in bytes.
+//!    	Must be aligned to the system's page size.
+//! @param[in] size
+//!    	Size of the range in bytes.
+//!    	Must be aligned to the system's page size.
+HEL_C_LINKAGE HelError helDiscardMemory(HelHandle handle, uintptr_t offset, size_t size);
+
 //! Creates a memory object that is managed by userspace.
 //!
 //!    The @p backingHandle is used to manage the memory object, while
@@ -768,6 +818,21 @@ HEL_C_LINKAGE HelError helCreateSliceView(HelHandle bundle, uintptr_t offset, si
 //!    	Handle to the new (i.e., forked) memory object.
 HEL_C_LINKAGE HelError helForkMemory(HelHandle handle, HelHandle *forkedHandle);
 
+//! Forks and maps a batch of memory objects into an address space.
+//!
+//! This is equivalent to calling ::helForkMemory and ::helMapMemory for each entry,
+//! but it only enters the kernel once and all memory objects are forked concurrently.
+//! Entries whose @p memory handles refer to the same memory object share a single fork,
+//! i.e., their @p forkedMemory handles refer to the same forked memory object.
+//! @param[in] spaceHandle
+//!     Handle to the address space that the memory is mapped into.
+//! @param[in,out] mappings
+//!     Pointer to an array of mappings (see ::HelForkMapping).
+//! @param[in] count
+//!     Number of mappings. Must not exceed ::kHelMaxForkMappings.
+HEL_C_LINKAGE HelError helForkMappings(HelHandle spaceHandle,
+		struct HelForkMapping *mappings, size_t count);
+
 //! Creates a virtual address space that threads can run in.
 //! @param[out] handle
 //!     Handle to the new address space.
@@ -787,6 +852,10 @@ HEL_C_LINKAGE HelError helCreateSpace(HelHandle *handle);
 //! @param[in] size
 //!    	Size of the mappping in bytes.
 //!    	Must be aligned to the system's page size.
+//! @param[in] flags
+//!    	Protection and placement flags (see ::HelMapFlags).
+//!    	If ::kHelMapPopulate is set, all pages are fetched and mapped
+//!    	before this call returns; failures to do so are ignored.
 //! @param[out] actualPointer
 //!    	Pointer to which the memory is mapped.
 //!     Differs from @p pointer only if @p pointer was specified as @p NULL.
@@ -839,6 +908,14 @@ HEL_C_LINKAGE HelError helSubmitSynchronizeSpace(HelHandle spaceHandle,
 //!    	Must be aligned to the system's page size.
 HEL_C_LINKAGE HelError helUnmapMemory(HelHandle spaceHandle, void *pointer, size_t size);
 
+//! Query page fault statistics of an address space.
+//! @param[in] spaceHandle
+//!     Handle to the address space.
+//!     Can be ::kHelNullHandle to query the address space of the current thread.
+//! @param[out] stats
+//!     Statistics related to the address space.
+HEL_C_LINKAGE HelError helQuerySpaceStats(HelHandle spaceHandle, struct HelSpaceStats *stats);
+
 HEL_C_LINKAGE HelError helPointerPhysical(const void *pointer, uintptr_t *physical);
 
 //! Load memory (i.e., bytes) from a descriptor.
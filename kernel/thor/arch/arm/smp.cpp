@@ -91,6 +91,7 @@ namespace {
 		Scheduler::resume(cpuContext->wqFiber);
 
 		LoadBalancer::singleton().setOnline(cpuContext);
+		runZeroingFiber(cpuContext);
 		auto *scheduler = &localScheduler.get();
 		scheduler->update();
 		scheduler->forceReschedule();
@@ -81,6 +81,7 @@ void smpMain(StatusBlock *statusBlock) {
 		    Scheduler::resume(getCpuData()->wqFiber);
 
 		    LoadBalancer::singleton().setOnline(getCpuData());
+		    runZeroingFiber(getCpuData());
 		    auto *scheduler = &localScheduler.get();
 		    scheduler->update();
 		    scheduler->forceReschedule();
@@ -7,6 +7,7 @@
 #include <thor-internal/load-balancing.hpp>
 #include <thor-internal/main.hpp>
 #include <thor-internal/physical.hpp>
+#include <thor-internal/profile.hpp>
 #include <thor-internal/ring-buffer.hpp>
 #include <thor-internal/cpu-data.hpp>
 #include <thor-internal/arch/pic.hpp>
@@ -765,8 +766,10 @@ void secondaryMain(StatusBlock *statusBlock) {
 	debugLogger() << "Hello world from CPU #" << getLocalApicId() << frg::endlog;
 
 	Scheduler::resume(cpuContext->wqFiber);
+	initializeProfileForThisCpu();
 
 	LoadBalancer::singleton().setOnline(cpuContext);
+	runZeroingFiber(cpuContext);
 	auto scheduler = &localScheduler.get();
 	scheduler->update();
 	scheduler->forceReschedule();
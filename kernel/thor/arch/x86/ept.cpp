@@ -120,6 +120,12 @@ frg::expected<Error> EptOperations::remapPresentPages(VirtualAddr va, MemoryView
 			va, view, offset, size, flags);
 }
 
+frg::expected<Error, size_t> EptOperations::mapMissingPages(VirtualAddr va, MemoryView *view,
+		uintptr_t offset, size_t size, PageFlags flags) {
+	return mapMissingPagesByCursor<EptCursor>(pageSpace_,
+			va, view, offset, size, flags);
+}
+
 frg::expected<Error> EptOperations::faultPage(VirtualAddr va, MemoryView *view,
 		uintptr_t offset, PageFlags flags) {
 	return faultPageByCursor<EptCursor>(pageSpace_,
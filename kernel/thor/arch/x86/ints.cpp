@@ -1,12 +1,15 @@
 #include <thor-internal/cpu-data.hpp>
+#include <thor-internal/fiber.hpp>
 #include <thor-internal/int-call.hpp>
 #include <thor-internal/profile.hpp>
 #include <thor-internal/thread.hpp>
+#include <thor-internal/universe.hpp>
 #include <thor-internal/arch-generic/cpu.hpp>
 #include <thor-internal/arch/pmc-amd.hpp>
 #include <thor-internal/arch/pmc-intel.hpp>
 #include <thor-internal/arch/system.hpp>
 #include <thor-internal/arch/pic.hpp>
+#include <thor-internal/arch/stack.hpp>
 
 extern char stubsPtr[], stubsLimit[];
 
@@ -554,6 +557,65 @@ namespace {
 			}
 		}
 	}
+
+#ifdef THOR_HAS_FRAME_POINTERS
+	// Finds the kernel stack that sp points into. The interrupted code can run
+	// on the stack of a thread or fiber or on one of the per-CPU stacks.
+	UniqueKernelStack *findInterruptedStack(CpuData *cpuData, uintptr_t sp) {
+		auto check = [&] (UniqueKernelStack &stack) {
+			return stack.basePtr() && stack.contains(reinterpret_cast<void *>(sp));
+		};
+
+		if(auto fiber = cpuData->activeFiber; fiber && check(fiber->getContext().stack))
+			return &fiber->getContext().stack;
+		if(auto thread = cpuData->activeThread.get();
+				thread && check(thread->getContext().kernelStack))
+			return &thread->getContext().kernelStack;
+		UniqueKernelStack *perCpuStacks[] = {&cpuData->irqStack, &cpuData->nmiStack,
+				&cpuData->detachedStack, &cpuData->idleStack};
+		for(auto stack : perCpuStacks) {
+			if(check(*stack))
+				return stack;
+		}
+		return nullptr;
+	}
+#endif
+
+	void recordProfileSample(CpuData *cpuData, NmiImageAccessor image) {
+		ProfileSample sample;
+		sample.header.magic = profileSampleMagic;
+		sample.header.flags = 0;
+		sample.header.cpu = cpuData->cpuIndex;
+		sample.header.reserved = 0;
+		sample.header.universeId = 0;
+		sample.frames[0] = *image.ip();
+		sample.header.numFrames = 1;
+
+		if(image.inUserDomain()) {
+			// If we interrupted user space, the active thread is guaranteed to be alive.
+			// Note that we cannot unwind user stacks here since we must not fault in NMI context.
+			auto thread = cpuData->activeThread.get();
+			sample.header.flags |= profileSampleUser;
+			sample.header.universeId = thread->getUniverse()->id();
+		}else{
+#ifdef THOR_HAS_FRAME_POINTERS
+			// Only follow frames that live on the interrupted kernel stack,
+			// between the interrupted sp and the top of that stack.
+			auto sp = *image.sp();
+			if(auto stack = findInterruptedStack(cpuData, sp); stack) {
+				walkStackFrom(*image.bp(), sp, reinterpret_cast<uintptr_t>(stack->basePtr()),
+						[&] (uintptr_t ip) {
+					if(sample.header.numFrames == profileMaxFrames)
+						return false;
+					sample.frames[sample.header.numFrames++] = ip;
+					return true;
+				});
+			}
+#endif
+		}
+
+		cpuData->localProfileRing->enqueue(&sample, sample.size());
+	}
 }
 
 extern "C" void onPlatformNmi(NmiImageAccessor image) {
@@ -573,15 +635,13 @@ extern "C" void onPlatformNmi(NmiImageAccessor image) {
 	bool explained = false;
 	auto pmcMechanism = cpuData->profileMechanism.load(std::memory_order_acquire);
 	if(pmcMechanism == ProfileMechanism::intelPmc && checkIntelPmcOverflow()) {
-		uintptr_t ip = *image.ip();
-		cpuData->localProfileRing->enqueue(&ip, sizeof(uintptr_t));
+		recordProfileSample(cpuData, image);
 		// Note: on Intel, the PMI is automatically masked on raises.
 		LocalApicContext::clearPmi();
 		setIntelPmc();
 		explained = true;
 	}else if(pmcMechanism == ProfileMechanism::amdPmc && checkAmdPmcOverflow()) {
-		uintptr_t ip = *image.ip();
-		cpuData->localProfileRing->enqueue(&ip, sizeof(uintptr_t));
+		recordProfileSample(cpuData, image);
 		setAmdPmc();
 		explained = true;
 	}
@@ -108,6 +108,12 @@ frg::expected<Error> NptOperations::remapPresentPages(VirtualAddr va, MemoryView
 			va, view, offset, size, flags);
 }
 
+frg::expected<Error, size_t> NptOperations::mapMissingPages(VirtualAddr va, MemoryView *view,
+		uintptr_t offset, size_t size, PageFlags flags) {
+	return mapMissingPagesByCursor<NptCursor>(pageSpace_,
+			va, view, offset, size, flags);
+}
+
 frg::expected<Error> NptOperations::faultPage(VirtualAddr va, MemoryView *view,
 		uintptr_t offset, PageFlags flags) {
 	return faultPageByCursor<NptCursor>(pageSpace_,
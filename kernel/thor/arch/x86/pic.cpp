@@ -454,8 +454,8 @@ extern IrqSpinlock globalIrqSlotsLock;
 
 namespace {
 	struct ApicMsiPin final : MsiPin {
-		ApicMsiPin(frg::string<KernelAlloc> name, unsigned int vector)
-		: MsiPin{std::move(name)}, vector_{vector} { }
+		ApicMsiPin(frg::string<KernelAlloc> name, unsigned int vector, uint8_t apicId)
+		: MsiPin{std::move(name)}, vector_{vector}, apicId_{apicId} { }
 
 		IrqStrategy program(TriggerMode mode, Polarity) override {
 			assert(mode == TriggerMode::edge);
@@ -475,7 +475,8 @@ namespace {
 		}
 
 		uint64_t getMessageAddress() override {
-			return 0xFEE00000;
+			// Physical destination mode, no redirection hint.
+			return 0xFEE00000 | (uint64_t{apicId_} << 12);
 		}
 
 		uint32_t getMessageData() override {
@@ -484,10 +485,11 @@ namespace {
 
 	private:
 		unsigned int vector_;
+		uint8_t apicId_;
 	};
 }
 
-MsiPin *allocateApicMsi(frg::string<KernelAlloc> name) {
+MsiPin *allocateApicMsi(frg::string<KernelAlloc> name, unsigned int cpu) {
 	auto guard = frg::guard(&globalIrqSlotsLock);
 
 	int slotIndex = -1;
@@ -500,16 +502,25 @@ MsiPin *allocateApicMsi(frg::string<KernelAlloc> name) {
 	if(slotIndex == -1)
 		return nullptr;
 
+	// Fall back to the BSP if the caller asks for a CPU that does not exist.
+	if(cpu >= getCpuCount())
+		cpu = 0;
+	// The destination field of the MSI address only has 8 bits; without
+	// interrupt remapping, CPUs with larger APIC IDs cannot be targeted.
+	int apicId = getCpuData(cpu)->localApicId;
+	if(apicId > 0xFF)
+		apicId = getCpuData(0)->localApicId;
+
 	// Create an IRQ pin for the MSI.
 	auto pin = frg::construct<ApicMsiPin>(*kernelAlloc,
-			std::move(name), 64 + slotIndex);
+			std::move(name), 64 + slotIndex, static_cast<uint8_t>(apicId));
 	pin->configure(IrqConfiguration{
 		.trigger = TriggerMode::edge,
 		.polarity = Polarity::high
 	});
 
 	infoLogger() << "thor: Allocating IRQ slot " << slotIndex
-			<< " to " << pin->name() << frg::endlog;
+			<< " to " << pin->name() << " (APIC ID " << apicId << ")" << frg::endlog;
 	globalIrqSlots[slotIndex]->link(pin);
 
 	return pin;
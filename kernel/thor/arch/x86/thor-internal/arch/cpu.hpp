@@ -285,9 +285,15 @@ struct NmiImageAccessor {
 	}
 
 	Word *ip() { return &_frame()->rip; }
+	Word *sp() { return &_frame()->rsp; }
+	Word *bp() { return &_frame()->rbp; }
 	Word *cs() { return &_frame()->cs; }
 	Word *rflags() { return &_frame()->rflags; }
 
+	bool inUserDomain() {
+		return *cs() == kSelClientUserCompat || *cs() == kSelClientUserCode;
+	}
+
 private:
 	// note: this struct is accessed from assembly.
 	// do not change the field offsets!
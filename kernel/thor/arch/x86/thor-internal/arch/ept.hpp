@@ -42,6 +42,9 @@ struct EptOperations final : VirtualOperations {
 	frg::expected<Error> remapPresentPages(VirtualAddr va, MemoryView *view,
 			uintptr_t offset, size_t size, PageFlags flags) override;
 
+	frg::expected<Error, size_t> mapMissingPages(VirtualAddr va, MemoryView *view,
+			uintptr_t offset, size_t size, PageFlags flags) override;
+
 	frg::expected<Error> faultPage(VirtualAddr va, MemoryView *view,
 			uintptr_t offset, PageFlags flags) override;
 
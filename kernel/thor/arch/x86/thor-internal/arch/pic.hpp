@@ -93,7 +93,7 @@ void sendGlobalNmi();
 // MSI management
 // --------------------------------------------------------
 
-MsiPin *allocateApicMsi(frg::string<KernelAlloc> name);
+MsiPin *allocateApicMsi(frg::string<KernelAlloc> name, unsigned int cpu);
 
 // --------------------------------------------------------
 // I/O APIC management
@@ -16,4 +16,23 @@ inline void walkThisStack(F functor) {
 	}
 }
 
+// Walks the frame pointer chain starting at bp without trusting its contents.
+// Only frames within [lower, upper) are followed; this makes it safe to use
+// from NMI context where we cannot afford to take a page fault.
+template <typename F>
+inline void walkStackFrom(uintptr_t bp, uintptr_t lower, uintptr_t upper, F functor) {
+	while (bp >= lower && bp + 2 * sizeof(uintptr_t) <= upper
+			&& !(bp & (sizeof(uintptr_t) - 1))) {
+		auto frame = reinterpret_cast<const uintptr_t *>(bp);
+		if (!frame[1])
+			break;
+		if (!functor(frame[1]))
+			break;
+		// Frames must strictly grow towards the top of the stack.
+		if (frame[0] <= bp)
+			break;
+		bp = frame[0];
+	}
+}
+
 } // namespace thor
@@ -316,7 +316,7 @@ struct IntelIommu final : Iommu, IrqSink {
 			frg::to_allocated_string(*kernelAlloc, id()) +
 			frg::string<KernelAlloc>{*kernelAlloc, "-msi"};
 
-		auto interrupt = allocateApicMsi(name);
+		auto interrupt = allocateApicMsi(name, 0);
 		assert(interrupt);
 		IrqPin::attachSink(interrupt, this);
 
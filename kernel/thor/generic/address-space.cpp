@@ -1,3 +1,4 @@
+#include <atomic>
 #include <cstddef>
 #include <type_traits>
 #include <thor-internal/address-space.hpp>
@@ -9,12 +10,15 @@
 
 namespace thor {
 
-extern size_t kernelMemoryUsage;
+extern std::atomic<size_t> kernelMemoryUsage;
 
 namespace {
 	constexpr bool logCleanup = false;
 	constexpr bool logUsage = false;
 
+	// Read faults also map the present pages within the surrounding aligned window.
+	constexpr size_t faultAroundSize = 16 * kPageSize;
+
 	[[maybe_unused]]
 	void logRss(VirtualSpace *space) {
 		if(!logUsage)
@@ -31,7 +35,7 @@ namespace {
 				<< (rss / 1024) << " KiB" << frg::endlog;
 		infoLogger() << "thor:     Physical usage: "
 				<< (physicalAllocator->numUsedPages() * 4) << " KiB, kernel usage: "
-				<< (kernelMemoryUsage / 1024) << " KiB" << frg::endlog;
+				<< (kernelMemoryUsage.load(std::memory_order_relaxed) / 1024) << " KiB" << frg::endlog;
 	}
 }
 
@@ -89,6 +93,29 @@ frg::expected<Error> VirtualOperations::remapPresentPages(VirtualAddr va, Memory
 	return {};
 }
 
+frg::expected<Error, size_t> VirtualOperations::mapMissingPages(VirtualAddr va,
+		MemoryView *view, uintptr_t offset, size_t size, PageFlags flags) {
+	assert(!(va & (kPageSize - 1)));
+	assert(!(offset & (kPageSize - 1)));
+	assert(!(size & (kPageSize - 1)));
+
+	size_t count = 0;
+	for(size_t progress = 0; progress < size; progress += kPageSize) {
+		if(isMapped(va + progress))
+			continue;
+
+		auto physicalRange = view->peekRange(offset + progress);
+		if(physicalRange.get<0>() == PhysicalAddr(-1))
+			continue;
+		assert(!(physicalRange.get<0>() & (kPageSize - 1)));
+
+		mapSingle4k(va + progress, physicalRange.get<0>(),
+				flags, physicalRange.get<1>());
+		count++;
+	}
+	return count;
+}
+
 frg::expected<Error> VirtualOperations::faultPage(VirtualAddr va, MemoryView *view,
 		uintptr_t offset, PageFlags flags) {
 	auto physicalRange = view->peekRange(offset & ~(kPageSize - 1));
@@ -320,13 +347,16 @@ coroutine<void> Mapping::runEvictionLoop() {
 // CowMapping
 // --------------------------------------------------------
 
-CowChain::CowChain()
-: _pages{*kernelAlloc} {
+CowChain::CowChain(uintptr_t offset, size_t length)
+: _offset{offset}, _length{length}, _pages{*kernelAlloc} {
 }
 
 CowChain::~CowChain() {
 	if(logCleanup)
 		infoLogger() << "thor: Releasing CowChain" << frg::endlog;
+
+	for(auto it = _pages.begin(); it != _pages.end(); ++it)
+		releasePage(*it);
 }
 
 // --------------------------------------------------------
@@ -393,9 +423,11 @@ void VirtualSpace::retire() {
 
 coroutine<frg::expected<Error, VirtualAddr>>
 VirtualSpace::map(smarter::borrowed_ptr<MemorySlice> slice,
-		VirtualAddr address, size_t offset, size_t length, uint32_t flags) {
+		VirtualAddr address, size_t offset, size_t length, uint32_t flags,
+		smarter::shared_ptr<WorkQueue> wq) {
 	assert(length);
 	assert(!(length % kPageSize));
+	assert(!(flags & kMapPopulate) || wq);
 
 	if(offset + length > slice->length())
 		co_return Error::bufferTooSmall;
@@ -473,8 +505,6 @@ VirtualSpace::map(smarter::borrowed_ptr<MemorySlice> slice,
 				slice.lock(), slice->offset() + offset);
 		mapping->selfPtr = mapping;
 
-		assert(!(flags & kMapPopulate));
-
 		// Install the new mapping object.
 		mapping->tie(selfPtr.lock(), actualAddress);
 		_mappings.insert(mapping.get());
@@ -508,9 +538,69 @@ VirtualSpace::map(smarter::borrowed_ptr<MemorySlice> slice,
 	if(mapping->view->canEvictMemory())
 		async::detach_with_allocator(*kernelAlloc, mapping->runEvictionLoop());
 
+	if(flags & kMapPopulate) {
+		// populate() only needs a shared lock. As with MAP_POPULATE on Linux,
+		// errors are ignored; the affected pages are faulted in on access.
+		consistencyLock.unlock();
+		co_await populate(actualAddress, length, std::move(wq));
+	}
+
 	co_return actualAddress;
 }
 
+coroutine<frg::expected<Error>>
+VirtualSpace::populate(VirtualAddr address, size_t length, smarter::shared_ptr<WorkQueue> wq) {
+	assert(!(address & (kPageSize - 1)));
+	assert(!(length & (kPageSize - 1)));
+
+	co_await _consistencyMutex.async_lock_shared();
+	frg::shared_lock consistencyLock{frg::adopt_lock, _consistencyMutex};
+
+	size_t overallProgress = 0;
+	while(overallProgress < length) {
+		smarter::shared_ptr<Mapping> mapping;
+		{
+			auto irqLock = frg::guard(&irqMutex());
+			auto spaceGuard = frg::guard(&_snapshotMutex);
+
+			mapping = _findMapping(address + overallProgress);
+		}
+		if(!mapping)
+			co_return Error::fault;
+		assert(mapping->state == MappingState::active);
+
+		auto mappingOffset = address + overallProgress - mapping->address;
+		auto mappingChunk = frg::min(length - overallProgress,
+				mapping->length - mappingOffset);
+
+		// Lock the range such that no page is evicted before it is mapped.
+		MemoryViewLockHandle lockHandle{mapping->view,
+				mapping->viewOffset + mappingOffset, mappingChunk};
+		co_await lockHandle.acquire(wq);
+		if(!lockHandle)
+			co_return Error::fault;
+
+		FetchFlags fetchFlags = 0;
+		if(mapping->flags & MappingFlags::dontRequireBacking)
+			fetchFlags |= fetchDisallowBacking;
+
+		FRG_CO_TRY(co_await mapping->view->touchRange(mapping->viewOffset + mappingOffset,
+				mappingChunk, fetchFlags, wq));
+
+		co_await mapping->evictionMutex.async_lock();
+		frg::unique_lock evictionLock{frg::adopt_lock, mapping->evictionMutex};
+
+		auto count = FRG_CO_TRY(_ops->mapMissingPages(mapping->address + mappingOffset,
+				mapping->view.get(), mapping->viewOffset + mappingOffset, mappingChunk,
+				mapping->compilePageFlags()));
+		_prefaultedPages.fetch_add(count, std::memory_order_relaxed);
+
+		overallProgress += mappingChunk;
+	}
+
+	co_return {};
+}
+
 coroutine<frg::expected<Error>>
 VirtualSpace::protect(VirtualAddr address, size_t length, uint32_t flags) {
 	std::underlying_type_t<MappingFlags> mappingFlags = 0;
@@ -648,6 +738,16 @@ VirtualSpace::handleFault(VirtualAddr address, uint32_t faultFlags,
 	// TODO: Aligning should not be necessary here.
 	auto offset = (address - mapping->address) & ~(kPageSize - 1);
 
+	// This is only a snapshot, but good enough for statistics.
+	// The first access to a page of copy-on-write memory is a minor fault if the page
+	// that we copy from is present.
+	if(mapping->view->peekSharedRange(mapping->viewOffset + offset).get<0>()
+			!= PhysicalAddr(-1)) {
+		_minorFaults.fetch_add(1, std::memory_order_relaxed);
+	}else{
+		_majorFaults.fetch_add(1, std::memory_order_relaxed);
+	}
+
 	while(true) {
 		FetchFlags fetchFlags = 0;
 		if(mapping->flags & MappingFlags::dontRequireBacking)
@@ -675,6 +775,23 @@ VirtualSpace::handleFault(VirtualAddr address, uint32_t faultFlags,
 			}
 		}
 
+		// Sequential reads (e.g., of code and data in shared libraries) usually touch the
+		// neighbouring pages next; if they are present already, map them now.
+		// In private mappings, this includes pages that were not copied yet; these are
+		// mapped read-only, such that a write still copies them.
+		// For write faults, the neighbours are usually not present yet (e.g., on the heap),
+		// so we do not spend the peekSharedRange() calls.
+		if(!(faultFlags & VirtualSpace::kFaultWrite)) {
+			auto windowStart = frg::max(address & ~(faultAroundSize - 1), mapping->address);
+			auto windowEnd = frg::min((address & ~(faultAroundSize - 1)) + faultAroundSize,
+					mapping->address + mapping->length);
+			auto aroundOutcome = _ops->mapMissingPages(windowStart, mapping->view.get(),
+					mapping->viewOffset + (windowStart - mapping->address),
+					windowEnd - windowStart, mapping->compilePageFlags());
+			if(aroundOutcome)
+				_prefaultedPages.fetch_add(aroundOutcome.value(), std::memory_order_relaxed);
+		}
+
 		co_return {};
 	}
 }
@@ -703,6 +820,9 @@ VirtualSpace::retrievePhysical(VirtualAddr address, smarter::shared_ptr<WorkQueu
 
 		FRG_CO_TRY(co_await mapping->view->fetchRange(
 				mapping->viewOffset + offset, fetchFlags, wq));
+		// The caller (e.g., a driver that programs DMA) relies on the physical address
+		// without observing evictions.
+		mapping->view->pinRange(mapping->viewOffset + offset, kPageSize);
 
 		auto physicalRange = mapping->view->peekRange(mapping->viewOffset + offset);
 		if(physicalRange.get<0>() == PhysicalAddr(-1)) {
@@ -0,0 +1,447 @@
+#include <string.h>
+
+#include <thor-internal/cpu-data.hpp>
+#include <thor-internal/debug.hpp>
+#include <thor-internal/kernel_heap.hpp>
+#include <thor-internal/physical.hpp>
+
+namespace thor {
+
+// Evicted anonymous pages are compressed in the LZ4 block format: each sequence is a token
+// (4 bits of literal length, 4 bits of match length), the literals and a 16-bit offset
+// into the preceding output. The compressor is a greedy single-probe matcher that keeps
+// a hash table of recent positions; since it only ever sees one page, positions fit into
+// 16 bits and the table can be reset cheaply for each page.
+
+namespace {
+
+// Size of the hash table (in entries).
+constexpr int hashLog = 12;
+constexpr size_t hashTableSize = size_t{1} << hashLog;
+
+constexpr size_t minMatch = 4;
+// As required by the LZ4 block format, the last 5 bytes are always literals
+// and the last match starts at least 12 bytes before the end of the input.
+constexpr size_t lastLiterals = 5;
+constexpr size_t matchFindLimit = 12;
+
+// Compressed pages are stored in a dedicated pool of physical pages (accessed through the
+// direct map), such that they neither consume kernel virtual memory nor heap memory.
+// Each page of the pool is divided into equally sized slots; all slots of a page belong to
+// the same size class, which is identified by the number of slots per page. The header of
+// a pool page is stored at its end; it links the partially used pages of each size class.
+
+struct PoolPageHeader {
+	PhysicalAddr prev;
+	PhysicalAddr next;
+	// Bit i is set if slot i is in use.
+	uint32_t usedSlots;
+	uint32_t numSlots;
+};
+
+constexpr size_t poolPageCapacity = kPageSize - sizeof(PoolPageHeader);
+constexpr unsigned int minSlotsPerPage = 2;
+constexpr unsigned int maxSlotsPerPage = 32;
+
+constexpr size_t slotSize(unsigned int numSlots) {
+	return (poolPageCapacity / numSlots) & ~size_t{15};
+}
+
+// Pages that need more than half of a pool page do not save enough memory
+// to be worth storing in compressed form.
+constexpr size_t maxCompressedSize = slotSize(minSlotsPerPage);
+
+// The pool never grows beyond this fraction of physical memory (in pages).
+// Once it is reached, pages are no longer compressed.
+constexpr size_t poolLimitDivisor = 5;
+
+struct CompressedPageCounters {
+	std::atomic<uint64_t> storedPages{0};
+	std::atomic<uint64_t> storedBytes{0};
+	std::atomic<uint64_t> poolPages{0};
+	std::atomic<uint64_t> zeroPages{0};
+	std::atomic<uint64_t> rejectedPages{0};
+	std::atomic<uint64_t> decompressions{0};
+};
+
+CompressedPageCounters &compressedCounters() {
+	static frg::eternal<CompressedPageCounters> singleton;
+	return singleton.get();
+}
+
+struct CompressedPagePool {
+	frg::ticket_spinlock mutex;
+	// Heads of the lists of partially used pages, indexed by the number of slots per page.
+	PhysicalAddr partialPages[maxSlotsPerPage + 1];
+
+	CompressedPagePool() {
+		for(auto &head : partialPages)
+			head = PhysicalAddr(-1);
+	}
+};
+
+CompressedPagePool &compressedPool() {
+	static frg::eternal<CompressedPagePool> singleton;
+	return singleton.get();
+}
+
+// The direct map is never torn down, hence the pointer outlives the PageAccessor.
+PoolPageHeader *poolHeader(PhysicalAddr page) {
+	PageAccessor accessor{page};
+	return reinterpret_cast<PoolPageHeader *>(
+			static_cast<uint8_t *>(accessor.get()) + poolPageCapacity);
+}
+
+// Called with the pool's mutex held.
+void linkPartialPage(CompressedPagePool *pool, PhysicalAddr page) {
+	auto header = poolHeader(page);
+	auto &head = pool->partialPages[header->numSlots];
+	header->prev = PhysicalAddr(-1);
+	header->next = head;
+	if(head != PhysicalAddr(-1))
+		poolHeader(head)->prev = page;
+	head = page;
+}
+
+// Called with the pool's mutex held.
+void unlinkPartialPage(CompressedPagePool *pool, PhysicalAddr page) {
+	auto header = poolHeader(page);
+	if(header->prev != PhysicalAddr(-1)) {
+		poolHeader(header->prev)->next = header->next;
+	}else{
+		pool->partialPages[header->numSlots] = header->next;
+	}
+	if(header->next != PhysicalAddr(-1))
+		poolHeader(header->next)->prev = header->prev;
+}
+
+// Allocates a slot that can hold size bytes. Returns false if the pool is full.
+bool allocateSlot(size_t size, PhysicalAddr &page, unsigned int &slot) {
+	auto *counters = &compressedCounters();
+	auto *pool = &compressedPool();
+	assert(size && size <= maxCompressedSize);
+
+	// Use the size class with the most slots per page that still fits.
+	auto numSlots = static_cast<unsigned int>(poolPageCapacity / ((size + 15) & ~size_t{15}));
+	numSlots = frg::min(numSlots, maxSlotsPerPage);
+	assert(numSlots >= minSlotsPerPage);
+	assert(slotSize(numSlots) >= size);
+
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&pool->mutex);
+
+	page = pool->partialPages[numSlots];
+	if(page == PhysicalAddr(-1)) {
+		auto limit = physicalAllocator->numTotalPages() / poolLimitDivisor;
+		if(counters->poolPages.load(std::memory_order_relaxed) >= limit)
+			return false;
+		page = physicalAllocator->allocate(kPageSize);
+		if(page == PhysicalAddr(-1))
+			return false;
+		counters->poolPages.fetch_add(1, std::memory_order_relaxed);
+
+		auto header = poolHeader(page);
+		header->usedSlots = 0;
+		header->numSlots = numSlots;
+		linkPartialPage(pool, page);
+	}
+
+	auto header = poolHeader(page);
+	assert(header->numSlots == numSlots);
+	slot = __builtin_ctz(~header->usedSlots);
+	assert(slot < numSlots);
+	header->usedSlots |= uint32_t{1} << slot;
+	if(header->usedSlots == (uint32_t{1} << numSlots) - 1)
+		unlinkPartialPage(pool, page);
+	return true;
+}
+
+void freeSlot(PhysicalAddr page, unsigned int slot) {
+	auto *counters = &compressedCounters();
+	auto *pool = &compressedPool();
+
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&pool->mutex);
+
+	auto header = poolHeader(page);
+	auto wasFull = header->usedSlots == (uint32_t{1} << header->numSlots) - 1;
+	assert(header->usedSlots & (uint32_t{1} << slot));
+	header->usedSlots &= ~(uint32_t{1} << slot);
+
+	if(!header->usedSlots) {
+		if(!wasFull)
+			unlinkPartialPage(pool, page);
+		physicalAllocator->free(page, kPageSize);
+		counters->poolPages.fetch_sub(1, std::memory_order_relaxed);
+	}else if(wasFull) {
+		linkPartialPage(pool, page);
+	}
+}
+
+uint32_t read32(const uint8_t *p) {
+	uint32_t v;
+	memcpy(&v, p, sizeof(uint32_t));
+	return v;
+}
+
+uint32_t hashSequence(uint32_t v) {
+	return (v * 2654435761U) >> (32 - hashLog);
+}
+
+bool isZeroPage(const void *pointer) {
+	auto words = reinterpret_cast<const uint64_t *>(pointer);
+	for(size_t i = 0; i < kPageSize / sizeof(uint64_t); i++) {
+		if(words[i])
+			return false;
+	}
+	return true;
+}
+
+// Writes a sequence of numLiterals literals followed by a match; matchLength == 0
+// denotes the last sequence, which has no match. Returns false if dst is too small.
+bool emitSequence(uint8_t *&out, uint8_t *outEnd, const uint8_t *literals, size_t numLiterals,
+		size_t offset, size_t matchLength) {
+	size_t worstCase = 1 + numLiterals / 255 + 1 + numLiterals + 2 + matchLength / 255 + 1;
+	if(static_cast<size_t>(outEnd - out) < worstCase)
+		return false;
+
+	auto token = out++;
+	if(numLiterals >= 15) {
+		*token = 15 << 4;
+		size_t rest = numLiterals - 15;
+		for(; rest >= 255; rest -= 255)
+			*out++ = 255;
+		*out++ = rest;
+	}else{
+		*token = numLiterals << 4;
+	}
+	memcpy(out, literals, numLiterals);
+	out += numLiterals;
+
+	if(!matchLength)
+		return true;
+
+	*out++ = offset & 0xFF;
+	*out++ = offset >> 8;
+	size_t rest = matchLength - minMatch;
+	if(rest >= 15) {
+		*token |= 15;
+		for(rest -= 15; rest >= 255; rest -= 255)
+			*out++ = 255;
+		*out++ = rest;
+	}else{
+		*token |= rest;
+	}
+	return true;
+}
+
+// Returns the size of the compressed data or zero if it does not fit into capacity bytes.
+size_t compressBlock(const uint8_t *src, size_t size, uint8_t *dst, size_t capacity,
+		uint16_t *hashTable) {
+	assert(size <= 0x10000);
+	memset(hashTable, 0, hashTableSize * sizeof(uint16_t));
+
+	auto out = dst;
+	auto outEnd = dst + capacity;
+	auto anchor = src;
+	auto ip = src;
+	auto matchLimit = src + size - lastLiterals;
+	auto searchLimit = src + size - matchFindLimit;
+
+	while(ip < searchLimit) {
+		auto h = hashSequence(read32(ip));
+		auto ref = src + hashTable[h];
+		hashTable[h] = ip - src;
+		if(ref >= ip || read32(ref) != read32(ip)) {
+			ip++;
+			continue;
+		}
+
+		auto matchEnd = ip + minMatch;
+		auto refEnd = ref + minMatch;
+		while(matchEnd < matchLimit && *matchEnd == *refEnd) {
+			matchEnd++;
+			refEnd++;
+		}
+
+		if(!emitSequence(out, outEnd, anchor, ip - anchor, ip - ref, matchEnd - ip))
+			return 0;
+		ip = matchEnd;
+		anchor = ip;
+	}
+
+	if(!emitSequence(out, outEnd, anchor, src + size - anchor, 0, 0))
+		return 0;
+	return out - dst;
+}
+
+// Returns false if src is not a valid block that decompresses to exactly size bytes.
+bool decompressBlock(const uint8_t *src, size_t srcSize, uint8_t *dst, size_t size) {
+	auto ip = src;
+	auto ipEnd = src + srcSize;
+	auto op = dst;
+	auto opEnd = dst + size;
+
+	auto readLength = [&] (size_t &length) -> bool {
+		uint8_t b;
+		do {
+			if(ip == ipEnd)
+				return false;
+			b = *ip++;
+			length += b;
+		} while(b == 255);
+		return true;
+	};
+
+	while(true) {
+		if(ip == ipEnd)
+			return false;
+		auto token = *ip++;
+
+		size_t numLiterals = token >> 4;
+		if(numLiterals == 15 && !readLength(numLiterals))
+			return false;
+		if(numLiterals > static_cast<size_t>(ipEnd - ip)
+				|| numLiterals > static_cast<size_t>(opEnd - op))
+			return false;
+		memcpy(op, ip, numLiterals);
+		ip += numLiterals;
+		op += numLiterals;
+
+		// The last sequence consists of literals only.
+		if(ip == ipEnd)
+			return op == opEnd;
+
+		if(ipEnd - ip < 2)
+			return false;
+		size_t offset = ip[0] | (size_t{ip[1]} << 8);
+		ip += 2;
+		if(!offset || offset > static_cast<size_t>(op - dst))
+			return false;
+
+		size_t matchLength = token & 15;
+		if(matchLength == 15 && !readLength(matchLength))
+			return false;
+		matchLength += minMatch;
+		if(matchLength > static_cast<size_t>(opEnd - op))
+			return false;
+
+		// Matches can overlap their own output, hence we copy byte by byte.
+		auto ref = op - offset;
+		for(size_t i = 0; i < matchLength; i++)
+			op[i] = ref[i];
+		op += matchLength;
+	}
+}
+
+} // anonymous namespace
+
+// Per-CPU state of the compressor.
+struct PageCompressionContext {
+	PageCompressionContext()
+	: hashTable{static_cast<uint16_t *>(kernelAlloc->allocate(hashTableSize * sizeof(uint16_t)))},
+		buffer{static_cast<uint8_t *>(kernelAlloc->allocate(maxCompressedSize))} { }
+
+	// Both buffers are only accessed with IRQs disabled.
+	uint16_t *hashTable;
+	uint8_t *buffer;
+};
+
+extern PerCpu<PageCompressionContext> pageCompressionContexts;
+THOR_DEFINE_PERCPU(pageCompressionContexts);
+
+bool compressPage(PhysicalAddr physical, CompressedPage &compressed) {
+	auto *counters = &compressedCounters();
+	assert(compressed.poolPage == PhysicalAddr(-1));
+
+	PageAccessor accessor{physical};
+	if(isZeroPage(accessor.get())) {
+		compressed.size = 0;
+		counters->zeroPages.fetch_add(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Do not spend the work of compressing if we cannot store the result anyway.
+	// Note that this is racy; allocateSlot() checks the limit again.
+	auto limit = physicalAllocator->numTotalPages() / poolLimitDivisor;
+	if(counters->poolPages.load(std::memory_order_relaxed) >= limit) {
+		counters->rejectedPages.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	PhysicalAddr page;
+	unsigned int slot;
+	size_t size;
+	{
+		// Disable IRQs to keep using the same CPU's buffers.
+		auto irqLock = frg::guard(&irqMutex());
+		auto &context = pageCompressionContexts.get();
+
+		size = compressBlock(static_cast<const uint8_t *>(accessor.get()), kPageSize,
+				context.buffer, maxCompressedSize, context.hashTable);
+		if(!size || !allocateSlot(size, page, slot)) {
+			counters->rejectedPages.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+
+		PageAccessor poolAccessor{page};
+		memcpy(static_cast<uint8_t *>(poolAccessor.get()) + slot * slotSize(poolHeader(page)->numSlots),
+				context.buffer, size);
+	}
+
+	compressed.poolPage = page;
+	compressed.slot = slot;
+	compressed.size = size;
+	counters->storedPages.fetch_add(1, std::memory_order_relaxed);
+	counters->storedBytes.fetch_add(size, std::memory_order_relaxed);
+	return true;
+}
+
+void decompressPage(const CompressedPage &compressed, PhysicalAddr physical) {
+	auto *counters = &compressedCounters();
+	counters->decompressions.fetch_add(1, std::memory_order_relaxed);
+
+	PageAccessor accessor{physical};
+	if(compressed.poolPage == PhysicalAddr(-1)) {
+		memset(accessor.get(), 0, kPageSize);
+		return;
+	}
+
+	// The slot cannot be freed concurrently, as it is owned by the caller.
+	PageAccessor poolAccessor{compressed.poolPage};
+	auto data = static_cast<const uint8_t *>(poolAccessor.get())
+			+ compressed.slot * slotSize(poolHeader(compressed.poolPage)->numSlots);
+	if(!decompressBlock(data, compressed.size,
+			static_cast<uint8_t *>(accessor.get()), kPageSize))
+		panicLogger() << "thor: Compressed page is corrupted" << frg::endlog;
+}
+
+void discardCompressedPage(CompressedPage &compressed) {
+	auto *counters = &compressedCounters();
+
+	if(compressed.poolPage != PhysicalAddr(-1)) {
+		freeSlot(compressed.poolPage, compressed.slot);
+		counters->storedPages.fetch_sub(1, std::memory_order_relaxed);
+		counters->storedBytes.fetch_sub(compressed.size, std::memory_order_relaxed);
+	}else{
+		counters->zeroPages.fetch_sub(1, std::memory_order_relaxed);
+	}
+	compressed.poolPage = PhysicalAddr(-1);
+	compressed.slot = 0;
+	compressed.size = 0;
+}
+
+CompressedPageStatistics getCompressedPageStatistics() {
+	auto *counters = &compressedCounters();
+
+	CompressedPageStatistics stats;
+	stats.storedPages = counters->storedPages.load(std::memory_order_relaxed);
+	stats.storedBytes = counters->storedBytes.load(std::memory_order_relaxed);
+	stats.poolBytes = counters->poolPages.load(std::memory_order_relaxed) * kPageSize;
+	stats.zeroPages = counters->zeroPages.load(std::memory_order_relaxed);
+	stats.rejectedPages = counters->rejectedPages.load(std::memory_order_relaxed);
+	stats.decompressions = counters->decompressions.load(std::memory_order_relaxed);
+	return stats;
+}
+
+} // namespace thor
@@ -1,3 +1,5 @@
+#include <atomic>
+
 #include <thor-internal/cpu-data.hpp>
 #include <thor-internal/debug.hpp>
 #include <thor-internal/fiber.hpp>
@@ -16,7 +18,8 @@ void operator delete(void *, size_t) {
 namespace thor {
 
 size_t kernelVirtualUsage = 0;
-size_t kernelMemoryUsage = 0;
+// Updated by the slab allocator without a common lock.
+std::atomic<size_t> kernelMemoryUsage{0};
 
 // --------------------------------------------------------
 // Memory management
@@ -130,8 +133,9 @@ void *KernelVirtualMemory::allocate(size_t size) {
 			infoLogger() << "thor:"
 					" Physical usage: " << (physicalAllocator->numUsedPages() * 4) << " KiB,"
 					" kernel VM: " << (kernelVirtualUsage / 1024) << " KiB"
-					" kernel RSS: " << (kernelMemoryUsage / 1024) << " KiB"
+					" kernel RSS: " << (kernelMemoryUsage.load(std::memory_order_relaxed) / 1024) << " KiB"
 					<< frg::endlog;
+			logKernelHeapStatistics();
 			panicLogger() << "thor: Out of kernel virtual memory" << frg::endlog;
 		}
 
@@ -215,7 +219,7 @@ uintptr_t KernelVirtualAlloc::map(size_t length) {
 		KernelPageSpace::global().mapSingle4k(VirtualAddr(p) + offset, physical,
 				page_access::write, CachingMode::null);
 	}
-	kernelMemoryUsage += length;
+	kernelMemoryUsage.fetch_add(length, std::memory_order_relaxed);
 
 	return uintptr_t(p);
 }
@@ -232,7 +236,7 @@ void KernelVirtualAlloc::unmap(uintptr_t address, size_t length) {
 		PhysicalAddr physical = KernelPageSpace::global().unmapSingle4k(address + offset);
 		physicalAllocator->free(physical, kPageSize);
 	}
-	kernelMemoryUsage -= length;
+	kernelMemoryUsage.fetch_sub(length, std::memory_order_relaxed);
 
 	// TODO: we could replace this closure by an appropriate async::detach_with_allocator call.
 	struct Closure final : ShootNode {
@@ -298,12 +302,7 @@ constinit frg::manual_box<PhysicalChunkAllocator> physicalAllocator = {};
 
 constinit frg::manual_box<KernelVirtualAlloc> kernelVirtualAlloc = {};
 
-constinit frg::manual_box<
-	frg::slab_pool<
-		KernelVirtualAlloc,
-		IrqSpinlock
-	>
-> kernelHeap = {};
+constinit frg::manual_box<KernelHeapPool> kernelHeap = {};
 
 constinit frg::manual_box<KernelAlloc> kernelAlloc = {};
 
@@ -485,6 +485,43 @@ HelError helResizeMemory(HelHandle handle, size_t newSize) {
 	return kHelErrNone;
 }
 
+HelError helDiscardMemory(HelHandle handle, uintptr_t offset, size_t size) {
+	if(offset & (kPageSize - 1))
+		return kHelErrIllegalArgs;
+	if(size & (kPageSize - 1))
+		return kHelErrIllegalArgs;
+
+	auto thisThread = getCurrentThread();
+	auto thisUniverse = thisThread->getUniverse();
+
+	smarter::shared_ptr<MemoryView> memory;
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		Universe::Guard universeGuard(thisUniverse->lock);
+
+		auto wrapper = thisUniverse->getDescriptor(universeGuard, handle);
+		if(!wrapper)
+			return kHelErrNoDescriptor;
+		if(!wrapper->is<MemoryViewDescriptor>())
+			return kHelErrBadDescriptor;
+		memory = wrapper->get<MemoryViewDescriptor>().memory;
+	}
+
+	if(offset + size < offset || offset + size > memory->getLength())
+		return kHelErrOutOfBounds;
+
+	auto outcome = Thread::asyncBlockCurrent([] (smarter::shared_ptr<MemoryView> memory,
+			uintptr_t offset, size_t size) -> coroutine<frg::expected<Error>> {
+		co_return co_await memory->discardRange(offset, size);
+	}(std::move(memory), offset, size));
+	if(!outcome) {
+		assert(outcome.error() == Error::illegalObject);
+		return kHelErrUnsupportedOperation;
+	}
+
+	return kHelErrNone;
+}
+
 HelError helCreateManagedMemory(size_t size, uint32_t flags,
 		HelHandle *backing_handle, HelHandle *frontal_handle) {
 	if(flags & ~uint32_t{kHelManagedReadahead})
@@ -545,6 +582,7 @@ HelError helCopyOnWrite(HelHandle memoryHandle,
 	auto slice = smarter::allocate_shared<CopyOnWriteMemory>(*kernelAlloc, std::move(view),
 			offset, size);
 	slice->selfPtr = slice;
+	slice->observeView();
 	{
 		auto irq_lock = frg::guard(&irqMutex());
 		Universe::Guard universe_guard(this_universe->lock);
@@ -819,6 +857,43 @@ HelError helGetRandomBytes(void *buffer, size_t wantedSize, size_t *actualSize)
 	return kHelErrNone;
 }
 
+namespace {
+	uint32_t translateMapFlags(uint32_t flags) {
+		uint32_t mapFlags = 0;
+		if(flags & kHelMapFixed) {
+			mapFlags |= AddressSpace::kMapFixed;
+		}else if(flags & kHelMapFixedNoReplace) {
+			mapFlags |= AddressSpace::kMapFixedNoReplace;
+		}else{
+			mapFlags |= AddressSpace::kMapPreferTop;
+		}
+
+		if(flags & kHelMapProtRead)
+			mapFlags |= AddressSpace::kMapProtRead;
+		if(flags & kHelMapProtWrite)
+			mapFlags |= AddressSpace::kMapProtWrite;
+		if(flags & kHelMapProtExecute)
+			mapFlags |= AddressSpace::kMapProtExecute;
+
+		if(flags & kHelMapDontRequireBacking)
+			mapFlags |= AddressSpace::kMapDontRequireBacking;
+		if(flags & kHelMapPopulate)
+			mapFlags |= AddressSpace::kMapPopulate;
+		return mapFlags;
+	}
+
+	HelError translateMapError(Error error) {
+		assert(error == Error::bufferTooSmall || error == Error::alreadyExists
+				|| error == Error::noMemory);
+
+		if(error == Error::bufferTooSmall)
+			return kHelErrBufferTooSmall;
+		else if(error == Error::noMemory)
+			return kHelErrNoMemory;
+		return kHelErrAlreadyExists;
+	}
+}
+
 HelError helMapMemory(HelHandle memory_handle, HelHandle space_handle,
 		void *pointer, uintptr_t offset, size_t length, uint32_t flags, void **actualPointer) {
 	if(length == 0)
@@ -833,24 +908,7 @@ HelError helMapMemory(HelHandle memory_handle, HelHandle space_handle,
 	auto this_thread = getCurrentThread();
 	auto this_universe = this_thread->getUniverse();
 
-	uint32_t map_flags = 0;
-	if(flags & kHelMapFixed) {
-		map_flags |= AddressSpace::kMapFixed;
-	}else if(flags & kHelMapFixedNoReplace) {
-		map_flags |= AddressSpace::kMapFixedNoReplace;
-	}else{
-		map_flags |= AddressSpace::kMapPreferTop;
-	}
-
-	if(flags & kHelMapProtRead)
-		map_flags |= AddressSpace::kMapProtRead;
-	if(flags & kHelMapProtWrite)
-		map_flags |= AddressSpace::kMapProtWrite;
-	if(flags & kHelMapProtExecute)
-		map_flags |= AddressSpace::kMapProtExecute;
-
-	if(flags & kHelMapDontRequireBacking)
-		map_flags |= AddressSpace::kMapDontRequireBacking;
+	uint32_t map_flags = translateMapFlags(flags);
 
 	smarter::shared_ptr<MemorySlice> slice;
 	smarter::shared_ptr<AddressSpace, BindableHandle> space;
@@ -904,24 +962,182 @@ HelError helMapMemory(HelHandle memory_handle, HelHandle space_handle,
 			return kHelErrIllegalArgs; // Non-vspaces aren't allowed to map at NULL
 
 		mapResult = Thread::asyncBlockCurrent(space->map(slice,
-				(VirtualAddr)pointer, offset, length, map_flags));
+				(VirtualAddr)pointer, offset, length, map_flags,
+				this_thread->mainWorkQueue()->take()));
 	} else {
 		mapResult = Thread::asyncBlockCurrent(vspace->map(slice,
-				(VirtualAddr)pointer, offset, length, map_flags));
+				(VirtualAddr)pointer, offset, length, map_flags,
+				this_thread->mainWorkQueue()->take()));
 	}
 
-	if(!mapResult) {
-		assert(mapResult.error() == Error::bufferTooSmall || mapResult.error() == Error::alreadyExists || mapResult.error() == Error::noMemory);
+	if(!mapResult)
+		return translateMapError(mapResult.error());
 
-		if(mapResult.error() == Error::bufferTooSmall)
-			return kHelErrBufferTooSmall;
-		else if(mapResult.error() == Error::noMemory)
-			return kHelErrNoMemory;
-		else if(mapResult.error() == Error::alreadyExists)
-			return kHelErrAlreadyExists;
+	*actualPointer = (void *)mapResult.value();
+	return kHelErrNone;
+}
+
+HelError helForkMappings(HelHandle spaceHandle, HelForkMapping *userMappings, size_t count) {
+	if(count > kHelMaxForkMappings)
+		return kHelErrIllegalArgs;
+
+	auto thisThread = getCurrentThread();
+	auto thisUniverse = thisThread->getUniverse();
+
+	frg::vector<HelForkMapping, KernelAlloc> mappings{*kernelAlloc};
+	mappings.resize(count);
+	if(!readUserArray(userMappings, mappings.data(), count))
+		return kHelErrFault;
+
+	for(auto &mapping : mappings) {
+		if(!mapping.size)
+			return kHelErrIllegalArgs;
+		if(reinterpret_cast<uintptr_t>(mapping.pointer) % kPageSize
+				|| mapping.offset % kPageSize
+				|| mapping.size % kPageSize)
+			return kHelErrIllegalArgs;
+		if(!mapping.pointer && (mapping.flags & kHelMapFixed))
+			return kHelErrIllegalArgs;
 	}
 
-	*actualPointer = (void *)mapResult.value();
+	struct ForkedView {
+		smarter::shared_ptr<MemoryView> view;
+		smarter::shared_ptr<MemoryView> forked;
+		Error error = Error::success;
+	};
+
+	// For each mapping, either the slice that is mapped or the index into forkedViews.
+	frg::vector<smarter::shared_ptr<MemorySlice>, KernelAlloc> slices{*kernelAlloc};
+	frg::vector<size_t, KernelAlloc> forkIndices{*kernelAlloc};
+	frg::vector<ForkedView, KernelAlloc> forkedViews{*kernelAlloc};
+	smarter::shared_ptr<AddressSpace, BindableHandle> space;
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		Universe::Guard universeGuard(thisUniverse->lock);
+
+		if(spaceHandle == kHelNullHandle) {
+			space = thisThread->getAddressSpace().lock();
+		}else{
+			auto spaceWrapper = thisUniverse->getDescriptor(universeGuard, spaceHandle);
+			if(!spaceWrapper)
+				return kHelErrNoDescriptor;
+			if(!spaceWrapper->is<AddressSpaceDescriptor>())
+				return kHelErrBadDescriptor;
+			space = spaceWrapper->get<AddressSpaceDescriptor>().space;
+		}
+
+		for(auto &mapping : mappings) {
+			auto memoryWrapper = thisUniverse->getDescriptor(universeGuard, mapping.memory);
+			if(!memoryWrapper)
+				return kHelErrNoDescriptor;
+
+			smarter::shared_ptr<MemorySlice> slice;
+			size_t forkIndex = static_cast<size_t>(-1);
+			if(memoryWrapper->is<MemoryViewDescriptor>()) {
+				auto memory = memoryWrapper->get<MemoryViewDescriptor>().memory;
+				if(mapping.copyOnWrite) {
+					// Mappings of the same memory object share a single fork.
+					for(size_t j = 0; j < forkedViews.size(); j++) {
+						if(forkedViews[j].view.get() == memory.get()) {
+							forkIndex = j;
+							break;
+						}
+					}
+					if(forkIndex == static_cast<size_t>(-1)) {
+						forkIndex = forkedViews.size();
+						forkedViews.push(ForkedView{std::move(memory), nullptr});
+					}
+				}else{
+					auto sliceLength = memory->getLength();
+					slice = smarter::allocate_shared<MemorySlice>(*kernelAlloc,
+							std::move(memory), 0, sliceLength);
+				}
+			}else if(memoryWrapper->is<MemorySliceDescriptor>() && !mapping.copyOnWrite) {
+				slice = memoryWrapper->get<MemorySliceDescriptor>().slice;
+			}else{
+				return kHelErrBadDescriptor;
+			}
+
+			slices.push(std::move(slice));
+			forkIndices.push(forkIndex);
+		}
+	}
+
+	// Fork all memory objects concurrently. Each fork needs to evict the original
+	// memory object from all of its mappings; doing the forks concurrently allows
+	// the resulting TLB shootdowns to overlap instead of waiting for them one by one.
+	if(forkedViews.size())
+		Thread::asyncBlockCurrent([] (frg::vector<ForkedView, KernelAlloc> *forkedViews)
+				-> coroutine<void> {
+			std::atomic<size_t> pending{forkedViews->size()};
+			async::oneshot_event doneEvent;
+			for(auto &forkedView : *forkedViews) {
+				async::detach_with_allocator(*kernelAlloc, [] (ForkedView *forkedView,
+						std::atomic<size_t> *pending, async::oneshot_event *doneEvent)
+						-> coroutine<void> {
+					auto [error, forked] = co_await forkedView->view->fork();
+					forkedView->error = error;
+					forkedView->forked = std::move(forked);
+					if(pending->fetch_sub(1, std::memory_order_acq_rel) == 1)
+						doneEvent->raise();
+				}(&forkedView, &pending, &doneEvent));
+			}
+			co_await doneEvent.wait();
+		}(&forkedViews));
+
+	for(auto &forkedView : forkedViews) {
+		if(forkedView.error == Error::illegalObject)
+			return kHelErrUnsupportedOperation;
+		assert(forkedView.error == Error::success);
+	}
+
+	// Map all memory objects. The forks are always mapped in their entirety.
+	Thread::asyncBlockCurrent([] (frg::vector<HelForkMapping, KernelAlloc> *mappings,
+			frg::vector<smarter::shared_ptr<MemorySlice>, KernelAlloc> *slices,
+			frg::vector<size_t, KernelAlloc> *forkIndices,
+			frg::vector<ForkedView, KernelAlloc> *forkedViews,
+			smarter::shared_ptr<AddressSpace, BindableHandle> space,
+			smarter::shared_ptr<WorkQueue> wq) -> coroutine<void> {
+		for(size_t i = 0; i < mappings->size(); i++) {
+			auto &mapping = (*mappings)[i];
+			auto slice = std::move((*slices)[i]);
+			if((*forkIndices)[i] != static_cast<size_t>(-1)) {
+				auto memory = (*forkedViews)[(*forkIndices)[i]].forked;
+				auto sliceLength = memory->getLength();
+				slice = smarter::allocate_shared<MemorySlice>(*kernelAlloc,
+						std::move(memory), 0, sliceLength);
+			}
+
+			auto mapResult = co_await space->map(std::move(slice),
+					reinterpret_cast<VirtualAddr>(mapping.pointer), mapping.offset,
+					mapping.size, translateMapFlags(mapping.flags), wq);
+			if(mapResult) {
+				mapping.pointer = reinterpret_cast<void *>(mapResult.value());
+				mapping.error = kHelErrNone;
+			}else{
+				mapping.error = translateMapError(mapResult.error());
+			}
+		}
+	}(&mappings, &slices, &forkIndices, &forkedViews, std::move(space),
+			thisThread->mainWorkQueue()->take()));
+
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		Universe::Guard universeGuard(thisUniverse->lock);
+
+		for(size_t i = 0; i < mappings.size(); i++) {
+			if(forkIndices[i] == static_cast<size_t>(-1)) {
+				mappings[i].forkedMemory = kHelNullHandle;
+				continue;
+			}
+			mappings[i].forkedMemory = thisUniverse->attachDescriptor(universeGuard,
+					MemoryViewDescriptor(forkedViews[forkIndices[i]].forked));
+		}
+	}
+
+	if(!writeUserArray(userMappings, mappings.data(), count))
+		return kHelErrFault;
+
 	return kHelErrNone;
 }
 
@@ -1015,6 +1231,41 @@ HelError helUnmapMemory(HelHandle space_handle, void *pointer, size_t length) {
 	return kHelErrNone;
 }
 
+HelError helQuerySpaceStats(HelHandle spaceHandle, HelSpaceStats *userStats) {
+	auto thisThread = getCurrentThread();
+	auto thisUniverse = thisThread->getUniverse();
+
+	smarter::shared_ptr<AddressSpace, BindableHandle> space;
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		Universe::Guard universeGuard(thisUniverse->lock);
+
+		if(spaceHandle == kHelNullHandle) {
+			space = thisThread->getAddressSpace().lock();
+		}else{
+			auto spaceWrapper = thisUniverse->getDescriptor(universeGuard, spaceHandle);
+			if(!spaceWrapper)
+				return kHelErrNoDescriptor;
+			if(!spaceWrapper->is<AddressSpaceDescriptor>())
+				return kHelErrBadDescriptor;
+			space = spaceWrapper->get<AddressSpaceDescriptor>().space;
+		}
+	}
+
+	auto faultStats = space->faultStatistics();
+
+	HelSpaceStats stats;
+	memset(&stats, 0, sizeof(HelSpaceStats));
+	stats.minorFaults = faultStats.minorFaults;
+	stats.majorFaults = faultStats.majorFaults;
+	stats.prefaultedPages = faultStats.prefaultedPages;
+
+	if(!writeUserObject(userStats, stats))
+		return kHelErrFault;
+
+	return kHelErrNone;
+}
+
 HelError helSubmitSynchronizeSpace(HelHandle spaceHandle, void *pointer, size_t length,
 		HelHandle queueHandle, uintptr_t context) {
 	auto thisThread = getCurrentThread();
@@ -3389,6 +3640,8 @@ HelError helBindKernlet(HelHandle handle, const HelKernletData *data, size_t num
 			auto window = reinterpret_cast<char *>(KernelVirtualMemory::global().allocate(0x10000));
 			assert(memory->getLength() <= 0x10000);
 
+			// The window is never unmapped, so the memory must not be evicted.
+			memory->pinRange(0, memory->getLength());
 			for(size_t off = 0; off < memory->getLength(); off += kPageSize) {
 				auto range = memory->peekRange(off);
 				assert(range.get<0>() != PhysicalAddr(-1));
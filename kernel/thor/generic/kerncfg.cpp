@@ -85,6 +85,16 @@ private:
 			resp.set_available_memory(physicalAllocator->numFreePages());
 			resp.set_memory_unit(kPageSize);
 
+			auto zeroedStats = getZeroedPageStatistics();
+			resp.set_zeroed_page_hits(zeroedStats.hits);
+			resp.set_zeroed_page_misses(zeroedStats.misses);
+
+			auto compressedStats = getCompressedPageStatistics();
+			resp.set_compressed_pages(compressedStats.storedPages);
+			resp.set_compressed_bytes(compressedStats.storedBytes);
+			resp.set_compressed_zero_pages(compressedStats.zeroPages);
+			resp.set_compressed_pool_bytes(compressedStats.poolBytes);
+
 			frg::unique_memory<KernelAlloc> respBuffer{*kernelAlloc, resp.size_of_head()};
 			bragi::write_head_only(resp, respBuffer);
 			auto respError = co_await SendBufferSender{lane, std::move(respBuffer)};
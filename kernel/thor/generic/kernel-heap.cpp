@@ -0,0 +1,408 @@
+#include <atomic>
+
+#include <thor-internal/cpu-data.hpp>
+#include <thor-internal/debug.hpp>
+#include <thor-internal/kernel_heap.hpp>
+#include <thor-internal/physical.hpp>
+
+namespace thor {
+
+extern std::atomic<size_t> kernelMemoryUsage;
+
+// Objects of up to 512 bytes are managed by a magazine allocator, as in Bonwick and Adams,
+// "Magazines and Vmem" (USENIX 2001). Each CPU owns two magazines (i.e., stacks of free
+// objects) per size class and serves allocations and frees from them with IRQs disabled
+// but without taking a lock. Only when both magazines are empty (or both are full),
+// the CPU exchanges a magazine with the depot of the size class.
+// Objects that are freed on another CPU than the one that allocated them are simply
+// cached by the freeing CPU; they are only returned to their slab once the depot overflows.
+//
+// The slabs of the size classes are pages in the direct physical mapping while kernelHeap
+// allocates from kernel virtual memory. Hence, free() can tell both kinds of objects apart
+// by their address even if the size is not known.
+
+namespace {
+
+// KASAN and the allocation log need to see all allocations and frees.
+#if defined(THOR_KASAN) || defined(KERNEL_LOG_ALLOCATIONS)
+constexpr bool enableHeapCaches = false;
+#else
+constexpr bool enableHeapCaches = true;
+#endif
+
+constexpr size_t magazineSize = 30;
+// Maximal number of full and of empty magazines in the depot of each size class.
+constexpr size_t depotLimit = 16;
+
+constexpr size_t classSize(size_t sizeClass) {
+	return size_t{16} << sizeClass;
+}
+
+// Returns numKernelHeapClasses for sizes that are too large for the magazines.
+size_t classForSize(size_t size) {
+	if(size <= classSize(0))
+		return 0;
+	if(size > classSize(numKernelHeapClasses - 1))
+		return numKernelHeapClasses;
+	return (64 - __builtin_clzl(size - 1)) - 4;
+}
+
+struct Magazine {
+	bool empty() {
+		return !rounds;
+	}
+
+	bool full() {
+		return rounds == magazineSize;
+	}
+
+	Magazine *next = nullptr;
+	size_t rounds = 0;
+	void *objects[magazineSize];
+};
+static_assert(sizeof(Magazine) == 256);
+
+// Header at the start of each slab page. Free objects of the slab are linked through
+// their first word.
+struct Slab {
+	Slab *previous = nullptr;
+	Slab *next = nullptr;
+	void *freeList = nullptr;
+	size_t sizeClass = 0;
+	size_t numFree = 0;
+};
+
+// Offset of the first object; all objects are naturally aligned.
+constexpr size_t slabStart(size_t sizeClass) {
+	return (sizeof(Slab) + classSize(sizeClass) - 1) & ~(classSize(sizeClass) - 1);
+}
+
+constexpr size_t objectsPerSlab(size_t sizeClass) {
+	return (kPageSize - slabStart(sizeClass)) / classSize(sizeClass);
+}
+
+struct HeapClass {
+	frg::ticket_spinlock mutex;
+
+	// The depot.
+	Magazine *fullMagazines = nullptr;
+	Magazine *emptyMagazines = nullptr;
+	size_t numFull = 0;
+	size_t numEmpty = 0;
+
+	// Slabs that have at least one free object.
+	Slab *partialSlabs = nullptr;
+	std::atomic<size_t> numSlabs{0};
+};
+
+constinit HeapClass heapClasses[numKernelHeapClasses];
+
+frg::slab_allocator<KernelVirtualAlloc, IrqSpinlock> poolAllocator(KernelHeapPool *pool) {
+	return frg::slab_allocator<KernelVirtualAlloc, IrqSpinlock>{pool};
+}
+
+bool isPoolObject(void *pointer) {
+	auto address = reinterpret_cast<uintptr_t>(pointer);
+	return address >= memoryLayoutNote->kernelVirtual
+			&& address - memoryLayoutNote->kernelVirtual < memoryLayoutNote->kernelVirtualSize;
+}
+
+Slab *slabOf(void *object) {
+	return reinterpret_cast<Slab *>(reinterpret_cast<uintptr_t>(object) & ~(kPageSize - 1));
+}
+
+// Per-CPU counters are only written by their own CPU but read by all CPUs.
+void bump(std::atomic<uint64_t> &counter) {
+	counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// ----------------------------------------------------------------------------
+// Slab layer. All functions in this section require the HeapClass' mutex.
+// ----------------------------------------------------------------------------
+
+void linkSlab(HeapClass &hc, Slab *slab) {
+	slab->previous = nullptr;
+	slab->next = hc.partialSlabs;
+	if(hc.partialSlabs)
+		hc.partialSlabs->previous = slab;
+	hc.partialSlabs = slab;
+}
+
+void unlinkSlab(HeapClass &hc, Slab *slab) {
+	if(slab->previous) {
+		slab->previous->next = slab->next;
+	}else{
+		hc.partialSlabs = slab->next;
+	}
+	if(slab->next)
+		slab->next->previous = slab->previous;
+}
+
+Slab *createSlab(size_t sizeClass) {
+	PhysicalAddr physical = physicalAllocator->allocate(kPageSize);
+	assert(physical != static_cast<PhysicalAddr>(-1) && "OOM");
+	kernelMemoryUsage.fetch_add(kPageSize, std::memory_order_relaxed);
+
+	auto slab = new (mapDirectPhysical(physical)) Slab{};
+	slab->sizeClass = sizeClass;
+	auto base = reinterpret_cast<uintptr_t>(slab) + slabStart(sizeClass);
+	for(size_t i = objectsPerSlab(sizeClass); i > 0; i--) {
+		auto object = reinterpret_cast<void **>(base + (i - 1) * classSize(sizeClass));
+		*object = slab->freeList;
+		slab->freeList = object;
+	}
+	slab->numFree = objectsPerSlab(sizeClass);
+	return slab;
+}
+
+// Moves objects from the slabs to the magazine until it holds count objects.
+void takeFromSlabs(size_t sizeClass, Magazine *magazine, size_t count) {
+	auto &hc = heapClasses[sizeClass];
+	while(magazine->rounds < count) {
+		auto slab = hc.partialSlabs;
+		if(!slab) {
+			slab = createSlab(sizeClass);
+			linkSlab(hc, slab);
+			hc.numSlabs.store(hc.numSlabs.load(std::memory_order_relaxed) + 1,
+					std::memory_order_relaxed);
+		}
+
+		while(slab->numFree && magazine->rounds < count) {
+			auto object = static_cast<void **>(slab->freeList);
+			slab->freeList = *object;
+			slab->numFree--;
+			magazine->objects[magazine->rounds++] = object;
+		}
+		if(!slab->numFree)
+			unlinkSlab(hc, slab);
+	}
+}
+
+void returnToSlab(size_t sizeClass, void *object) {
+	auto &hc = heapClasses[sizeClass];
+	auto slab = slabOf(object);
+	assert(slab->sizeClass == sizeClass);
+
+	*static_cast<void **>(object) = slab->freeList;
+	slab->freeList = object;
+	if(!slab->numFree++)
+		linkSlab(hc, slab);
+
+	if(slab->numFree == objectsPerSlab(sizeClass)) {
+		unlinkSlab(hc, slab);
+		hc.numSlabs.store(hc.numSlabs.load(std::memory_order_relaxed) - 1,
+				std::memory_order_relaxed);
+		physicalAllocator->free(reverseDirectPhysical(slab), kPageSize);
+		kernelMemoryUsage.fetch_sub(kPageSize, std::memory_order_relaxed);
+	}
+}
+
+// ----------------------------------------------------------------------------
+// Depot. All functions in this section require the HeapClass' mutex.
+// ----------------------------------------------------------------------------
+
+void putEmptyMagazine(HeapClass &hc, Magazine *magazine) {
+	assert(magazine->empty());
+	if(hc.numEmpty == depotLimit) {
+		auto allocator = poolAllocator(kernelHeap.get());
+		frg::destruct(allocator, magazine);
+		return;
+	}
+	magazine->next = hc.emptyMagazines;
+	hc.emptyMagazines = magazine;
+	hc.numEmpty++;
+}
+
+Magazine *getEmptyMagazine(HeapClass &hc) {
+	if(!hc.emptyMagazines) {
+		auto allocator = poolAllocator(kernelHeap.get());
+		return frg::construct<Magazine>(allocator);
+	}
+	auto magazine = hc.emptyMagazines;
+	hc.emptyMagazines = magazine->next;
+	hc.numEmpty--;
+	return magazine;
+}
+
+} // anonymous namespace
+
+struct KernelHeapCpuCache {
+	struct Counters {
+		std::atomic<uint64_t> allocations{0};
+		std::atomic<uint64_t> frees{0};
+		std::atomic<uint64_t> cpuHits{0};
+		std::atomic<uint64_t> depotExchanges{0};
+	};
+
+	struct Class {
+		Magazine *loaded = nullptr;
+		Magazine *previous = nullptr;
+		Counters counters;
+	};
+
+	KernelHeapCpuCache() {
+		auto allocator = poolAllocator(kernelHeap.get());
+		for(auto &cc : classes) {
+			cc.loaded = frg::construct<Magazine>(allocator);
+			cc.previous = frg::construct<Magazine>(allocator);
+		}
+		active = true;
+	}
+
+	Class classes[numKernelHeapClasses];
+
+	// The boot CPU allocates memory before its per-CPU data is initialized.
+	// Until then, this is false and allocations go to kernelHeap.
+	bool active = false;
+};
+
+extern PerCpu<KernelHeapCpuCache> kernelHeapCaches;
+THOR_DEFINE_PERCPU(kernelHeapCaches);
+
+namespace {
+
+// Called with IRQs disabled if both magazines are empty.
+void refillMagazines(size_t sizeClass, KernelHeapCpuCache::Class &cc) {
+	auto &hc = heapClasses[sizeClass];
+	auto lock = frg::guard(&hc.mutex);
+
+	if(hc.fullMagazines) {
+		auto full = hc.fullMagazines;
+		hc.fullMagazines = full->next;
+		hc.numFull--;
+
+		putEmptyMagazine(hc, cc.previous);
+		cc.previous = cc.loaded;
+		cc.loaded = full;
+		bump(cc.counters.depotExchanges);
+		return;
+	}
+
+	// Only fill the magazine halfway such that the next few frees
+	// do not immediately need to go back to the depot.
+	takeFromSlabs(sizeClass, cc.loaded, magazineSize / 2);
+}
+
+// Called with IRQs disabled if both magazines are full.
+void spillMagazines(size_t sizeClass, KernelHeapCpuCache::Class &cc) {
+	auto &hc = heapClasses[sizeClass];
+	auto lock = frg::guard(&hc.mutex);
+
+	if(hc.numFull < depotLimit) {
+		cc.previous->next = hc.fullMagazines;
+		hc.fullMagazines = cc.previous;
+		hc.numFull++;
+
+		cc.previous = cc.loaded;
+		cc.loaded = getEmptyMagazine(hc);
+		bump(cc.counters.depotExchanges);
+		return;
+	}
+
+	// The depot is full; this is where objects that are freed on other CPUs
+	// eventually make it back to their slabs.
+	while(!cc.previous->empty())
+		returnToSlab(sizeClass, cc.previous->objects[--cc.previous->rounds]);
+	std::swap(cc.loaded, cc.previous);
+}
+
+void freeToCache(size_t sizeClass, void *object) {
+	auto irqLock = frg::guard(&irqMutex());
+	auto &cache = kernelHeapCaches.get();
+
+	if(!cache.active) {
+		auto lock = frg::guard(&heapClasses[sizeClass].mutex);
+		returnToSlab(sizeClass, object);
+		return;
+	}
+
+	auto &cc = cache.classes[sizeClass];
+	bump(cc.counters.frees);
+	if(cc.loaded->full() && !cc.previous->full())
+		std::swap(cc.loaded, cc.previous);
+	if(cc.loaded->full()) {
+		spillMagazines(sizeClass, cc);
+	}else{
+		bump(cc.counters.cpuHits);
+	}
+	cc.loaded->objects[cc.loaded->rounds++] = object;
+}
+
+} // anonymous namespace
+
+// ----------------------------------------------------------------------------
+// KernelAlloc.
+// ----------------------------------------------------------------------------
+
+void *KernelAlloc::allocate(size_t size) {
+	auto sizeClass = classForSize(size);
+	if(!enableHeapCaches || sizeClass == numKernelHeapClasses)
+		return poolAllocator(pool_).allocate(size);
+
+	auto irqLock = frg::guard(&irqMutex());
+	auto &cache = kernelHeapCaches.get();
+	if(!cache.active)
+		return poolAllocator(pool_).allocate(size);
+
+	auto &cc = cache.classes[sizeClass];
+	bump(cc.counters.allocations);
+	if(cc.loaded->empty() && !cc.previous->empty())
+		std::swap(cc.loaded, cc.previous);
+	if(cc.loaded->empty()) {
+		refillMagazines(sizeClass, cc);
+	}else{
+		bump(cc.counters.cpuHits);
+	}
+	return cc.loaded->objects[--cc.loaded->rounds];
+}
+
+void KernelAlloc::deallocate(void *pointer, size_t size) {
+	if(!pointer)
+		return;
+	if(!enableHeapCaches || isPoolObject(pointer)) {
+		poolAllocator(pool_).deallocate(pointer, size);
+		return;
+	}
+	freeToCache(slabOf(pointer)->sizeClass, pointer);
+}
+
+void KernelAlloc::free(void *pointer) {
+	if(!pointer)
+		return;
+	if(!enableHeapCaches || isPoolObject(pointer)) {
+		poolAllocator(pool_).free(pointer);
+		return;
+	}
+	freeToCache(slabOf(pointer)->sizeClass, pointer);
+}
+
+KernelHeapStatistics getKernelHeapStatistics(size_t sizeClass) {
+	assert(sizeClass < numKernelHeapClasses);
+
+	KernelHeapStatistics stats{};
+	stats.objectSize = classSize(sizeClass);
+	for(size_t i = 0; i < getCpuCount(); i++) {
+		auto &counters = kernelHeapCaches.getFor(i).classes[sizeClass].counters;
+		stats.allocations += counters.allocations.load(std::memory_order_relaxed);
+		stats.frees += counters.frees.load(std::memory_order_relaxed);
+		stats.cpuHits += counters.cpuHits.load(std::memory_order_relaxed);
+		stats.depotExchanges += counters.depotExchanges.load(std::memory_order_relaxed);
+	}
+	// Do not take the mutex; this is also called when we run out of memory.
+	stats.slabPages = heapClasses[sizeClass].numSlabs.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void logKernelHeapStatistics() {
+	for(size_t i = 0; i < numKernelHeapClasses; i++) {
+		auto stats = getKernelHeapStatistics(i);
+		auto operations = stats.allocations + stats.frees;
+		infoLogger() << "thor: Kernel heap, " << stats.objectSize << " byte objects: "
+				<< stats.allocations << " allocations, " << stats.frees << " frees ("
+				<< (operations ? stats.cpuHits * 100 / operations : 0) << "% CPU-local), "
+				<< stats.depotExchanges << " depot exchanges, "
+				<< stats.slabPages << " slab pages" << frg::endlog;
+	}
+}
+
+} // namespace thor
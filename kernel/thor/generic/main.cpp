@@ -94,6 +94,7 @@ extern "C" void thorInitialize() {
 				region[i].numRoots, reinterpret_cast<int8_t *>(region[i].buddyTree));
 	infoLogger() << "thor: Number of available pages: "
 			<< physicalAllocator->numFreePages() << frg::endlog;
+	physicalAllocator->initializePageFrames();
 
 	kernelVirtualAlloc.initialize();
 	kernelHeap.initialize(*kernelVirtualAlloc);
@@ -359,6 +360,7 @@ extern "C" void thorMain() {
 
 	infoLogger() << "thor: Entering initilization fiber." << frg::endlog;
 	LoadBalancer::singleton().setOnline(getCpuData());
+	runZeroingFiber(getCpuData());
 	auto *scheduler = &localScheduler.get();
 	scheduler->update();
 	scheduler->forceReschedule();
@@ -587,6 +589,9 @@ void handleSyscall(SyscallImageAccessor image) {
 	case kHelCallResizeMemory: {
 		*image.error() = helResizeMemory((HelHandle)arg0, (size_t)arg1);
 	} break;
+	case kHelCallDiscardMemory: {
+		*image.error() = helDiscardMemory((HelHandle)arg0, (uintptr_t)arg1, (size_t)arg2);
+	} break;
 	case kHelCallCreateManagedMemory: {
 		HelHandle backing_handle, frontal_handle;
 		*image.error() = helCreateManagedMemory((size_t)arg0, (uint32_t)arg1,
@@ -624,6 +629,10 @@ void handleSyscall(SyscallImageAccessor image) {
 		*image.error() = helForkMemory((HelHandle)arg0, &forkedHandle);
 		*image.out0() = forkedHandle;
 	} break;
+	case kHelCallForkMappings: {
+		*image.error() = helForkMappings((HelHandle)arg0,
+				(HelForkMapping *)arg1, (size_t)arg2);
+	} break;
 	case kHelCallCreateSpace: {
 		HelHandle handle;
 		*image.error() = helCreateSpace(&handle);
@@ -642,6 +651,9 @@ void handleSyscall(SyscallImageAccessor image) {
 	case kHelCallUnmapMemory: {
 		*image.error() = helUnmapMemory((HelHandle)arg0, (void *)arg1, (size_t)arg2);
 	} break;
+	case kHelCallQuerySpaceStats: {
+		*image.error() = helQuerySpaceStats((HelHandle)arg0, (HelSpaceStats *)arg1);
+	} break;
 	case kHelCallSubmitSynchronizeSpace: {
 		*image.error() = helSubmitSynchronizeSpace((HelHandle)arg0, (void *)arg1, (size_t)arg2,
 				(HelHandle)arg3, (uintptr_t)arg4);
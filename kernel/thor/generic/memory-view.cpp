@@ -42,6 +42,8 @@ struct MemoryReclaimer {
 			if(!(page->flags & CachePage::reclaimInflight)) {
 				auto it = page->bundle->_reclaimList.iterator_to(page);
 				page->bundle->_reclaimList.erase(it);
+				page->bundle->_reclaimPending.store(!page->bundle->_reclaimList.empty(),
+						std::memory_order_relaxed);
 			}
 
 			page->flags &= ~(CachePage::reclaimPosted | CachePage::reclaimInflight);
@@ -63,6 +65,8 @@ struct MemoryReclaimer {
 			if(!(page->flags & CachePage::reclaimInflight)) {
 				auto it = page->bundle->_reclaimList.iterator_to(page);
 				page->bundle->_reclaimList.erase(it);
+				page->bundle->_reclaimPending.store(!page->bundle->_reclaimList.empty(),
+						std::memory_order_relaxed);
 			}
 
 			page->flags &= ~(CachePage::reclaimPosted | CachePage::reclaimInflight);
@@ -78,7 +82,11 @@ struct MemoryReclaimer {
 	auto awaitReclaim(CacheBundle *bundle, async::cancellation_token ct = {}) {
 		return async::sequence(
 			async::transform(
-				bundle->_reclaimEvent.async_wait(ct),
+				// Do not wait if pages were posted while the bundle was busy;
+				// their raise() happened before we started waiting.
+				bundle->_reclaimEvent.async_wait_if([bundle] () -> bool {
+					return !bundle->_reclaimPending.load(std::memory_order_relaxed);
+				}, ct),
 				[] (auto) { }
 			),
 			// TODO: Use the reclaim fiber, not WorkQueue::generalQueue().
@@ -94,6 +102,7 @@ struct MemoryReclaimer {
 			return nullptr;
 
 		auto page = bundle->_reclaimList.pop_front();
+		bundle->_reclaimPending.store(!bundle->_reclaimList.empty(), std::memory_order_relaxed);
 
 		assert(page->flags & CachePage::reclaimRegistered);
 		assert(page->flags & CachePage::reclaimPosted);
@@ -105,29 +114,33 @@ struct MemoryReclaimer {
 	}
 
 	void runReclaimFiber() {
-		auto checkReclaim = [this] () -> bool {
+		// Returns the number of pages that we should post in this iteration.
+		// Posted pages are only freed once their bundle reclaims them,
+		// so we post at most as many pages as we are above the watermark.
+		auto computeBudget = [] () -> size_t {
 			if(disableUncaching)
-				return false;
+				return 0;
+			if(tortureUncaching)
+				return ~size_t{0};
+
+			auto pagesWatermark = physicalAllocator->numTotalPages() * 3 / 4;
+			auto usedPages = physicalAllocator->numUsedPages();
+			if(usedPages < pagesWatermark)
+				return 0;
+			if(logUncaching)
+				infoLogger() << "thor: Uncaching pages. " << usedPages
+						<< " pages are in use (watermark: " << pagesWatermark << ")"
+						<< frg::endlog;
+			return usedPages - pagesWatermark + 1;
+		};
 
+		auto postPage = [this] () -> bool {
 			auto irqLock = frg::guard(&irqMutex());
 			auto lock = frg::guard(&_mutex);
 
 			if(_lruList.empty())
 				return false;
 
-			if(!tortureUncaching) {
-				auto pagesWatermark = physicalAllocator->numTotalPages() * 3 / 4;
-				auto usedPages = physicalAllocator->numUsedPages();
-				if(usedPages < pagesWatermark) {
-					return false;
-				}else{
-					if(logUncaching)
-						infoLogger() << "thor: Uncaching page. " << usedPages
-								<< " pages are in use (watermark: " << pagesWatermark << ")"
-								<< frg::endlog;
-				}
-			}
-
 			auto page = _lruList.pop_front();
 
 			assert(page->flags & CachePage::reclaimRegistered);
@@ -138,6 +151,7 @@ struct MemoryReclaimer {
 			_cachedSize -= kPageSize;
 
 			page->bundle->_reclaimList.push_back(page);
+			page->bundle->_reclaimPending.store(true, std::memory_order_relaxed);
 			page->bundle->_reclaimEvent.raise();
 
 			return true;
@@ -152,7 +166,7 @@ struct MemoryReclaimer {
 							<< " KiB of cached pages" << frg::endlog;
 				}
 
-				while(checkReclaim())
+				for(auto budget = computeBudget(); budget && postPage(); budget--)
 					;
 				if(tortureUncaching) {
 					KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(10'000'000));
@@ -354,6 +368,15 @@ Error MemoryView::setIndirection(size_t, smarter::shared_ptr<MemoryView>,
 	return Error::illegalObject;
 }
 
+coroutine<frg::expected<Error>> MemoryView::discardRange(uintptr_t, size_t) {
+	co_return Error::illegalObject;
+}
+
+frg::tuple<PhysicalAddr, CachingMode, bool> MemoryView::peekSharedRange(uintptr_t offset) {
+	auto range = peekRange(offset);
+	return frg::make_tuple(range.get<0>(), range.get<1>(), false);
+}
+
 // --------------------------------------------------------
 // getZeroMemory()
 // --------------------------------------------------------
@@ -407,6 +430,10 @@ struct ZeroMemory final : MemoryView, GlobalFutexSpace {
 		urgentLogger() << "thor: ZeroMemory::markDirty() called," << frg::endlog;
 	}
 
+	bool readsAsZero() override {
+		return true;
+	}
+
 	coroutine<frg::expected<Error, PhysicalAddr>> takeGlobalFutex(uintptr_t,
 			smarter::shared_ptr<WorkQueue>) override {
 		// TODO: Futexes are always read-write. What should we do here?
@@ -589,14 +616,356 @@ size_t HardwareMemory::getLength() {
 	return _length;
 }
 
+// --------------------------------------------------------
+// AnonymousSpace
+// --------------------------------------------------------
+
+AnonymousSpace::AnonymousSpace(size_t numPages)
+: _pages{*kernelAlloc} {
+	_pages.resize(numPages, nullptr);
+}
+
+AnonymousSpace::~AnonymousSpace() {
+	// The reclaim coroutine holds a reference, so no page can be evicting here.
+	// Likewise, discardPages() is only called while the AllocatedMemory is alive.
+	for(size_t i = 0; i < _pages.size(); ++i) {
+		auto pit = _pages[i];
+		if(!pit)
+			continue;
+		assert(pit->loadState != kStateEvicting);
+		assert(pit->loadState != kStateDiscarding);
+
+		if(pit->loadState == kStatePresent) {
+			if(!pit->lockCount && !pit->incompressible)
+				globalReclaimer->removePage(&pit->cachePage);
+			physicalAllocator->free(pit->physical, kPageSize);
+		}else if(pit->loadState == kStateCompressed) {
+			discardCompressedPage(pit->compressed);
+		}
+		frg::destruct(*kernelAlloc, pit);
+	}
+}
+
+void AnonymousSpace::runReclaim() {
+	[] (smarter::shared_ptr<AnonymousSpace> self, enable_detached_coroutine = {}) -> void {
+		while(true) {
+			co_await globalReclaimer->awaitReclaim(self.get(), self->_cancelReclaim);
+
+			AnonymousPage *pit;
+			{
+				auto irqLock = frg::guard(&irqMutex());
+				auto lock = frg::guard(&self->_mutex);
+
+				if(self->_reclaimCancelled)
+					break;
+
+				auto page = globalReclaimer->reclaimPage(self.get());
+				if(!page)
+					continue;
+
+				pit = self->_pages[page->identity];
+				assert(pit);
+				assert(pit->loadState == kStatePresent);
+				assert(!pit->lockCount);
+				pit->loadState = kStateEvicting;
+				globalReclaimer->removePage(&pit->cachePage);
+			}
+
+			// After this, the page is not mapped anymore; any new access cancels the eviction.
+			co_await self->evictQueue.evictRange(pit->cachePage.identity << kPageShift, kPageSize);
+
+			PhysicalAddr physical;
+			{
+				auto irqLock = frg::guard(&irqMutex());
+				auto lock = frg::guard(&self->_mutex);
+
+				if(pit->loadState != kStateEvicting)
+					continue;
+				physical = pit->physical;
+			}
+
+			CompressedPage compressed;
+			bool success = compressPage(physical, compressed);
+
+			{
+				auto irqLock = frg::guard(&irqMutex());
+				auto lock = frg::guard(&self->_mutex);
+
+				if(pit->loadState != kStateEvicting) {
+					// The page was accessed while we compressed it.
+					if(success)
+						discardCompressedPage(compressed);
+					continue;
+				}
+				assert(!pit->lockCount);
+
+				if(!success) {
+					pit->loadState = kStatePresent;
+					pit->incompressible = true;
+					continue;
+				}
+
+				pit->loadState = kStateCompressed;
+				pit->compressed = compressed;
+				pit->physical = PhysicalAddr(-1);
+			}
+
+			if(logUncaching)
+				warningLogger() << "Compressing anonymous page" << frg::endlog;
+			physicalAllocator->free(physical, kPageSize);
+		}
+	}(selfPtr.lock());
+}
+
+void AnonymousSpace::cancelReclaim() {
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&_mutex);
+
+		_reclaimCancelled = true;
+	}
+	_cancelReclaim.cancel();
+}
+
+size_t AnonymousSpace::getLength() {
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	return _pages.size() << kPageShift;
+}
+
+void AnonymousSpace::resize(size_t numPages) {
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	assert(numPages >= _pages.size());
+	_pages.resize(numPages, nullptr);
+}
+
+void AnonymousSpace::lockPages(uintptr_t offset, size_t size) {
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	auto misalign = offset & (kPageSize - 1);
+	for(size_t pg = 0; pg < size + misalign; pg += kPageSize) {
+		auto pit = _getPage((offset + pg) >> kPageShift);
+		pit->lockCount++;
+		if(pit->lockCount == 1) {
+			if(pit->loadState == kStatePresent) {
+				if(!pit->incompressible)
+					globalReclaimer->removePage(&pit->cachePage);
+			}else if(pit->loadState == kStateEvicting) {
+				// Stop the eviction to keep the page present.
+				pit->loadState = kStatePresent;
+			}else if(pit->loadState == kStateDiscarding) {
+				// Stop the discard; the page still needs to read as zero.
+				PageAccessor accessor{pit->physical};
+				memset(accessor.get(), 0, kPageSize);
+				pit->loadState = kStatePresent;
+			}
+		}
+		assert(pit->loadState != kStateEvicting);
+	}
+}
+
+void AnonymousSpace::unlockPages(uintptr_t offset, size_t size) {
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	auto misalign = offset & (kPageSize - 1);
+	for(size_t pg = 0; pg < size + misalign; pg += kPageSize) {
+		auto pit = _pages[(offset + pg) >> kPageShift];
+		assert(pit);
+		assert(pit->lockCount > 0);
+		pit->lockCount--;
+		if(!pit->lockCount) {
+			if(pit->loadState == kStatePresent && !pit->incompressible)
+				globalReclaimer->addPage(&pit->cachePage);
+		}
+		assert(pit->loadState != kStateEvicting);
+	}
+}
+
+void AnonymousSpace::pinPages(uintptr_t offset, size_t size) {
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	// Pins are never released; they are simply locks that are not unlocked.
+	auto misalign = offset & (kPageSize - 1);
+	for(size_t pg = 0; pg < size + misalign; pg += kPageSize) {
+		auto pit = _touchPage((offset + pg) >> kPageShift);
+		pit->lockCount++;
+		if(pit->lockCount == 1 && !pit->incompressible)
+			globalReclaimer->removePage(&pit->cachePage);
+	}
+}
+
+PhysicalAddr AnonymousSpace::peekPage(uintptr_t offset) {
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	auto index = offset >> kPageShift;
+	assert(index < _pages.size());
+	auto pit = _pages[index];
+	if(!pit)
+		return PhysicalAddr(-1);
+
+	if(pit->loadState == kStateEvicting) {
+		// Cancel evication -- the page is still needed.
+		pit->loadState = kStatePresent;
+		globalReclaimer->addPage(&pit->cachePage);
+	}else if(pit->loadState != kStatePresent) {
+		return PhysicalAddr(-1);
+	}
+	return pit->physical;
+}
+
+PhysicalAddr AnonymousSpace::fetchPage(uintptr_t offset) {
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	return _touchPage(offset >> kPageShift)->physical;
+}
+
+coroutine<void> AnonymousSpace::discardPages(uintptr_t offset, size_t size) {
+	assert(!(offset & (kPageSize - 1)));
+	assert(!(size & (kPageSize - 1)));
+
+	bool anyDiscarding = false;
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&_mutex);
+
+		for(size_t pg = 0; pg < size; pg += kPageSize) {
+			auto pit = _pages[(offset + pg) >> kPageShift];
+			if(!pit)
+				continue;
+
+			if(pit->loadState == kStateCompressed) {
+				discardCompressedPage(pit->compressed);
+				pit->loadState = kStateMissing;
+			}else if(pit->loadState == kStatePresent && !pit->lockCount) {
+				if(!pit->incompressible)
+					globalReclaimer->removePage(&pit->cachePage);
+				pit->loadState = kStateDiscarding;
+				anyDiscarding = true;
+			}else if(pit->loadState == kStatePresent || pit->loadState == kStateEvicting) {
+				// Locked pages need to stay present and evicting pages are owned
+				// by the reclaim coroutine; we only clear their contents.
+				if(pit->loadState == kStateEvicting) {
+					pit->loadState = kStatePresent;
+					globalReclaimer->addPage(&pit->cachePage);
+				}
+				PageAccessor accessor{pit->physical};
+				memset(accessor.get(), 0, kPageSize);
+			}
+		}
+	}
+
+	if(!anyDiscarding)
+		co_return;
+
+	// After this, the pages are not mapped anymore; any new access clears them instead.
+	co_await evictQueue.evictRange(offset, size);
+
+	auto irqLock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	for(size_t pg = 0; pg < size; pg += kPageSize) {
+		auto pit = _pages[(offset + pg) >> kPageShift];
+		if(!pit || pit->loadState != kStateDiscarding)
+			continue;
+		physicalAllocator->free(pit->physical, kPageSize);
+		pit->physical = PhysicalAddr(-1);
+		pit->loadState = kStateMissing;
+	}
+}
+
+// Called with _mutex held.
+AnonymousSpace::AnonymousPage *AnonymousSpace::_getPage(size_t index) {
+	assert(index < _pages.size());
+	if(!_pages[index])
+		_pages[index] = frg::construct<AnonymousPage>(*kernelAlloc, this, index);
+	return _pages[index];
+}
+
+// Called with _mutex held.
+AnonymousSpace::AnonymousPage *AnonymousSpace::_touchPage(size_t index) {
+	auto pit = _getPage(index);
+
+	if(pit->loadState == kStatePresent) {
+		if(!pit->lockCount) {
+			if(pit->incompressible) {
+				// Give the page another chance; its contents may have changed.
+				pit->incompressible = false;
+				globalReclaimer->addPage(&pit->cachePage);
+			}else{
+				globalReclaimer->bumpPage(&pit->cachePage);
+			}
+		}
+		return pit;
+	}
+
+	if(pit->loadState == kStateEvicting) {
+		// Cancel evication -- the page is still needed.
+		assert(!pit->lockCount);
+	}else if(pit->loadState == kStateDiscarding) {
+		// Cancel the discard but keep the zero contents that it promises.
+		PageAccessor accessor{pit->physical};
+		memset(accessor.get(), 0, kPageSize);
+	}else if(pit->loadState == kStateMissing
+			|| (pit->loadState == kStateCompressed && pit->compressed.poolPage == PhysicalAddr(-1))) {
+		pit->physical = allocateZeroedPage();
+		assert(pit->physical != PhysicalAddr(-1) && "OOM");
+	}else{
+		assert(pit->loadState == kStateCompressed);
+		pit->physical = physicalAllocator->allocate(kPageSize);
+		assert(pit->physical != PhysicalAddr(-1) && "OOM");
+		decompressPage(pit->compressed, pit->physical);
+	}
+	if(pit->loadState == kStateCompressed)
+		discardCompressedPage(pit->compressed);
+
+	pit->loadState = kStatePresent;
+	pit->incompressible = false;
+	if(!pit->lockCount)
+		globalReclaimer->addPage(&pit->cachePage);
+	return pit;
+}
+
 // --------------------------------------------------------
 // AllocatedMemory
 // --------------------------------------------------------
 
+namespace {
+
+// Only memory that is not used for DMA (i.e., that consists of 4 KiB chunks without
+// address restrictions) can be evicted. Such memory can still be pinned
+// if user space requests its physical address.
+smarter::shared_ptr<AnonymousSpace> makeAnonymousSpace(size_t length,
+		int addressBits, size_t chunkSize) {
+	if(chunkSize != kPageSize || addressBits != 64)
+		return nullptr;
+
+	auto space = smarter::allocate_shared<AnonymousSpace>(*kernelAlloc,
+			(length + (kPageSize - 1)) >> kPageShift);
+	space->selfPtr = space;
+	space->runReclaim();
+	return space;
+}
+
+} // anonymous namespace
+
 AllocatedMemory::AllocatedMemory(size_t desiredLngth,
 		int addressBits, size_t desiredChunkSize, size_t chunkAlign)
-: _physicalChunks{*kernelAlloc},
-		_addressBits{addressBits}, _chunkAlign{chunkAlign} {
+: AllocatedMemory{desiredLngth, addressBits, desiredChunkSize, chunkAlign,
+		makeAnonymousSpace(desiredLngth, addressBits, desiredChunkSize)} { }
+
+AllocatedMemory::AllocatedMemory(size_t desiredLngth,
+		int addressBits, size_t desiredChunkSize, size_t chunkAlign,
+		smarter::shared_ptr<AnonymousSpace> swap)
+: MemoryView{swap ? &swap->evictQueue : nullptr}, _physicalChunks{*kernelAlloc},
+		_addressBits{addressBits}, _chunkAlign{chunkAlign}, _swap{std::move(swap)} {
 	static_assert(sizeof(unsigned long) == sizeof(uint64_t), "Fix use of __builtin_clzl");
 	_chunkSize = size_t(1) << (64 - __builtin_clzl(desiredChunkSize - 1));
 	if(_chunkSize != desiredChunkSize)
@@ -612,10 +981,17 @@ AllocatedMemory::AllocatedMemory(size_t desiredLngth,
 	assert(_chunkSize % kPageSize == 0);
 	assert(_chunkAlign % kPageSize == 0);
 	assert(_chunkSize % _chunkAlign == 0);
-	_physicalChunks.resize(length / _chunkSize, PhysicalAddr(-1));
+	if(!_swap)
+		_physicalChunks.resize(length / _chunkSize, PhysicalAddr(-1));
 }
 
 AllocatedMemory::~AllocatedMemory() {
+	// The AnonymousSpace frees its pages once its reclaim coroutine terminates.
+	if(_swap) {
+		_swap->cancelReclaim();
+		return;
+	}
+
 	// TODO: This destructor takes a lock. This is potentially unexpected.
 	// Rework this to only schedule the deallocation but not actually perform it?
 	if(logUsage)
@@ -631,6 +1007,13 @@ AllocatedMemory::~AllocatedMemory() {
 }
 
 void AllocatedMemory::resize(size_t newSize, async::any_receiver<void> receiver) {
+	if(_swap) {
+		assert(!(newSize % kPageSize));
+		_swap->resize(newSize >> kPageShift);
+		receiver.set_value();
+		return;
+	}
+
 	{
 		auto irq_lock = frg::guard(&irqMutex());
 		auto lock = frg::guard(&_mutex);
@@ -649,18 +1032,24 @@ AllocatedMemory::resolveGlobalFutex(uintptr_t offset) {
 	return frg::make_tuple(std::move(futexSpace), offset);
 }
 
-Error AllocatedMemory::lockRange(uintptr_t, size_t) {
-	// For now, we do not evict "anonymous" memory. TODO: Implement eviction here.
+Error AllocatedMemory::lockRange(uintptr_t offset, size_t size) {
+	// Memory that is used for DMA is never evicted.
+	if(_swap)
+		_swap->lockPages(offset, size);
 	return Error::success;
 }
 
-void AllocatedMemory::unlockRange(uintptr_t, size_t) {
-	// For now, we do not evict "anonymous" memory. TODO: Implement eviction here.
+void AllocatedMemory::unlockRange(uintptr_t offset, size_t size) {
+	if(_swap)
+		_swap->unlockPages(offset, size);
 }
 
 frg::tuple<PhysicalAddr, CachingMode> AllocatedMemory::peekRange(uintptr_t offset) {
 	assert(offset % kPageSize == 0);
 
+	if(_swap)
+		return frg::tuple<PhysicalAddr, CachingMode>{_swap->peekPage(offset), CachingMode::null};
+
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
 
@@ -676,6 +1065,12 @@ frg::tuple<PhysicalAddr, CachingMode> AllocatedMemory::peekRange(uintptr_t offse
 
 coroutine<frg::expected<Error, PhysicalRange>>
 AllocatedMemory::fetchRange(uintptr_t offset, FetchFlags, smarter::shared_ptr<WorkQueue>) {
+	if(_swap) {
+		auto misalign = offset & (kPageSize - 1);
+		auto physical = _swap->fetchPage(offset);
+		co_return PhysicalRange{physical + misalign, kPageSize - misalign, CachingMode::null};
+	}
+
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
 
@@ -703,7 +1098,40 @@ void AllocatedMemory::markDirty(uintptr_t, size_t) {
 	// Do nothing for now.
 }
 
+void AllocatedMemory::pinRange(uintptr_t offset, size_t size) {
+	if(_swap)
+		_swap->pinPages(offset, size);
+}
+
+coroutine<frg::expected<Error>> AllocatedMemory::discardRange(uintptr_t offset, size_t size) {
+	assert(!(offset & (kPageSize - 1)));
+	assert(!(size & (kPageSize - 1)));
+
+	if(_swap) {
+		co_await _swap->discardPages(offset, size);
+		co_return {};
+	}
+
+	// Chunks may be in use for DMA, hence we only clear their contents.
+	auto irq_lock = frg::guard(&irqMutex());
+	auto lock = frg::guard(&_mutex);
+
+	for(size_t pg = 0; pg < size; pg += kPageSize) {
+		auto index = (offset + pg) / _chunkSize;
+		auto disp = (offset + pg) & (_chunkSize - 1);
+		assert(index < _physicalChunks.size());
+		if(_physicalChunks[index] == PhysicalAddr(-1))
+			continue;
+		PageAccessor accessor{_physicalChunks[index] + disp};
+		memset(accessor.get(), 0, kPageSize);
+	}
+	co_return {};
+}
+
 size_t AllocatedMemory::getLength() {
+	if(_swap)
+		return _swap->getLength();
+
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
 
@@ -713,12 +1141,14 @@ size_t AllocatedMemory::getLength() {
 coroutine<frg::expected<Error, PhysicalAddr>> AllocatedMemory::takeGlobalFutex(uintptr_t offset,
 		smarter::shared_ptr<WorkQueue> wq) {
 	// TODO: This could be optimized further (by avoiding the coroutine call).
+	lockRange(offset & ~(kPageSize - 1), kPageSize);
 	auto range = FRG_CO_TRY(co_await fetchRange(offset & ~(kPageSize - 1), 0, wq));
 	assert(range.get<0>() != PhysicalAddr(-1));
 	co_return range.get<0>();
 }
 
-void AllocatedMemory::retireGlobalFutex(uintptr_t) {
+void AllocatedMemory::retireGlobalFutex(uintptr_t offset) {
+	unlockRange(offset & ~(kPageSize - 1), kPageSize);
 }
 
 // --------------------------------------------------------
@@ -1029,11 +1459,8 @@ BackingMemory::fetchRange(uintptr_t offset, FetchFlags, smarter::shared_ptr<Work
 	assert(pit);
 
 	if(pit->physical == PhysicalAddr(-1)) {
-		PhysicalAddr physical = physicalAllocator->allocate(kPageSize);
+		PhysicalAddr physical = allocateZeroedPage();
 		assert(physical != PhysicalAddr(-1) && "OOM");
-
-		PageAccessor accessor{physical};
-		memset(accessor.get(), 0, kPageSize);
 		pit->physical = physical;
 	}
 
@@ -1440,6 +1867,9 @@ Error IndirectMemory::setIndirection(size_t slot, smarter::shared_ptr<MemoryView
 	auto indirection = smarter::allocate_shared<IndirectionSlot>(*kernelAlloc,
 			this, slot, memory, offset, size);
 	// TODO: start a coroutine to observe evictions.
+	//       Until then, we need to prevent evictions of the memory; since evictRange()
+	//       waits for all observers, this applies to pages outside of the slot, too.
+	memory->pinRange(0, memory->getLength());
 	memory->addObserver(&indirection->observer);
 	indirections_[slot] = std::move(indirection);
 	return Error::success;
@@ -1449,12 +1879,6 @@ Error IndirectMemory::setIndirection(size_t slot, smarter::shared_ptr<MemoryView
 // CopyOnWriteMemory
 // --------------------------------------------------------
 
-CowPage::~CowPage() {
-	assert(state == CowState::hasCopy);
-	assert(physical != PhysicalAddr(-1));
-	physicalAllocator->free(physical, kPageSize);
-}
-
 CopyOnWriteMemory::CopyOnWriteMemory(smarter::shared_ptr<MemoryView> view,
 		uintptr_t offset, size_t length,
 		smarter::shared_ptr<CowChain> chain)
@@ -1467,6 +1891,14 @@ CopyOnWriteMemory::CopyOnWriteMemory(smarter::shared_ptr<MemoryView> view,
 }
 
 CopyOnWriteMemory::~CopyOnWriteMemory() {
+	if(_viewObservation)
+		_viewObservation->cancelEviction.cancel();
+
+	// Only visit the pages that we own; sparse objects can be large.
+	for(auto it = _ownedPages.begin(); it != _ownedPages.end(); ++it) {
+		assert(it->state == CowState::hasCopy);
+		releasePage(it->physical);
+	}
 }
 
 size_t CopyOnWriteMemory::getLength() {
@@ -1489,9 +1921,9 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 			-> coroutine<void> {
 		smarter::shared_ptr<CopyOnWriteMemory> forked;
 		smarter::shared_ptr<CowChain> newChain;
-		frg::vector<frg::tuple<size_t, smarter::shared_ptr<CowPage>>, KernelAlloc> inProgressPages{*kernelAlloc};
+		frg::vector<size_t, KernelAlloc> inProgressPages{*kernelAlloc};
 
-		auto doCopyOnePage = [&] (size_t pg, smarter::borrowed_ptr<CowPage> page) {
+		auto doCopyOnePage = [&] (size_t pg, CowPage *page) {
 			// The page is locked. We *need* to keep it in the old address space.
 			if(page->lockCount /*|| disableCow */) {
 				// Allocate a new physical page for a copy.
@@ -1504,19 +1936,19 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 				memcpy(copyAccessor.get(), lockedAccessor.get(), kPageSize);
 
 				// Update the chains.
-				auto copyPage = smarter::allocate_shared<CowPage>(*kernelAlloc);
-				copyPage->state = CowState::hasCopy;
-				copyPage->physical = copyPhysical;
+				retainPage(copyPhysical);
 				auto copyIt = forked->_ownedPages.insert(pg >> kPageShift);
-				*copyIt = copyPage;
+				copyIt->state = CowState::hasCopy;
+				copyIt->physical = copyPhysical;
 			}else{
 				auto physical = page->physical;
 				assert(physical != PhysicalAddr(-1));
 
-				// Update the chains.
+				// Update the chains. The reference of the original mapping
+				// is transferred to the new chain.
 				auto pageOffset = self->_viewOffset + pg;
 				auto newIt = newChain->_pages.insert(pageOffset >> kPageShift);
-				*newIt = page.lock();
+				*newIt = physical;
 				self->_ownedPages.erase(pg >> kPageShift);
 			}
 		};
@@ -1529,7 +1961,8 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 			// To correct handle locks pages, we move only non-locked pages from
 			// the original mapping to the new chain.
 			auto curChain = self->_copyChain;
-			newChain = smarter::allocate_shared<CowChain>(*kernelAlloc);
+			newChain = smarter::allocate_shared<CowChain>(*kernelAlloc,
+					self->_viewOffset, self->_length);
 
 			// Update the original mapping
 			self->_copyChain = newChain;
@@ -1550,27 +1983,26 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 						auto chainLock = frg::guard(&curChain->_mutex);
 
 						if(auto it = curChain->_pages.find(pageOffset >> kPageShift); it) {
-							auto page = *it;
-							assert(page->state == CowState::hasCopy);
+							auto physical = *it;
+							retainPage(physical);
 							auto newIt = newChain->_pages.insert(pageOffset >> kPageShift);
-							*newIt = page;
+							*newIt = physical;
 						}
 					}
 					continue;
 				}
 
-				auto page = *it;
-				if(page->state == CowState::inProgress) {
+				if(it->state == CowState::inProgress) {
 					// We wait for the in progress pages later, as we
 					// need to drop the locks we're holding before
 					// suspending, but they are ensuring consistency
 					// of the object we're working on.
-					inProgressPages.push(frg::make_tuple(pg, page));
+					inProgressPages.push(pg);
 					continue;
 				}else
-					assert(page->state == CowState::hasCopy);
+					assert(it->state == CowState::hasCopy);
 
-				doCopyOnePage(pg, page);
+				doCopyOnePage(pg, it);
 			}
 		}
 
@@ -1581,8 +2013,10 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 				auto irqLock = frg::guard(&irqMutex());
 				auto lock = frg::guard(&self->_mutex);
 
-				for (auto [_, inProgressPage] : inProgressPages) {
-					if (inProgressPage->state == CowState::inProgress)
+				for (auto pg : inProgressPages) {
+					auto it = self->_ownedPages.find(pg >> kPageShift);
+					assert(it);
+					if (it->state == CowState::inProgress)
 						return true;
 				}
 
@@ -1596,13 +2030,16 @@ void CopyOnWriteMemory::fork(async::any_receiver<frg::tuple<Error, smarter::shar
 			auto lock = frg::guard(&self->_mutex);
 
 			// Copy all the previously in progress pages now that they're done copying.
-			for (auto [pg, page] : inProgressPages) {
-				assert(page->state == CowState::hasCopy);
-				doCopyOnePage(pg, page);
+			for (auto pg : inProgressPages) {
+				auto it = self->_ownedPages.find(pg >> kPageShift);
+				assert(it);
+				assert(it->state == CowState::hasCopy);
+				doCopyOnePage(pg, it);
 			}
 		}
 
 		co_await self->_evictQueue.evictRange(0, self->_length);
+		forked->observeView();
 		receiver.set_value({Error::success, std::move(forked)});
 	}(this, receiver));
 }
@@ -1623,10 +2060,11 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 		while(progress < size) {
 			auto offset = overallOffset + progress;
 
+			// Note that we cannot keep pointers to CowPages across suspension:
+			// the page can be moved to a CowChain by fork() while we are not looking.
 			smarter::shared_ptr<CowChain> chain;
 			smarter::shared_ptr<MemoryView> view;
 			uintptr_t viewOffset;
-			smarter::shared_ptr<CowPage> cowPage;
 			bool waitForCopy = false;
 			{
 				// If the page is present in our private chain, we just return it.
@@ -1635,15 +2073,14 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 
 				auto cowIt = self->_ownedPages.find(offset >> kPageShift);
 				if(cowIt) {
-					cowPage = *cowIt;
-					if(cowPage->state == CowState::hasCopy) {
-						assert(cowPage->physical != PhysicalAddr(-1));
+					if(cowIt->state == CowState::hasCopy) {
+						assert(cowIt->physical != PhysicalAddr(-1));
 
-						cowPage->lockCount++;
+						cowIt->lockCount++;
 						progress += kPageSize;
 						continue;
 					}else{
-						assert(cowPage->state == CowState::inProgress);
+						assert(cowIt->state == CowState::inProgress);
 						waitForCopy = true;
 					}
 				}else{
@@ -1652,10 +2089,8 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 					viewOffset = self->_viewOffset;
 
 					// Otherwise we need to copy from the chain or from the root view.
-					cowPage = smarter::allocate_shared<CowPage>(*kernelAlloc);
-					cowPage->state = CowState::inProgress;
 					cowIt = self->_ownedPages.insert(offset >> kPageShift);
-					*cowIt = cowPage;
+					cowIt->state = CowState::inProgress;
 				}
 			}
 
@@ -1663,59 +2098,57 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 				bool stillWaiting;
 				do {
 					stillWaiting = co_await self->_copyEvent.async_wait_if([&] () -> bool {
-						// TODO: this could be faster if cowPage->state was atomic.
+						// TODO: this could be faster if the state was atomic.
 						auto irqLock = frg::guard(&irqMutex());
 						auto lock = frg::guard(&self->_mutex);
 
-						if(cowPage->state == CowState::inProgress)
-							return true;
-						assert(cowPage->state == CowState::hasCopy);
-						return false;
+						auto cowIt = self->_ownedPages.find(offset >> kPageShift);
+						return cowIt && cowIt->state == CowState::inProgress;
 					});
 					co_await wq->schedule();
 				} while(stillWaiting);
 
-				{
-					auto irqLock = frg::guard(&irqMutex());
-					auto lock = frg::guard(&self->_mutex);
-
-					assert(cowPage->state == CowState::hasCopy);
-					cowPage->lockCount++;
-				}
-				progress += kPageSize;
+				// Retry; the page is either present now or it was moved to a chain.
 				continue;
 			}
 
-			PhysicalAddr physical = physicalAllocator->allocate(kPageSize);
-			assert(physical != PhysicalAddr(-1) && "OOM");
-			PageAccessor accessor{physical};
-
 			// Try to copy from a descendant CoW chain.
 			auto pageOffset = viewOffset + offset;
-			bool chainHasCopy = false;
+			PhysicalAddr physical = PhysicalAddr(-1);
 			if(chain) {
 				auto irqLock = frg::guard(&irqMutex());
 				auto lock = frg::guard(&chain->_mutex);
 
 				if(auto it = chain->_pages.find(pageOffset >> kPageShift); it) {
-					auto page = *it;
 					// We can just copy synchronously here -- the descendant is not evicted.
-					assert(page->state == CowState::hasCopy);
-					auto srcPhysical = page->physical;
+					auto srcPhysical = *it;
 					assert(srcPhysical != PhysicalAddr(-1));
+
+					physical = physicalAllocator->allocate(kPageSize);
+					assert(physical != PhysicalAddr(-1) && "OOM");
+					PageAccessor accessor{physical};
 					auto srcAccessor = PageAccessor{srcPhysical};
 					memcpy(accessor.get(), srcAccessor.get(), kPageSize);
-					chainHasCopy = true;
 				}
 			}
 
-			// Copy from the root view.
-			if(!chainHasCopy) {
-				// TODO: Handle errors here -- we need to drop the lock again.
-				auto copyOutcome = co_await view->copyFrom(pageOffset & ~(kPageSize - 1),
-						accessor.get(), kPageSize, wq);
-				assert(copyOutcome);
+			if(physical == PhysicalAddr(-1)) {
+				if(view->readsAsZero()) {
+					// There is nothing to copy; take a pre-zeroed page if possible.
+					physical = allocateZeroedPage();
+					assert(physical != PhysicalAddr(-1) && "OOM");
+				}else{
+					// Copy from the root view.
+					physical = physicalAllocator->allocate(kPageSize);
+					assert(physical != PhysicalAddr(-1) && "OOM");
+					PageAccessor accessor{physical};
+					// TODO: Handle errors here -- we need to drop the lock again.
+					auto copyOutcome = co_await view->copyFrom(pageOffset & ~(kPageSize - 1),
+							accessor.get(), kPageSize, wq);
+					assert(copyOutcome);
+				}
 			}
+			retainPage(physical);
 
 			// To make CoW unobservable, we first need to evict the page here.
 			// TODO: enable read-only eviction.
@@ -1725,10 +2158,12 @@ bool CopyOnWriteMemory::asyncLockRange(uintptr_t offset, size_t size,
 				auto irqLock = frg::guard(&irqMutex());
 				auto lock = frg::guard(&self->_mutex);
 
-				assert(cowPage->state == CowState::inProgress);
-				cowPage->state = CowState::hasCopy;
-				cowPage->physical = physical;
-				cowPage->lockCount++;
+				auto cowIt = self->_ownedPages.find(offset >> kPageShift);
+				assert(cowIt);
+				assert(cowIt->state == CowState::inProgress);
+				cowIt->state = CowState::hasCopy;
+				cowIt->physical = physical;
+				cowIt->lockCount++;
 			}
 			self->_copyEvent.raise();
 			progress += kPageSize;
@@ -1747,10 +2182,9 @@ void CopyOnWriteMemory::unlockRange(uintptr_t offset, size_t size) {
 	for(size_t pg = 0; pg < size; pg += kPageSize) {
 		auto it = _ownedPages.find((offset + pg) >> kPageShift);
 		assert(it);
-		auto page = *it;
-		assert(page->state == CowState::hasCopy);
-		assert(page->lockCount > 0);
-		page->lockCount--;
+		assert(it->state == CowState::hasCopy);
+		assert(it->lockCount > 0);
+		it->lockCount--;
 	}
 }
 
@@ -1758,98 +2192,130 @@ frg::tuple<PhysicalAddr, CachingMode> CopyOnWriteMemory::peekRange(uintptr_t off
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
 
-	if(auto it = _ownedPages.find(offset >> kPageShift); it) {
-		auto page = *it;
-		assert(page->state == CowState::hasCopy);
-		return frg::tuple<PhysicalAddr, CachingMode>{page->physical, CachingMode::null};
-	}
+	// Pages that are still being copied are not available yet.
+	if(auto it = _ownedPages.find(offset >> kPageShift); it && it->state == CowState::hasCopy)
+		return frg::tuple<PhysicalAddr, CachingMode>{it->physical, CachingMode::null};
 
 	return frg::tuple<PhysicalAddr, CachingMode>{PhysicalAddr(-1), CachingMode::null};
 }
 
+frg::tuple<PhysicalAddr, CachingMode, bool> CopyOnWriteMemory::peekSharedRange(uintptr_t offset) {
+	{
+		auto irq_lock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&_mutex);
+
+		if(auto it = _ownedPages.find(offset >> kPageShift); it) {
+			if(it->state != CowState::hasCopy)
+				return frg::make_tuple(PhysicalAddr(-1), CachingMode::null, false);
+			return frg::make_tuple(it->physical, CachingMode::null, false);
+		}
+
+		// Pages of the chain are never evicted. fork() replaces the chain but it
+		// retains all pages that we do not own and evicts our whole range afterwards.
+		if(_copyChain) {
+			auto chainLock = frg::guard(&_copyChain->_mutex);
+
+			if(auto it = _copyChain->_pages.find((_viewOffset + offset) >> kPageShift); it)
+				return frg::make_tuple(*it, CachingMode::null, true);
+		}
+	}
+
+	// Mappings hold their eviction mutex while they map the result. If we copy the page
+	// or if _view evicts it in the meantime, the mapping is thus unmapped afterwards.
+	// The view can shrink after we were created (e.g., if a file is truncated).
+	if(!_viewShareable || _viewOffset + offset >= _view->getLength())
+		return frg::make_tuple(PhysicalAddr(-1), CachingMode::null, false);
+	auto range = _view->peekRange(_viewOffset + offset);
+	return frg::make_tuple(range.get<0>(), range.get<1>(), true);
+}
+
 coroutine<frg::expected<Error, PhysicalRange>>
 CopyOnWriteMemory::fetchRange(uintptr_t offset, FetchFlags, smarter::shared_ptr<WorkQueue> wq) {
 	smarter::shared_ptr<CowChain> chain;
 	smarter::shared_ptr<MemoryView> view;
 	uintptr_t viewOffset;
-	smarter::shared_ptr<CowPage> cowPage;
-	bool waitForCopy = false;
-	{
-		// If the page is present in our private chain, we just return it.
-		auto irqLock = frg::guard(&irqMutex());
-		auto lock = frg::guard(&_mutex);
+	while(true) {
+		bool waitForCopy = false;
+		{
+			// If the page is present in our private chain, we just return it.
+			auto irqLock = frg::guard(&irqMutex());
+			auto lock = frg::guard(&_mutex);
 
-		auto cowIt = _ownedPages.find(offset >> kPageShift);
-		if(cowIt) {
-			cowPage = *cowIt;
-			if(cowPage->state == CowState::hasCopy) {
-				assert(cowPage->physical != PhysicalAddr(-1));
+			auto cowIt = _ownedPages.find(offset >> kPageShift);
+			if(cowIt) {
+				if(cowIt->state == CowState::hasCopy) {
+					assert(cowIt->physical != PhysicalAddr(-1));
 
-				co_return PhysicalRange{cowPage->physical, kPageSize, CachingMode::null};
+					co_return PhysicalRange{cowIt->physical, kPageSize, CachingMode::null};
+				}else{
+					assert(cowIt->state == CowState::inProgress);
+					waitForCopy = true;
+				}
 			}else{
-				assert(cowPage->state == CowState::inProgress);
-				waitForCopy = true;
+				chain = _copyChain;
+				view = _view;
+				viewOffset = _viewOffset;
+
+				// Otherwise we need to copy from the chain or from the root view.
+				cowIt = _ownedPages.insert(offset >> kPageShift);
+				cowIt->state = CowState::inProgress;
 			}
-		}else{
-			chain = _copyChain;
-			view = _view;
-			viewOffset = _viewOffset;
-
-			// Otherwise we need to copy from the chain or from the root view.
-			cowPage = smarter::allocate_shared<CowPage>(*kernelAlloc);
-			cowPage->state = CowState::inProgress;
-			cowIt = _ownedPages.insert(offset >> kPageShift);
-			*cowIt = cowPage;
 		}
-	}
 
-	if(waitForCopy) {
+		if(!waitForCopy)
+			break;
+
 		bool stillWaiting;
 		do {
 			stillWaiting = co_await _copyEvent.async_wait_if([&] () -> bool {
-				// TODO: this could be faster if cowIt->state was atomic.
+				// TODO: this could be faster if the state was atomic.
 				auto irqLock = frg::guard(&irqMutex());
 				auto lock = frg::guard(&_mutex);
 
-				if(cowPage->state == CowState::inProgress)
-					return true;
-				assert(cowPage->state == CowState::hasCopy);
-				return false;
+				auto cowIt = _ownedPages.find(offset >> kPageShift);
+				return cowIt && cowIt->state == CowState::inProgress;
 			});
 			co_await wq->schedule();
 		} while(stillWaiting);
 
-		co_return PhysicalRange{cowPage->physical, kPageSize, CachingMode::null};
+		// Retry; the page is either present now or it was moved to a chain by fork().
 	}
 
-	PhysicalAddr physical = physicalAllocator->allocate(kPageSize);
-	assert(physical != PhysicalAddr(-1) && "OOM");
-	PageAccessor accessor{physical};
-
 	// Try to copy from a descendant CoW chain.
 	auto pageOffset = viewOffset + offset;
-	bool chainHasCopy = false;
+	PhysicalAddr physical = PhysicalAddr(-1);
 	if(chain) {
 		auto irqLock = frg::guard(&irqMutex());
 		auto lock = frg::guard(&chain->_mutex);
 
 		if(auto it = chain->_pages.find(pageOffset >> kPageShift); it) {
-			auto page = *it;
 			// We can just copy synchronously here -- the descendant is not evicted.
-			assert(page->state == CowState::hasCopy);
-			auto srcPhysical = page->physical;
+			auto srcPhysical = *it;
 			assert(srcPhysical != PhysicalAddr(-1));
+
+			physical = physicalAllocator->allocate(kPageSize);
+			assert(physical != PhysicalAddr(-1) && "OOM");
+			PageAccessor accessor{physical};
 			auto srcAccessor = PageAccessor{srcPhysical};
 			memcpy(accessor.get(), srcAccessor.get(), kPageSize);
-			chainHasCopy = true;
 		}
 	}
 
-	// Copy from the root view.
-	if(!chainHasCopy) {
-		FRG_CO_TRY(co_await view->copyFrom(pageOffset & ~(kPageSize - 1),
-				accessor.get(), kPageSize, wq));
+	if(physical == PhysicalAddr(-1)) {
+		if(view->readsAsZero()) {
+			// There is nothing to copy; take a pre-zeroed page if possible.
+			physical = allocateZeroedPage();
+			assert(physical != PhysicalAddr(-1) && "OOM");
+		}else{
+			// Copy from the root view.
+			physical = physicalAllocator->allocate(kPageSize);
+			assert(physical != PhysicalAddr(-1) && "OOM");
+			PageAccessor accessor{physical};
+			FRG_CO_TRY(co_await view->copyFrom(pageOffset & ~(kPageSize - 1),
+					accessor.get(), kPageSize, wq));
+		}
 	}
+	retainPage(physical);
 
 	// To make CoW unobservable, we first need to evict the page here.
 	// TODO: enable read-only eviction.
@@ -1859,18 +2325,61 @@ CopyOnWriteMemory::fetchRange(uintptr_t offset, FetchFlags, smarter::shared_ptr<
 		auto irqLock = frg::guard(&irqMutex());
 		auto lock = frg::guard(&_mutex);
 
-		assert(cowPage->state == CowState::inProgress);
-		cowPage->state = CowState::hasCopy;
-		cowPage->physical = physical;
+		auto cowIt = _ownedPages.find(offset >> kPageShift);
+		assert(cowIt);
+		assert(cowIt->state == CowState::inProgress);
+		cowIt->state = CowState::hasCopy;
+		cowIt->physical = physical;
 	}
 	_copyEvent.raise();
-	co_return PhysicalRange{cowPage->physical, kPageSize, CachingMode::null};
+	co_return PhysicalRange{physical, kPageSize, CachingMode::null};
 }
 
 void CopyOnWriteMemory::markDirty(uintptr_t, size_t) {
 	// We do not need to track dirty pages.
 }
 
+void CopyOnWriteMemory::observeView() {
+	// There are no pages to share (and peekRange() must not be called).
+	if(_view->readsAsZero())
+		return;
+	_viewShareable = true;
+
+	if(!_view->canEvictMemory())
+		return;
+
+	// Attach the observer before any page of _view can be mapped.
+	_viewObservation = smarter::allocate_shared<ViewObservation>(*kernelAlloc);
+	_view->addObserver(&_viewObservation->observer);
+
+	// Only hold a weak reference, such that mappings keep this object alive but not vice versa.
+	smarter::weak_ptr<CopyOnWriteMemory> weakSelf{selfPtr.lock()};
+	async::detach_with_allocator(*kernelAlloc, [] (smarter::weak_ptr<CopyOnWriteMemory> weakSelf,
+			smarter::shared_ptr<MemoryView> view, uintptr_t viewOffset, size_t length,
+			smarter::shared_ptr<ViewObservation> observation) -> coroutine<void> {
+		while(true) {
+			auto eviction = co_await view->pollEviction(&observation->observer,
+					observation->cancelEviction);
+			if(!eviction)
+				break;
+			if(eviction.offset() + eviction.size() <= viewOffset
+					|| eviction.offset() >= viewOffset + length) {
+				eviction.done();
+				continue;
+			}
+
+			auto evictBegin = frg::max(eviction.offset(), viewOffset);
+			auto evictEnd = frg::min(eviction.offset() + eviction.size(), viewOffset + length);
+			if(auto self = weakSelf.lock(); self)
+				co_await self->_evictQueue.evictRange(evictBegin - viewOffset,
+						evictEnd - evictBegin);
+			eviction.done();
+		}
+
+		view->removeObserver(&observation->observer);
+	}(std::move(weakSelf), _view, _viewOffset, _length, _viewObservation));
+}
+
 coroutine<frg::expected<Error, PhysicalAddr>> CopyOnWriteMemory::takeGlobalFutex(uintptr_t offset,
 		smarter::shared_ptr<WorkQueue> wq) {
 	// For now, we pick the trival implementation here.
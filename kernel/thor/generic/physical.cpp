@@ -2,6 +2,7 @@
 #include <thor-internal/arch-generic/paging.hpp>
 #include <thor-internal/cpu-data.hpp>
 #include <thor-internal/debug.hpp>
+#include <thor-internal/kernel_heap.hpp>
 #include <thor-internal/physical.hpp>
 
 namespace thor {
@@ -50,6 +51,33 @@ void PhysicalChunkAllocator::bootstrapRegion(PhysicalAddr address,
 	_freePages.store(currentFree + (numRoots << order), std::memory_order_relaxed);
 }
 
+void PhysicalChunkAllocator::initializePageFrames() {
+	size_t totalSize = 0;
+	for(int i = 0; i < _numRegions; i++) {
+		auto &region = _allRegions[i];
+		size_t size = (region.regionSize >> kPageShift) * sizeof(PageFrame);
+		size = (size + kPageSize - 1) & ~(kPageSize - 1);
+
+		// The array is carved out of the region's own pages (or those of earlier regions);
+		// it does not need to be physically contiguous.
+		auto pointer = KernelVirtualMemory::global().allocate(size);
+		for(size_t offset = 0; offset < size; offset += kPageSize) {
+			auto physical = allocate(kPageSize);
+			assert(physical != static_cast<PhysicalAddr>(-1) && "OOM");
+			KernelPageSpace::global().mapSingle4k(VirtualAddr(pointer) + offset, physical,
+					page_access::write, CachingMode::null);
+		}
+
+		region.pageFrames = static_cast<PageFrame *>(pointer);
+		for(size_t j = 0; j < (region.regionSize >> kPageShift); j++)
+			new (&region.pageFrames[j]) PageFrame{};
+		totalSize += size;
+	}
+
+	infoLogger() << "thor: Page frame database uses " << (totalSize / 1024)
+			<< " KiB" << frg::endlog;
+}
+
 PhysicalAddr PhysicalChunkAllocator::allocate(size_t size, int addressBits) {
 	auto irq_lock = frg::guard(&irqMutex());
 	auto lock = frg::guard(&_mutex);
@@ -13,7 +13,11 @@ namespace thor {
 bool wantKernelProfile = false;
 
 namespace {
+	constexpr size_t globalProfileRingSize = 4 << 20;
+
 	frg::manual_box<LogRingBuffer> globalProfileRing;
+	// Set once the global ring is available and hardware support was detected.
+	bool profilingEnabled = false;
 
 	initgraph::Task initProfilingSinks{&globalInitEngine, "generic.init-profiling-sinks",
 		initgraph::Requires{getFibersAvailableStage(),
@@ -44,40 +48,54 @@ void initializeProfile() {
 		return;
 	}
 
-	void *profileMemory = kernelAlloc->allocate(1 << 20);
-	globalProfileRing.initialize(reinterpret_cast<uintptr_t>(profileMemory), 1 << 20);
+	void *profileMemory = kernelAlloc->allocate(globalProfileRingSize);
+	globalProfileRing.initialize(reinterpret_cast<uintptr_t>(profileMemory),
+			globalProfileRingSize);
+	profilingEnabled = true;
 
-	// Dump the per-CPU profiling data to the global ring buffer.
-	// TODO: Start one such fiber per CPU.
-	KernelFiber::run([=] {
-		getCpuData()->localProfileRing = frg::construct<SingleContextRecordRing>(*kernelAlloc);
-
-		if(getGlobalCpuFeatures()->profileFlags & CpuFeatures::profileIntelSupported) {
-			initializeIntelPmc();
-			getCpuData()->profileMechanism.store(ProfileMechanism::intelPmc,
-					std::memory_order_release);
-			setIntelPmc();
-		}else{
-			assert(getGlobalCpuFeatures()->profileFlags & CpuFeatures::profileAmdSupported);
-			getCpuData()->profileMechanism.store(ProfileMechanism::amdPmc,
-					std::memory_order_release);
-			setAmdPmc();
-		}
+	// The boot CPU is already up; other CPUs call this during their initialization.
+	initializeProfileForThisCpu();
+#endif
+}
+
+void initializeProfileForThisCpu() {
+#ifdef __x86_64__
+	if(!profilingEnabled)
+		return;
+
+	auto cpuData = getCpuData();
+	cpuData->localProfileRing = frg::construct<SingleContextRecordRing>(*kernelAlloc);
 
+	if(getGlobalCpuFeatures()->profileFlags & CpuFeatures::profileIntelSupported) {
+		initializeIntelPmc();
+		cpuData->profileMechanism.store(ProfileMechanism::intelPmc,
+				std::memory_order_release);
+		setIntelPmc();
+	}else{
+		assert(getGlobalCpuFeatures()->profileFlags & CpuFeatures::profileAmdSupported);
+		cpuData->profileMechanism.store(ProfileMechanism::amdPmc,
+				std::memory_order_release);
+		setAmdPmc();
+	}
+
+	// Dump this CPU's profiling data to the global ring buffer.
+	// Note that we capture the CpuData explicitly: the fiber may
+	// run on a different CPU than the one that produces the samples.
+	KernelFiber::run([=] {
 		uint64_t deqPtr = 0;
 		while(true) {
-			char buffer[128];
-			auto [success, recordPtr, newPtr, size] = getCpuData()->localProfileRing->dequeueAt(
-					deqPtr, buffer, 128);
+			ProfileSample sample;
+			auto [success, recordPtr, newPtr, size] = cpuData->localProfileRing->dequeueAt(
+					deqPtr, &sample, sizeof(ProfileSample));
 			deqPtr = newPtr;
 			if(!success) {
 				KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(1'000'000));
 				continue;
 			}
 			assert(size);
-			assert(size < 128);
+			assert(size <= sizeof(ProfileSample));
 
-			globalProfileRing->enqueue(buffer, size);
+			globalProfileRing->enqueue(&sample, size);
 		}
 	});
 #endif
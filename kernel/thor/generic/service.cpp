@@ -656,6 +656,7 @@ namespace posix {
 					auto cowMemory = smarter::allocate_shared<CopyOnWriteMemory>(*kernelAlloc,
 							std::move(fileMemory), req->rel_offset(), req->size());
 					cowMemory->selfPtr = cowMemory;
+					cowMemory->observeView();
 					slice = smarter::allocate_shared<MemorySlice>(*kernelAlloc,
 							std::move(cowMemory), 0, req->size());
 				}else{
@@ -716,6 +717,7 @@ namespace posix {
 				auto cowMemory = smarter::allocate_shared<CopyOnWriteMemory>(*kernelAlloc,
 						std::move(fileMemory), 0, size);
 				cowMemory->selfPtr = cowMemory;
+				cowMemory->observeView();
 				auto slice = smarter::allocate_shared<MemorySlice>(*kernelAlloc,
 						std::move(cowMemory), 0, size);
 
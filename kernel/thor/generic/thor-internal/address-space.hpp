@@ -36,6 +36,42 @@ frg::expected<Error> mapPresentPagesByCursor(PageSpace *ps, VirtualAddr va,
 	return {};
 }
 
+// Like mapPresentPagesByCursor() but skips pages that are already mapped.
+// Also maps pages that the view shares with other views (see peekSharedRange());
+// those are mapped read-only. Returns the number of pages that were mapped.
+template<typename Cursor, typename PageSpace>
+frg::expected<Error, size_t> mapMissingPagesByCursor(PageSpace *ps, VirtualAddr va,
+		MemoryView *view, uintptr_t offset, size_t size, PageFlags flags) {
+	assert(!(va & (kPageSize - 1)));
+	assert(!(offset & (kPageSize - 1)));
+	assert(!(size & (kPageSize - 1)));
+
+	size_t count = 0;
+	Cursor c{ps, va};
+	while(c.virtualAddress() < va + size) {
+		auto progress = c.virtualAddress() - va;
+		if(c.isPresent()) {
+			c.advance4k();
+			continue;
+		}
+
+		auto physicalRange = view->peekSharedRange(offset + progress);
+		if(physicalRange.template get<0>() == PhysicalAddr(-1)) {
+			c.advance4k();
+			continue;
+		}
+		assert(!(physicalRange.template get<0>() & (kPageSize - 1)));
+
+		auto pageFlags = flags;
+		if(physicalRange.template get<2>())
+			pageFlags &= ~page_access::write;
+		c.map4k(physicalRange.template get<0>(), pageFlags, physicalRange.template get<1>());
+		c.advance4k();
+		count++;
+	}
+	return count;
+}
+
 template<typename Cursor, typename PageSpace>
 frg::expected<Error> remapPresentPagesByCursor(PageSpace *ps, VirtualAddr va,
 		MemoryView *view, uintptr_t offset, size_t size, PageFlags flags) {
@@ -174,6 +210,11 @@ struct VirtualOperations {
 	virtual frg::expected<Error> remapPresentPages(VirtualAddr va, MemoryView *view,
 			uintptr_t offset, size_t size, PageFlags flags);
 
+	// Maps the pages that are present in the view but not yet mapped.
+	// Returns the number of pages that were mapped.
+	virtual frg::expected<Error, size_t> mapMissingPages(VirtualAddr va, MemoryView *view,
+			uintptr_t offset, size_t size, PageFlags flags);
+
 	virtual frg::expected<Error> faultPage(VirtualAddr va, MemoryView *view,
 			uintptr_t offset, PageFlags flags);
 
@@ -488,6 +529,16 @@ using MappingTree = frg::rbtree<
 	MappingLess
 >;
 
+struct FaultStatistics {
+	// Faults on pages that were already present in the memory view.
+	uint64_t minorFaults = 0;
+	// Faults on pages that the memory view had to fetch first
+	// (by allocating, copying or reading them in).
+	uint64_t majorFaults = 0;
+	// Pages that were mapped ahead of time, by fault-around or kMapPopulate.
+	uint64_t prefaultedPages = 0;
+};
+
 struct VirtualSpace {
 	friend struct Mapping;
 
@@ -518,9 +569,15 @@ public:
 
 	void setupInitialHole(VirtualAddr address, size_t size);
 
+	// kMapPopulate requires a WorkQueue to fetch the pages.
 	coroutine<frg::expected<Error, VirtualAddr>>
 	map(smarter::borrowed_ptr<MemorySlice> view,
-			VirtualAddr address, size_t offset, size_t length, uint32_t flags);
+			VirtualAddr address, size_t offset, size_t length, uint32_t flags,
+			smarter::shared_ptr<WorkQueue> wq = nullptr);
+
+	// Fetches and maps all pages in the given range.
+	coroutine<frg::expected<Error>>
+	populate(VirtualAddr address, size_t length, smarter::shared_ptr<WorkQueue> wq);
 
 	coroutine<frg::expected<Error>>
 	protect(VirtualAddr address, size_t length, uint32_t flags);
@@ -541,6 +598,14 @@ public:
 		return _ops->getRss();
 	}
 
+	FaultStatistics faultStatistics() {
+		FaultStatistics stats;
+		stats.minorFaults = _minorFaults.load(std::memory_order_relaxed);
+		stats.majorFaults = _majorFaults.load(std::memory_order_relaxed);
+		stats.prefaultedPages = _prefaultedPages.load(std::memory_order_relaxed);
+		return stats;
+	}
+
 	// ----------------------------------------------------------------------------------
 	// Read/write support.
 	// ----------------------------------------------------------------------------------
@@ -662,6 +727,10 @@ private:
 
 	HoleTree _holes;
 	MappingTree _mappings;
+
+	std::atomic<uint64_t> _minorFaults{0};
+	std::atomic<uint64_t> _majorFaults{0};
+	std::atomic<uint64_t> _prefaultedPages{0};
 };
 
 struct AddressSpace final : VirtualSpace, smarter::crtp_counter<AddressSpace, BindableHandle> {
@@ -694,6 +763,12 @@ struct AddressSpace final : VirtualSpace, smarter::crtp_counter<AddressSpace, Bi
 					va, view, offset, size, flags);
 		}
 
+		frg::expected<Error, size_t> mapMissingPages(VirtualAddr va, MemoryView *view,
+				uintptr_t offset, size_t size, PageFlags flags) override {
+			return mapMissingPagesByCursor<ClientPageSpace::Cursor>(&space_->pageSpace_,
+					va, view, offset, size, flags);
+		}
+
 		frg::expected<Error> faultPage(VirtualAddr va, MemoryView *view,
 				uintptr_t offset, PageFlags flags) override {
 			return faultPageByCursor<ClientPageSpace::Cursor>(&space_->pageSpace_,
@@ -110,6 +110,12 @@ public:
 		return false;
 	}
 
+	bool isPresent() {
+		if(!accessors_[lastLevel])
+			return false;
+		return Policy::ptePagePresent(readCurrentPte_());
+	}
+
 	bool findDirty(uintptr_t limit) {
 		while(va_ < limit) {
 			if(!accessors_[lastLevel]) {
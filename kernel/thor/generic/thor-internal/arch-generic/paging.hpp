@@ -16,6 +16,7 @@ concept ValidCursor = requires (T t, uintptr_t va, PhysicalAddr pa,
 	{ t.moveTo(va) } -> std::same_as<void>;
 	{ t.advance4k() } -> std::same_as<void>;
 	{ t.findPresent(va) } -> std::same_as<bool>;
+	{ t.isPresent() } -> std::same_as<bool>;
 	{ t.findDirty(va) } -> std::same_as<bool>;
 	{ t.map4k(pa, flags, mode) } -> std::same_as<void>;
 	{ t.remap4k(pa, flags, mode) } -> std::same_as<PageStatus>;
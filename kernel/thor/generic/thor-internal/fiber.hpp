@@ -138,6 +138,10 @@ public:
 		return _associatedWorkQueue.get();
 	}
 
+	FiberContext &getContext() {
+		return _fiberContext;
+	}
+
 private:
 	frg::ticket_spinlock _mutex;
 	bool _blocked;
@@ -18,10 +18,11 @@ struct UniqueKernelStack {
 	friend void swap(UniqueKernelStack &a, UniqueKernelStack &b) {
 		using std::swap;
 		swap(a._base, b._base);
+		swap(a._limit, b._limit);
 	}
 
 	UniqueKernelStack()
-	: _base(nullptr) { }
+	: _base(nullptr), _limit(nullptr) { }
 
 	UniqueKernelStack(const UniqueKernelStack &other) = delete;
 
@@ -43,6 +44,10 @@ struct UniqueKernelStack {
 	void *basePtr() {
 		return _base;
 	}
+	// Lowest address of the stack (the stack grows down from basePtr() towards it).
+	void *limitPtr() {
+		return _limit;
+	}
 
 	template<typename T, typename... Args>
 	T *embed(Args &&... args) {
@@ -52,15 +57,16 @@ struct UniqueKernelStack {
 	}
 
 	bool contains(void *sp) {
-		return uintptr_t(sp) >= uintptr_t(_base) + kSize
+		return uintptr_t(sp) >= uintptr_t(_limit)
 				&& uintptr_t(sp) <= uintptr_t(_base);
 	}
 
 private:
 	explicit UniqueKernelStack(char *base)
-	: _base(base) { }
+	: _base(base), _limit(base - kSize) { }
 
 	char *_base;
+	char *_limit;
 };
 
 } // namespace thor
@@ -73,16 +73,47 @@ public:
 	void output_trace(void *buffer, size_t size);
 };
 
-using KernelAlloc = frg::slab_allocator<KernelVirtualAlloc, IrqSpinlock>;
+using KernelHeapPool = frg::slab_pool<KernelVirtualAlloc, IrqSpinlock>;
+
+// Number of size classes (16, 32, ..., 512 bytes) that are served from per-CPU caches.
+inline constexpr size_t numKernelHeapClasses = 6;
+
+// The kernel's general purpose allocator. Objects of up to 512 bytes are taken from
+// per-CPU magazines (see kernel-heap.cpp) that are backed by slabs in the direct
+// physical mapping; only larger objects go to kernelHeap, which takes a global lock.
+// Copies of this class are cheap handles to the same heap.
+struct KernelAlloc {
+	constexpr KernelAlloc(KernelHeapPool *pool)
+	: pool_{pool} { }
+
+	void *allocate(size_t size);
+	void deallocate(void *pointer, size_t size);
+	void free(void *pointer);
+
+private:
+	KernelHeapPool *pool_;
+};
+
+struct KernelHeapStatistics {
+	size_t objectSize;
+	uint64_t allocations;
+	uint64_t frees;
+	// Number of allocations and frees that did not leave the CPU's magazines.
+	uint64_t cpuHits;
+	// Number of magazines that were exchanged with the depot.
+	uint64_t depotExchanges;
+	size_t slabPages;
+};
+
+// Sums up the per-CPU counters of the given size class.
+// The result is only approximate as other CPUs can update their counters concurrently.
+KernelHeapStatistics getKernelHeapStatistics(size_t sizeClass);
+
+void logKernelHeapStatistics();
 
 extern constinit frg::manual_box<KernelVirtualAlloc> kernelVirtualAlloc;
 
-extern constinit frg::manual_box<
-	frg::slab_pool<
-		KernelVirtualAlloc,
-		IrqSpinlock
-	>
-> kernelHeap;
+extern constinit frg::manual_box<KernelHeapPool> kernelHeap;
 
 extern constinit frg::manual_box<KernelAlloc> kernelAlloc;
 
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <cstddef>
 
 #include <async/algorithm.hpp>
@@ -12,6 +13,7 @@
 #include <thor-internal/arch-generic/paging.hpp>
 #include <thor-internal/error.hpp>
 #include <thor-internal/futex.hpp>
+#include <thor-internal/physical.hpp>
 #include <thor-internal/types.hpp>
 #include <thor-internal/kernel-locks.hpp>
 
@@ -66,6 +68,9 @@ private:
 		>
 	> _reclaimList;
 
+	// Mirrors !_reclaimList.empty() such that awaitReclaim() can check it without locking.
+	std::atomic<bool> _reclaimPending{false};
+
 	async::recurring_event _reclaimEvent;
 };
 
@@ -303,6 +308,11 @@ public:
 	// Result stays valid until the range is evicted.
 	virtual frg::tuple<PhysicalAddr, CachingMode> peekRange(uintptr_t offset) = 0;
 
+	// Like peekRange() but may also return pages that this view shares with other views
+	// (e.g., pages that copy-on-write memory did not copy yet). For such pages, the third
+	// element is true: they must only be mapped read-only; writes need fetchRange().
+	virtual frg::tuple<PhysicalAddr, CachingMode, bool> peekSharedRange(uintptr_t offset);
+
 	// Makes a range of memory available for peekRange().
 	virtual coroutine<frg::expected<Error>>
 	touchRange(uintptr_t offset, size_t size, FetchFlags flags, smarter::shared_ptr<WorkQueue> wq);
@@ -316,6 +326,20 @@ public:
 	// Marks a range of pages as dirty.
 	virtual void markDirty(uintptr_t offset, size_t size) = 0;
 
+	// Permanently keeps a range of pages present (and at the same physical address).
+	// This is required before physical addresses are handed out to code that does not
+	// observe evictions (e.g., user space via helPointerPhysical()).
+	virtual void pinRange(uintptr_t offset, size_t size) {
+		(void)offset;
+		(void)size;
+	}
+
+	// Returns true if all pages of this view always read as zero.
+	// Copy-on-write can then use zeroed pages instead of copying.
+	virtual bool readsAsZero() {
+		return false;
+	}
+
 	virtual void submitManage(ManageNode *handle);
 
 	// Called (e.g. by user space) to update a range after loading or writeback.
@@ -324,6 +348,10 @@ public:
 	virtual Error setIndirection(size_t slot, smarter::shared_ptr<MemoryView> view,
 			uintptr_t offset, size_t size);
 
+	// Discards the contents of a range of pages; afterwards, the range reads as zero.
+	// Views that own their pages release them.
+	virtual coroutine<frg::expected<Error>> discardRange(uintptr_t offset, size_t size);
+
 	// ----------------------------------------------------------------------------------
 	// Memory eviction.
 	// ----------------------------------------------------------------------------------
@@ -523,6 +551,12 @@ public:
 		return {this};
 	}
 
+	friend async::sender_awaiter<ForkSender,
+			frg::tuple<Error, smarter::shared_ptr<MemoryView>>>
+	operator co_await(ForkSender sender) {
+		return {sender};
+	}
+
 	template<typename R>
 	struct ForkOperation {
 		ForkOperation(ForkSender s, R receiver)
@@ -790,6 +824,89 @@ private:
 	CachingMode _cacheMode;
 };
 
+// Backend of AllocatedMemory objects whose pages can be evicted. Evicted pages are
+// compressed into a dedicated pool of physical pages (see compressPage())
+// and decompressed on the next access.
+// Note that this only covers memory that is allocated by helAllocateMemory() (e.g., tmpfs
+// files and driver buffers). Pages that are owned by a CopyOnWriteMemory (i.e., private
+// and anonymous mappings, including heaps and stacks of servers) are not reclaimed.
+// It is reference counted separately from the AllocatedMemory, such that the coroutine
+// that evicts pages can keep it alive while the AllocatedMemory is destructed.
+struct AnonymousSpace final : CacheBundle {
+	enum LoadState {
+		// The page was never accessed; it reads as zero.
+		kStateMissing,
+		kStatePresent,
+		kStateEvicting,
+		kStateCompressed,
+		// The page is unmapped before it is released by discardPages().
+		kStateDiscarding
+	};
+
+	struct AnonymousPage {
+		AnonymousPage(AnonymousSpace *bundle, uint64_t identity) {
+			cachePage.bundle = bundle;
+			cachePage.identity = identity;
+		}
+
+		AnonymousPage(const AnonymousPage &) = delete;
+
+		AnonymousPage &operator= (const AnonymousPage &) = delete;
+
+		PhysicalAddr physical = PhysicalAddr(-1);
+		LoadState loadState = kStateMissing;
+		unsigned int lockCount = 0;
+		// Set if the page did not compress well (or the compressed page pool was full).
+		// It stays present and is only registered for reclaim again once it is accessed.
+		bool incompressible = false;
+		CompressedPage compressed;
+		CachePage cachePage;
+	};
+
+	AnonymousSpace(size_t numPages);
+	AnonymousSpace(const AnonymousSpace &) = delete;
+	~AnonymousSpace();
+
+	AnonymousSpace &operator= (const AnonymousSpace &) = delete;
+
+	// Starts the coroutine that evicts pages. Requires selfPtr to be set.
+	void runReclaim();
+	// Stops the coroutine. Called when the AllocatedMemory is destructed.
+	void cancelReclaim();
+
+	size_t getLength();
+	void resize(size_t numPages);
+
+	// Note: Neither offset nor size are necessarily multiples of the page size.
+	void lockPages(uintptr_t offset, size_t size);
+	void unlockPages(uintptr_t offset, size_t size);
+	void pinPages(uintptr_t offset, size_t size);
+
+	PhysicalAddr peekPage(uintptr_t offset);
+	// Makes a page present (decompressing it if necessary) and marks it as recently used.
+	PhysicalAddr fetchPage(uintptr_t offset);
+
+	// Releases the pages of a range such that they read as zero again.
+	// Locked pages (and pages that are accessed concurrently) are zeroed instead.
+	coroutine<void> discardPages(uintptr_t offset, size_t size);
+
+	smarter::borrowed_ptr<AnonymousSpace> selfPtr;
+
+	EvictionQueue evictQueue;
+
+private:
+	AnonymousPage *_getPage(size_t index);
+	AnonymousPage *_touchPage(size_t index);
+
+	frg::ticket_spinlock _mutex;
+
+	frg::vector<AnonymousPage *, KernelAlloc> _pages;
+
+	// Set by cancelReclaim(), protected by _mutex.
+	bool _reclaimCancelled = false;
+	async::cancellation_event _cancelReclaim;
+};
+
 struct AllocatedMemory final : MemoryView, GlobalFutexSpace {
 	AllocatedMemory(size_t length, int addressBits = 64,
 			size_t chunkSize = kPageSize, size_t chunkAlign = kPageSize);
@@ -809,6 +926,8 @@ struct AllocatedMemory final : MemoryView, GlobalFutexSpace {
 			fetchRange(uintptr_t offset, FetchFlags flags,
 			smarter::shared_ptr<WorkQueue> wq) override;
 	void markDirty(uintptr_t offset, size_t size) override;
+	void pinRange(uintptr_t offset, size_t size) override;
+	coroutine<frg::expected<Error>> discardRange(uintptr_t offset, size_t size) override;
 
 	coroutine<frg::expected<Error, PhysicalAddr>> takeGlobalFutex(uintptr_t offset,
 			smarter::shared_ptr<WorkQueue> wq) override;
@@ -818,11 +937,18 @@ public:
 	// Contract: set by the code that constructs this object.
 	smarter::borrowed_ptr<AllocatedMemory> selfPtr;
 private:
+	AllocatedMemory(size_t length, int addressBits, size_t chunkSize, size_t chunkAlign,
+			smarter::shared_ptr<AnonymousSpace> swap);
+
 	frg::ticket_spinlock _mutex;
 
 	frg::vector<PhysicalAddr, KernelAlloc> _physicalChunks;
 	int _addressBits;
 	size_t _chunkSize, _chunkAlign;
+
+	// Holds the pages instead of _physicalChunks if they can be evicted.
+	// This is the case for memory with 4 KiB chunks and without address restrictions.
+	smarter::shared_ptr<AnonymousSpace> _swap;
 };
 
 struct ManagedSpace : CacheBundle {
@@ -1030,23 +1156,28 @@ enum class CowState {
 	hasCopy
 };
 
+// CowPages are stored inline in the radix tree of their CopyOnWriteMemory.
+// A physical page can be shared between a CopyOnWriteMemory and CowChains (or between
+// multiple CowChains); it is reference counted through its PageFrame.
 struct CowPage {
-	~CowPage();
-
 	PhysicalAddr physical = -1;
 	CowState state = CowState::null;
 	unsigned int lockCount = 0;
 };
 
 struct CowChain {
-	CowChain();
+	// The chain contains pages in the range [offset, offset + length) of the root view.
+	CowChain(uintptr_t offset, size_t length);
 
 	~CowChain();
 
 // TODO: Either this private again or make this class POD-like.
 	frg::ticket_spinlock _mutex;
 
-	frg::rcu_radixtree<smarter::shared_ptr<CowPage>, KernelAlloc> _pages;
+	uintptr_t _offset;
+	size_t _length;
+	// Each page holds a reference (see retainPage()).
+	frg::rcu_radixtree<PhysicalAddr, KernelAlloc> _pages;
 };
 
 struct CopyOnWriteMemory final : MemoryView, GlobalFutexSpace /*, MemoryObserver */ {
@@ -1069,6 +1200,7 @@ public:
 			smarter::shared_ptr<WorkQueue> wq, LockRangeNode *node) override;
 	void unlockRange(uintptr_t offset, size_t size) override;
 	frg::tuple<PhysicalAddr, CachingMode> peekRange(uintptr_t offset) override;
+	frg::tuple<PhysicalAddr, CachingMode, bool> peekSharedRange(uintptr_t offset) override;
 	coroutine<frg::expected<Error, PhysicalRange>>
 			fetchRange(uintptr_t offset, FetchFlags flags,
 			smarter::shared_ptr<WorkQueue> wq) override;
@@ -1078,19 +1210,36 @@ public:
 			smarter::shared_ptr<WorkQueue> wq) override;
 	void retireGlobalFutex(uintptr_t offset) override;
 
+	// Starts to forward evictions of the underlying view to our observers.
+	// Until this is called, peekSharedRange() only returns pages of the CowChain,
+	// as pages of the underlying view may be evicted behind our back.
+	// Contract: called by the code that constructs this object (after setting selfPtr).
+	void observeView();
+
 public:
 	// Contract: set by the code that constructs this object.
 	smarter::borrowed_ptr<CopyOnWriteMemory> selfPtr;
 private:
+	// Shared with the coroutine that observes the underlying view,
+	// such that it can outlive this object.
+	struct ViewObservation {
+		MemoryObserver observer;
+		async::cancellation_event cancelEviction;
+	};
+
 	frg::ticket_spinlock _mutex;
 
 	smarter::shared_ptr<MemoryView> _view;
 	uintptr_t _viewOffset;
 	size_t _length;
 	smarter::shared_ptr<CowChain> _copyChain;
-	frg::rcu_radixtree<smarter::shared_ptr<CowPage>, KernelAlloc> _ownedPages;
+	// Pages in state hasCopy hold a reference (see retainPage()).
+	frg::rcu_radixtree<CowPage, KernelAlloc> _ownedPages;
 	async::recurring_event _copyEvent;
 	EvictionQueue _evictQueue;
+	// Whether peekSharedRange() can return pages of _view (see observeView()).
+	bool _viewShareable = false;
+	smarter::shared_ptr<ViewObservation> _viewObservation;
 };
 
 // --------------------------------------------------------------------------------------
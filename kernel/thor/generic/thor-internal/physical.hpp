@@ -12,6 +12,8 @@
 
 namespace thor {
 
+struct CpuData;
+
 extern ManagarmElfNote<MemoryLayout> memoryLayoutNote;
 
 inline uintptr_t directPhysicalOffset() {
@@ -114,6 +116,20 @@ void poisonPhysicalAccess(PhysicalAddr physical);
 void poisonPhysicalWriteAccess(PhysicalAddr physical);
 
 
+// Metadata of a physical page. The PhysicalChunkAllocator keeps a contiguous array
+// of PageFrames (indexed by page frame number) for each memory region; this allows
+// memory objects to share pages without allocating per-page bookkeeping on the heap.
+struct PageFrame {
+	// Number of references to the page. Only pages that are shared through
+	// retainPage() and releasePage() are counted; all other pages keep zero.
+	std::atomic<uint32_t> refCount{0};
+	// Combination of the pageFrame* flags below.
+	std::atomic<uint32_t> flags{0};
+};
+
+// The page is owned by copy-on-write memory (i.e., by CopyOnWriteMemory and CowChains).
+inline constexpr uint32_t pageFrameCow = 1;
+
 class PhysicalChunkAllocator {
 	typedef frg::ticket_spinlock Mutex;
 public:
@@ -122,6 +138,22 @@ public:
 	void bootstrapRegion(PhysicalAddr address,
 			int order, size_t numRoots, int8_t *buddyTree);
 
+	// Allocates the PageFrame arrays of all regions.
+	// Must be called after all regions are bootstrapped.
+	void initializePageFrames();
+
+	// Returns the PageFrame of a page that was allocated by this allocator.
+	PageFrame *pageFrame(PhysicalAddr physical) {
+		for(int i = 0; i < _numRegions; i++) {
+			auto &region = _allRegions[i];
+			if(physical - region.physicalBase >= region.regionSize)
+				continue;
+			return &region.pageFrames[(physical - region.physicalBase) >> kPageShift];
+		}
+		assert(!"Physical page is not part of any region");
+		__builtin_unreachable();
+	}
+
 	PhysicalAddr allocate(size_t size, int addressBits = 64);
 	void free(PhysicalAddr address, size_t size);
 
@@ -142,6 +174,7 @@ private:
 		PhysicalAddr physicalBase;
 		PhysicalAddr regionSize;
 		BuddyAccessor buddyAccessor;
+		PageFrame *pageFrames;
 	};
 
 	Region _allRegions[8];
@@ -154,4 +187,82 @@ private:
 
 extern constinit frg::manual_box<PhysicalChunkAllocator> physicalAllocator;
 
+// Adds a reference to a page. Freshly allocated pages start without references;
+// the first call to retainPage() marks the page as owned by copy-on-write memory.
+inline void retainPage(PhysicalAddr physical) {
+	auto frame = physicalAllocator->pageFrame(physical);
+	if(!frame->refCount.fetch_add(1, std::memory_order_relaxed))
+		frame->flags.fetch_or(pageFrameCow, std::memory_order_relaxed);
+}
+
+// Drops a reference to a page and frees the page when the last reference is gone.
+inline void releasePage(PhysicalAddr physical) {
+	auto frame = physicalAllocator->pageFrame(physical);
+	assert(frame->flags.load(std::memory_order_relaxed) & pageFrameCow);
+	auto count = frame->refCount.fetch_sub(1, std::memory_order_acq_rel);
+	assert(count);
+	if(count > 1)
+		return;
+	frame->flags.store(0, std::memory_order_relaxed);
+	physicalAllocator->free(physical, kPageSize);
+}
+
+// Pool of pre-zeroed pages. Each CPU runs a low priority fiber that refills the pool
+// while the CPU is otherwise idle, such that the page fault paths of anonymous memory
+// do not have to zero pages synchronously.
+
+struct ZeroedPageStatistics {
+	// Allocations that were served from the pool.
+	uint64_t hits;
+	// Allocations that found the pool empty and zeroed the page synchronously.
+	uint64_t misses;
+	// Pages that are currently in the pool.
+	size_t pooledPages;
+};
+
+// Allocates a single zero-filled page; returns PhysicalAddr(-1) on OOM.
+PhysicalAddr allocateZeroedPage();
+
+// Starts the fiber that refills the pool on the given CPU.
+void runZeroingFiber(CpuData *cpu);
+
+ZeroedPageStatistics getZeroedPageStatistics();
+
+// Compressed storage for evicted anonymous pages (see AnonymousSpace).
+
+struct CompressedPage {
+	// Page of the compressed page pool that holds the data and the slot within that page;
+	// PhysicalAddr(-1) for pages that only contain zeros.
+	PhysicalAddr poolPage = PhysicalAddr(-1);
+	uint16_t slot = 0;
+	uint16_t size = 0;
+};
+
+struct CompressedPageStatistics {
+	// Pages that are currently stored (excluding zero pages) and their compressed size.
+	uint64_t storedPages;
+	uint64_t storedBytes;
+	// Memory that is used by the pool that holds the compressed data.
+	uint64_t poolBytes;
+	// Pages that are currently stored and only contain zeros.
+	uint64_t zeroPages;
+	// Pages that did not compress well enough (or did not fit into the pool)
+	// and were kept in memory.
+	uint64_t rejectedPages;
+	// Pages that were decompressed on access.
+	uint64_t decompressions;
+};
+
+// Compresses a page into compressed. Returns false if the page is not worth compressing
+// or if the pool of compressed pages is full.
+bool compressPage(PhysicalAddr physical, CompressedPage &compressed);
+
+// Restores the contents of a page; the CompressedPage stays valid.
+void decompressPage(const CompressedPage &compressed, PhysicalAddr physical);
+
+// Frees the storage of a page.
+void discardCompressedPage(CompressedPage &compressed);
+
+CompressedPageStatistics getCompressedPageStatistics();
+
 } // namespace thor
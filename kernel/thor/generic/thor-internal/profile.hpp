@@ -1,12 +1,48 @@
 #pragma once
 
+#include <stdint.h>
+
 #include <thor-internal/ring-buffer.hpp>
 
 namespace thor {
 
 extern bool wantKernelProfile;
 
+// Layout of the records in the kernel-profile I/O channel.
+// Each record consists of a ProfileSampleHeader followed by numFrames IPs.
+// The first IP is always the sampled IP; the remaining IPs are return
+// addresses obtained by walking the frame pointer chain (if available).
+constexpr uint32_t profileSampleMagic = 0x50524631; // "PRF1".
+
+constexpr uint16_t profileSampleUser = 1;
+
+constexpr int profileMaxFrames = 16;
+
+struct ProfileSampleHeader {
+	uint32_t magic;
+	uint16_t flags;
+	uint16_t numFrames;
+	uint32_t cpu;
+	uint32_t reserved;
+	// Identifies the universe of user samples (zero for kernel samples).
+	// This is Universe::id(), not the address of the universe.
+	uint64_t universeId;
+};
+static_assert(sizeof(ProfileSampleHeader) == 24);
+
+struct ProfileSample {
+	ProfileSampleHeader header;
+	uint64_t frames[profileMaxFrames];
+
+	size_t size() {
+		return sizeof(ProfileSampleHeader) + header.numFrames * sizeof(uint64_t);
+	}
+};
+
 void initializeProfile();
+// Enables sampling on the current CPU and starts a fiber that drains
+// its localProfileRing. Called on each CPU once it is fully initialized.
+void initializeProfileForThisCpu();
 LogRingBuffer *getGlobalProfileRing();
 
 } // namespace thor
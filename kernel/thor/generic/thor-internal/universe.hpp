@@ -271,9 +271,17 @@ public:
 
 	frg::optional<AnyDescriptor> detachDescriptor(Guard &guard, Handle handle);
 
+	// Sequential ID of this universe. Unlike its address, this ID is safe
+	// to expose to user space (e.g., in kernel profiles).
+	uint64_t id() {
+		return _id;
+	}
+
 	Lock lock;
 
 private:
+	uint64_t _id;
+
 	frg::hash_map<
 		Handle,
 		AnyDescriptor,
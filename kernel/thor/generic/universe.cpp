@@ -1,13 +1,18 @@
+#include <atomic>
+
 #include <thor-internal/universe.hpp>
 
 namespace thor {
 
 namespace {
 	constexpr bool logCleanup = false;
+
+	std::atomic<uint64_t> nextUniverseId{1};
 }
 
 Universe::Universe()
-: _descriptorMap{frg::hash<Handle>{}, *kernelAlloc}, _nextHandle{1} { }
+: _id{nextUniverseId.fetch_add(1, std::memory_order_relaxed)},
+		_descriptorMap{frg::hash<Handle>{}, *kernelAlloc}, _nextHandle{1} { }
 
 Universe::~Universe() {
 	if(logCleanup)
@@ -0,0 +1,172 @@
+#include <string.h>
+
+#include <async/recurring-event.hpp>
+#include <frg/manual_box.hpp>
+#include <thor-internal/cpu-data.hpp>
+#include <thor-internal/debug.hpp>
+#include <thor-internal/fiber.hpp>
+#include <thor-internal/physical.hpp>
+#include <thor-internal/schedule.hpp>
+#include <thor-internal/timer.hpp>
+
+namespace thor {
+
+namespace {
+
+// Capacity of the pool (4 MiB).
+constexpr size_t zeroedPoolCapacity = 1024;
+// The zeroing fibers are woken up once the pool drops to this level.
+constexpr size_t zeroedPoolLowWatermark = zeroedPoolCapacity / 2;
+// Number of pages that a zeroing fiber zeroes before it yields the CPU.
+// Fibers are not preempted, so this bounds the latency of threads on the same CPU.
+constexpr size_t zeroedRefillBatch = 16;
+// Do not refill the pool if fewer pages than this are free.
+constexpr size_t zeroedRefillMinFree = 4 * zeroedPoolCapacity;
+
+// The zeroing fibers only run if there is nothing else to do on their CPU.
+constexpr int zeroingPriority = -1000;
+
+void zeroPageNonTemporal(void *pointer) {
+#if defined(__x86_64__)
+	// Non-temporal stores bypass the cache, such that zeroing pages ahead of time
+	// does not evict the working set of the CPU.
+	auto words = reinterpret_cast<uint64_t *>(pointer);
+	for(size_t i = 0; i < kPageSize / sizeof(uint64_t); i++)
+		asm volatile ("movnti %1, %0" : "=m"(words[i]) : "r"(uint64_t{0}));
+	asm volatile ("sfence" : : : "memory");
+#else
+	memset(pointer, 0, kPageSize);
+#endif
+}
+
+struct ZeroedPagePool {
+	frg::ticket_spinlock mutex;
+	PhysicalAddr pages[zeroedPoolCapacity];
+	size_t numPages = 0;
+
+	// Raised when the pool drops to the low watermark.
+	async::recurring_event drainedEvent;
+
+	std::atomic<uint64_t> hits{0};
+	std::atomic<uint64_t> misses{0};
+};
+
+ZeroedPagePool &zeroedPool() {
+	static frg::eternal<ZeroedPagePool> singleton;
+	return singleton.get();
+}
+
+// Leave the remaining memory to allocations that actually need it.
+bool memoryIsScarce() {
+	return physicalAllocator->numFreePages() < zeroedRefillMinFree;
+}
+
+// Zeroes up to zeroedRefillBatch pages and puts them into the pool.
+// Returns false if the pool cannot take more pages at the moment.
+bool refillZeroedPages() {
+	auto *pool = &zeroedPool();
+
+	for(size_t i = 0; i < zeroedRefillBatch; i++) {
+		{
+			auto irqLock = frg::guard(&irqMutex());
+			auto lock = frg::guard(&pool->mutex);
+
+			if(pool->numPages == zeroedPoolCapacity)
+				return false;
+		}
+
+		if(memoryIsScarce())
+			return false;
+		auto physical = physicalAllocator->allocate(kPageSize);
+		if(physical == PhysicalAddr(-1))
+			return false;
+		zeroPageNonTemporal(mapDirectPhysical(physical));
+
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&pool->mutex);
+
+		if(pool->numPages == zeroedPoolCapacity) {
+			// Another CPU filled the pool in the meantime.
+			physicalAllocator->free(physical, kPageSize);
+			return false;
+		}
+		pool->pages[pool->numPages++] = physical;
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+PhysicalAddr allocateZeroedPage() {
+	auto *pool = &zeroedPool();
+
+	PhysicalAddr physical = PhysicalAddr(-1);
+	bool drained = false;
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&pool->mutex);
+
+		if(pool->numPages) {
+			physical = pool->pages[--pool->numPages];
+			drained = pool->numPages == zeroedPoolLowWatermark;
+		}
+	}
+
+	if(physical != PhysicalAddr(-1)) {
+		pool->hits.fetch_add(1, std::memory_order_relaxed);
+		if(drained)
+			pool->drainedEvent.raise();
+		return physical;
+	}
+
+	pool->misses.fetch_add(1, std::memory_order_relaxed);
+	physical = physicalAllocator->allocate(kPageSize);
+	if(physical == PhysicalAddr(-1))
+		return physical;
+	PageAccessor accessor{physical};
+	memset(accessor.get(), 0, kPageSize);
+	return physical;
+}
+
+void runZeroingFiber(CpuData *cpu) {
+	KernelFiber::run([] {
+		Scheduler::setPriority(thisFiber(), zeroingPriority);
+
+		auto *pool = &zeroedPool();
+		while(true) {
+			if(refillZeroedPages()) {
+				// Yield such that threads that were woken up in the meantime can run.
+				KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(50'000));
+				continue;
+			}
+
+			if(memoryIsScarce()) {
+				KernelFiber::asyncBlockCurrent(generalTimerEngine()->sleepFor(1'000'000'000));
+				continue;
+			}
+
+			KernelFiber::asyncBlockCurrent(pool->drainedEvent.async_wait_if([pool] () -> bool {
+				auto irqLock = frg::guard(&irqMutex());
+				auto lock = frg::guard(&pool->mutex);
+
+				return pool->numPages > zeroedPoolLowWatermark;
+			}));
+		}
+	}, &localScheduler.get(cpu));
+}
+
+ZeroedPageStatistics getZeroedPageStatistics() {
+	auto *pool = &zeroedPool();
+
+	ZeroedPageStatistics stats;
+	stats.hits = pool->hits.load(std::memory_order_relaxed);
+	stats.misses = pool->misses.load(std::memory_order_relaxed);
+	{
+		auto irqLock = frg::guard(&irqMutex());
+		auto lock = frg::guard(&pool->mutex);
+		stats.pooledPages = pool->numPages;
+	}
+	return stats;
+}
+
+} // namespace thor
@@ -249,8 +249,9 @@ static initgraph::Task discoverAcpiRootBuses{&globalInitEngine, "pci.discover-ac
 				PciMsiController *msiController = nullptr;
 				#ifdef __x86_64__
 					struct ApicMsiController final : PciMsiController {
-						MsiPin *allocateMsiPin(frg::string<KernelAlloc> name) override {
-							return allocateApicMsi(std::move(name));
+						MsiPin *allocateMsiPin(frg::string<KernelAlloc> name,
+								unsigned int cpu) override {
+							return allocateApicMsi(std::move(name), cpu);
 						}
 					};
 
@@ -389,7 +389,8 @@ coroutine<frg::expected<Error>> PciEntity::handleRequest(LaneHandle lane) {
 				+ frg::string<KernelAlloc>{*kernelAlloc, "-"}
 				+ frg::to_allocated_string(*kernelAlloc, function)
 				+ frg::string<KernelAlloc>{*kernelAlloc, "."}
-				+ frg::to_allocated_string(*kernelAlloc, req->index()));
+				+ frg::to_allocated_string(*kernelAlloc, req->index()),
+				req->cpu());
 		if(!interrupt) {
 			infoLogger() << "thor: Could not allocate interrupt vector for MSI" << frg::endlog;
 
@@ -504,7 +504,8 @@ protected:
 };
 
 struct PciMsiController {
-	virtual MsiPin *allocateMsiPin(frg::string<KernelAlloc> name) = 0;
+	// Allocates an MSI that is delivered to the given CPU.
+	virtual MsiPin *allocateMsiPin(frg::string<KernelAlloc> name, unsigned int cpu) = 0;
 
 protected:
 	~PciMsiController() = default;
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+
+#include <helix/memory.hpp>
+
+// Byte queue for stream-like files, backed by anonymous memory.
+// Positions are absolute offsets into the stream; they keep increasing
+// for the lifetime of the queue. The capacity is a power of two that grows
+// geometrically on demand. Large buffers are kept while they are in use;
+// they are only released after the queue drained a number of times
+// without filling a quarter of the buffer.
+struct ByteRing {
+	static constexpr size_t minCapacity = 0x4000;
+	static constexpr int releaseAfterDrains = 16;
+
+	uint64_t head() const {
+		return _head;
+	}
+
+	uint64_t tail() const {
+		return _tail;
+	}
+
+	size_t size() const {
+		return _tail - _head;
+	}
+
+	bool empty() const {
+		return _head == _tail;
+	}
+
+	void push(const void *data, size_t length) {
+		if(!length)
+			return;
+		if(size() + length > _capacity)
+			_grow(size() + length);
+		_copyIn(_data, _capacity, _tail, data, length);
+		_tail += length;
+		_peak = std::max(_peak, size());
+	}
+
+	// Copies length bytes starting at the head without consuming them.
+	void peek(void *data, size_t length) const {
+		assert(length <= size());
+		if(!length)
+			return;
+		auto dest = static_cast<char *>(data);
+		auto index = _head & (_capacity - 1);
+		auto first = std::min(length, _capacity - index);
+		memcpy(dest, _data + index, first);
+		memcpy(dest + first, _data, length - first);
+	}
+
+	void consume(size_t length) {
+		assert(length <= size());
+		_head += length;
+		if(empty())
+			_drained();
+	}
+
+	// Accounts for bytes that were delivered without going through the queue.
+	void skip(size_t length) {
+		assert(empty());
+		_head += length;
+		_tail += length;
+	}
+
+private:
+	static void _copyIn(char *base, size_t capacity, uint64_t position,
+			const void *data, size_t length) {
+		auto src = static_cast<const char *>(data);
+		auto index = position & (capacity - 1);
+		auto first = std::min(length, capacity - index);
+		memcpy(base + index, src, first);
+		memcpy(base, src + first, length - first);
+	}
+
+	void _grow(size_t required) {
+		auto capacity = std::max(_capacity, minCapacity);
+		while(capacity < required)
+			capacity *= 2;
+
+		HelHandle handle;
+		HEL_CHECK(helAllocateMemory(capacity, 0, nullptr, &handle));
+		helix::UniqueDescriptor memory{handle};
+		helix::Mapping mapping{memory, 0, capacity};
+		auto data = static_cast<char *>(mapping.get());
+
+		// Keep positions stable; only their index into the buffer changes.
+		if(!empty()) {
+			auto index = _head & (_capacity - 1);
+			auto first = std::min(size(), _capacity - index);
+			_copyIn(data, capacity, _head, _data + index, first);
+			_copyIn(data, capacity, _head + first, _data, size() - first);
+		}
+
+		_memory = std::move(memory);
+		_mapping = std::move(mapping);
+		_data = data;
+		_capacity = capacity;
+	}
+
+	// Releasing the buffer on every drain would allocate and map
+	// a new one for every round trip of a busy stream.
+	void _drained() {
+		if(_capacity > minCapacity && _peak < _capacity / 4) {
+			if(++_idleDrains >= releaseAfterDrains)
+				_release();
+		}else{
+			_idleDrains = 0;
+		}
+		_peak = 0;
+	}
+
+	void _release() {
+		_mapping = helix::Mapping{};
+		_memory = helix::UniqueDescriptor{};
+		_data = nullptr;
+		_capacity = 0;
+		_idleDrains = 0;
+	}
+
+	helix::UniqueDescriptor _memory;
+	helix::Mapping _mapping;
+	char *_data = nullptr;
+	size_t _capacity = 0;
+	uint64_t _head = 0;
+	uint64_t _tail = 0;
+	// Largest size() since the last drain.
+	size_t _peak = 0;
+	// Number of consecutive drains that used less than a quarter of the capacity.
+	int _idleDrains = 0;
+};
@@ -3,7 +3,10 @@
 #include <stdint.h>
 #include <string.h>
 #include <sys/auxv.h>
+#include <algorithm>
 #include <iostream>
+#include <map>
+#include <optional>
 
 #include "vfs.hpp"
 #include "exec.hpp"
@@ -11,10 +14,16 @@
 
 constexpr size_t kPageSize = 0x1000;
 
-// This struct is parsed before knowing the type of executable (PIE vs. non-PIE)
-// and also before knowing the ELF's base address.
-struct ImagePreamble {
+// Parsed meta data of an ELF image that does not depend on the base address.
+// Instances are shared through the image cache and must not be modified.
+struct ElfImage {
 	bool isPie = false;
+	uintptr_t entry;
+	size_t phdrEntrySize;
+	size_t phdrCount;
+	std::vector<Elf64_Phdr> phdrs;
+	// Memory of the file; mapped (or copied from) to load the segments.
+	helix::UniqueDescriptor fileMemory;
 };
 
 // This struct contains the image meta data with correct base address applied.
@@ -28,46 +37,97 @@ struct ImageInfo {
 	size_t phdrCount;
 };
 
-async::result<frg::expected<Error, ImagePreamble>>
-parseElfPreamble(SharedFilePtr file) {
-	ImagePreamble preamble;
+namespace {
 
-	// Read the elf file header and verify the signature.
-	Elf64_Ehdr ehdr;
-	FRG_CO_TRY(co_await file->seek(0, VfsSeek::absolute));
-	FRG_CO_TRY(co_await file->readExactly(nullptr, &ehdr, sizeof(Elf64_Ehdr)));
+// Images are identified by their inode, size and modification time, such that
+// replacing or modifying a binary invalidates the cached entry. This relies on
+// file systems updating the modification time on writes.
+struct ImageKey {
+	dev_t device;
+	uint64_t inode;
+	uint64_t fileSize;
+	uint64_t mtimeSecs;
+	uint64_t mtimeNanos;
 
-	if(!(ehdr.e_ident[0] == 0x7F
-			&& ehdr.e_ident[1] == 'E'
-			&& ehdr.e_ident[2] == 'L'
-			&& ehdr.e_ident[3] == 'F'))
-		co_return Error::badExecutable;
-	if(ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
-		co_return Error::badExecutable;
+	auto operator<=>(const ImageKey &) const = default;
+};
 
-	// Right now we treat every ET_DYN object as PIE and unconditionally apply
-	// a non-zero base address.
-	if(ehdr.e_type == ET_DYN)
-		preamble.isPie = true;
+struct ImageCacheEntry {
+	std::shared_ptr<ElfImage> image;
+	uint64_t lastUse;
+};
 
-	co_return preamble;
+// Maximal number of images in the cache. Entries keep the file memory alive,
+// hence the cache should not grow without bounds.
+constexpr size_t maxCachedImages = 64;
+
+std::map<ImageKey, ImageCacheEntry> imageCache;
+uint64_t imageCacheClock = 0;
+
+async::result<std::optional<ImageKey>> getImageKey(SharedFilePtr file) {
+	auto link = file->associatedLink();
+	if(!link)
+		co_return std::nullopt;
+	auto node = link->getTarget();
+	if(!node->superblock())
+		co_return std::nullopt;
+	auto statsResult = co_await node->getStats();
+	if(!statsResult)
+		co_return std::nullopt;
+	auto &stats = statsResult.value();
+	co_return ImageKey{node->superblock()->deviceNumber(), stats.inodeNumber,
+			stats.fileSize, stats.mtimeSecs, stats.mtimeNanos};
 }
 
-async::result<frg::expected<Error, ImageInfo>>
-loadElfImage(SharedFilePtr file, VmContext *vmContext, uintptr_t base) {
-	assert(!(base & (kPageSize - 1))); // Callers need to ensure this.
+std::shared_ptr<ElfImage> lookupCachedImage(const std::optional<ImageKey> &key) {
+	if(!key)
+		return nullptr;
+	auto it = imageCache.find(*key);
+	if(it == imageCache.end())
+		return nullptr;
+	it->second.lastUse = ++imageCacheClock;
+	return it->second.image;
+}
+
+void insertCachedImage(const std::optional<ImageKey> &key, std::shared_ptr<ElfImage> image) {
+	if(!key)
+		return;
+	if(imageCache.size() >= maxCachedImages) {
+		auto victim = std::min_element(imageCache.begin(), imageCache.end(),
+				[] (const auto &a, const auto &b) {
+			return a.second.lastUse < b.second.lastUse;
+		});
+		imageCache.erase(victim);
+	}
+	imageCache.insert_or_assign(*key, ImageCacheEntry{std::move(image), ++imageCacheClock});
+}
+
+// The dynamic loader is the same for every process. Instead of mapping its segments
+// on every exec(), we load it once into a template context that is never run;
+// exec() forks the template's areas into the new context.
+struct LoaderTemplate {
+	ImageKey key;
+	std::shared_ptr<VmContext> context;
 	ImageInfo info;
+};
 
-	// Get a handle to the file's memory.
-	auto fileMemory = co_await file->accessMemory();
+std::optional<LoaderTemplate> loaderTemplate;
+
+} // anonymous namespace
+
+// Reads and verifies the ELF header and the program headers, unless the image is cached.
+async::result<frg::expected<Error, std::shared_ptr<ElfImage>>>
+parseElfImage(SharedFilePtr file, std::optional<ImageKey> key) {
+	if(auto image = lookupCachedImage(key); image)
+		co_return image;
+
+	auto image = std::make_shared<ElfImage>();
 
 	// Read the elf file header and verify the signature.
 	Elf64_Ehdr ehdr;
 	FRG_CO_TRY(co_await file->seek(0, VfsSeek::absolute));
 	FRG_CO_TRY(co_await file->readExactly(nullptr, &ehdr, sizeof(Elf64_Ehdr)));
 
-	// Verify the ELF file again, since loadElfPreamble() is not necessarily called
-	// on every object that we load.
 	if(!(ehdr.e_ident[0] == 0x7F
 			&& ehdr.e_ident[1] == 'E'
 			&& ehdr.e_ident[2] == 'L'
@@ -75,20 +135,81 @@ loadElfImage(SharedFilePtr file, VmContext *vmContext, uintptr_t base) {
 		co_return Error::badExecutable;
 	if(ehdr.e_type != ET_EXEC && ehdr.e_type != ET_DYN)
 		co_return Error::badExecutable;
+	if(ehdr.e_phentsize < sizeof(Elf64_Phdr))
+		co_return Error::badExecutable;
 
-	info.entryIp = (char *)base + ehdr.e_entry;
-	info.phdrEntrySize = ehdr.e_phentsize;
-	info.phdrCount = ehdr.e_phnum;
+	// Right now we treat every ET_DYN object as PIE and unconditionally apply
+	// a non-zero base address.
+	if(ehdr.e_type == ET_DYN)
+		image->isPie = true;
+
+	image->entry = ehdr.e_entry;
+	image->phdrEntrySize = ehdr.e_phentsize;
+	image->phdrCount = ehdr.e_phnum;
 
-	// Read the elf program headers and load them into the address space.
+	// Read the elf program headers.
 	std::vector<char> phdrBuffer;
 	phdrBuffer.resize(ehdr.e_phnum * ehdr.e_phentsize);
 	FRG_CO_TRY(co_await file->seek(ehdr.e_phoff, VfsSeek::absolute));
 	FRG_CO_TRY(co_await file->readExactly(nullptr,
 			phdrBuffer.data(), ehdr.e_phnum * size_t(ehdr.e_phentsize)));
 
-	for(int i = 0; i < ehdr.e_phnum; i++) {
-		auto phdr = (Elf64_Phdr *)(phdrBuffer.data() + i * ehdr.e_phentsize);
+	image->phdrs.resize(ehdr.e_phnum);
+	for(int i = 0; i < ehdr.e_phnum; i++)
+		memcpy(&image->phdrs[i], phdrBuffer.data() + i * ehdr.e_phentsize, sizeof(Elf64_Phdr));
+
+	// Get a handle to the file's memory.
+	image->fileMemory = co_await file->accessMemory();
+	if(!image->fileMemory)
+		co_return Error::badExecutable;
+	size_t memoryLength;
+	HEL_CHECK(helMemoryInfo(image->fileMemory.getHandle(), &memoryLength));
+
+	// Segments are mapped from (or copied out of) the file's memory,
+	// hence they must not extend beyond it.
+	for(auto &phdr : image->phdrs) {
+		if(phdr.p_type != PT_LOAD || !phdr.p_memsz)
+			continue;
+		if(phdr.p_filesz > phdr.p_memsz || !phdr.p_align)
+			co_return Error::badExecutable;
+		if(!(phdr.p_flags & PF_W) && phdr.p_memsz > memoryLength)
+			co_return Error::badExecutable;
+
+		// Writable segments are copied, others are mapped in whole pages.
+		uintptr_t start;
+		size_t extent;
+		if(phdr.p_flags & PF_W) {
+			start = phdr.p_offset;
+			extent = phdr.p_filesz;
+		}else{
+			size_t misalign = phdr.p_vaddr & (kPageSize - 1);
+			if(phdr.p_offset < misalign)
+				co_return Error::badExecutable;
+			start = phdr.p_offset - misalign;
+			extent = (phdr.p_memsz + misalign + kPageSize - 1) & ~(kPageSize - 1);
+		}
+		if(start > memoryLength || extent > memoryLength - start)
+			co_return Error::badExecutable;
+	}
+
+	insertCachedImage(key, image);
+	co_return image;
+}
+
+async::result<frg::expected<Error, ImageInfo>>
+loadElfImage(SharedFilePtr file, std::shared_ptr<ElfImage> image,
+		VmContext *vmContext, uintptr_t base) {
+	assert(!(base & (kPageSize - 1))); // Callers need to ensure this.
+	ImageInfo info;
+
+	auto &fileMemory = image->fileMemory;
+	info.entryIp = (char *)base + image->entry;
+	info.phdrEntrySize = image->phdrEntrySize;
+	info.phdrCount = image->phdrCount;
+
+	// Load the segments into the address space.
+	for(auto &phdrRef : image->phdrs) {
+		auto phdr = &phdrRef;
 
 		if(phdr->p_type == PT_LOAD) {
 			if(!phdr->p_memsz) // Skip empty segments.
@@ -149,12 +270,16 @@ loadElfImage(SharedFilePtr file, VmContext *vmContext, uintptr_t base) {
 					co_return Error::badExecutable;
 				}
 
-				// Read the segment contents from the file.
+				// Copy the segment contents from the file's memory; this avoids
+				// going through the file system if the pages are already cached.
 				memset(window, 0, mapLength);
-				FRG_CO_TRY(co_await file->seek(phdr->p_offset, VfsSeek::absolute));
-				FRG_CO_TRY(co_await file->readExactly(nullptr,
-						(char *)window + misalign, phdr->p_filesz));
+				auto readSegment = co_await helix_ng::readMemory(fileMemory,
+						phdr->p_offset, phdr->p_filesz, (char *)window + misalign);
 				HEL_CHECK(helUnmapMemory(kHelNullHandle, window, mapLength));
+				if(readSegment.error()) {
+					std::cout << "posix: Failed to read ELF segment" << std::endl;
+					co_return Error::badExecutable;
+				}
 			}
 		}else if(phdr->p_type == PT_PHDR) {
 			info.phdrPtr = (char *)base + phdr->p_vaddr;
@@ -172,6 +297,29 @@ loadElfImage(SharedFilePtr file, VmContext *vmContext, uintptr_t base) {
 	co_return info;
 }
 
+// Loads the dynamic loader, which is always placed at a fixed address.
+async::result<frg::expected<Error, ImageInfo>>
+loadDynamicLoader(SharedFilePtr file, VmContext *vmContext) {
+	constexpr uintptr_t ldsoBase = 0x40000000;
+
+	auto key = co_await getImageKey(file);
+	if(!key) {
+		auto image = FRG_CO_TRY(co_await parseElfImage(file, key));
+		co_return co_await loadElfImage(file, std::move(image), vmContext, ldsoBase);
+	}
+
+	if(!loaderTemplate || loaderTemplate->key != *key) {
+		auto image = FRG_CO_TRY(co_await parseElfImage(file, key));
+		auto context = VmContext::create();
+		auto info = FRG_CO_TRY(co_await loadElfImage(file, std::move(image),
+				context.get(), ldsoBase));
+		loaderTemplate = LoaderTemplate{*key, std::move(context), info};
+	}
+
+	vmContext->forkAreasFrom(*loaderTemplate->context);
+	co_return loaderTemplate->info;
+}
+
 template<typename T, size_t N>
 void *copyArrayToStack(void *window, size_t &d, const T (&value)[N]) {
 	assert(d >= alignof(T) + sizeof(T) * N);
@@ -192,6 +340,7 @@ execute(ViewPath root, ViewPath workdir,
 
 	auto execFile = FRG_CO_TRY(co_await open(root, workdir, path, self));
 	assert(execFile); // If open() succeeds, it must return a non-null file.
+	auto execKey = co_await getImageKey(execFile);
 
 	int nRecursions = 0;
 	while(true) {
@@ -200,6 +349,10 @@ execute(ViewPath root, ViewPath workdir,
 			co_return Error::badExecutable;
 		}
 
+		// Cached images are known to be ELF files.
+		if(lookupCachedImage(execKey))
+			break;
+
 		char shebangPrefix[2];
 		if(!(co_await execFile->readExactly(nullptr, shebangPrefix, 2)))
 			break;
@@ -252,23 +405,28 @@ execute(ViewPath root, ViewPath workdir,
 		args.insert(args.begin(), interpreterPath);
 		path = std::move(interpreterPath);
 		execFile = std::move(interpreterFile);
+		execKey = co_await getImageKey(execFile);
 		nRecursions++;
 	}
 
-	auto execPreamble = FRG_CO_TRY(co_await parseElfPreamble(execFile));
+	// TODO: Should we really look up the dynamic linker in the current working dir?
+	auto ldsoFile = FRG_CO_TRY(co_await open(root, workdir, "/usr/lib/ld-init.so", self));
+	assert(ldsoFile); // If open() succeeds, it must return a non-null file.
+	// Load the dynamic loader first: forking it from the template
+	// requires its address range to be unoccupied.
+	auto ldsoInfo = FRG_CO_TRY(co_await loadDynamicLoader(ldsoFile, vmContext.get()));
+
+	auto execImage = FRG_CO_TRY(co_await parseElfImage(execFile, execKey));
 	ImageInfo execInfo;
-	if(execPreamble.isPie) {
+	if(execImage->isPie) {
 		// Unconditionally apply a non-zero base address to PIE objects.
-		execInfo = FRG_CO_TRY(co_await loadElfImage(execFile, vmContext.get(), 0x200000));
+		execInfo = FRG_CO_TRY(co_await loadElfImage(execFile, execImage,
+				vmContext.get(), 0x200000));
 	}else{
-		execInfo = FRG_CO_TRY(co_await loadElfImage(execFile, vmContext.get(), 0));
+		execInfo = FRG_CO_TRY(co_await loadElfImage(execFile, execImage,
+				vmContext.get(), 0));
 	}
 
-	// TODO: Should we really look up the dynamic linker in the current working dir?
-	auto ldsoFile = FRG_CO_TRY(co_await open(root, workdir, "/usr/lib/ld-init.so", self));
-	assert(ldsoFile); // If open() succeeds, it must return a non-null file.
-	auto ldsoInfo = FRG_CO_TRY(co_await loadElfImage(ldsoFile, vmContext.get(), 0x40000000));
-
 	constexpr size_t stackSize = 0x200000;
 
 	// Allocate memory for the stack.
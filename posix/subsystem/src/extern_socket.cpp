@@ -1,17 +1,144 @@
 #include "extern_socket.hpp"
 
+#include <iostream>
+#include <optional>
+#include <unordered_map>
+
+#include <async/recurring-event.hpp>
+#include <helix/memory.hpp>
+#include <protocols/fs/defs.hpp>
+
 #include "fs.bragi.hpp"
 #include "protocols/fs/client.hpp"
 
 namespace {
+
+constexpr bool logStatusSeqlock = false;
+
+// Status table of a server, mapped once and shared by all of its sockets.
+// Instead of one FILE_POLL_WAIT per socket, we keep (at most) a single
+// STATUS_TABLE_WAIT request in flight that completes when any slot changes.
+struct StatusTable {
+	StatusTable(helix::BorrowedLane lane, helix::UniqueDescriptor memory)
+	: _lane{lane}, _mapping{memory, 0, protocols::fs::statusTableSize} { }
+
+	// Sequence number that is incremented whenever any slot changes.
+	uint64_t changes() {
+		return __atomic_load_n(&_slots()[0].sequence, __ATOMIC_ACQUIRE);
+	}
+
+	// Returns std::nullopt if the slot is currently being updated.
+	std::optional<PollStatusResult> read(size_t slot) {
+		auto entry = &_slots()[slot];
+
+		// Start the seqlock read.
+		auto seqlock = __atomic_load_n(&entry->seqlock, __ATOMIC_ACQUIRE);
+		if(seqlock & 1) {
+			if(logStatusSeqlock)
+				std::cout << "posix: Status slot update in progess" << std::endl;
+			return std::nullopt;
+		}
+
+		// Perform the actual loads.
+		auto sequence = __atomic_load_n(&entry->sequence, __ATOMIC_RELAXED);
+		auto status = __atomic_load_n(&entry->status, __ATOMIC_RELAXED);
+
+		// Finish the seqlock read.
+		__atomic_thread_fence(__ATOMIC_ACQUIRE);
+		if(__atomic_load_n(&entry->seqlock, __ATOMIC_RELAXED) != seqlock) {
+			if(logStatusSeqlock)
+				std::cout << "posix: Stale data from status slot" << std::endl;
+			return std::nullopt;
+		}
+
+		return PollStatusResult{sequence, status};
+	}
+
+	async::result<void> waitForChange(uint64_t pastChanges,
+			async::cancellation_token cancellation) {
+		_numWaiters++;
+		if(!_watching) {
+			_watching = true;
+			async::detach(_watch());
+		}
+
+		while(changes() == pastChanges && !cancellation.is_cancellation_requested())
+			co_await _changeEvent.async_wait(cancellation);
+		_numWaiters--;
+	}
+
+private:
+	protocols::fs::StatusSlot *_slots() {
+		return reinterpret_cast<protocols::fs::StatusSlot *>(_mapping.get());
+	}
+
+	async::result<void> _watch() {
+		while(_numWaiters) {
+			managarm::fs::CntRequest req;
+			req.set_req_type(managarm::fs::CntReqType::STATUS_TABLE_WAIT);
+			req.set_sequence(changes());
+
+			auto ser = req.SerializeAsString();
+			auto [offer, send_req, recv_resp] = co_await helix_ng::exchangeMsgs(
+				_lane,
+				helix_ng::offer(
+					helix_ng::sendBuffer(ser.data(), ser.size()),
+					helix_ng::recvInline()
+				)
+			);
+			HEL_CHECK(offer.error());
+			HEL_CHECK(send_req.error());
+			HEL_CHECK(recv_resp.error());
+
+			managarm::fs::SvrResponse resp;
+			resp.ParseFromArray(recv_resp.data(), recv_resp.length());
+			assert(resp.error() == managarm::fs::Errors::SUCCESS);
+
+			_changeEvent.raise();
+		}
+		_watching = false;
+	}
+
+	helix::BorrowedLane _lane;
+	helix::Mapping _mapping;
+	async::recurring_event _changeEvent;
+	size_t _numWaiters = 0;
+	bool _watching = false;
+};
+
+// Maps server lanes to their status tables.
+std::unordered_map<HelHandle, std::shared_ptr<StatusTable>> globalStatusTables;
+
 struct Socket : File {
-	Socket(helix::UniqueLane sockLane)
+	Socket(helix::UniqueLane sockLane, std::shared_ptr<StatusTable> statusTable,
+			size_t statusSlot)
 	: File{StructName::get("extern-socket")},
-		_file{std::move(sockLane)} { }
+		_file{std::move(sockLane)}, _statusTable{std::move(statusTable)},
+		_statusSlot{statusSlot} { }
 
 	async::result<frg::expected<Error, PollWaitResult>>
 	pollWait(Process *, uint64_t sequence, int mask,
 			async::cancellation_token cancellation) override {
+		while(_statusTable) {
+			// Read the change counter first such that we do not miss updates
+			// that happen between reading the slot and waiting.
+			auto changes = _statusTable->changes();
+			auto result = _statusTable->read(_statusSlot);
+			if(!result)
+				break;
+
+			// The table only contains the current status, not the edges since sequence;
+			// report the current status instead. This is a superset of the edges
+			// that are still active, which is all that epoll cares about.
+			auto [currentSeq, status] = *result;
+			if(currentSeq != sequence)
+				co_return PollWaitResult{currentSeq, status};
+			if(cancellation.is_cancellation_requested())
+				co_return PollWaitResult{currentSeq, 0};
+
+			co_await _statusTable->waitForChange(changes, cancellation);
+		}
+
 		auto resultOrError = co_await _file.pollWait(sequence, mask, cancellation);
 		assert(resultOrError);
 		co_return resultOrError.value();
@@ -19,6 +146,11 @@ struct Socket : File {
 
 	async::result<frg::expected<Error, PollStatusResult>>
 	pollStatus(Process *) override {
+		if(_statusTable) {
+			if(auto result = _statusTable->read(_statusSlot); result)
+				co_return *result;
+		}
+
 		auto resultOrError = co_await _file.pollStatus();
 		assert(resultOrError);
 		co_return resultOrError.value();
@@ -30,6 +162,8 @@ struct Socket : File {
 
 private:
 	protocols::fs::File _file;
+	std::shared_ptr<StatusTable> _statusTable;
+	size_t _statusSlot;
 };
 }
 
@@ -47,11 +181,12 @@ async::result<smarter::shared_ptr<File, FileHandle>> createSocket(helix::Borrowe
 	auto req_data = req.SerializeAsString();
 	char buffer[128];
 
-	auto [offer, send_req, recv_resp, recv_lane] = co_await helix_ng::exchangeMsgs(
+	auto [offer, send_req, recv_resp, recv_lane, recv_table] = co_await helix_ng::exchangeMsgs(
 		lane,
 		helix_ng::offer(
 			helix_ng::sendBuffer(req_data.data(), req_data.size()),
 			helix_ng::recvBuffer(buffer, sizeof(buffer)),
+			helix_ng::pullDescriptor(),
 			helix_ng::pullDescriptor()
 		)
 	);
@@ -64,7 +199,22 @@ async::result<smarter::shared_ptr<File, FileHandle>> createSocket(helix::Borrowe
 	resp.ParseFromArray(buffer, recv_resp.actualLength());
 	assert(resp.error() == managarm::fs::Errors::SUCCESS);
 
-	auto file = smarter::make_shared<Socket>(recv_lane.descriptor());
+	std::shared_ptr<StatusTable> statusTable;
+	size_t statusSlot = 0;
+	if(resp.caps() & managarm::fs::FileCaps::FC_STATUS_TABLE) {
+		assert(!recv_table.error());
+		assert(resp.status_slot() && resp.status_slot() < protocols::fs::numStatusSlots);
+
+		// All sockets of a server share the same table; only map it once.
+		auto &entry = globalStatusTables[lane.getHandle()];
+		if(!entry)
+			entry = std::make_shared<StatusTable>(lane, recv_table.descriptor());
+		statusTable = entry;
+		statusSlot = resp.status_slot();
+	}
+
+	auto file = smarter::make_shared<Socket>(recv_lane.descriptor(),
+			std::move(statusTable), statusSlot);
 	file->setupWeakFile(file);
 	co_return File::constructHandle(file);
 }
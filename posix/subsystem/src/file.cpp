@@ -1,6 +1,7 @@
 
 #include <string.h>
 #include <fcntl.h>
+#include <linux/falloc.h>
 
 #include <sys/socket.h>
 #include <helix/ipc.hpp>
@@ -154,10 +155,15 @@ async::result<frg::expected<protocols::fs::Error>> File::ptTruncate(void *object
 }
 
 async::result<frg::expected<protocols::fs::Error>> File::ptAllocate(void *object,
-		int64_t offset, size_t size) {
+		int mode, int64_t offset, size_t size) {
 	auto self = static_cast<File *>(object);
 
-	co_return co_await self->allocate(offset, size);
+	if(!mode)
+		co_return co_await self->allocate(offset, size);
+	// As on Linux, punching holes never changes the file size.
+	if(mode == (FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE))
+		co_return co_await self->punchHole(offset, size);
+	co_return protocols::fs::Error::illegalOperationTarget;
 }
 
 async::result<protocols::fs::Error> File::ptBind(void *object,
@@ -378,6 +384,12 @@ async::result<frg::expected<protocols::fs::Error>> File::allocate(int64_t, size_
 	throw std::runtime_error("posix: Object has no File::allocate()");
 }
 
+async::result<frg::expected<protocols::fs::Error>> File::punchHole(int64_t, size_t) {
+	std::cout << "\e[35mposix \e[1;34m" << structName()
+			<< "\e[0m\e[35m: File does not support punching holes\e[39m" << std::endl;
+	co_return protocols::fs::Error::illegalOperationTarget;
+}
+
 async::result<frg::expected<Error, off_t>> File::seek(off_t, VfsSeek) {
 	if(_defaultOps & defaultPipeLikeSeek) {
 		co_return Error::seekOnPipe;
@@ -212,7 +212,7 @@ public:
 	ptTruncate(void *object, size_t size);
 
 	static async::result<frg::expected<protocols::fs::Error>>
-	ptAllocate(void *object, int64_t offset, size_t size);
+	ptAllocate(void *object, int mode, int64_t offset, size_t size);
 
 	static async::result<protocols::fs::Error>
 	ptBind(void *object, helix_ng::CredentialsView credentials,
@@ -393,6 +393,9 @@ public:
 
 	virtual async::result<frg::expected<protocols::fs::Error>> allocate(int64_t offset, size_t size);
 
+	// Releases the storage of a range such that it reads as zero; keeps the file size.
+	virtual async::result<frg::expected<protocols::fs::Error>> punchHole(int64_t offset, size_t size);
+
 	// poll() uses a sequence number mechansim for synchronization.
 	// Before returning, it waits until current-sequence > in-sequence.
 	// Returns (current-sequence, edges since in-sequence, current events).
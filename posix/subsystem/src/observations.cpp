@@ -97,6 +97,71 @@ void dumpRegisters(std::shared_ptr<Process> proc) {
 	}
 }
 
+namespace {
+
+struct ExecArguments {
+	std::string path;
+	std::vector<std::string> args;
+	std::vector<std::string> env;
+};
+
+// Loads the path, arguments and environment that are passed to the execve
+// and spawn supercalls (as pointer and size pairs in the argument registers).
+async::result<ExecArguments> loadExecArguments(std::shared_ptr<Process> self, uintptr_t *gprs) {
+	ExecArguments result;
+
+	result.path.resize(gprs[kHelRegArg1]);
+	auto loadPath = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
+			gprs[kHelRegArg0], gprs[kHelRegArg1], result.path.data());
+	HEL_CHECK(loadPath.error());
+
+	std::string args_area;
+	args_area.resize(gprs[kHelRegArg3]);
+	auto loadArgs = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
+			gprs[kHelRegArg2], gprs[kHelRegArg3], args_area.data());
+	HEL_CHECK(loadArgs.error());
+
+	std::string env_area;
+	env_area.resize(gprs[kHelRegArg5]);
+	auto loadEnv = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
+			gprs[kHelRegArg4], gprs[kHelRegArg5], env_area.data());
+	HEL_CHECK(loadEnv.error());
+
+	// Parse both the arguments and the environment areas.
+	size_t k;
+
+	k = 0;
+	while(k < args_area.size()) {
+		auto d = args_area.find(char(0), k);
+		assert(d != std::string::npos);
+		result.args.push_back(args_area.substr(k, d - k));
+		k = d + 1;
+	}
+
+	k = 0;
+	while(k < env_area.size()) {
+		auto d = env_area.find(char(0), k);
+		assert(d != std::string::npos);
+		result.env.push_back(env_area.substr(k, d - k));
+		k = d + 1;
+	}
+
+	co_return result;
+}
+
+int execErrorToErrno(Error error) {
+	if(error == Error::noSuchFile)
+		return ENOENT;
+	if(error == Error::badExecutable || error == Error::eof)
+		return ENOEXEC;
+	// Unhandled error, log and bubble up EIO
+	std::cout << "posix: exec: unhandled error from Process::exec, we got: "
+			<< (int)error << std::endl;
+	return EIO;
+}
+
+} // anonymous namespace
+
 async::result<void> observeThread(std::shared_ptr<Process> self,
 		std::shared_ptr<Generation> generation) {
 	auto thread = self->threadDescriptor();
@@ -199,6 +264,55 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 
 			HEL_CHECK(helResume(thread.getHandle()));
 			HEL_CHECK(helResume(new_thread));
+		}else if(observe.observation() == kHelObserveSuperCall + posix::superVfork) {
+			if(logRequests)
+				std::cout << "posix: vfork supercall" << std::endl;
+			auto child = Process::vfork(self);
+
+			// Copy registers from the current thread to the new one.
+			auto new_thread = child->threadDescriptor().getHandle();
+			uintptr_t pcrs[2], gprs[kHelNumGprs], thrs[2];
+			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsProgram, &pcrs));
+			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsThread, &thrs));
+
+			HEL_CHECK(helStoreRegisters(new_thread, kHelRegsProgram, &pcrs));
+			HEL_CHECK(helStoreRegisters(new_thread, kHelRegsThread, &thrs));
+
+			gprs[kHelRegError] = kHelErrNone;
+			gprs[kHelRegOut0] = 0;
+			HEL_CHECK(helStoreRegisters(new_thread, kHelRegsGeneral, &gprs));
+			HEL_CHECK(helResume(new_thread));
+
+			// The child runs on our stack; keep this thread suspended
+			// until the child does not use our address space anymore.
+			co_await child->waitForVforkRelease();
+
+			gprs[kHelRegOut0] = child->pid();
+			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+			HEL_CHECK(helResume(thread.getHandle()));
+		}else if(observe.observation() == kHelObserveSuperCall + posix::superSpawn) {
+			if(logRequests)
+				std::cout << "posix: spawn supercall" << std::endl;
+			uintptr_t gprs[kHelNumGprs];
+			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+
+			auto [path, args, env] = co_await loadExecArguments(self, gprs);
+
+			if(logRequests || logPaths)
+				std::cout << "posix: spawn path: " << path << std::endl;
+
+			auto outcome = co_await Process::spawn(self,
+					path, std::move(args), std::move(env));
+			gprs[kHelRegError] = kHelErrNone;
+			if(outcome) {
+				gprs[kHelRegOut0] = 0;
+				gprs[kHelRegOut1] = outcome.value()->pid();
+			}else{
+				gprs[kHelRegOut0] = execErrorToErrno(outcome.error());
+			}
+			HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
+			HEL_CHECK(helResume(thread.getHandle()));
 		}else if(observe.observation() == kHelObserveSuperCall + posix::superClone) {
 			if(logRequests)
 				std::cout << "posix: clone supercall" << std::endl;
@@ -224,71 +338,16 @@ async::result<void> observeThread(std::shared_ptr<Process> self,
 			uintptr_t gprs[kHelNumGprs];
 			HEL_CHECK(helLoadRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
 
-			std::string path;
-			path.resize(gprs[kHelRegArg1]);
-			auto loadPath = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
-					gprs[kHelRegArg0], gprs[kHelRegArg1], path.data());
-			HEL_CHECK(loadPath.error());
-
-			std::string args_area;
-			args_area.resize(gprs[kHelRegArg3]);
-			auto loadArgs = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
-					gprs[kHelRegArg2], gprs[kHelRegArg3], args_area.data());
-			HEL_CHECK(loadArgs.error());
-
-			std::string env_area;
-			env_area.resize(gprs[kHelRegArg5]);
-			auto loadEnv = co_await helix_ng::readMemory(self->vmContext()->getSpace(),
-					gprs[kHelRegArg4], gprs[kHelRegArg5], env_area.data());
-			HEL_CHECK(loadEnv.error());
+			auto [path, args, env] = co_await loadExecArguments(self, gprs);
 
 			if(logRequests || logPaths)
 				std::cout << "posix: execve path: " << path << std::endl;
 
-			// Parse both the arguments and the environment areas.
-			size_t k;
-
-			std::vector<std::string> args;
-			k = 0;
-			while(k < args_area.size()) {
-				auto d = args_area.find(char(0), k);
-				assert(d != std::string::npos);
-				args.push_back(args_area.substr(k, d - k));
-//				std::cout << "arg: " << args.back() << std::endl;
-				k = d + 1;
-			}
-
-			std::vector<std::string> env;
-			k = 0;
-			while(k < env_area.size()) {
-				auto d = env_area.find(char(0), k);
-				assert(d != std::string::npos);
-				env.push_back(env_area.substr(k, d - k));
-//				std::cout << "env: " << env.back() << std::endl;
-				k = d + 1;
-			}
-
 			auto error = co_await Process::exec(self,
 					path, std::move(args), std::move(env));
-			if(error == Error::success) {
-				// Continue
-			}else if(error == Error::noSuchFile) {
-				gprs[kHelRegError] = kHelErrNone;
-				gprs[kHelRegOut0] = ENOENT;
-				HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-
-				HEL_CHECK(helResume(thread.getHandle()));
-			}else if(error == Error::badExecutable || error == Error::eof) {
-				gprs[kHelRegError] = kHelErrNone;
-				gprs[kHelRegOut0] = ENOEXEC;
-				HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
-
-				HEL_CHECK(helResume(thread.getHandle()));
-			}else {
-				// Unhandled error, log and bubble up EIO
-				std::cout << "posix: exec: unhandled error from Process::exec, we got: " << (int)error << std::endl;
+			if(error != Error::success) {
 				gprs[kHelRegError] = kHelErrNone;
-				gprs[kHelRegOut0] = EIO;
+				gprs[kHelRegOut0] = execErrorToErrno(error);
 				HEL_CHECK(helStoreRegisters(thread.getHandle(), kHelRegsGeneral, &gprs));
 
 				HEL_CHECK(helResume(thread.getHandle()));
@@ -32,47 +32,66 @@ std::shared_ptr<VmContext> VmContext::create() {
 }
 
 std::shared_ptr<VmContext> VmContext::clone(std::shared_ptr<VmContext> original) {
-	auto context = std::make_shared<VmContext>();
+	auto context = create();
+	context->forkAreasFrom(*original);
+	return context;
+}
 
-	HelHandle space;
-	HEL_CHECK(helCreateSpace(&space));
-	context->_space = helix::UniqueDescriptor(space);
+void VmContext::forkAreasFrom(const VmContext &source) {
+	// Fork and map the areas in batches; this avoids a pair of system calls per area.
+	// Areas that share a copy-on-write view (e.g., after mprotect() split an area)
+	// also share the forked view.
+	std::vector<HelForkMapping> batch;
+	std::vector<std::map<uintptr_t, Area>::const_iterator> batchAreas;
+	auto flushBatch = [&] {
+		if(batch.empty())
+			return;
+		HEL_CHECK(helForkMappings(_space.getHandle(), batch.data(), batch.size()));
+
+		for(size_t i = 0; i < batch.size(); i++) {
+			const auto &[address, area] = *batchAreas[i];
+			if(batch[i].error != kHelErrAlreadyExists)
+				HEL_CHECK(batch[i].error);
+
+			Area copy;
+			copy.copyOnWrite = area.copyOnWrite;
+			copy.areaSize = area.areaSize;
+			copy.nativeFlags = area.nativeFlags;
+			copy.fileView = area.fileView.dup();
+			if(area.copyOnWrite)
+				copy.copyView = helix::UniqueDescriptor{batch[i].forkedMemory};
+			copy.copyOffset = area.copyOffset;
+			copy.file = area.file;
+			copy.offset = area.offset;
+			_areaTree.emplace(address, std::move(copy));
+		}
+
+		batch.clear();
+		batchAreas.clear();
+	};
 
-	for(const auto &entry : original->_areaTree) {
-		const auto &[address, area] = entry;
+	for(auto it = source._areaTree.cbegin(); it != source._areaTree.cend(); ++it) {
+		const auto &[address, area] = *it;
 
-		helix::UniqueDescriptor copyView;
+		HelForkMapping mapping{};
 		if(area.copyOnWrite) {
-			HelHandle copyHandle;
-			HEL_CHECK(helForkMemory(area.copyView.getHandle(), &copyHandle));
-			copyView = helix::UniqueDescriptor{copyHandle};
-
-			void *pointer;
-			HelError error = helMapMemory(copyView.getHandle(), context->_space.getHandle(),
-					reinterpret_cast<void *>(address),
-					0, area.areaSize, area.nativeFlags, &pointer);
-			if(error != kHelErrNone && error != kHelErrAlreadyExists) {
-				HEL_CHECK(error);
-			}
+			mapping.memory = area.copyView.getHandle();
+			mapping.copyOnWrite = 1;
+			mapping.offset = area.copyOffset;
 		}else{
-			void *pointer;
-			HEL_CHECK(helMapMemory(area.fileView.getHandle(), context->_space.getHandle(),
-					reinterpret_cast<void *>(address),
-					area.offset, area.areaSize, area.nativeFlags, &pointer));
+			mapping.memory = area.fileView.getHandle();
+			mapping.offset = area.offset;
 		}
-
-		Area copy;
-		copy.copyOnWrite = area.copyOnWrite;
-		copy.areaSize = area.areaSize;
-		copy.nativeFlags = area.nativeFlags;
-		copy.fileView = area.fileView.dup();
-		copy.copyView = std::move(copyView);
-		copy.file = area.file;
-		copy.offset = area.offset;
-		context->_areaTree.emplace(address, std::move(copy));
+		mapping.pointer = reinterpret_cast<void *>(address);
+		mapping.size = area.areaSize;
+		mapping.flags = area.nativeFlags;
+		batch.push_back(mapping);
+		batchAreas.push_back(it);
+
+		if(batch.size() == kHelMaxForkMappings)
+			flushBatch();
 	}
-
-	return context;
+	flushBatch();
 }
 
 VmContext::~VmContext() {
@@ -103,6 +122,7 @@ auto VmContext::splitAreaOn_(uintptr_t addr, size_t size) ->
 			right.nativeFlags = area.nativeFlags;
 			right.fileView = area.fileView.dup();
 			right.copyView = area.copyView.dup();
+			right.copyOffset = area.copyOffset + (addr - base);
 			right.file = area.file;
 			right.offset = area.offset + (addr - base);
 
@@ -174,9 +194,11 @@ VmContext::mapFile(uintptr_t hint, helix::UniqueDescriptor memory,
 	Area area;
 	area.copyOnWrite = copyOnWrite;
 	area.areaSize = alignedSize;
-	area.nativeFlags = nativeFlags;
+	// Populating only applies to the initial mapping, not to remaps or forks.
+	area.nativeFlags = nativeFlags & ~kHelMapPopulate;
 	area.fileView = std::move(memory);
 	area.copyView = std::move(copyView);
+	area.copyOffset = 0;
 	area.file = std::move(file);
 	area.offset = offset;
 	_areaTree.emplace(address, std::move(area));
@@ -216,6 +238,7 @@ async::result<void *> VmContext::remapFile(void *oldPointer,
 	area.nativeFlags = it->second.nativeFlags;
 	area.fileView = std::move(it->second.fileView);
 	area.copyView = std::move(it->second.copyView);
+	area.copyOffset = it->second.copyOffset;
 	area.file = std::move(it->second.file);
 	area.offset = it->second.offset;
 	_areaTree.erase(it);
@@ -1152,6 +1175,9 @@ async::result<Error> Process::exec(std::shared_ptr<Process> process,
 	// From here on, we can now release resources of the old process image.
 	process->_fileContext->closeOnExec();
 
+	// A child of vfork() returns the address space to its parent.
+	process->releaseVforkParent_();
+
 	// "Commit" the exec() operation.
 	size_t pos = path.rfind('/');
 	assert(pos != std::string::npos);
@@ -1177,6 +1203,164 @@ async::result<Error> Process::exec(std::shared_ptr<Process> process,
 	co_return Error::success;
 }
 
+std::shared_ptr<Process> Process::vfork(std::shared_ptr<Process> original) {
+	auto hull = std::make_shared<PidHull>(nextPid++);
+	auto process = std::make_shared<Process>(std::move(hull), original.get());
+	process->_path = original->path();
+	process->_name = original->name();
+	// The address space is shared until the child calls exec() or terminates;
+	// all other contexts are copied as in fork().
+	process->_vmContext = original->_vmContext;
+	process->_fsContext = FsContext::clone(original->_fsContext);
+	process->_fileContext = FileContext::clone(original->_fileContext);
+	process->_signalContext = SignalContext::clone(original->_signalContext);
+	process->_vforkRelease = std::make_shared<async::oneshot_event>();
+	process->realTimer.process = process;
+
+	original->_pgPointer->reassociateProcess(process.get());
+
+	HelHandle thread_memory;
+	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &thread_memory));
+	process->_threadPageMemory = helix::UniqueDescriptor{thread_memory};
+	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
+
+	// Signal masks are copied on vfork().
+	process->_signalMask = original->_signalMask;
+
+	auto [server_lane, client_lane] = helix::createStream();
+	HEL_CHECK(helTransferDescriptor(client_lane.getHandle(),
+			process->_fileContext->getUniverse().getHandle(), &process->_clientPosixLane));
+	client_lane.release();
+
+	// The thread page and file table are mapped into the shared address space;
+	// releaseVforkParent_() unmaps them again.
+	HEL_CHECK(helMapMemory(process->_threadPageMemory.getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite,
+			&process->_clientThreadPage));
+	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead,
+			&process->_clientFileTable));
+	process->_clientClkTrackerPage = original->_clientClkTrackerPage;
+
+	process->_clientAuxBegin = original->_clientAuxBegin;
+	process->_clientAuxEnd = original->_clientAuxEnd;
+	process->_uid = original->_uid;
+	process->_euid = original->_euid;
+	process->_gid = original->_gid;
+	process->_egid = original->_egid;
+	original->_children.push_back(process);
+	process->_hull->initializeProcess(process.get());
+	process->_didExecute = false;
+
+	auto procfs_root = std::static_pointer_cast<procfs::DirectoryNode>(getProcfs()->getTarget());
+	process->_procfs_dir = procfs_root->createProcDirectory(std::to_string(process->_hull->getPid()), process.get());
+
+	HelHandle new_thread;
+	HEL_CHECK(helCreateThread(process->fileContext()->getUniverse().getHandle(),
+			process->vmContext()->getSpace().getHandle(), kHelAbiSystemV,
+			nullptr, nullptr, kHelThreadStopped, &new_thread));
+	process->_threadDescriptor = helix::UniqueDescriptor{new_thread};
+	process->_posixLane = std::move(server_lane);
+
+	auto generation = std::make_shared<Generation>();
+	process->_currentGeneration = generation;
+	async::detach(serve(process, std::move(generation)));
+
+	return process;
+}
+
+void Process::releaseVforkParent_() {
+	if(!_vforkRelease)
+		return;
+
+	HEL_CHECK(helUnmapMemory(_vmContext->getSpace().getHandle(), _clientThreadPage, 0x1000));
+	HEL_CHECK(helUnmapMemory(_vmContext->getSpace().getHandle(), _clientFileTable, 0x1000));
+
+	auto release = std::move(_vforkRelease);
+	release->raise();
+}
+
+async::result<frg::expected<Error, std::shared_ptr<Process>>>
+Process::spawn(std::shared_ptr<Process> original, std::string path,
+		std::vector<std::string> args, std::vector<std::string> env) {
+	// Load the executable before creating the process, such that
+	// we do not need to tear down a half-constructed process on failure.
+	// Note that nothing of the parent's address space is copied.
+	auto vmContext = VmContext::create();
+	auto fileContext = FileContext::clone(original->_fileContext);
+	fileContext->closeOnExec();
+	auto execResult = FRG_CO_TRY(co_await execute(original->_fsContext->getRoot(),
+			original->_fsContext->getWorkingDirectory(),
+			path, std::move(args), std::move(env), vmContext,
+			fileContext->getUniverse(), fileContext->clientMbusLane(), original.get()));
+
+	auto hull = std::make_shared<PidHull>(nextPid++);
+	auto process = std::make_shared<Process>(std::move(hull), original.get());
+	size_t pos = path.rfind('/');
+	assert(pos != std::string::npos);
+	process->_name = path.substr(pos + 1);
+	process->_path = std::move(path);
+	process->_vmContext = std::move(vmContext);
+	process->_fsContext = FsContext::clone(original->_fsContext);
+	process->_fileContext = std::move(fileContext);
+	process->_signalContext = SignalContext::clone(original->_signalContext);
+	process->_signalContext->resetHandlers();
+	process->realTimer.process = process;
+
+	original->_pgPointer->reassociateProcess(process.get());
+
+	HelHandle thread_memory;
+	HEL_CHECK(helAllocateMemory(0x1000, 0, nullptr, &thread_memory));
+	process->_threadPageMemory = helix::UniqueDescriptor{thread_memory};
+	process->_threadPageMapping = helix::Mapping{process->_threadPageMemory, 0, 0x1000};
+
+	// Signal masks are inherited, as in fork() followed by exec().
+	process->_signalMask = original->_signalMask;
+
+	auto [server_lane, client_lane] = helix::createStream();
+	HEL_CHECK(helTransferDescriptor(client_lane.getHandle(),
+			process->_fileContext->getUniverse().getHandle(), &process->_clientPosixLane));
+	client_lane.release();
+
+	HEL_CHECK(helMapMemory(process->_threadPageMemory.getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead | kHelMapProtWrite,
+			&process->_clientThreadPage));
+	HEL_CHECK(helMapMemory(process->_fileContext->fileTableMemory().getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead,
+			&process->_clientFileTable));
+	HEL_CHECK(helMapMemory(clk::trackerPageMemory().getHandle(),
+			process->_vmContext->getSpace().getHandle(),
+			nullptr, 0, 0x1000, kHelMapProtRead,
+			&process->_clientClkTrackerPage));
+
+	process->_threadDescriptor = std::move(execResult.thread);
+	process->_clientAuxBegin = execResult.auxBegin;
+	process->_clientAuxEnd = execResult.auxEnd;
+	process->_uid = original->_uid;
+	process->_euid = original->_euid;
+	process->_gid = original->_gid;
+	process->_egid = original->_egid;
+	original->_children.push_back(process);
+	process->_hull->initializeProcess(process.get());
+	process->_didExecute = true;
+
+	auto procfs_root = std::static_pointer_cast<procfs::DirectoryNode>(getProcfs()->getTarget());
+	process->_procfs_dir = procfs_root->createProcDirectory(std::to_string(process->_hull->getPid()), process.get());
+
+	process->_posixLane = std::move(server_lane);
+
+	auto generation = std::make_shared<Generation>();
+	process->_currentGeneration = generation;
+	helResume(process->_threadDescriptor.getHandle());
+	async::detach(serve(process, std::move(generation)));
+
+	co_return process;
+}
+
 void Process::retire(Process *process) {
 	assert(process->_parent);
 	process->_parent->_childrenUsage.userTime += process->_generationUsage.userTime;
@@ -1203,6 +1387,8 @@ async::result<void> Process::terminate(TerminationState state) {
 	HEL_CHECK(helQueryThreadStats(_threadDescriptor.getHandle(), &stats));
 	_generationUsage.userTime += stats.userTime;
 
+	releaseVforkParent_();
+
 	_posixLane = {};
 	_threadDescriptor = {};
 	_vmContext = nullptr;
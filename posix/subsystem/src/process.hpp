@@ -45,6 +45,10 @@ struct VmContext {
 
 	void unmapFile(void *pointer, size_t size);
 
+	// Maps copy-on-write forks of all areas of source into this context.
+	// Used by clone() and to instantiate pre-built mapping templates.
+	void forkAreasFrom(const VmContext &source);
+
 private:
 	struct Area {
 		bool copyOnWrite;
@@ -52,6 +56,8 @@ private:
 		uint32_t nativeFlags;
 		helix::UniqueDescriptor fileView;
 		helix::UniqueDescriptor copyView;
+		// Offset of the area within copyView.
+		uintptr_t copyOffset;
 		smarter::shared_ptr<File, FileHandle> file;
 		intptr_t offset;
 	};
@@ -387,6 +393,14 @@ struct Process : std::enable_shared_from_this<Process> {
 
 	static std::shared_ptr<Process> fork(std::shared_ptr<Process> parent);
 	static std::shared_ptr<Process> clone(std::shared_ptr<Process> parent, void *ip, void *sp);
+	// Creates a child that shares the address space of the parent until it calls
+	// exec() or terminates; see waitForVforkRelease().
+	static std::shared_ptr<Process> vfork(std::shared_ptr<Process> parent);
+	// Creates a child that directly runs the given executable, without copying the
+	// address space of the parent. Equivalent to fork() followed by exec().
+	static async::result<frg::expected<Error, std::shared_ptr<Process>>>
+	spawn(std::shared_ptr<Process> parent, std::string path,
+			std::vector<std::string> args, std::vector<std::string> env);
 
 	static async::result<Error> exec(std::shared_ptr<Process> process,
 			std::string path, std::vector<std::string> args, std::vector<std::string> env);
@@ -489,6 +503,13 @@ public:
 		return _didExecute;
 	}
 
+	// Completes once a child created by vfork() stops using the parent's address space.
+	async::result<void> waitForVforkRelease() {
+		auto release = _vforkRelease;
+		if(release)
+			co_await release->wait();
+	}
+
 	std::string path() {
 		return _path;
 	}
@@ -665,6 +686,8 @@ public:
 	IntervalTimer realTimer;
 
 private:
+	void releaseVforkParent_();
+
 	Process *_parent;
 
 	std::shared_ptr<PidHull> _hull;
@@ -683,6 +706,8 @@ private:
 	std::shared_ptr<FileContext> _fileContext;
 	std::shared_ptr<SignalContext> _signalContext;
 	std::shared_ptr<procfs::Link> _procfs_dir;
+	// Set for children of vfork() until they call exec() or terminate.
+	std::shared_ptr<async::oneshot_event> _vforkRelease;
 
 	std::shared_ptr<ProcessGroup> _pgPointer;
 	boost::intrusive::list_member_hook<> _pgHook;
@@ -657,9 +657,13 @@ async::result<std::string> StatNode::show(Process *) {
 	stream << "0 "; // tty_nr
 	stream << "0 "; // tpgid
 	stream << "0 "; // flags
-	stream << "0 "; // minflt
+	// Terminated processes (e.g., zombies) no longer have an address space.
+	HelSpaceStats spaceStats{};
+	if(auto vmContext = _process->vmContext(); vmContext)
+		HEL_CHECK(helQuerySpaceStats(vmContext->getSpace().getHandle(), &spaceStats));
+	stream << spaceStats.minorFaults << " "; // minflt
 	stream << "0 "; // cminflt
-	stream << "0 "; // majflt
+	stream << spaceStats.majorFaults << " "; // majflt
 	stream << "0 "; // cmajflt
 	stream << _process->accumulatedUsage().userTime << " "; // utime
 	stream << "0 "; // stime
@@ -578,6 +578,8 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 				nativeFlags |= kHelMapFixedNoReplace;
 			else if(req->flags() & MAP_FIXED)
 				nativeFlags |= kHelMapFixed;
+			if(req->flags() & MAP_POPULATE)
+				nativeFlags |= kHelMapPopulate;
 
 			bool copyOnWrite;
 			if((req->flags() & (MAP_PRIVATE | MAP_SHARED)) == MAP_PRIVATE) {
@@ -2777,7 +2779,8 @@ async::result<void> serveRequests(std::shared_ptr<Process> self,
 					co_await sendErrorResponse(managarm::posix::Errors::ILLEGAL_ARGUMENTS);
 					continue;
 				}
-			} else if (req->domain() == AF_INET || req->domain() == AF_PACKET) {
+			} else if (req->domain() == AF_INET || req->domain() == AF_INET6
+					|| req->domain() == AF_PACKET) {
 				file = co_await extern_socket::createSocket(
 					co_await net::getNetLane(),
 					req->domain(),
@@ -91,6 +91,15 @@ public:
 		co_return Error::success;
 	}
 
+	// Called when the contents of the node change.
+	void updateModificationTime() {
+		struct timespec time;
+		// TODO: Move to CLOCK_REALTIME when supported
+		clock_gettime(CLOCK_MONOTONIC, &time);
+		_mtime = time;
+		_ctime = time;
+	}
+
 	async::result<Error> utimensat(uint64_t atime_sec, uint64_t atime_nsec, uint64_t mtime_sec, uint64_t mtime_nsec) override {
 		if(atime_sec != UTIME_NOW || atime_nsec != UTIME_NOW || mtime_sec != UTIME_NOW || mtime_nsec != UTIME_NOW) {
 			std::cout << "\e[31m" "tmp_fs: utimensat() only supports setting atime and mtime to current time" "\e[39m" << std::endl;
@@ -449,6 +458,8 @@ public:
 
 	async::result<frg::expected<protocols::fs::Error>> allocate(int64_t offset, size_t size) override;
 
+	async::result<frg::expected<protocols::fs::Error>> punchHole(int64_t offset, size_t size) override;
+
 	FutureMaybe<helix::UniqueDescriptor> accessMemory() override;
 
 	helix::BorrowedDescriptor getPassthroughLane() override {
@@ -507,28 +518,26 @@ struct MemoryNode final : Node {
 	}
 
 private:
-	void _resizeFile(size_t new_size) {
-		_fileSize = new_size;
-
-		size_t aligned_size = (new_size + 0xFFF) & ~size_t(0xFFF);
-		if(aligned_size <= _areaSize)
-			return;
-
-		if(_memory) {
-			HEL_CHECK(helResizeMemory(_memory.getHandle(), aligned_size));
-		}else{
-			HelHandle handle;
-			HEL_CHECK(helAllocateMemory(aligned_size, 0, nullptr, &handle));
-			_memory = helix::UniqueDescriptor{handle};
-		}
+	// Files are backed by a single memory object, such that they can be mapped.
+	// Its capacity grows geometrically and it is accessed through fixed-size windows
+	// that are mapped on demand; growing a file never remaps existing windows.
+	static constexpr size_t windowSize = 0x40000;
 
-		_mapping = helix::Mapping{_memory, 0, aligned_size};
-		_areaSize = aligned_size;
-	}
+	void _resizeFile(size_t new_size);
+	void _reserveCapacity(size_t size);
+
+	char *_window(size_t index);
+	template<typename F>
+	void _walkWindows(size_t offset, size_t length, F functor);
+
+	void _copyIn(size_t offset, const void *buffer, size_t length);
+	void _copyOut(size_t offset, void *buffer, size_t length);
+	// Makes a range read as zero; releases the pages that it covers completely.
+	void _clearRange(size_t offset, size_t length);
 
 	helix::UniqueDescriptor _memory;
-	helix::Mapping _mapping;
-	size_t _areaSize;
+	std::vector<helix::Mapping> _windows;
+	size_t _capacity;
 	size_t _fileSize;
 };
 
@@ -603,12 +612,92 @@ private:
 // ----------------------------------------------------------------------------
 
 MemoryNode::MemoryNode(Superblock *superblock)
-: Node{superblock, FsNode::defaultSupportsObservers}, _areaSize{0}, _fileSize{0} { }
+: Node{superblock, FsNode::defaultSupportsObservers}, _capacity{0}, _fileSize{0} { }
 
 MemoryNode::~MemoryNode() {
 	notifyObservers(FsObserver::deleteSelfEvent, {}, 0);
 }
 
+void MemoryNode::_resizeFile(size_t new_size) {
+	// Data beyond the end of the file needs to read as zero if the file grows again.
+	if(new_size < _fileSize) {
+		size_t aligned_size = (_fileSize + 0xFFF) & ~size_t(0xFFF);
+		_clearRange(new_size, aligned_size - new_size);
+	}else{
+		_reserveCapacity(new_size);
+	}
+	_fileSize = new_size;
+}
+
+void MemoryNode::_reserveCapacity(size_t size) {
+	if(size <= _capacity)
+		return;
+
+	// Double the capacity to amortize the cost of appends.
+	size_t capacity = std::max((size + windowSize - 1) & ~(windowSize - 1), 2 * _capacity);
+	if(_memory) {
+		HEL_CHECK(helResizeMemory(_memory.getHandle(), capacity));
+	}else{
+		HelHandle handle;
+		HEL_CHECK(helAllocateMemory(capacity, 0, nullptr, &handle));
+		_memory = helix::UniqueDescriptor{handle};
+	}
+
+	_windows.resize(capacity / windowSize);
+	_capacity = capacity;
+}
+
+char *MemoryNode::_window(size_t index) {
+	assert(index < _windows.size());
+	if(!_windows[index])
+		_windows[index] = helix::Mapping{_memory, static_cast<ptrdiff_t>(index * windowSize),
+				windowSize};
+	return reinterpret_cast<char *>(_windows[index].get());
+}
+
+template<typename F>
+void MemoryNode::_walkWindows(size_t offset, size_t length, F functor) {
+	assert(offset + length <= _capacity);
+	size_t progress = 0;
+	while(progress < length) {
+		auto index = (offset + progress) / windowSize;
+		auto disp = (offset + progress) % windowSize;
+		auto chunk = std::min(length - progress, windowSize - disp);
+		functor(_window(index) + disp, progress, chunk);
+		progress += chunk;
+	}
+}
+
+void MemoryNode::_copyIn(size_t offset, const void *buffer, size_t length) {
+	_walkWindows(offset, length, [&] (char *window, size_t progress, size_t chunk) {
+		memcpy(window, static_cast<const char *>(buffer) + progress, chunk);
+	});
+}
+
+void MemoryNode::_copyOut(size_t offset, void *buffer, size_t length) {
+	_walkWindows(offset, length, [&] (char *window, size_t progress, size_t chunk) {
+		memcpy(static_cast<char *>(buffer) + progress, window, chunk);
+	});
+}
+
+void MemoryNode::_clearRange(size_t offset, size_t length) {
+	auto zero = [] (char *window, size_t, size_t chunk) {
+		memset(window, 0, chunk);
+	};
+
+	size_t end = offset + length;
+	size_t discardBegin = (offset + 0xFFF) & ~size_t(0xFFF);
+	size_t discardEnd = end & ~size_t(0xFFF);
+	if(discardBegin >= discardEnd) {
+		_walkWindows(offset, length, zero);
+		return;
+	}
+
+	_walkWindows(offset, discardBegin - offset, zero);
+	_walkWindows(discardEnd, end - discardEnd, zero);
+	HEL_CHECK(helDiscardMemory(_memory.getHandle(), discardBegin, discardEnd - discardBegin));
+}
+
 void MemoryFile::handleClose() {
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
 	if(flags_ & semanticWrite)
@@ -640,7 +729,7 @@ MemoryFile::readSome(Process *, void *buffer, size_t max_length) {
 		co_return 0;
 	auto chunk = std::min(node->_fileSize - _offset, max_length);
 
-	memcpy(buffer, reinterpret_cast<char *>(node->_mapping.get()) + _offset, chunk);
+	node->_copyOut(_offset, buffer, chunk);
 	_offset += chunk;
 	node->notifyObservers(FsObserver::accessEvent, associatedLink()->getName(), 0);
 	co_return chunk;
@@ -653,7 +742,8 @@ MemoryFile::writeAll(Process *, const void *buffer, size_t length) {
 	if(_offset + length > node->_fileSize)
 		node->_resizeFile(_offset + length);
 
-	memcpy(reinterpret_cast<char *>(node->_mapping.get()) + _offset, buffer, length);
+	node->_copyIn(_offset, buffer, length);
+	node->updateModificationTime();
 	_offset += length;
 	node->notifyObservers(FsObserver::modifyEvent, associatedLink()->getName(), 0);
 	co_return length;
@@ -667,7 +757,7 @@ MemoryFile::pread(Process *, int64_t offset, void *buffer, size_t length) {
 		co_return 0;
 	auto chunk = std::min(node->_fileSize - offset, length);
 
-	memcpy(buffer, reinterpret_cast<char *>(node->_mapping.get()) + offset, chunk);
+	node->_copyOut(offset, buffer, chunk);
 
 	co_return chunk;
 }
@@ -679,7 +769,8 @@ MemoryFile::pwrite(Process *, int64_t offset, const void *buffer, size_t length)
 	if(offset + length > node->_fileSize)
 		node->_resizeFile(offset + length);
 
-	memcpy(reinterpret_cast<char *>(node->_mapping.get()) + offset, buffer, length);
+	node->_copyIn(offset, buffer, length);
+	node->updateModificationTime();
 	co_return length;
 }
 
@@ -688,6 +779,7 @@ MemoryFile::truncate(size_t size) {
 	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
 
 	node->_resizeFile(size);
+	node->updateModificationTime();
 	co_return {};
 }
 
@@ -699,6 +791,22 @@ MemoryFile::allocate(int64_t offset, size_t size) {
 	if(offset + size <= node->_fileSize)
 		co_return {};
 	node->_resizeFile(offset + size);
+	node->updateModificationTime();
+	co_return {};
+}
+
+async::result<frg::expected<protocols::fs::Error>>
+MemoryFile::punchHole(int64_t offset, size_t size) {
+	auto node = static_cast<MemoryNode *>(associatedLink()->getTarget().get());
+
+	if(offset < 0)
+		co_return protocols::fs::Error::illegalArguments;
+	// Beyond the end of the file, the memory already reads as zero.
+	if(static_cast<size_t>(offset) >= node->_fileSize)
+		co_return {};
+	node->_clearRange(offset, std::min(size, node->_fileSize - offset));
+	node->updateModificationTime();
+	node->notifyObservers(FsObserver::modifyEvent, associatedLink()->getName(), 0);
 	co_return {};
 }
 
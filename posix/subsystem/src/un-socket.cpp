@@ -13,6 +13,7 @@
 #include <bragi/helpers-std.hpp>
 #include <protocols/fs/common.hpp>
 #include <helix/ipc.hpp>
+#include "byte-ring.hpp"
 #include "fs.bragi.hpp"
 #include "un-socket.hpp"
 #include "process.hpp"
@@ -46,6 +47,42 @@ struct Packet {
 	size_t offset = 0;
 };
 
+// SOCK_STREAM sockets keep their data in a ByteRing. Ancillary data is stored
+// separately for ranges of the stream; consecutive writes share one chunk
+// unless their ancillary data differs. Reads never cross chunk boundaries.
+struct StreamChunk {
+	bool canMerge(const StreamChunk &other) const {
+		return files.empty() && other.files.empty()
+			&& senderPid == other.senderPid
+			&& senderUid == other.senderUid
+			&& senderGid == other.senderGid;
+	}
+
+	// Stream offset of the first byte.
+	uint64_t offset = 0;
+	size_t length = 0;
+
+	int senderPid = 0;
+	unsigned int senderUid = 0;
+	unsigned int senderGid = 0;
+
+	struct timeval recvTimestamp = {};
+
+	std::vector<smarter::shared_ptr<File, FileHandle>> files;
+};
+
+// Reader that blocks on an empty stream socket. Large writes are copied
+// straight into its buffer, bypassing the ring.
+struct PendingRead {
+	void *data;
+	size_t maxLength;
+	size_t length = 0;
+	StreamChunk chunk;
+};
+
+// Writes of at least this size are handed to a pending reader directly.
+constexpr size_t directCopyThreshold = 0x4000;
+
 struct OpenFile : File {
 	enum class State {
 		null,
@@ -126,6 +163,15 @@ public:
 		if(logSockets)
 			std::cout << "posix: Read from socket \e[1;34m" << structName() << "\e[0m" << std::endl;
 
+		if(socktype_ == SOCK_STREAM) {
+			if(_recvRing.empty() && nonBlock_)
+				co_return Error::wouldBlock;
+
+			// File descriptors that are read by read() are discarded.
+			auto result = co_await _recvStream(nullptr, 0, data, max_length, 0);
+			co_return std::get<protocols::fs::RecvData>(result).dataLength;
+		}
+
 		if(_recvQueue.empty() && nonBlock_) {
 			if(logSockets)
 				std::cout << "posix: UNIX socket would block" << std::endl;
@@ -136,24 +182,13 @@ public:
 			co_await _statusBell.async_wait();
 
 		auto packet = &_recvQueue.front();
-		if(socktype_ == SOCK_STREAM) {
-			assert(packet->files.empty());
-
-			auto chunk = std::min(packet->buffer.size() - packet->offset, max_length);
-			memcpy(data, packet->buffer.data() + packet->offset, chunk);
-			packet->offset += chunk;
-			if(packet->offset == packet->buffer.size())
-				_recvQueue.pop_front();
-			co_return chunk;
-		} else {
-			assert(!packet->offset);
-			assert(packet->files.empty());
-			auto size = packet->buffer.size();
-			assert(max_length >= size);
-			memcpy(data, packet->buffer.data(), size);
-			_recvQueue.pop_front();
-			co_return size;
-		}
+		assert(!packet->offset);
+		assert(packet->files.empty());
+		auto size = packet->buffer.size();
+		assert(max_length >= size);
+		memcpy(data, packet->buffer.data(), size);
+		_recvQueue.pop_front();
+		co_return size;
 	}
 
 	async::result<frg::expected<Error, size_t>>
@@ -164,6 +199,15 @@ public:
 		if(logSockets)
 			std::cout << "posix: Write to socket \e[1;34m" << structName() << "\e[0m" << std::endl;
 
+		if(socktype_ == SOCK_STREAM) {
+			StreamChunk chunk;
+			chunk.senderPid = process->pid();
+			chunk.senderUid = process->uid();
+			chunk.senderGid = process->gid();
+			_remote->_pushStream(data, length, std::move(chunk));
+			co_return length;
+		}
+
 		Packet packet;
 		packet.senderPid = process->pid();
 		packet.buffer.resize(length);
@@ -188,12 +232,18 @@ public:
 		if(socktype_ == SOCK_STREAM && _currentState != State::connected && _currentState != State::remoteShutDown)
 			co_return protocols::fs::Error::notConnected;
 
-		if(socktype_ == SOCK_STREAM && _recvQueue.empty() && _currentState == State::remoteShutDown)
+		if(socktype_ == SOCK_STREAM && _recvRing.empty() && _currentState == State::remoteShutDown)
 			co_return protocols::fs::RecvData{{}, 0, 0, 0};
 
 		if(logSockets)
 			std::cout << "posix: Recv from socket \e[1;34m" << structName() << "\e[0m" << std::endl;
 
+		if(socktype_ == SOCK_STREAM) {
+			if(_recvRing.empty() && ((flags & MSG_DONTWAIT) || nonBlock_))
+				co_return protocols::fs::Error::wouldBlock;
+			co_return co_await _recvStream(process, flags, data, max_length, max_ctrl_length);
+		}
+
 		if(_recvQueue.empty() && ((flags & MSG_DONTWAIT) || nonBlock_)) {
 			if(logSockets)
 				std::cout << "posix: UNIX socket would block" << std::endl;
@@ -250,23 +300,14 @@ public:
 		}
 
 		// datagram packets are always read from their beginning, so offsets are illegal
-		assert(!packet->offset || socktype_ == SOCK_STREAM);
-		auto data_length = packet->buffer.size() - packet->offset;
-		auto chunk = std::min(packet->buffer.size() - packet->offset, max_length);
-		memcpy(data, packet->buffer.data() + packet->offset, chunk);
+		assert(!packet->offset);
+		auto data_length = packet->buffer.size();
+		auto chunk = std::min(packet->buffer.size(), max_length);
+		memcpy(data, packet->buffer.data(), chunk);
 
-		if(socktype_ == SOCK_STREAM) {
-			returned_length = chunk;
-			if(!(flags & MSG_PEEK)) {
-				packet->offset += chunk;
-				if(packet->offset == packet->buffer.size())
-					_recvQueue.pop_front();
-			}
-		} else {
-			returned_length = (flags & MSG_TRUNC) ? data_length : chunk;
-			if(!(flags & MSG_PEEK))
-				_recvQueue.pop_front();
-		}
+		returned_length = (flags & MSG_TRUNC) ? data_length : chunk;
+		if(!(flags & MSG_PEEK))
+			_recvQueue.pop_front();
 
 		if(data_length != returned_length)
 			reply_flags |= MSG_TRUNC;
@@ -340,6 +381,16 @@ public:
 		// We ignore MSG_DONTWAIT here as we never block anyway.
 
 		// TODO: Add permission checking for ucred related items
+		if(socktype_ == SOCK_STREAM) {
+			StreamChunk chunk;
+			chunk.senderPid = ucreds.pid;
+			chunk.senderUid = ucreds.uid;
+			chunk.senderGid = ucreds.gid;
+			chunk.files = std::move(files);
+			remote->_pushStream(data, max_length, std::move(chunk));
+			co_return max_length;
+		}
+
 		Packet packet;
 		packet.senderPid = ucreds.pid;
 		packet.senderUid = ucreds.uid;
@@ -424,7 +475,7 @@ public:
 			if(_currentState == State::remoteShutDown)
 				events |= EPOLLHUP | EPOLLIN;
 		}
-		if(!_acceptQueue.empty() || !_recvQueue.empty())
+		if(!_acceptQueue.empty() || !_recvQueue.empty() || !_recvRing.empty())
 			events |= EPOLLIN;
 
 		co_return PollStatusResult{_currentSeq, events};
@@ -657,6 +708,8 @@ public:
 
 					if(_currentState != State::connected) {
 						resp.set_error(managarm::fs::Errors::NOT_CONNECTED);
+					} else if(socktype_ == SOCK_STREAM) {
+						resp.set_fionread_count(_recvRing.size());
 					} else if(_recvQueue.empty()) {
 						resp.set_fionread_count(0);
 					} else {
@@ -691,6 +744,140 @@ public:
 	}
 
 private:
+	// Appends a write to the receive queue of a stream socket.
+	void _pushStream(const void *data, size_t length, StreamChunk chunk) {
+		if(!length)
+			return;
+
+		auto now = clk::getRealtime();
+		TIMESPEC_TO_TIMEVAL(&chunk.recvTimestamp, &now);
+
+		auto bytes = static_cast<const char *>(data);
+		if(_pendingRead && _recvRing.empty() && length >= directCopyThreshold) {
+			auto pending = std::exchange(_pendingRead, nullptr);
+			pending->length = std::min(length, pending->maxLength);
+			memcpy(pending->data, bytes, pending->length);
+			_recvRing.skip(pending->length);
+
+			// Ancillary data belongs to the first byte of the write.
+			pending->chunk = chunk;
+			pending->chunk.offset = _recvRing.head() - pending->length;
+			pending->chunk.length = pending->length;
+			chunk.files.clear();
+
+			bytes += pending->length;
+			length -= pending->length;
+		}
+
+		if(length) {
+			chunk.offset = _recvRing.tail();
+			chunk.length = length;
+			if(!_recvChunks.empty() && _recvChunks.back().canMerge(chunk)) {
+				_recvChunks.back().length += length;
+			}else{
+				_recvChunks.push_back(std::move(chunk));
+			}
+			_recvRing.push(bytes, length);
+		}
+
+		_inSeq = ++_currentSeq;
+		_statusBell.raise();
+	}
+
+	// Receives from a stream socket; returns at most the remainder of one chunk.
+	// If process is null, no control messages are generated.
+	async::result<protocols::fs::RecvResult>
+	_recvStream(Process *process, uint32_t flags, void *data, size_t max_length,
+			size_t max_ctrl_length) {
+		PendingRead pending{data, max_length};
+		while(_recvRing.empty()) {
+			if(_currentState != State::connected)
+				co_return protocols::fs::RecvData{{}, 0, 0, 0};
+
+			bool direct = !(flags & MSG_PEEK) && max_length && !_pendingRead;
+			if(direct)
+				_pendingRead = &pending;
+			co_await _statusBell.async_wait();
+			if(_pendingRead == &pending)
+				_pendingRead = nullptr;
+
+			if(pending.length) {
+				uint32_t reply_flags = 0;
+				auto ctrl = _streamCtrl(process, flags, pending.chunk, max_ctrl_length, reply_flags);
+				co_return protocols::fs::RecvData{std::move(ctrl), pending.length, 0, reply_flags};
+			}
+		}
+
+		auto &chunk = _recvChunks.front();
+		assert(chunk.offset <= _recvRing.head());
+		assert(_recvRing.head() < chunk.offset + chunk.length);
+		auto length = std::min(chunk.offset + chunk.length - _recvRing.head(), uint64_t{max_length});
+
+		uint32_t reply_flags = 0;
+		auto ctrl = _streamCtrl(process, flags, chunk, max_ctrl_length, reply_flags);
+
+		_recvRing.peek(data, length);
+		if(!(flags & MSG_PEEK)) {
+			_recvRing.consume(length);
+			if(_recvRing.head() == chunk.offset + chunk.length)
+				_recvChunks.pop_front();
+		}
+
+		co_return protocols::fs::RecvData{std::move(ctrl), length, 0, reply_flags};
+	}
+
+	std::vector<char> _streamCtrl(Process *process, uint32_t flags, StreamChunk &chunk,
+			size_t max_ctrl_length, uint32_t &reply_flags) {
+		if(!process) {
+			chunk.files.clear();
+			return {};
+		}
+
+		protocols::fs::CtrlBuilder ctrl{max_ctrl_length};
+
+		if(_passCreds) {
+			struct ucred creds;
+			memset(&creds, 0, sizeof(struct ucred));
+			creds.pid = chunk.senderPid;
+			creds.uid = chunk.senderUid;
+			creds.gid = chunk.senderGid;
+
+			auto truncated = ctrl.message(SOL_SOCKET, SCM_CREDENTIALS, sizeof(struct ucred));
+			if(truncated)
+				reply_flags |= MSG_CTRUNC;
+			else
+				ctrl.write(creds);
+		}
+
+		if(timestamp_) {
+			auto truncated = ctrl.message(SOL_SOCKET, SCM_TIMESTAMP, sizeof(struct timeval));
+			if(!truncated)
+				ctrl.write(chunk.recvTimestamp);
+		}
+
+		if(!chunk.files.empty()) {
+			auto [truncated, payload_len] = ctrl.message_truncated(SOL_SOCKET, SCM_RIGHTS, sizeof(int) * chunk.files.size(), sizeof(int));
+			assert(!(payload_len % sizeof(int)));
+			for(auto &file : chunk.files) {
+				if(truncated && payload_len < sizeof(int))
+					break;
+
+				ctrl.write<int>(process->fileContext()->attachFile(std::move(file), flags & MSG_CMSG_CLOEXEC));
+
+				if(truncated)
+					payload_len -= sizeof(int);
+			}
+
+			if(truncated)
+				reply_flags |= MSG_CTRUNC;
+
+			if(!(flags & MSG_PEEK))
+				chunk.files.clear();
+		}
+
+		return ctrl.buffer();
+	}
+
 	static size_t getNameFor(OpenFile *sock, void *addrPtr, size_t maxAddrLength) {
 		sockaddr_un sa;
 		size_t outSize = offsetof(sockaddr_un, sun_path) + sock->_sockpath.size() + 1;
@@ -747,9 +934,14 @@ private:
 	// TODO: Use weak_ptrs here!
 	std::deque<OpenFile *> _acceptQueue;
 
-	// The actual receive queue of the socket.
+	// The actual receive queue of the socket (except for SOCK_STREAM).
 	std::deque<Packet> _recvQueue;
 
+	// Receive queue of SOCK_STREAM sockets and the ancillary data of its contents.
+	ByteRing _recvRing;
+	std::deque<StreamChunk> _recvChunks;
+	PendingRead *_pendingRead = nullptr;
+
 	int _ownerPid;
 
 	// For connected sockets, this is the socket we are connected to.
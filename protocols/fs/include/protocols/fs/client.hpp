@@ -50,6 +50,15 @@ struct File {
 	async::result<frg::expected<Error, size_t>>
 	recvfrom(void *buf, size_t len, int flags, struct sockaddr *addr_ptr, socklen_t addr_length);
 
+	// Like sendmmsg() and recvmmsg(), but with a single SendMsgBatchRequest or
+	// RecvMsgBatchRequest. Returns the number of messages that were transferred
+	// and sets their msg_len. Control messages are only supported for receiving.
+	async::result<frg::expected<Error, size_t>>
+	sendMsgBatch(struct mmsghdr *msgs, size_t count, int flags);
+
+	async::result<frg::expected<Error, size_t>>
+	recvMsgBatch(struct mmsghdr *msgs, size_t count, int flags);
+
 private:
 	helix::UniqueDescriptor _lane;
 };
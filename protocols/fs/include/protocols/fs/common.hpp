@@ -143,6 +143,13 @@ struct RecvData {
 using RecvResult = std::variant<Error, RecvData>;
 using SendResult = std::variant<Error, size_t>;
 
+// Upper bound on the number of messages in RecvMsgBatchRequest and SendMsgBatchRequest
+// (this matches UIO_MAXIOV, which Linux uses to limit recvmmsg() and sendmmsg()).
+constexpr size_t maxMsgBatch = 1024;
+// Upper bound on the total size of the payloads, addresses and control messages
+// of a batch. Servers reject larger batches with ILLEGAL_ARGUMENT.
+constexpr size_t maxMsgBatchBytes = 4 * 1024 * 1024;
+
 struct CtrlBuilder {
 	CtrlBuilder(size_t max_size)
 	: _maxSize{max_size}, _offset{0} { }
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace protocols::fs {
@@ -11,4 +12,20 @@ struct StatusPage {
 	int status;
 };
 
+// Server-wide table of status slots, shared by all files of a server.
+// Each slot has the layout of a StatusPage but is padded to a cache line.
+// The first slot is the header; its sequence counts updates to all other slots
+// such that clients can wait for changes to any of their files at once.
+constexpr size_t statusTableSize = 0x10000;
+constexpr size_t statusSlotSize = 64;
+constexpr size_t numStatusSlots = statusTableSize / statusSlotSize;
+
+struct alignas(statusSlotSize) StatusSlot {
+	uint64_t seqlock;
+	uint64_t sequence;
+	int flags;
+	int status;
+};
+static_assert(sizeof(StatusSlot) == statusSlotSize);
+
 } // namespace protocols::fs
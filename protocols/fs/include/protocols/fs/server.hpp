@@ -6,6 +6,7 @@
 #include <time.h>
 
 #include <async/cancellation.hpp>
+#include <async/recurring-event.hpp>
 #include <async/result.hpp>
 #include <frg/expected.hpp>
 #include <helix/ipc.hpp>
@@ -15,6 +16,8 @@
 #include <smarter.hpp>
 #include <deque>
 #include <memory>
+#include <utility>
+#include <vector>
 
 namespace managarm::fs {
 	struct CntRequest;
@@ -102,7 +105,7 @@ struct FileOperations {
 		return *this;
 	}
 	constexpr FileOperations &withFallocate(async::result<frg::expected<protocols::fs::Error>> (*f)(void *object,
-			int64_t offset, size_t size)) {
+			int mode, int64_t offset, size_t size)) {
 		fallocate = f;
 		return *this;
 	}
@@ -156,7 +159,7 @@ struct FileOperations {
 	async::result<ReadEntriesResult> (*readEntries)(void *object) = nullptr;
 	async::result<helix::BorrowedDescriptor>(*accessMemory)(void *object) = nullptr;
 	async::result<frg::expected<protocols::fs::Error>> (*truncate)(void *object, size_t size) = nullptr;
-	async::result<frg::expected<protocols::fs::Error>> (*fallocate)(void *object, int64_t offset, size_t size) = nullptr;
+	async::result<frg::expected<protocols::fs::Error>> (*fallocate)(void *object, int mode, int64_t offset, size_t size) = nullptr;
 	async::result<void> (*ioctl)(void *object, uint32_t id, helix_ng::RecvInlineResult req,
 			helix::UniqueLane conversation) = nullptr;
 	async::result<protocols::fs::Error> (*flock)(void *object, int flags) = nullptr;
@@ -203,6 +206,79 @@ private:
 	helix::Mapping _mapping;
 };
 
+// Publishes the status of many files in a single StatusSlot table.
+// Clients map the table once per server and wait for changes to any slot
+// through a single STATUS_TABLE_WAIT request.
+struct StatusTableProvider {
+	StatusTableProvider();
+
+	StatusTableProvider(const StatusTableProvider &) = delete;
+	StatusTableProvider &operator= (const StatusTableProvider &) = delete;
+
+	helix::BorrowedDescriptor getMemory() {
+		return _memory;
+	}
+
+	// Returns zero if all slots are in use.
+	size_t allocate();
+	void free(size_t slot);
+
+	void update(size_t slot, uint64_t sequence, int status);
+
+	// Waits until any slot was updated after the header sequence was observed.
+	// Returns the new header sequence.
+	async::result<uint64_t> waitForChange(uint64_t sequence,
+			async::cancellation_token cancellation = {});
+
+private:
+	helix::UniqueDescriptor _memory;
+	helix::Mapping _mapping;
+	std::vector<size_t> _freeSlots;
+	size_t _nextSlot = 1;
+	async::recurring_event _changeEvent;
+};
+
+// Owns a slot of a StatusTableProvider; the slot is released on destruction.
+struct StatusTableSlot {
+	StatusTableSlot() = default;
+
+	StatusTableSlot(StatusTableProvider *table)
+	: _table{table}, _index{table->allocate()} { }
+
+	StatusTableSlot(const StatusTableSlot &) = delete;
+
+	StatusTableSlot(StatusTableSlot &&other)
+	: _table{std::exchange(other._table, nullptr)}, _index{std::exchange(other._index, 0)} { }
+
+	~StatusTableSlot() {
+		if(_index)
+			_table->free(_index);
+	}
+
+	StatusTableSlot &operator= (StatusTableSlot other) {
+		std::swap(_table, other._table);
+		std::swap(_index, other._index);
+		return *this;
+	}
+
+	explicit operator bool () const {
+		return _index;
+	}
+
+	size_t index() const {
+		return _index;
+	}
+
+	void update(uint64_t sequence, int status) {
+		if(_index)
+			_table->update(_index, sequence, status);
+	}
+
+private:
+	StatusTableProvider *_table = nullptr;
+	size_t _index = 0;
+};
+
 struct NodeOperations {
 	async::result<FileStats> (*getStats)(std::shared_ptr<void> object);
 
@@ -1,6 +1,9 @@
 
+#include <assert.h>
+#include <algorithm>
 #include <iostream>
 
+#include <bragi/helpers-std.hpp>
 #include "fs.bragi.hpp"
 #include "protocols/fs/client.hpp"
 
@@ -329,5 +332,162 @@ File::recvfrom(void *buf, size_t len, int flags, struct sockaddr *addr_ptr, sock
 	co_return resp.ret_val();
 }
 
+namespace {
+
+size_t iovLength(const struct msghdr &hdr) {
+	size_t length = 0;
+	for(size_t i = 0; i < hdr.msg_iovlen; i++)
+		length += hdr.msg_iov[i].iov_len;
+	return length;
+}
+
+// Upper bound on the encoded size of a batch reply's tail: each of its arrays
+// takes at most one (varint-encoded) element per message.
+size_t maxBatchReplyTail(size_t count) {
+	return 64 + 4 * 10 * count;
+}
+
+} // anonymous namespace
+
+async::result<frg::expected<Error, size_t>>
+File::sendMsgBatch(struct mmsghdr *msgs, size_t count, int flags) {
+	managarm::fs::SendMsgBatchRequest req;
+	req.set_flags(flags);
+
+	// The payloads and addresses of all messages are sent back to back.
+	std::vector<char> data;
+	std::vector<char> addrs;
+	for(size_t i = 0; i < count; i++) {
+		auto &hdr = msgs[i].msg_hdr;
+		for(size_t j = 0; j < hdr.msg_iovlen; j++) {
+			auto base = reinterpret_cast<char *>(hdr.msg_iov[j].iov_base);
+			data.insert(data.end(), base, base + hdr.msg_iov[j].iov_len);
+		}
+		auto name = reinterpret_cast<char *>(hdr.msg_name);
+		addrs.insert(addrs.end(), name, name + hdr.msg_namelen);
+		req.add_sizes(iovLength(hdr));
+		req.add_addr_sizes(hdr.msg_namelen);
+	}
+
+	std::vector<uint8_t> tail(maxBatchReplyTail(count));
+	auto [offer, send_head, send_tail, send_data, imbue_creds, send_addrs, recv_resp, recv_tail] =
+	    co_await helix_ng::exchangeMsgs(
+	        _lane,
+	        helix_ng::offer(
+	            helix_ng::sendBragiHeadTail(req, frg::stl_allocator{}),
+	            helix_ng::sendBuffer(data.data(), data.size()),
+	            helix_ng::imbueCredentials(),
+	            helix_ng::sendBuffer(addrs.data(), addrs.size()),
+	            helix_ng::recvInline(),
+	            helix_ng::recvBuffer(tail.data(), tail.size())
+	        )
+	    );
+
+	HEL_CHECK(offer.error());
+	HEL_CHECK(send_head.error());
+	HEL_CHECK(send_tail.error());
+	// The server does not take the payloads of rejected batches; in this case,
+	// send_data and send_addrs fail and the reply carries the error.
+	HEL_CHECK(imbue_creds.error());
+	HEL_CHECK(recv_resp.error());
+	HEL_CHECK(recv_tail.error());
+
+	tail.resize(recv_tail.actualLength());
+	auto resp = *bragi::parse_head_tail<managarm::fs::SendMsgBatchReply>(recv_resp, tail);
+	if(resp.error() != managarm::fs::Errors::SUCCESS)
+		co_return static_cast<Error>(resp.error());
+
+	assert(resp.sizes().size() <= count);
+	for(size_t i = 0; i < resp.sizes().size(); i++)
+		msgs[i].msg_len = resp.sizes()[i];
+	co_return resp.sizes().size();
+}
+
+async::result<frg::expected<Error, size_t>>
+File::recvMsgBatch(struct mmsghdr *msgs, size_t count, int flags) {
+	managarm::fs::RecvMsgBatchRequest req;
+	req.set_flags(flags);
+
+	size_t dataSize = 0;
+	size_t addrSize = 0;
+	size_t ctrlSize = 0;
+	for(size_t i = 0; i < count; i++) {
+		auto &hdr = msgs[i].msg_hdr;
+		req.add_sizes(iovLength(hdr));
+		req.add_addr_sizes(hdr.msg_namelen);
+		req.add_ctrl_sizes(hdr.msg_controllen);
+		dataSize += iovLength(hdr);
+		addrSize += hdr.msg_namelen;
+		ctrlSize += hdr.msg_controllen;
+	}
+
+	std::vector<uint8_t> tail(maxBatchReplyTail(count));
+	std::vector<char> data(dataSize);
+	std::vector<char> addrs(addrSize);
+	std::vector<char> ctrl(ctrlSize);
+	auto [offer, send_head, send_tail, imbue_creds, recv_resp, recv_tail,
+			recv_addrs, recv_data, recv_ctrl] =
+	    co_await helix_ng::exchangeMsgs(
+	        _lane,
+	        helix_ng::offer(
+	            helix_ng::sendBragiHeadTail(req, frg::stl_allocator{}),
+	            helix_ng::imbueCredentials(),
+	            helix_ng::recvInline(),
+	            helix_ng::recvBuffer(tail.data(), tail.size()),
+	            helix_ng::recvBuffer(addrs.data(), addrs.size()),
+	            helix_ng::recvBuffer(data.data(), data.size()),
+	            helix_ng::recvBuffer(ctrl.data(), ctrl.size())
+	        )
+	    );
+
+	HEL_CHECK(offer.error());
+	HEL_CHECK(send_head.error());
+	HEL_CHECK(send_tail.error());
+	HEL_CHECK(imbue_creds.error());
+	HEL_CHECK(recv_resp.error());
+	HEL_CHECK(recv_tail.error());
+	HEL_CHECK(recv_addrs.error());
+	HEL_CHECK(recv_data.error());
+	HEL_CHECK(recv_ctrl.error());
+
+	tail.resize(recv_tail.actualLength());
+	auto resp = *bragi::parse_head_tail<managarm::fs::RecvMsgBatchReply>(recv_resp, tail);
+	if(resp.error() != managarm::fs::Errors::SUCCESS)
+		co_return static_cast<Error>(resp.error());
+
+	// Scatter the messages, which the server sends back to back, into the caller's buffers.
+	size_t received = resp.ret_vals().size();
+	assert(received <= count);
+	size_t dataOffset = 0;
+	size_t addrOffset = 0;
+	size_t ctrlOffset = 0;
+	for(size_t i = 0; i < received; i++) {
+		auto &hdr = msgs[i].msg_hdr;
+
+		auto dataLength = std::min(size_t(resp.ret_vals()[i]), iovLength(hdr));
+		size_t copied = 0;
+		for(size_t j = 0; j < hdr.msg_iovlen && copied < dataLength; j++) {
+			auto chunk = std::min(hdr.msg_iov[j].iov_len, dataLength - copied);
+			memcpy(hdr.msg_iov[j].iov_base, data.data() + dataOffset + copied, chunk);
+			copied += chunk;
+		}
+		dataOffset += dataLength;
+
+		auto addrLength = std::min(size_t(resp.addr_sizes()[i]), size_t(hdr.msg_namelen));
+		memcpy(hdr.msg_name, addrs.data() + addrOffset, addrLength);
+		addrOffset += addrLength;
+
+		auto ctrlLength = resp.ctrl_sizes()[i];
+		memcpy(hdr.msg_control, ctrl.data() + ctrlOffset, ctrlLength);
+		ctrlOffset += ctrlLength;
+
+		msgs[i].msg_len = dataLength;
+		hdr.msg_namelen = resp.addr_sizes()[i];
+		hdr.msg_controllen = ctrlLength;
+		hdr.msg_flags = resp.flags()[i];
+	}
+	co_return received;
+}
+
 } } // namespace protocol::fs
 
@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <algorithm>
 #include <iostream>
 #include <vector>
 
@@ -48,6 +49,7 @@ protocols::ostrace::Vocabulary ostVocabulary{
 };
 
 bool ostraceInit = false;
+
 protocols::ostrace::Context ostContext{ostVocabulary};
 
 async::result<void> initOstrace() {
@@ -524,7 +526,8 @@ async::detached handlePassthrough(smarter::shared_ptr<void> file,
 			logBragiSerializedReply(ser);
 			co_return;
 		}
-		auto result = co_await file_ops->fallocate(file.get(), req.rel_offset(), req.size());
+		auto result = co_await file_ops->fallocate(file.get(), req.fallocate_mode(),
+				req.rel_offset(), req.size());
 
 		managarm::fs::SvrResponse resp;
 
@@ -532,6 +535,8 @@ async::detached handlePassthrough(smarter::shared_ptr<void> file,
 			resp.set_error(managarm::fs::Errors::SUCCESS);
 		} else if(result.error() == protocols::fs::Error::insufficientPermissions) {
 			resp.set_error(managarm::fs::Errors::INSUFFICIENT_PERMISSIONS);
+		} else if(result.error() == protocols::fs::Error::illegalOperationTarget) {
+			resp.set_error(managarm::fs::Errors::ILLEGAL_OPERATION_TARGET);
 		} else {
 			resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
 		}
@@ -1164,6 +1169,219 @@ async::detached handleMessages(smarter::shared_ptr<void> file,
 		);
 		HEL_CHECK(send_resp.error());
 		logBragiSerializedReply(ser);
+	} else if(preamble.id() == managarm::fs::RecvMsgBatchRequest::message_id) {
+		std::vector<uint8_t> tail(preamble.tail_size());
+		auto [recv_tail] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::recvBuffer(tail.data(), tail.size())
+		);
+		HEL_CHECK(recv_tail.error());
+		logBragiRequest(tail);
+
+		auto req = bragi::parse_head_tail<managarm::fs::RecvMsgBatchRequest>(recv_req, tail);
+		recv_req.reset();
+
+		if(!req) {
+			std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+			co_return;
+		}
+
+		auto [extract_creds] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::extractCredentials()
+		);
+		HEL_CHECK(extract_creds.error());
+
+		managarm::fs::RecvMsgBatchReply resp;
+
+		auto count = req->sizes().size();
+		if(!file_ops->recvMsg) {
+			resp.set_error(managarm::fs::Errors::ILLEGAL_OPERATION_TARGET);
+		}else if(!count || count > maxMsgBatch
+				|| req->addr_sizes().size() != count
+				|| req->ctrl_sizes().size() != count) {
+			resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+		}else{
+			resp.set_error(managarm::fs::Errors::SUCCESS);
+			size_t batchSize = 0;
+			for(size_t i = 0; i < count; i++) {
+				// Check each size on its own so that the sum cannot overflow.
+				if(req->sizes()[i] > maxMsgBatchBytes
+						|| req->addr_sizes()[i] > maxMsgBatchBytes
+						|| req->ctrl_sizes()[i] > maxMsgBatchBytes) {
+					resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+					break;
+				}
+				batchSize += req->sizes()[i] + req->addr_sizes()[i] + req->ctrl_sizes()[i];
+				if(batchSize > maxMsgBatchBytes) {
+					resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+					break;
+				}
+			}
+		}
+
+		// Payloads, addresses and control messages of all messages, back to back.
+		// If the request is rejected, these stay empty but are still sent.
+		std::vector<char> data;
+		std::vector<char> addrs;
+		std::vector<char> ctrl;
+
+		std::vector<char> buffer;
+		std::vector<char> addr;
+		for(size_t i = 0; i < count && resp.error() == managarm::fs::Errors::SUCCESS; i++) {
+			// With MSG_WAITFORONE, only block for the first message.
+			auto flags = req->flags() & ~uint32_t{MSG_WAITFORONE};
+			if(i && (req->flags() & MSG_WAITFORONE))
+				flags |= MSG_DONTWAIT;
+
+			buffer.resize(req->sizes()[i]);
+			addr.resize(req->addr_sizes()[i]);
+			auto result = co_await file_ops->recvMsg(file.get(),
+				extract_creds.credentials(), flags,
+				buffer.data(), buffer.size(),
+				addr.data(), addr.size(),
+				req->ctrl_sizes()[i]);
+
+			// Errors after the first message are dropped; like on Linux,
+			// the caller gets the messages that were received so far.
+			if(auto error = std::get_if<Error>(&result)) {
+				if(!i)
+					resp.set_error(*error | toFsError);
+				break;
+			}
+
+			auto &msg = std::get<RecvData>(result);
+			assert(msg.ctrl.size() <= req->ctrl_sizes()[i]);
+			auto dataLength = std::min(msg.dataLength, buffer.size());
+			auto addrLength = std::min(msg.addressLength, addr.size());
+			data.insert(data.end(), buffer.begin(), buffer.begin() + dataLength);
+			addrs.insert(addrs.end(), addr.begin(), addr.begin() + addrLength);
+			ctrl.insert(ctrl.end(), msg.ctrl.begin(), msg.ctrl.end());
+
+			resp.add_ret_vals(msg.dataLength);
+			resp.add_addr_sizes(msg.addressLength);
+			resp.add_ctrl_sizes(msg.ctrl.size());
+			resp.add_flags(msg.flags);
+		}
+
+		auto [send_head, send_tail, send_addrs, send_data, send_ctrl] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::sendBragiHeadTail(resp, frg::stl_allocator{}),
+			helix_ng::sendBuffer(addrs.data(), addrs.size()),
+			helix_ng::sendBuffer(data.data(), data.size()),
+			helix_ng::sendBuffer(ctrl.data(), ctrl.size())
+		);
+		HEL_CHECK(send_head.error());
+		HEL_CHECK(send_tail.error());
+		HEL_CHECK(send_addrs.error());
+		HEL_CHECK(send_data.error());
+		HEL_CHECK(send_ctrl.error());
+		logBragiReply(resp);
+	} else if(preamble.id() == managarm::fs::SendMsgBatchRequest::message_id) {
+		std::vector<uint8_t> tail(preamble.tail_size());
+		auto [recv_tail] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::recvBuffer(tail.data(), tail.size())
+		);
+		HEL_CHECK(recv_tail.error());
+		logBragiRequest(tail);
+
+		auto req = bragi::parse_head_tail<managarm::fs::SendMsgBatchRequest>(recv_req, tail);
+		recv_req.reset();
+
+		if(!req) {
+			std::cout << "posix: Rejecting request due to decoding failure" << std::endl;
+			co_return;
+		}
+
+		managarm::fs::SendMsgBatchReply resp;
+
+		auto count = req->sizes().size();
+		size_t dataSize = 0;
+		size_t addrSize = 0;
+		if(!file_ops->sendMsg) {
+			resp.set_error(managarm::fs::Errors::ILLEGAL_OPERATION_TARGET);
+		}else if(!count || count > maxMsgBatch || req->addr_sizes().size() != count) {
+			resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+		}else{
+			resp.set_error(managarm::fs::Errors::SUCCESS);
+			for(size_t i = 0; i < count; i++) {
+				// Check each size on its own so that the sum cannot overflow.
+				if(req->sizes()[i] > maxMsgBatchBytes
+						|| req->addr_sizes()[i] > maxMsgBatchBytes) {
+					resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+					break;
+				}
+				dataSize += req->sizes()[i];
+				addrSize += req->addr_sizes()[i];
+				if(dataSize + addrSize > maxMsgBatchBytes) {
+					resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+					break;
+				}
+			}
+		}
+
+		if(resp.error() != managarm::fs::Errors::SUCCESS) {
+			// Do not allocate buffers for a rejected request. Receiving into empty
+			// buffers fails with kHelErrBufferTooSmall on both sides; this consumes
+			// the client's payloads such that it still gets the reply.
+			auto [recv_data, extract_creds, recv_addrs, send_head, send_tail] =
+				co_await helix_ng::exchangeMsgs(
+					conversation,
+					helix_ng::recvBuffer(nullptr, 0),
+					helix_ng::extractCredentials(),
+					helix_ng::recvBuffer(nullptr, 0),
+					helix_ng::sendBragiHeadTail(resp, frg::stl_allocator{})
+				);
+			HEL_CHECK(send_head.error());
+			HEL_CHECK(send_tail.error());
+			logBragiReply(resp);
+			co_return;
+		}
+
+		std::vector<uint8_t> data(dataSize);
+		std::vector<uint8_t> addrs(addrSize);
+		auto [recv_data, extract_creds, recv_addrs] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::recvBuffer(data.data(), data.size()),
+			helix_ng::extractCredentials(),
+			helix_ng::recvBuffer(addrs.data(), addrs.size())
+		);
+		HEL_CHECK(recv_data.error());
+		HEL_CHECK(extract_creds.error());
+		HEL_CHECK(recv_addrs.error());
+
+		if(recv_data.actualLength() != data.size() || recv_addrs.actualLength() != addrs.size())
+			resp.set_error(managarm::fs::Errors::ILLEGAL_ARGUMENT);
+
+		size_t dataOffset = 0;
+		size_t addrOffset = 0;
+		for(size_t i = 0; i < count && resp.error() == managarm::fs::Errors::SUCCESS; i++) {
+			auto res = co_await file_ops->sendMsg(file.get(),
+				extract_creds.credentials(), req->flags(),
+				data.data() + dataOffset, req->sizes()[i],
+				addrs.data() + addrOffset, req->addr_sizes()[i],
+				{}, {});
+
+			// As for recvmmsg(), errors after the first message are dropped.
+			if(!res) {
+				if(!i)
+					resp.set_error(res.error() | toFsError);
+				break;
+			}
+
+			resp.add_sizes(res.value());
+			dataOffset += req->sizes()[i];
+			addrOffset += req->addr_sizes()[i];
+		}
+
+		auto [send_head, send_tail] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::sendBragiHeadTail(resp, frg::stl_allocator{})
+		);
+		HEL_CHECK(send_head.error());
+		HEL_CHECK(send_tail.error());
+		logBragiReply(resp);
 	} else if(preamble.id() == managarm::fs::IoctlRequest::message_id) {
 		auto req = bragi::parse_head_only<managarm::fs::IoctlRequest>(recv_req);
 		recv_req.reset();
@@ -1397,6 +1615,66 @@ void StatusPageProvider::update(uint64_t sequence, int status) {
 	__atomic_store_n(&page->seqlock, seqlock + 2, __ATOMIC_RELEASE);
 }
 
+StatusTableProvider::StatusTableProvider() {
+	HelHandle handle;
+	HEL_CHECK(helAllocateMemory(statusTableSize, 0, nullptr, &handle));
+	_memory = helix::UniqueDescriptor{handle};
+	_mapping = helix::Mapping{_memory, 0, statusTableSize};
+}
+
+size_t StatusTableProvider::allocate() {
+	if(!_freeSlots.empty()) {
+		auto slot = _freeSlots.back();
+		_freeSlots.pop_back();
+		return slot;
+	}
+	if(_nextSlot == numStatusSlots)
+		return 0;
+	return _nextSlot++;
+}
+
+void StatusTableProvider::free(size_t slot) {
+	assert(slot && slot < _nextSlot);
+	update(slot, 0, 0);
+	_freeSlots.push_back(slot);
+}
+
+void StatusTableProvider::update(size_t slot, uint64_t sequence, int status) {
+	auto slots = reinterpret_cast<protocols::fs::StatusSlot *>(_mapping.get());
+	auto entry = &slots[slot];
+
+	// Skip updates that do not change anything; this avoids spurious wake-ups.
+	if(__atomic_load_n(&entry->sequence, __ATOMIC_RELAXED) == sequence
+			&& __atomic_load_n(&entry->status, __ATOMIC_RELAXED) == status)
+		return;
+
+	// Same seqlock protocol as StatusPageProvider::update().
+	auto seqlock = __atomic_load_n(&entry->seqlock, __ATOMIC_RELAXED);
+	assert(!(seqlock & 1));
+	__atomic_store_n(&entry->seqlock, seqlock + 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	__atomic_store_n(&entry->sequence, sequence, __ATOMIC_RELAXED);
+	__atomic_store_n(&entry->status, status, __ATOMIC_RELAXED);
+
+	__atomic_store_n(&entry->seqlock, seqlock + 2, __ATOMIC_RELEASE);
+
+	// Bump the header sequence after the slot is consistent.
+	__atomic_fetch_add(&slots[0].sequence, 1, __ATOMIC_RELEASE);
+	_changeEvent.raise();
+}
+
+async::result<uint64_t> StatusTableProvider::waitForChange(uint64_t sequence,
+		async::cancellation_token cancellation) {
+	auto header = reinterpret_cast<protocols::fs::StatusSlot *>(_mapping.get());
+	while(true) {
+		auto current = __atomic_load_n(&header->sequence, __ATOMIC_RELAXED);
+		if(current != sequence || cancellation.is_cancellation_requested())
+			co_return current;
+		co_await _changeEvent.async_wait(cancellation);
+	}
+}
+
 async::detached serveNode(helix::UniqueLane lane, std::shared_ptr<void> node,
 		const NodeOperations *node_ops) {
 	while(true) {
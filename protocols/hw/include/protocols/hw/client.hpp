@@ -82,7 +82,8 @@ struct Device {
 	async::result<helix::UniqueDescriptor> accessBar(int index);
 	async::result<helix::UniqueDescriptor> accessExpansionRom();
 	async::result<helix::UniqueDescriptor> accessIrq(size_t index = 0);
-	async::result<helix::UniqueDescriptor> installMsi(int index);
+	// Delivers the MSI to the given CPU (if it can be targeted, otherwise to CPU 0).
+	async::result<helix::UniqueDescriptor> installMsi(int index, unsigned int cpu = 0);
 
 	async::result<DtInfo> getDtInfo();
 	async::result<helix::UniqueDescriptor> accessDtRegister(uint32_t index);
@@ -207,9 +207,10 @@ async::result<helix::UniqueDescriptor> Device::accessIrq(size_t index) {
 	co_return pull_irq.descriptor();
 }
 
-async::result<helix::UniqueDescriptor> Device::installMsi(int index) {
+async::result<helix::UniqueDescriptor> Device::installMsi(int index, unsigned int cpu) {
 	managarm::hw::InstallMsiRequest req;
 	req.set_index(index);
+	req.set_cpu(cpu);
 
 	auto [offer, send_req, recv_head] = co_await helix_ng::exchangeMsgs(
 			_lane,
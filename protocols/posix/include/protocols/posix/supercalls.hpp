@@ -19,6 +19,8 @@ inline constexpr uint32_t superSigAltStack = 12;
 inline constexpr uint32_t superSigSuspend = 13;
 inline constexpr uint32_t superGetTid = 14;
 inline constexpr uint32_t superSigGetPending = 15;
+inline constexpr uint32_t superVfork = 16;
+inline constexpr uint32_t superSpawn = 17;
 inline constexpr uint32_t superGetServerData = 64;
 
 } // namespace posix
@@ -55,12 +55,15 @@ struct InterruptTransfer {
 struct BulkTransfer {
 	BulkTransfer(XferFlags flags, arch::dma_buffer_view buffer)
 	: flags{flags}, buffer{buffer},
-			allowShortPackets{false}, lazyNotification{false} { }
+			allowShortPackets{false}, lazyNotification{false}, streamId{0} { }
 
 	XferFlags flags;
 	arch::dma_buffer_view buffer;
 	bool allowShortPackets;
 	bool lazyNotification;
+	// SuperSpeed bulk stream that the transfer is queued on (1-based).
+	// Must be zero iff the endpoint does not use streams.
+	uint16_t streamId;
 };
 
 enum class PipeType {
@@ -79,6 +82,11 @@ public:
 	virtual async::result<frg::expected<UsbError, size_t>> transfer(ControlTransfer info) = 0;
 	virtual async::result<frg::expected<UsbError, size_t>> transfer(InterruptTransfer info) = 0;
 	virtual async::result<frg::expected<UsbError, size_t>> transfer(BulkTransfer info) = 0;
+
+	// Number of bulk streams that the HCD has set up for this endpoint.
+	virtual size_t numStreams() {
+		return 0;
+	}
 };
 
 
@@ -89,6 +97,8 @@ struct Endpoint {
 	async::result<frg::expected<UsbError, size_t>> transfer(InterruptTransfer info) const;
 	async::result<frg::expected<UsbError, size_t>> transfer(BulkTransfer info) const;
 
+	size_t numStreams() const;
+
 private:
 	std::shared_ptr<EndpointData> _state;
 };
@@ -74,6 +74,7 @@ namespace descriptor_type {
 		string = 0x03,
 		interface = 0x04,
 		endpoint = 0x05,
+		ss_endpoint_companion = 0x30,
 
 		// TODO: Put non-standard descriptors somewhere else.
 		hid = 0x21,
@@ -116,4 +116,8 @@ async::result<frg::expected<UsbError, size_t>> Endpoint::transfer(BulkTransfer i
 	return _state->transfer(info);
 }
 
+size_t Endpoint::numStreams() const {
+	return _state->numStreams();
+}
+
 } // namespace protocols::usb
@@ -1,6 +1,7 @@
 
 #include <memory>
 #include <iostream>
+#include <type_traits>
 
 #include <string.h>
 
@@ -55,15 +56,20 @@ private:
 
 
 struct EndpointState final : EndpointData {
-	EndpointState(helix::UniqueLane lane)
-	:_lane(std::move(lane)) { }
+	EndpointState(helix::UniqueLane lane, size_t numStreams)
+	:_lane(std::move(lane)), _numStreams{numStreams} { }
 
 	async::result<frg::expected<UsbError, size_t>> transfer(ControlTransfer info) override;
 	async::result<frg::expected<UsbError, size_t>> transfer(InterruptTransfer info) override;
 	async::result<frg::expected<UsbError, size_t>> transfer(BulkTransfer info) override;
 
+	size_t numStreams() override {
+		return _numStreams;
+	}
+
 private:
 	helix::UniqueLane _lane;
+	size_t _numStreams;
 };
 
 arch::dma_pool *DeviceState::setupPool() {
@@ -298,7 +304,7 @@ InterfaceState::getEndpoint(PipeType type, int number) {
 
 	HEL_CHECK(pullLane.error());
 
-	auto state = std::make_shared<EndpointState>(pullLane.descriptor());
+	auto state = std::make_shared<EndpointState>(pullLane.descriptor(), resp->num_streams());
 	co_return Endpoint(std::move(state));
 }
 
@@ -315,6 +321,8 @@ doTransferOfType(auto &lane, managarm::usb::XferType type, XferInfo info) {
 	req.set_allow_short_packets(info.allowShortPackets);
 	req.set_lazy_notification(info.lazyNotification);
 	req.set_length(info.buffer.size());
+	if constexpr (std::is_same_v<XferInfo, BulkTransfer>)
+		req.set_stream_id(info.streamId);
 
 	if(info.flags == kXferToDevice) {
 		auto [offer, sendReq, sendData, recvResp] =
@@ -37,7 +37,7 @@ async::result<void> respondWithError(helix::UniqueDescriptor &conversation, UsbE
 }
 
 template <typename XferType>
-auto handleXferReq(auto req, auto &endpoint, auto &&...xferArgs) {
+XferType makeXfer(auto req, auto &&...xferArgs) {
 	XferType xfer{
 		req->dir() == managarm::usb::XferDirection::TO_HOST
 		? kXferToHost
@@ -49,11 +49,89 @@ auto handleXferReq(auto req, auto &endpoint, auto &&...xferArgs) {
 		xfer.allowShortPackets = req->allow_short_packets();
 	xfer.lazyNotification = req->lazy_notification();
 
-	return endpoint.transfer(xfer);
+	return xfer;
+}
+
+template <typename XferType>
+auto handleXferReq(auto req, auto &endpoint, auto &&...xferArgs) {
+	return endpoint.transfer(makeXfer<XferType>(req, std::forward<decltype(xferArgs)>(xferArgs)...));
 };
 
 } // namespace anonymous
 
+async::result<void> handleTransfer(Endpoint endpoint, helix::UniqueDescriptor conversation,
+		managarm::usb::TransferRequest req) {
+	// TODO(qookie): Use proper pool:
+	//		 something like ep.device.bufferPool()
+	arch::dma_buffer buffer{nullptr, static_cast<size_t>(req.length())};
+
+	if (req.dir() == managarm::usb::XferDirection::TO_DEVICE) {
+		auto [recvBuffer] = co_await helix_ng::exchangeMsgs(
+			conversation,
+			helix_ng::recvBuffer(buffer.data(), buffer.size())
+		);
+
+		HEL_CHECK(recvBuffer.error());
+	}
+
+	frg::expected<UsbError, uint64_t> outcome;
+
+	switch (req.type()) {
+		using enum managarm::usb::XferType;
+		case INTERRUPT:
+			outcome = co_await handleXferReq<InterruptTransfer>(&req, endpoint, buffer);
+			break;
+		case BULK: {
+			auto xfer = makeXfer<BulkTransfer>(&req, buffer);
+			xfer.streamId = req.stream_id();
+			outcome = co_await endpoint.transfer(xfer);
+			break;
+		}
+			// TODO(qookie): Support control EPs
+			//case CONTROL:
+			//	outcome = co_await handleXferReq<ControlTransfer>(&req, endpoint, buffer);
+			//	break;
+		default:
+			std::cout << "Unexpected endpoint type\n";
+			co_return;
+	}
+
+	if (!outcome) {
+		co_await respondWithError(conversation, outcome.error());
+		co_return;
+	}
+
+	auto length = outcome.value();
+
+	managarm::usb::SvrResponse resp;
+	resp.set_error(managarm::usb::Errors::SUCCESS);
+
+	if (req.dir() == managarm::usb::XferDirection::TO_HOST) {
+		auto [sendResp, sendData] =
+			co_await helix_ng::exchangeMsgs(
+				conversation,
+				helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{}),
+				helix_ng::sendBuffer(buffer.data(), length)
+			);
+
+		HEL_CHECK(sendResp.error());
+		HEL_CHECK(sendData.error());
+	} else {
+		auto [sendResp] =
+			co_await helix_ng::exchangeMsgs(
+				conversation,
+				helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{})
+			);
+
+		HEL_CHECK(sendResp.error());
+	}
+}
+
+async::detached handleStreamTransfer(Endpoint endpoint, helix::UniqueDescriptor conversation,
+		managarm::usb::TransferRequest req) {
+	co_await handleTransfer(std::move(endpoint), std::move(conversation), std::move(req));
+}
+
 async::detached serveEndpoint(Endpoint endpoint, helix::UniqueLane lane) {
 	while(true) {
 		auto [accept, recvReq] = co_await helix_ng::exchangeMsgs(
@@ -81,66 +159,14 @@ async::detached serveEndpoint(Endpoint endpoint, helix::UniqueLane lane) {
 				co_return;
 			}
 
-			// TODO(qookie): Use proper pool:
-			//		 something like ep.device.bufferPool()
-			arch::dma_buffer buffer{nullptr, static_cast<size_t>(req->length())};
-
-			if (req->dir() == managarm::usb::XferDirection::TO_DEVICE) {
-				auto [recvBuffer] = co_await helix_ng::exchangeMsgs(
-					conversation,
-					helix_ng::recvBuffer(buffer.data(), buffer.size())
-				);
-
-				HEL_CHECK(recvBuffer.error());
-			}
-
-			frg::expected<UsbError, uint64_t> outcome;
-
-			switch (req->type()) {
-				using enum managarm::usb::XferType;
-				case INTERRUPT:
-					outcome = co_await handleXferReq<InterruptTransfer>(req, endpoint, buffer);
-					break;
-				case BULK:
-					outcome = co_await handleXferReq<BulkTransfer>(req, endpoint, buffer);
-					break;
-					// TODO(qookie): Support control EPs
-					//case CONTROL:
-					//	outcome = co_await handleXferReq<ControlTransfer>(req, endpoint, buffer);
-					//	break;
-				default:
-					std::cout << "Unexpected endpoint type\n";
-					co_return;
-			}
-
-			if (!outcome) {
-				co_await respondWithError(conversation, outcome.error());
-				continue;
-			}
-
-			auto length = outcome.value();
-
-			managarm::usb::SvrResponse resp;
-			resp.set_error(managarm::usb::Errors::SUCCESS);
-
-			if (req->dir() == managarm::usb::XferDirection::TO_HOST) {
-				auto [sendResp, sendData] =
-					co_await helix_ng::exchangeMsgs(
-						conversation,
-						helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{}),
-						helix_ng::sendBuffer(buffer.data(), length)
-					);
-
-				HEL_CHECK(sendResp.error());
-				HEL_CHECK(sendData.error());
-			} else {
-				auto [sendResp] =
-					co_await helix_ng::exchangeMsgs(
-						conversation,
-						helix_ng::sendBragiHeadOnly(resp, frg::stl_allocator{})
-					);
-
-				HEL_CHECK(sendResp.error());
+			// Transfers on bulk streams are handled concurrently: the device decides
+			// which of the queued transfers completes first. All other transfers
+			// have to reach the ring in the order in which they were submitted,
+			// hence we wait for them (including the data of OUT transfers).
+			if(req->stream_id()) {
+				handleStreamTransfer(endpoint, std::move(conversation), std::move(*req));
+			}else{
+				co_await handleTransfer(endpoint, std::move(conversation), std::move(*req));
 			}
 		}else{
 			managarm::usb::SvrResponse resp;
@@ -192,6 +218,7 @@ async::detached serveInterface(Interface interface, helix::UniqueLane lane) {
 			}
 
 			auto endpoint = std::move(outcome.value());
+			auto numStreams = endpoint.numStreams();
 
 			helix::UniqueLane localLane, remoteLane;
 			std::tie(localLane, remoteLane) = helix::createStream();
@@ -200,6 +227,7 @@ async::detached serveInterface(Interface interface, helix::UniqueLane lane) {
 
 			managarm::usb::SvrResponse resp;
 			resp.set_error(managarm::usb::Errors::SUCCESS);
+			resp.set_num_streams(numStreams);
 
 			auto [sendResp, sendLane] = co_await helix_ng::exchangeMsgs(
 				conversation,
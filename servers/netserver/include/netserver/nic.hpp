@@ -3,6 +3,7 @@
 #include <array>
 #include <arch/dma_pool.hpp>
 #include <async/result.hpp>
+#include <cassert>
 #include <frg/logging.hpp>
 #include <frg/formatting.hpp>
 #include <cstdint>
@@ -47,9 +48,45 @@ private:
 enum EtherType : uint16_t {
 	ETHER_TYPE_IP4 = 0x0800,
 	ETHER_TYPE_ARP = 0x0806,
+	ETHER_TYPE_IP6 = 0x86DD,
 };
 
-// TODO(arsen): Expose interface for csum offloading, constructing frames, and
+struct LinkStats {
+	uint64_t rxPackets = 0;
+	uint64_t rxBytes = 0;
+	// Frames that were lost because the device ran out of receive buffers
+	// (as reported by the driver) or that were discarded as malformed.
+	uint64_t rxDropped = 0;
+};
+
+//! A transport layer checksum that still has to be filled into an outgoing frame.
+//! It covers the frame from start to its end and is stored at start + offset.
+//! The checksum field must already contain the folded (but not complemented)
+//! sum of the pseudo header.
+struct TxChecksum {
+	uint16_t start;
+	uint16_t offset;
+};
+
+//! Describes how an oversized TCP frame (over IPv4 or IPv6) is split into segments
+//! (generic segmentation offload). All segments repeat the first headerLength
+//! bytes of the frame and carry at most segmentSize bytes of TCP payload.
+struct TxSegmentation {
+	//! Offset of the IP header.
+	uint16_t networkStart;
+	//! Length of the link, IP and TCP headers. IPv6 extension headers are not supported.
+	uint16_t headerLength;
+	uint16_t segmentSize;
+};
+
+//! Result of a receive operation.
+struct RxFrame {
+	size_t length;
+	//! The device has verified the transport layer checksum.
+	bool checksumVerified = false;
+};
+
+// TODO(arsen): Expose interface for constructing frames, and
 // other features of NICs
 struct Link {
 	struct AllocatedBuffer {
@@ -63,6 +100,46 @@ struct Link {
 	virtual async::result<size_t> receive(arch::dma_buffer_view) = 0;
 	//! Sends an entire ethernet frame
 	virtual async::result<void> send(const arch::dma_buffer_view) = 0;
+	//! Like receive(), but also reports the results of receive offloads.
+	//! Drivers that can verify checksums override this.
+	virtual async::result<RxFrame> receiveFrame(arch::dma_buffer_view frame) {
+		co_return RxFrame{co_await receive(frame)};
+	}
+	//! Sends an ethernet frame whose transport layer checksum is not filled in yet.
+	//! Drivers that support checksum offloading override this;
+	//! by default, the checksum is computed in software.
+	virtual async::result<void> sendWithChecksum(arch::dma_buffer_view frame, TxChecksum csum);
+	//! Sends a TCP/IPv4 or TCP/IPv6 frame that may exceed the MTU. Its TCP checksum is not filled in
+	//! yet (as for sendWithChecksum()). Drivers that support TCP segmentation offload
+	//! override this; by default, the frame is segmented in software.
+	virtual async::result<void> sendSegmented(arch::dma_buffer_view frame, TxChecksum csum,
+			TxSegmentation seg);
+	//! Number of receive queues. Devices with multiple queues spread the received
+	//! flows over them (e.g., by RSS, see rss.hpp); runDevice() serves each queue
+	//! with its own loop. All loops run on netserver's dispatcher thread.
+	virtual size_t rxQueueCount() {
+		return 1;
+	}
+	//! Like receiveFrame(), but posts the buffer to the given receive queue.
+	virtual async::result<RxFrame> receiveFromQueue(size_t queue, arch::dma_buffer_view frame) {
+		assert(!queue);
+		co_return co_await receiveFrame(frame);
+	}
+	//! Number of receive calls that runDevice() keeps in flight at the same time
+	//! on each queue, i.e., the number of receive buffers that are pre-posted to it.
+	//! Drivers must complete concurrent receive calls on the same queue
+	//! in the order they were made.
+	virtual size_t rxRingSize() {
+		return 1;
+	}
+	//! runDevice() (re-)posts receive buffers to a queue between these calls. Drivers
+	//! may defer notifying the device about the new buffers until rxBatchEnd().
+	virtual void rxBatchBegin(size_t) { }
+	virtual void rxBatchEnd(size_t) { }
+
+	LinkStats &stats() {
+		return stats_;
+	}
 	arch::dma_pool *dmaPool();
 	AllocatedBuffer allocateFrame(size_t payloadSize);
 	AllocatedBuffer allocateFrame(MacAddress to, EtherType type,
@@ -106,9 +183,11 @@ protected:
 	bool l1_up_ = false;
 
 	bool raw_ip_ = false;
+
+	LinkStats stats_;
 };
 
-async::detached runDevice(std::shared_ptr<Link> dev);
+void runDevice(std::shared_ptr<Link> dev);
 } // namespace nic
 
 inline std::ostream &operator<<(std::ostream &os, const nic::MacAddress &mac) {
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <arch/dma_structs.hpp>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+namespace nic {
+
+//! Receive side scaling (RSS): a device with multiple receive queues hashes the
+//! addresses and ports of each frame with the Toeplitz function and looks up the
+//! queue in an indirection table. All frames of a flow end up on the same queue.
+struct RssConfig {
+	static constexpr size_t keySize = 40;
+	static constexpr size_t tableSize = 128;
+
+	//! Spreads flows evenly over queueCount queues, using the well-known
+	//! key from Microsoft's RSS specification.
+	static RssConfig spread(size_t queueCount);
+
+	uint16_t queueFor(uint32_t hash) const {
+		return indirection[hash % tableSize];
+	}
+
+	std::array<uint8_t, keySize> key;
+	std::array<uint16_t, tableSize> indirection;
+};
+
+//! Computes the Toeplitz hash of data. The key must be at least 4 bytes longer than the data.
+uint32_t toeplitzHash(const uint8_t *key, size_t keySize, const uint8_t *data, size_t size);
+
+//! Computes the RSS hash of an IPv4 or IPv6 packet that starts networkStart bytes into
+//! frame. TCP and UDP packets are hashed by their addresses and ports, other packets
+//! (and IPv4 fragments) only by their addresses. If reverse is set, source and destination
+//! are swapped, i.e., an outgoing packet hashes to the same value as the packets that
+//! it answers. Returns std::nullopt for frames that are not IP packets.
+std::optional<uint32_t> flowHash(const RssConfig &config, arch::dma_buffer_view frame,
+		size_t networkStart, bool reverse = false);
+
+} // namespace nic
@@ -149,6 +149,8 @@ Neighbours::Entry &Neighbours::getEntry(uint32_t ip) {
 
 void Neighbours::updateTable(uint32_t ip, nic::MacAddress mac, std::weak_ptr<nic::Link> link) {
 	auto &entry = getEntry(ip);
+	if(entry.state != State::reachable || entry.mac != mac)
+		ip4Router().invalidate();
 	entry.mac = mac;
 	entry.state = State::reachable;
 	entry.link = std::move(link);
@@ -178,6 +180,7 @@ async::detached entryProber(uint32_t ip, Neighbours::Entry &e, uint32_t sender)
 	}
 	e.state = Neighbours::State::failed;
 	e.change.raise();
+	ip4Router().invalidate();
 }
 } // namespace
 
@@ -197,6 +200,14 @@ async::result<std::optional<nic::MacAddress>> Neighbours::tryResolve(uint32_t ip
 	co_return entry.mac;
 }
 
+std::optional<nic::MacAddress> Neighbours::lookup(uint32_t ip) {
+	auto f = table_.find(ip);
+	if (f == table_.end() || f->second.state != State::reachable) {
+		return std::nullopt;
+	}
+	return f->second.mac;
+}
+
 Neighbours &neigh4() {
 	static Neighbours neigh;
 	return neigh;
@@ -24,6 +24,8 @@ struct Neighbours {
 	};
 	async::result<std::optional<nic::MacAddress>> tryResolve(uint32_t addr,
 		uint32_t sender);
+	// Returns the MAC address of addr without probing if it is reachable.
+	std::optional<nic::MacAddress> lookup(uint32_t addr);
 	void feedArp(nic::MacAddress destination, arch::dma_buffer_view arpData, std::weak_ptr<nic::Link> link);
 	void updateTable(uint32_t proto, nic::MacAddress hardware, std::weak_ptr<nic::Link> link);
 	std::map<uint32_t, Neighbours::Entry> &getTable();
@@ -1,32 +1,209 @@
 #include "checksum.hpp"
 
+#include <string.h>
+
 #include <arch/bit.hpp>
 
-void Checksum::update(uint16_t word)  {
-	state_ += word;
-	while (state_ >> 16 != 0) {
-		state_ = (state_ >> 16) + (state_ & 0xffff);
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Folds a 64-bit one's complement sum to 16 bits.
+uint16_t fold64(uint64_t sum) {
+	sum = (sum & 0xFFFF'FFFF) + (sum >> 32);
+	sum = (sum & 0xFFFF'FFFF) + (sum >> 32);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	return sum;
+}
+
+// Sums the (less than 8) trailing bytes of a buffer.
+// A trailing odd byte is padded with zero, as if it was followed by a zero byte in memory.
+uint64_t sumTail(const unsigned char *p, size_t size) {
+	uint64_t sum = 0;
+	if(size & 4) {
+		uint32_t v;
+		memcpy(&v, p, 4);
+		sum += v;
+		p += 4;
+	}
+	if(size & 2) {
+		uint16_t v;
+		memcpy(&v, p, 2);
+		sum += v;
+		p += 2;
 	}
+	if(size & 1) {
+		unsigned char v[2] = {*p, 0};
+		uint16_t w;
+		memcpy(&w, v, 2);
+		sum += w;
+	}
+	return sum;
 }
 
-void Checksum::update(const void *data, size_t size) {
-	using namespace arch;
-	auto iter = static_cast<const unsigned char*>(data);
-	if (size % 2 != 0) {
-		size--;
-		update(iter[size] << 8);
+// All kernels return a 64-bit sum that folds to the one's complement sum
+// of the buffer interpreted as native endian 16-bit words.
+
+uint64_t sumScalar(const unsigned char *p, size_t size) {
+	uint64_t sum = 0;
+	uint64_t carries = 0;
+	auto add = [&] (uint64_t v) {
+		sum += v;
+		carries += (sum < v);
+	};
+
+	while(size >= 32) {
+		uint64_t v[4];
+		memcpy(v, p, 32);
+		add(v[0]);
+		add(v[1]);
+		add(v[2]);
+		add(v[3]);
+		p += 32;
+		size -= 32;
+	}
+	while(size >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		add(v);
+		p += 8;
+		size -= 8;
 	}
-	auto end = iter + size;
-	for (; iter < end; iter += 2) {
-		update(iter[0] << 8 | iter[1]);
+	add(sumTail(p, size));
+	// 2^64 is congruent to 1 modulo 2^16 - 1, so carries can simply be added back.
+	sum += carries;
+	return sum + (sum < carries);
+}
+
+#if defined(__x86_64__)
+
+// Sums the 64-bit lanes of the accumulators (plus the sum of the remaining bytes).
+uint64_t sumLanes(const uint64_t *lanes, size_t n, uint64_t rest) {
+	uint64_t sum = rest;
+	uint64_t carries = 0;
+	for(size_t i = 0; i < n; i++) {
+		sum += lanes[i];
+		carries += (sum < lanes[i]);
+	}
+	sum += carries;
+	return sum + (sum < carries);
+}
+
+// The SIMD kernels zero-extend 32-bit words into 64-bit lanes, so the lanes
+// cannot overflow unless the buffer is larger than 16 GiB.
+
+// SSE2 is part of the x86_64 baseline, hence no target attributes are necessary.
+uint64_t sumSse2(const unsigned char *p, size_t size) {
+	auto zero = _mm_setzero_si128();
+	auto acc0 = _mm_setzero_si128();
+	auto acc1 = _mm_setzero_si128();
+
+	while(size >= 32) {
+		auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+		auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(p + 16));
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(a, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(a, zero));
+		acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(b, zero));
+		acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(b, zero));
+		p += 32;
+		size -= 32;
+	}
+
+	uint64_t lanes[4];
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), acc0);
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(lanes + 2), acc1);
+	return sumLanes(lanes, 4, sumScalar(p, size));
+}
+
+[[gnu::target("avx2")]]
+uint64_t sumAvx2(const unsigned char *p, size_t size) {
+	auto zero = _mm256_setzero_si256();
+	auto acc0 = _mm256_setzero_si256();
+	auto acc1 = _mm256_setzero_si256();
+
+	while(size >= 64) {
+		auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+		auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + 32));
+		acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(a, zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(a, zero));
+		acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(b, zero));
+		acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(b, zero));
+		p += 64;
+		size -= 64;
 	}
+
+	uint64_t lanes[8];
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), acc0);
+	_mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes + 4), acc1);
+	return sumLanes(lanes, 8, sumScalar(p, size));
+}
+
+#endif // defined(__x86_64__)
+
+using SumKernel = uint64_t (*)(const unsigned char *, size_t);
+
+SumKernel selectKernel() {
+#if defined(__x86_64__)
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("avx2"))
+		return sumAvx2;
+	return sumSse2;
+#else
+	return sumScalar;
+#endif
+}
+
+const SumKernel sumKernel = selectKernel();
+
+// For short buffers (e.g., headers), the SIMD kernels are not worth it.
+constexpr size_t simdThreshold = 64;
+
+} // anonymous namespace
+
+void Checksum::update(uint16_t word) {
+	auto be = arch::convert_endian<arch::endian::big>(word);
+	update(&be, sizeof(be));
+}
+
+void Checksum::update(const void *data, size_t size) {
+	auto p = static_cast<const unsigned char *>(data);
+	uint16_t sum = fold64(size < simdThreshold ? sumScalar(p, size) : sumKernel(p, size));
+
+	// If the data starts at an odd offset, all of its bytes end up
+	// in the other half of the 16-bit words, see RFC1071.
+	if(odd_)
+		sum = __builtin_bswap16(sum);
+	state_ += sum;
+	odd_ ^= size & 1;
 }
 
 void Checksum::update(arch::dma_buffer_view view) {
 	update(view.data(), view.size());
 }
 
+uint16_t Checksum::fold() const {
+	// The state is a sum of native endian words; convert it to the
+	// numerical value of the (big endian) checksum field.
+	return arch::convert_endian<arch::endian::big>(fold64(state_));
+}
+
 uint16_t Checksum::finalize() {
-	auto state_ = this->state_;
-	return ~state_;
+	return ~fold();
+}
+
+uint16_t Checksum::adjust(uint16_t checksum, uint16_t oldWord, uint16_t newWord) {
+	// HC' = ~(~HC + ~m + m'), see RFC1624 eqn. 3.
+	uint32_t sum = uint16_t(~checksum) + uint16_t(~oldWord) + uint32_t{newWord};
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	sum = (sum & 0xFFFF) + (sum >> 16);
+	return ~sum;
+}
+
+uint16_t Checksum::adjust(uint16_t checksum, uint32_t oldWord, uint32_t newWord) {
+	checksum = adjust(checksum, uint16_t(oldWord >> 16), uint16_t(newWord >> 16));
+	return adjust(checksum, uint16_t(oldWord), uint16_t(newWord));
 }
@@ -3,12 +3,28 @@
 #include <arch/dma_structs.hpp>
 
 // 16-bit one's compliment sum checksum, as described in RFC791, amongst others
+//
+// Data is summed in 64-bit chunks (using SIMD where available) and only folded
+// to 16 bits in finalize(); see RFC1071 for why this is equivalent. Consecutive
+// update() calls may pass buffers of odd size.
 struct Checksum {
 	void update(uint16_t word);
 	void update(const void *mem, size_t size);
 	void update(arch::dma_buffer_view area);
+	// Returns the folded sum without complementing it. This is the value that
+	// is stored in the checksum field for checksum offloading (e.g., the sum of
+	// the pseudo header).
+	uint16_t fold() const;
 	uint16_t finalize();
 
+	// Incrementally updates a checksum (as stored in a header, i.e., after
+	// complementing) when a 16-bit word that it covers changes, see RFC1624.
+	static uint16_t adjust(uint16_t checksum, uint16_t oldWord, uint16_t newWord);
+	static uint16_t adjust(uint16_t checksum, uint32_t oldWord, uint32_t newWord);
+
 private:
-	uint32_t state_ = 0;
+	// Sum of the data in memory order, i.e., of native endian 16-bit words.
+	uint64_t state_ = 0;
+	// Whether the number of bytes summed so far is odd.
+	bool odd_ = false;
 };
@@ -0,0 +1,93 @@
+#include "icmp6.hpp"
+
+#include "checksum.hpp"
+#include "inet.hpp"
+#include "ndp.hpp"
+#include <cstring>
+#include <iostream>
+
+namespace {
+
+struct Icmp6Header {
+	uint8_t type;
+	uint8_t code;
+	arch::scalar_storage<uint16_t, arch::big_endian> checksum;
+};
+static_assert(sizeof(Icmp6Header) == 4);
+
+async::detached sendEchoReply(smarter::shared_ptr<const Ip6Packet> packet) {
+	auto &request = packet->header;
+	auto ti = co_await ip6().targetByRemote(request.source, packet->link.lock());
+	if (!ti) {
+		co_return;
+	}
+	// Answer from the address that the request was sent to, unless it was multicast.
+	if (!request.destination.isMulticast()) {
+		ti->source = request.destination;
+	}
+
+	auto payload = packet->payload().subview(sizeof(Icmp6Header));
+	std::vector<uint8_t> body(payload.size());
+	std::memcpy(body.data(), payload.data(), payload.size());
+	co_await sendIcmp6(std::move(*ti), Icmp6Type::echoReply, 0, std::move(body));
+}
+
+} // anonymous namespace
+
+void Icmp6::feedDatagram(smarter::shared_ptr<const Ip6Packet> packet) {
+	auto payload = packet->payload();
+	if (payload.size() < sizeof(Icmp6Header)) {
+		return;
+	}
+
+	// Unlike ICMPv4, the checksum covers the pseudo header (RFC 4443, 2.3).
+	Checksum csum;
+	addPseudoHeader(csum, packet->header.source, packet->header.destination,
+		IpProto::icmp6, payload.size());
+	csum.update(payload);
+	auto sum = csum.finalize();
+	if (sum != 0 && sum != 0xFFFF) {
+		std::cout << "netserver: ICMPv6 packet with bad checksum" << std::endl;
+		return;
+	}
+
+	Icmp6Header header;
+	std::memcpy(&header, payload.data(), sizeof(header));
+	auto body = payload.subview(sizeof(header));
+
+	switch (static_cast<Icmp6Type>(header.type)) {
+	case Icmp6Type::echoRequest:
+		if (header.code == 0 && (packet->header.destination.isMulticast()
+				|| ip6().hasIp(packet->header.destination))) {
+			sendEchoReply(std::move(packet));
+		}
+		break;
+	case Icmp6Type::neighbourSolicitation:
+	case Icmp6Type::neighbourAdvertisement:
+	case Icmp6Type::routerAdvertisement:
+		if (header.code == 0) {
+			neigh6().feedNdp(static_cast<Icmp6Type>(header.type), std::move(packet), body);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+async::result<protocols::fs::Error> sendIcmp6(Ip6TargetInfo ti, Icmp6Type type, uint8_t code,
+		std::vector<uint8_t> body) {
+	Icmp6Header header{
+		.type = static_cast<uint8_t>(type),
+		.code = code,
+		.checksum = 0,
+	};
+
+	Checksum csum;
+	addPseudoHeader(csum, ti.source, ti.remote, IpProto::icmp6, sizeof(header) + body.size());
+	csum.update(&header, sizeof(header));
+	csum.update(body.data(), body.size());
+	header.checksum = csum.finalize();
+
+	co_return co_await ip6().sendFrame(std::move(ti), &header, sizeof(header),
+		body.data(), body.size(), static_cast<uint16_t>(IpProto::icmp6));
+}
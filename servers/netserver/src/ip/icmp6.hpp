@@ -0,0 +1,28 @@
+#pragma once
+
+#include <async/result.hpp>
+#include <protocols/fs/common.hpp>
+#include <smarter.hpp>
+#include <cstdint>
+#include <vector>
+
+class Ip6Packet;
+struct Ip6TargetInfo;
+
+enum class Icmp6Type : uint8_t {
+	echoRequest = 128,
+	echoReply = 129,
+	routerSolicitation = 133,
+	routerAdvertisement = 134,
+	neighbourSolicitation = 135,
+	neighbourAdvertisement = 136,
+};
+
+struct Icmp6 {
+	// Answers echo requests and passes neighbour discovery messages to neigh6().
+	void feedDatagram(smarter::shared_ptr<const Ip6Packet> packet);
+};
+
+// Sends an ICMPv6 message; body is the message following the type, code and checksum fields.
+async::result<protocols::fs::Error> sendIcmp6(Ip6TargetInfo ti, Icmp6Type type, uint8_t code,
+		std::vector<uint8_t> body);
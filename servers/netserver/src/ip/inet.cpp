@@ -0,0 +1,166 @@
+#include "inet.hpp"
+
+#include <arch/bit.hpp>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+bool inetHasIp(const Ip6Address &addr) {
+	if(addr.isIp4Mapped())
+		return ip4().hasIp(addr.ip4());
+	return ip6().hasIp(addr);
+}
+
+void addPseudoHeader(Checksum &csum, const Ip6Address &source, const Ip6Address &destination,
+		IpProto proto, size_t length) {
+	// The checksum does not depend on the order of the 16-bit words.
+	if(source.isIp4Mapped()) {
+		csum.update(source.bytes.data() + 12, 4);
+		csum.update(destination.bytes.data() + 12, 4);
+		csum.update(static_cast<uint16_t>(proto));
+		csum.update(static_cast<uint16_t>(length));
+	}else{
+		csum.update(source.bytes.data(), source.bytes.size());
+		csum.update(destination.bytes.data(), destination.bytes.size());
+		csum.update(static_cast<uint16_t>(length >> 16));
+		csum.update(static_cast<uint16_t>(length));
+		csum.update(static_cast<uint16_t>(proto));
+	}
+}
+
+protocols::fs::Error parseSockaddr(int family, const void *addrPtr, size_t addrLength,
+		Ip6Address &address, uint16_t &port, int *scope) {
+	sa_family_t saFamily;
+	if(addrLength < sizeof(saFamily))
+		return protocols::fs::Error::illegalArguments;
+	std::memcpy(&saFamily, addrPtr, sizeof(saFamily));
+	if(saFamily != family)
+		return protocols::fs::Error::afNotSupported;
+
+	if(scope)
+		*scope = 0;
+
+	if(family == AF_INET) {
+		struct sockaddr_in sa;
+		if(addrLength < sizeof(sa))
+			return protocols::fs::Error::illegalArguments;
+		std::memcpy(&sa, addrPtr, sizeof(sa));
+
+		address = Ip6Address::fromIp4(arch::from_endian<arch::big_endian, uint32_t>(sa.sin_addr.s_addr));
+		port = arch::from_endian<arch::big_endian, uint16_t>(sa.sin_port);
+		return protocols::fs::Error::none;
+	}
+
+	assert(family == AF_INET6);
+	struct sockaddr_in6 sa;
+	if(addrLength < sizeof(sa))
+		return protocols::fs::Error::illegalArguments;
+	std::memcpy(&sa, addrPtr, sizeof(sa));
+
+	std::memcpy(address.bytes.data(), &sa.sin6_addr, sizeof(sa.sin6_addr));
+	port = arch::from_endian<arch::big_endian, uint16_t>(sa.sin6_port);
+	if(scope && address.isLinkLocal())
+		*scope = sa.sin6_scope_id;
+	return protocols::fs::Error::none;
+}
+
+size_t writeSockaddr(int family, const Ip6Address &address, uint16_t port, int scope,
+		void *addrPtr, size_t maxLength) {
+	if(family == AF_INET) {
+		struct sockaddr_in sa{};
+		sa.sin_family = AF_INET;
+		sa.sin_port = arch::to_endian<arch::big_endian, uint16_t>(port);
+		sa.sin_addr.s_addr = arch::to_endian<arch::big_endian, uint32_t>(address.ip4());
+		if(maxLength) {
+			std::memset(addrPtr, 0, maxLength);
+			std::memcpy(addrPtr, &sa, std::min(sizeof(sa), maxLength));
+		}
+		return sizeof(sa);
+	}
+
+	assert(family == AF_INET6);
+	struct sockaddr_in6 sa{};
+	sa.sin6_family = AF_INET6;
+	sa.sin6_port = arch::to_endian<arch::big_endian, uint16_t>(port);
+	std::memcpy(&sa.sin6_addr, address.bytes.data(), sizeof(sa.sin6_addr));
+	if(address.isLinkLocal())
+		sa.sin6_scope_id = scope;
+	if(maxLength) {
+		std::memset(addrPtr, 0, maxLength);
+		std::memcpy(addrPtr, &sa, std::min(sizeof(sa), maxLength));
+	}
+	return sizeof(sa);
+}
+
+InetPacket::InetPacket(smarter::shared_ptr<const Ip4Packet> packet)
+: source{Ip6Address::fromIp4(packet->header.source)},
+	destination{Ip6Address::fromIp4(packet->header.destination)},
+	link{packet->link}, checksumVerified{packet->checksumVerified},
+	payload_{packet->payload()}, ip4_{std::move(packet)} { }
+
+InetPacket::InetPacket(smarter::shared_ptr<const Ip6Packet> packet)
+: source{packet->header.source}, destination{packet->header.destination},
+	link{packet->link}, checksumVerified{packet->checksumVerified},
+	payload_{packet->payload()}, ip6_{std::move(packet)} { }
+
+bool InetPacket::verifyChecksum(IpProto proto) const {
+	if(checksumVerified)
+		return true;
+
+	Checksum csum;
+	addPseudoHeader(csum, source, destination, proto, payload_.size());
+	csum.update(payload_);
+	auto sum = csum.finalize();
+	return sum == 0 || sum == 0xFFFF;
+}
+
+Ip6Address InetTargetInfo::source() const {
+	if(auto ti = std::get_if<Ip4TargetInfo>(&target))
+		return Ip6Address::fromIp4(ti->source);
+	return std::get<Ip6TargetInfo>(target).source;
+}
+
+async::result<std::optional<InetTargetInfo>>
+InetRouteCache::lookup(const Ip6Address &remote, std::shared_ptr<nic::Link> link) {
+	if(remote.isIp4Mapped()) {
+		auto ti = co_await ip4_.lookup(remote.ip4(), std::move(link));
+		if(!ti)
+			co_return std::nullopt;
+		co_return InetTargetInfo{std::move(*ti)};
+	}
+
+	auto ti = co_await ip6_.lookup(remote, std::move(link));
+	if(!ti)
+		co_return std::nullopt;
+	co_return InetTargetInfo{std::move(*ti)};
+}
+
+async::result<std::optional<InetTargetInfo>> inetTargetByRemote(const Ip6Address &remote,
+		std::shared_ptr<nic::Link> link) {
+	if(remote.isIp4Mapped()) {
+		auto ti = co_await ip4().targetByRemote(remote.ip4(), std::move(link));
+		if(!ti)
+			co_return std::nullopt;
+		co_return InetTargetInfo{std::move(*ti)};
+	}
+
+	auto ti = co_await ip6().targetByRemote(remote, std::move(link));
+	if(!ti)
+		co_return std::nullopt;
+	co_return InetTargetInfo{std::move(*ti)};
+}
+
+async::result<protocols::fs::Error> inetSendFrame(InetTargetInfo ti,
+		const void *transportHeader, size_t transportHeaderLen,
+		const void *data, size_t dataLen,
+		IpProto proto, IpOffload offload) {
+	if(auto v4 = std::get_if<Ip4TargetInfo>(&ti.target))
+		co_return co_await ip4().sendFrame(std::move(*v4),
+			transportHeader, transportHeaderLen, data, dataLen,
+			static_cast<uint16_t>(proto), offload);
+
+	co_return co_await ip6().sendFrame(std::get<Ip6TargetInfo>(std::move(ti.target)),
+		transportHeader, transportHeaderLen, data, dataLen,
+		static_cast<uint16_t>(proto), offload);
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+// UDP and TCP are shared between IPv4 and IPv6. They represent IPv4 addresses
+// as IPv4-mapped IPv6 addresses, such that AF_INET6 sockets can also
+// communicate with IPv4 peers (RFC 3493, 3.7).
+
+#include <netinet/in.h>
+#include <variant>
+
+#include "checksum.hpp"
+#include "ip4.hpp"
+#include "ip6.hpp"
+
+// Local address of unbound AF_INET sockets. Unbound AF_INET6 sockets use ::,
+// which also receives IPv4 packets.
+inline const Ip6Address ip4Any = Ip6Address::fromIp4(INADDR_ANY);
+inline const Ip6Address ip4Broadcast = Ip6Address::fromIp4(INADDR_BROADCAST);
+
+inline bool isWildcard(const Ip6Address &addr) {
+	return addr.isUnspecified() || addr == ip4Any;
+}
+
+// Whether a socket that is bound to local receives packets that are sent to destination.
+inline bool acceptsDestination(const Ip6Address &local, const Ip6Address &destination) {
+	if(local.isUnspecified())
+		return true;
+	if(local == ip4Any)
+		return destination.isIp4Mapped();
+	return local == destination;
+}
+
+// Whether two sockets cannot be bound to the same port on these addresses.
+inline bool bindsOverlap(const Ip6Address &a, const Ip6Address &b) {
+	return acceptsDestination(a, b) || acceptsDestination(b, a);
+}
+
+// Whether the address is assigned to one of our links.
+bool inetHasIp(const Ip6Address &addr);
+
+// Adds the pseudo header of a transport layer packet of the given length to csum
+// (RFC 768 for IPv4 and RFC 8200, 8.1 for IPv6).
+void addPseudoHeader(Checksum &csum, const Ip6Address &source, const Ip6Address &destination,
+		IpProto proto, size_t length);
+
+// Parses a sockaddr_in (for AF_INET sockets) or a sockaddr_in6 (for AF_INET6 sockets).
+// scope is set to the interface index of link-local IPv6 addresses (or to zero).
+protocols::fs::Error parseSockaddr(int family, const void *addrPtr, size_t addrLength,
+		Ip6Address &address, uint16_t &port, int *scope = nullptr);
+// Writes (at most maxLength bytes of) the socket address in the format of family.
+// Returns the size of the full socket address.
+size_t writeSockaddr(int family, const Ip6Address &address, uint16_t port, int scope,
+		void *addrPtr, size_t maxLength);
+
+// Network layer view of a received packet, for the transport protocols.
+struct InetPacket {
+	InetPacket() = default;
+	explicit InetPacket(smarter::shared_ptr<const Ip4Packet> packet);
+	explicit InetPacket(smarter::shared_ptr<const Ip6Packet> packet);
+
+	bool isIp4() const {
+		return static_cast<bool>(ip4_);
+	}
+
+	const Ip4Packet &ip4Packet() const {
+		return *ip4_;
+	}
+
+	arch::dma_buffer_view payload() const {
+		return payload_;
+	}
+
+	// Verifies the transport layer checksum unless the NIC already did so.
+	bool verifyChecksum(IpProto proto) const;
+
+	Ip6Address source;
+	Ip6Address destination;
+	std::weak_ptr<nic::Link> link;
+	bool checksumVerified = false;
+
+private:
+	arch::dma_buffer_view payload_;
+	// Keep the network layer packet (and hence, its buffer) alive.
+	smarter::shared_ptr<const Ip4Packet> ip4_;
+	smarter::shared_ptr<const Ip6Packet> ip6_;
+};
+
+// Routing decision for a remote address of either family.
+struct InetTargetInfo {
+	Ip6Address source() const;
+
+	std::variant<Ip4TargetInfo, Ip6TargetInfo> target;
+};
+
+// Per-socket route cache for both families, see Ip4RouteCache.
+struct InetRouteCache {
+	async::result<std::optional<InetTargetInfo>> lookup(const Ip6Address &remote,
+		std::shared_ptr<nic::Link> link = {});
+
+private:
+	Ip4RouteCache ip4_;
+	Ip6RouteCache ip6_;
+};
+
+// Like Ip4::targetByRemote() and Ip6::targetByRemote(), depending on the family of remote.
+async::result<std::optional<InetTargetInfo>> inetTargetByRemote(const Ip6Address &remote,
+		std::shared_ptr<nic::Link> link = {});
+// Like Ip4::sendFrame() and Ip6::sendFrame(), depending on the family of the target.
+async::result<protocols::fs::Error> inetSendFrame(InetTargetInfo ti,
+		const void *transportHeader, size_t transportHeaderLen,
+		const void *data, size_t dataLen,
+		IpProto proto, IpOffload offload = {});
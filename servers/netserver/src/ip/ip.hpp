@@ -0,0 +1,60 @@
+#pragma once
+
+// Parts of the network layer that are shared between IPv4 and IPv6.
+
+#include <arch/dma_pool.hpp>
+#include <async/result.hpp>
+#include <netserver/nic.hpp>
+#include <cassert>
+#include <cstdint>
+#include <optional>
+
+enum class IpProto : uint16_t {
+	icmp = 1,
+	tcp = 6,
+	udp = 17,
+	icmp6 = 58,
+};
+
+// Offloads that Ip4::sendFrame() and Ip6::sendFrame() request from the link.
+struct IpOffload {
+	// Offset of the transport layer checksum into the data. If set, the link
+	// fills in the checksum; the field must contain the pseudo header sum.
+	std::optional<uint16_t> checksumOffset;
+	// If non-zero, the data is a TCP super-segment that may exceed the MTU;
+	// the link splits it into segments of at most segmentSize payload bytes
+	// (following the first transportHeaderSize bytes). Requires checksumOffset.
+	uint16_t segmentSize = 0;
+	uint16_t transportHeaderSize = 0;
+};
+
+// Whether a packet with len bytes of transport layer data needs to be segmented.
+inline bool needsSegmentation(const IpOffload &offload, size_t len) {
+	return offload.segmentSize && len > offload.transportHeaderSize + offload.segmentSize;
+}
+
+// Hands a frame that contains a network layer header of headerSize bytes
+// (starting networkStart bytes into the frame) to the link.
+inline async::result<void> sendWithOffload(nic::Link &link, arch::dma_buffer_view frame,
+		size_t networkStart, size_t headerSize, const IpOffload &offload, bool segmented) {
+	if(!offload.checksumOffset) {
+		co_await link.send(frame);
+		co_return;
+	}
+
+	nic::TxChecksum csum{
+		static_cast<uint16_t>(networkStart + headerSize),
+		*offload.checksumOffset
+	};
+
+	if(segmented) {
+		co_await link.sendSegmented(frame, csum, {
+			.networkStart = static_cast<uint16_t>(networkStart),
+			.headerLength = static_cast<uint16_t>(networkStart + headerSize
+				+ offload.transportHeaderSize),
+			.segmentSize = offload.segmentSize,
+		});
+	}else{
+		co_await link.sendWithChecksum(frame, csum);
+	}
+}
@@ -2,10 +2,14 @@
 
 #include "arp.hpp"
 #include "checksum.hpp"
+#include "inet.hpp"
+#include "tcp4.hpp"
+#include "udp4.hpp"
 #include <async/recurring-event.hpp>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <algorithm>
+#include <cassert>
 #include <cstring>
 #include <iostream>
 #include <iomanip>
@@ -26,29 +30,13 @@ Ip4 &ip4() {
 	return inst;
 }
 
-bool Ip4Router::addRoute(Route r) {
-	return routes.emplace(std::move(r)).second;
-}
-
-std::optional<Route> Ip4Router::resolveRoute(uint32_t ip, std::shared_ptr<nic::Link> link) {
-	for (auto i = routes.begin(); i != routes.end(); i++) {
-		const auto &r = *i;
-		if (r.network.sameNet(ip)) {
-			if(link && r.link.lock()->index() != link->index())
-				continue;
-
-			if (r.link.expired()) {
-				i = routes.erase(i);
-				continue;
-			}
-			return { r };
-		}
-	}
-	return {};
+protocols::fs::StatusTableProvider &statusTable() {
+	static protocols::fs::StatusTableProvider inst;
+	return inst;
 }
 
-bool operator<(const CidrAddress &lhs, const CidrAddress &) {
-	return std::tie(lhs.prefix, lhs.ip) < std::tie(lhs.prefix, lhs.ip);
+bool operator<(const CidrAddress &lhs, const CidrAddress &rhs) {
+	return std::tie(lhs.prefix, lhs.ip) < std::tie(rhs.prefix, rhs.ip);
 }
 
 auto operator<=>(const Route &lhs, const Route &rhs) {
@@ -71,6 +59,52 @@ bool operator==(const Route &lhs, const Route &rhs) {
 	return operator<=>(lhs, rhs) == 0;
 }
 
+bool Ip4Router::addRoute(Route r) {
+	auto [it, inserted] = routes.emplace(std::move(r));
+	if(!inserted)
+		return false;
+
+	auto &entries = trie_.insert(it->network.ip, it->network.prefix);
+	auto pos = std::find_if(entries.begin(), entries.end(),
+		[&] (const Route *other) { return *it < *other; });
+	entries.insert(pos, &*it);
+	invalidate();
+	return true;
+}
+
+void Ip4Router::removeRoute(std::set<Route>::iterator it) {
+	auto entries = trie_.find(it->network.ip, it->network.prefix);
+	assert(entries);
+	std::erase(*entries, &*it);
+	if(entries->empty())
+		trie_.erase(it->network.ip, it->network.prefix);
+	routes.erase(it);
+	invalidate();
+}
+
+std::optional<Route> Ip4Router::resolveRoute(uint32_t ip, std::shared_ptr<nic::Link> link) {
+	std::optional<Route> result;
+	std::vector<const Route *> expired;
+	trie_.longestMatch(ip, [&] (const std::vector<const Route *> &entries) {
+		for(auto r : entries) {
+			auto target = r->link.lock();
+			if(!target) {
+				expired.push_back(r);
+				continue;
+			}
+			if(link && target->index() != link->index())
+				continue;
+			result = *r;
+			return true;
+		}
+		return false;
+	});
+
+	for(auto r : expired)
+		removeRoute(routes.find(*r));
+	return result;
+}
+
 bool Ip4Packet::parse(arch::dma_buffer owner, arch::dma_buffer_view frame) {
 	buffer_ = std::move(owner);
 	data = frame;
@@ -181,6 +215,7 @@ private:
 	friend struct Ip4;
 	int proto;
 	uint32_t remote = 0;
+	Ip4RouteCache routeCache;
 	std::queue<smarter::shared_ptr<const Ip4Packet>> pqueue;
 	async::recurring_event bell;
 };
@@ -218,7 +253,7 @@ async::result<frg::expected<protocols::fs::Error, size_t>> Ip4Socket::sendmsg(vo
 		co_return protocols::fs::Error::accessDenied;
 	}
 
-	auto ti = co_await ip4().targetByRemote(address);
+	auto ti = co_await self->routeCache.lookup(address);
 	if (!ti) {
 		co_return protocols::fs::Error::netUnreachable;
 	}
@@ -262,6 +297,38 @@ Ip4::targetByRemote(uint32_t remote, std::shared_ptr<nic::Link> link) {
 	co_return Ip4TargetInfo { remote, source, *oroute, std::move(target) };
 }
 
+async::result<std::optional<Ip4TargetInfo>>
+Ip4RouteCache::lookup(uint32_t remote, std::shared_ptr<nic::Link> link) {
+	auto generation = ip4Router().generation();
+	int linkFilter = link ? link->index() : 0;
+	if(info_ && generation_ == generation && remote_ == remote && linkFilter_ == linkFilter) {
+		if(auto target = link_.lock()) {
+			auto ti = *info_;
+			ti.link = std::move(target);
+			co_return ti;
+		}
+	}
+
+	auto ti = co_await ip4().targetByRemote(remote, std::move(link));
+	if(!ti) {
+		info_ = std::nullopt;
+		co_return std::nullopt;
+	}
+
+	// If the neighbour is not resolved yet, sendFrame() resolves it; that bumps
+	// the generation, so the next lookup picks up the MAC address.
+	if(!ti->link->rawIp())
+		ti->nextHop = neigh4().lookup(ti->route.gateway ? ti->route.gateway : remote);
+
+	generation_ = generation;
+	remote_ = remote;
+	linkFilter_ = linkFilter;
+	link_ = ti->link;
+	info_ = *ti;
+	info_->link = nullptr;
+	co_return ti;
+}
+
 bool Ip4::hasIp(uint32_t addr) {
 	return std::any_of(ips.cbegin(), ips.cend(),
 		[addr] (auto &x) {
@@ -270,22 +337,41 @@ bool Ip4::hasIp(uint32_t addr) {
 }
 
 async::result<protocols::fs::Error> Ip4::sendFrame(Ip4TargetInfo ti,
-		void *data, size_t len, uint16_t proto) {
+		void *data, size_t len, uint16_t proto, IpOffload offload) {
+	return sendFrame(std::move(ti), data, len, nullptr, 0, proto, offload);
+}
+
+async::result<protocols::fs::Error> Ip4::sendFrame(Ip4TargetInfo ti,
+		const void *transportHeader, size_t transportHeaderLen,
+		const void *data, size_t dataLen, uint16_t proto, IpOffload offload) {
 	using arch::convert_endian;
 	using arch::endian;
 
+	size_t len = transportHeaderLen + dataLen;
+
 	// TODO(arsen): fragmentation
 	// calculate header size
 	size_t header_size = sizeof(Ip4Packet::Header);
 	size_t packet_size = len + header_size;
+	if (packet_size > 0xFFFF)
+		co_return protocols::fs::Error::messageSize;
+
+	// For super-segments, only the size of the individual segments matters.
+	size_t wire_size = packet_size;
+	bool segmented = needsSegmentation(offload, len);
+	if (segmented) {
+		assert(offload.checksumOffset);
+		wire_size = header_size + offload.transportHeaderSize + offload.segmentSize;
+	}
+
 	// TODO(arsen): options
-	if (ti.route.mtu != 0 && ti.route.mtu < packet_size) {
+	if (ti.route.mtu != 0 && ti.route.mtu < wire_size) {
 		std::cout << "netserver: cant fragment 1" << std::endl;
 		co_return protocols::fs::Error::messageSize;
 	}
 
 	auto &target = ti.link;
-	if (target->mtu < packet_size) {
+	if (target->mtu < wire_size) {
 		std::cout << "netserver: cant fragment 2" << std::endl;
 		co_return protocols::fs::Error::messageSize;
 	}
@@ -319,7 +405,9 @@ async::result<protocols::fs::Error> Ip4::sendFrame(Ip4TargetInfo ti,
 			macTarget = ti.remote;
 		}
 
-		auto mac = co_await neigh4().tryResolve(macTarget, ti.source);
+		auto mac = ti.nextHop;
+		if (!mac)
+			mac = co_await neigh4().tryResolve(macTarget, ti.source);
 		if (!mac) {
 			co_return protocols::fs::Error::hostUnreachable;
 		}
@@ -330,16 +418,21 @@ async::result<protocols::fs::Error> Ip4::sendFrame(Ip4TargetInfo ti,
 	}
 
 	std::memcpy(fb.payload.data(), &hdr, sizeof(hdr));
-	std::memcpy(fb.payload.subview(header_size).byte_data(), data, len);
+	std::memcpy(fb.payload.subview(header_size).byte_data(), transportHeader, transportHeaderLen);
+	if (dataLen)
+		std::memcpy(fb.payload.subview(header_size + transportHeaderLen).byte_data(), data, dataLen);
 
-	co_await target->send(std::move(fb.frame));
+	auto networkStart = fb.frame.size() - fb.payload.size();
+	co_await sendWithOffload(*target, fb.frame, networkStart, header_size, offload, segmented);
 	co_return protocols::fs::Error::none;
 }
 
 void Ip4::feedPacket(nic::MacAddress, nic::MacAddress,
-		arch::dma_buffer owner, arch::dma_buffer_view frame, std::weak_ptr<nic::Link> link) {
+		arch::dma_buffer owner, arch::dma_buffer_view frame, std::weak_ptr<nic::Link> link,
+		bool checksumVerified) {
 	Ip4Packet hdr{};
 	hdr.link = link;
+	hdr.checksumVerified = checksumVerified;
 
 	if (!hdr.parse(std::move(owner), frame)) {
 		std::cout << "netserver: runt, or otherwise invalid, ip4 frame received"
@@ -359,8 +452,8 @@ void Ip4::feedPacket(nic::MacAddress, nic::MacAddress,
 
 	switch (static_cast<IpProto>(proto)) {
 	case IpProto::icmp: icmp.feedDatagram(hdrs, link); break;
-	case IpProto::udp: udp.feedDatagram(hdrs, link); break;
-	case IpProto::tcp: tcp.feedDatagram(hdrs); break;
+	case IpProto::udp: udp4().feedDatagram(InetPacket{hdrs}); break;
+	case IpProto::tcp: tcp4().feedDatagram(InetPacket{hdrs}); break;
 	default: break;
 	}
 
@@ -372,6 +465,7 @@ void Ip4::feedPacket(nic::MacAddress, nic::MacAddress,
 
 void Ip4::setLink(CidrAddress addr, std::weak_ptr<nic::Link> l) {
 	ips.emplace(addr, std::move(l));
+	ip4Router().invalidate();
 }
 
 std::shared_ptr<nic::Link> Ip4::getLink(uint32_t addr) {
@@ -383,6 +477,7 @@ std::shared_ptr<nic::Link> Ip4::getLink(uint32_t addr) {
 	auto ptr = iter->second.lock();
 	if (!ptr) {
 		ips.erase(iter);
+		ip4Router().invalidate();
 		return {};
 	}
 	return ptr;
@@ -405,7 +500,10 @@ std::optional<CidrAddress> Ip4::getCidrByIndex(int index) {
 }
 
 bool Ip4::deleteLink(CidrAddress addr) {
-	return ips.erase(addr) > 0;
+	if(!ips.erase(addr))
+		return false;
+	ip4Router().invalidate();
+	return true;
 }
 
 std::optional<uint32_t> Ip4::findLinkIp(uint32_t ipOnNet, nic::Link *link) {
@@ -420,8 +518,10 @@ std::optional<uint32_t> Ip4::findLinkIp(uint32_t ipOnNet, nic::Link *link) {
 	return {};
 }
 
-managarm::fs::Errors Ip4::serveSocket(helix::UniqueLane lane, int type, int proto, int flags) {
+managarm::fs::Errors Ip4::serveSocket(helix::UniqueLane lane, int type, int proto, int flags,
+		size_t &statusSlot) {
 	using namespace protocols::fs;
+	statusSlot = 0;
 	switch (type) {
 	case SOCK_RAW: {
 		auto sock = smarter::make_shared<Ip4Socket>(proto);
@@ -446,12 +546,12 @@ managarm::fs::Errors Ip4::serveSocket(helix::UniqueLane lane, int type, int prot
 			icmp.serveSocket(std::move(lane));
 			break;
 		default:
-			udp.serveSocket(std::move(lane));
+			statusSlot = udp4().serveSocket(AF_INET, std::move(lane));
 			break;
 		}
 		return managarm::fs::Errors::SUCCESS;
 	case SOCK_STREAM:
-		tcp.serveSocket(flags, std::move(lane));
+		statusSlot = tcp4().serveSocket(AF_INET, flags, std::move(lane));
 		return managarm::fs::Errors::SUCCESS;
 	default:
 		return managarm::fs::Errors::ILLEGAL_ARGUMENT;
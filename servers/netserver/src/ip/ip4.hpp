@@ -7,24 +7,20 @@
 #include <smarter.hpp>
 #include <netserver/nic.hpp>
 #include <protocols/fs/common.hpp>
+#include <protocols/fs/server.hpp>
 #include <set>
 #include <cstdint>
 #include <memory>
 #include <optional>
+#include <vector>
 
 #include "icmp.hpp"
-#include "udp4.hpp"
-#include "tcp4.hpp"
+#include "ip.hpp"
+#include "lpm-trie.hpp"
 
 #include <netserver/nic.hpp>
 #include "fs.bragi.hpp"
 
-enum class IpProto : uint16_t {
-	icmp = 1,
-	tcp = 6,
-	udp = 17,
-};
-
 struct CidrAddress {
 	uint32_t ip;
 	uint8_t prefix;
@@ -64,13 +60,30 @@ struct Ip4Router {
 
 	// false if insertion fails
 	bool addRoute(Route r);
+	// Returns the preferred route of the longest prefix that contains ip.
 	std::optional<Route> resolveRoute(uint32_t ip, std::shared_ptr<nic::Link> link = {});
 
 	inline const std::set<Route> &getRoutes() const {
 		return routes;
 	}
+
+	// Changes whenever a route, a local address or a neighbour changes.
+	// Cached routing decisions (see Ip4RouteCache) are only valid for one generation.
+	uint64_t generation() const {
+		return generation_;
+	}
+
+	void invalidate() {
+		generation_++;
+	}
+
 private:
+	void removeRoute(std::set<Route>::iterator it);
+
 	std::set<Route> routes;
+	// Routes of each prefix, in the order of the set (i.e., by preference).
+	LpmTrie<std::vector<const Route *>> trie_;
+	uint64_t generation_ = 1;
 };
 
 class Ip4Packet {
@@ -108,6 +121,8 @@ public:
 	static_assert(sizeof(header) == 20, "bad header size");
 	arch::dma_buffer_view data;
 	std::weak_ptr<nic::Link> link;
+	// The NIC has already verified the transport layer checksum.
+	bool checksumVerified = false;
 
 	inline arch::dma_buffer_view payload() const {
 		return data.subview(header.ihl * 4);
@@ -126,14 +141,35 @@ struct Ip4TargetInfo {
 	uint32_t source;
 	Ip4Router::Route route;
 	std::shared_ptr<nic::Link> link;
+	// MAC address of the next hop, if it is already known.
+	std::optional<nic::MacAddress> nextHop;
+};
+
+// Per-socket cache of the routing decision for the most recent destination.
+struct Ip4RouteCache {
+	// Like Ip4::targetByRemote(), but reuses the previous result if the
+	// destination is unchanged and the router generation did not change.
+	async::result<std::optional<Ip4TargetInfo>> lookup(uint32_t remote,
+		std::shared_ptr<nic::Link> link = {});
+
+private:
+	uint64_t generation_ = 0;
+	uint32_t remote_ = 0;
+	int linkFilter_ = 0;
+	// Stored without the link, which is only referenced weakly.
+	std::optional<Ip4TargetInfo> info_;
+	std::weak_ptr<nic::Link> link_;
 };
 
 struct Ip4Socket;
 struct Ip4 {
-	managarm::fs::Errors serveSocket(helix::UniqueLane lane, int type, int proto, int flags);
+	// statusSlot is set to the socket's status table slot (or to zero).
+	managarm::fs::Errors serveSocket(helix::UniqueLane lane, int type, int proto, int flags,
+			size_t &statusSlot);
 	// frame is a view into the owner buffer, stripping away eth bits
 	void feedPacket(nic::MacAddress dest, nic::MacAddress src,
-		arch::dma_buffer owner, arch::dma_buffer_view frame, std::weak_ptr<nic::Link> link);
+		arch::dma_buffer owner, arch::dma_buffer_view frame, std::weak_ptr<nic::Link> link,
+		bool checksumVerified = false);
 
 	bool hasIp(uint32_t ip);
 	std::shared_ptr<nic::Link> getLink(uint32_t ip);
@@ -145,15 +181,21 @@ struct Ip4 {
 	async::result<std::optional<Ip4TargetInfo>> targetByRemote(uint32_t, std::shared_ptr<nic::Link> link = {});
 	async::result<protocols::fs::Error> sendFrame(Ip4TargetInfo,
 		void*, size_t,
-		uint16_t);
+		uint16_t, IpOffload offload = {});
+	// Same as above, but takes the transport header and the payload separately
+	// so that callers do not have to assemble the packet first.
+	async::result<protocols::fs::Error> sendFrame(Ip4TargetInfo,
+		const void *transportHeader, size_t transportHeaderLen,
+		const void *data, size_t dataLen,
+		uint16_t, IpOffload offload = {});
 private:
 	std::multimap<int, smarter::shared_ptr<Ip4Socket>> sockets;
 	std::map<CidrAddress, std::weak_ptr<nic::Link>> ips;
 
-	Udp4 udp;
 	Icmp icmp;
-	Tcp4 tcp;
 };
 
 Ip4 &ip4();
+// Status table that is shared with posix for all sockets of the netserver.
+protocols::fs::StatusTableProvider &statusTable();
 Ip4Router &ip4Router();
@@ -0,0 +1,477 @@
+#include "ip6.hpp"
+
+#include "inet.hpp"
+#include "ndp.hpp"
+#include "tcp4.hpp"
+#include "udp4.hpp"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <protocols/fs/server.hpp>
+
+using Route = Ip6Router::Route;
+
+namespace {
+
+// Extension headers that may precede the upper layer header (RFC 8200, 4.1).
+constexpr uint8_t hopByHopHeader = 0;
+constexpr uint8_t routingHeader = 43;
+constexpr uint8_t fragmentHeader = 44;
+constexpr uint8_t destinationOptionsHeader = 60;
+
+const Ip6Address linkLocalPrefix = Ip6Address::fromKey(Ip6Key{0xFE80} << 112);
+const Ip6Address multicastPrefix = Ip6Address::fromKey(Ip6Key{0xFF} << 120);
+
+} // anonymous namespace
+
+const Ip6Address ip6AllNodes = Ip6Address::fromKey(Ip6Key{0xFF02} << 112 | 1);
+const Ip6Address ip6AllRouters = Ip6Address::fromKey(Ip6Key{0xFF02} << 112 | 2);
+
+Ip6Router &ip6Router() {
+	static Ip6Router inst;
+	return inst;
+}
+
+Ip6 &ip6() {
+	static Ip6 inst;
+	return inst;
+}
+
+Ip6Address Ip6Address::fromKey(Ip6Key key) {
+	Ip6Address addr;
+	for(int i = 15; i >= 0; i--) {
+		addr.bytes[i] = key & 0xFF;
+		key >>= 8;
+	}
+	return addr;
+}
+
+Ip6Address Ip6Address::fromIp4(uint32_t ip) {
+	return fromKey(Ip6Key{0xFFFF} << 32 | ip);
+}
+
+Ip6Address Ip6Address::fromPrefixAndMac(const Ip6Address &prefix, nic::MacAddress mac) {
+	Ip6Address addr = prefix;
+	addr.bytes[8] = mac[0] ^ 0x02;
+	addr.bytes[9] = mac[1];
+	addr.bytes[10] = mac[2];
+	addr.bytes[11] = 0xFF;
+	addr.bytes[12] = 0xFE;
+	addr.bytes[13] = mac[3];
+	addr.bytes[14] = mac[4];
+	addr.bytes[15] = mac[5];
+	return addr;
+}
+
+Ip6Key Ip6Address::key() const {
+	Ip6Key key = 0;
+	for(auto b : bytes)
+		key = (key << 8) | b;
+	return key;
+}
+
+bool Ip6Address::isIp4Mapped() const {
+	return std::all_of(bytes.begin(), bytes.begin() + 10, [] (uint8_t b) { return !b; })
+		&& bytes[10] == 0xFF && bytes[11] == 0xFF;
+}
+
+uint32_t Ip6Address::ip4() const {
+	return uint32_t{bytes[12]} << 24 | uint32_t{bytes[13]} << 16
+		| uint32_t{bytes[14]} << 8 | bytes[15];
+}
+
+Ip6Address Ip6Address::solicitedNode() const {
+	auto addr = fromKey(Ip6Key{0xFF02} << 112 | Ip6Key{0x1FF} << 24);
+	std::copy(bytes.begin() + 13, bytes.end(), addr.bytes.begin() + 13);
+	return addr;
+}
+
+nic::MacAddress Ip6Address::multicastMac() const {
+	return nic::MacAddress{{0x33, 0x33, bytes[12], bytes[13], bytes[14], bytes[15]}};
+}
+
+std::ostream &operator<<(std::ostream &os, const Ip6Address &addr) {
+	char str[INET6_ADDRSTRLEN];
+	if(!inet_ntop(AF_INET6, addr.bytes.data(), str, sizeof(str)))
+		return os << "(invalid)";
+	return os << str;
+}
+
+std::weak_ordering operator<=>(const Route &lhs, const Route &rhs) {
+	// bigger MTU is better, and hence sorts lower
+	auto order = std::tie(lhs.network, lhs.metric, lhs.scope, rhs.mtu, lhs.type, lhs.protocol,
+					lhs.gateway, lhs.source, lhs.flags) <=>
+		std::tie(rhs.network, rhs.metric, rhs.scope, lhs.mtu, rhs.type, rhs.protocol,
+				rhs.gateway, rhs.source, rhs.flags);
+	if(order != 0)
+		return order;
+
+	// Unlike for IPv4, the same prefix (e.g., fe80::/64) commonly exists on multiple links.
+	// Order by owner since that remains stable once the link is gone.
+	if(lhs.link.owner_before(rhs.link))
+		return std::weak_ordering::less;
+	if(rhs.link.owner_before(lhs.link))
+		return std::weak_ordering::greater;
+	return std::weak_ordering::equivalent;
+}
+
+bool operator==(const Route &lhs, const Route &rhs) {
+	return operator<=>(lhs, rhs) == 0;
+}
+
+bool Ip6Router::addRoute(Route r) {
+	auto [it, inserted] = routes.emplace(std::move(r));
+	if(!inserted)
+		return false;
+
+	auto &entries = trie_.insert(it->network.ip.key(), it->network.prefix);
+	auto pos = std::find_if(entries.begin(), entries.end(),
+		[&] (const Route *other) { return *it < *other; });
+	entries.insert(pos, &*it);
+	invalidate();
+	return true;
+}
+
+void Ip6Router::removeRoute(std::set<Route>::iterator it) {
+	auto entries = trie_.find(it->network.ip.key(), it->network.prefix);
+	assert(entries);
+	std::erase(*entries, &*it);
+	if(entries->empty())
+		trie_.erase(it->network.ip.key(), it->network.prefix);
+	routes.erase(it);
+	invalidate();
+}
+
+std::optional<Route> Ip6Router::resolveRoute(const Ip6Address &ip, std::shared_ptr<nic::Link> link) {
+	std::optional<Route> result;
+	std::vector<const Route *> expired;
+	trie_.longestMatch(ip.key(), [&] (const std::vector<const Route *> &entries) {
+		for(auto r : entries) {
+			auto target = r->link.lock();
+			if(!target) {
+				expired.push_back(r);
+				continue;
+			}
+			if(link && target->index() != link->index())
+				continue;
+			result = *r;
+			return true;
+		}
+		return false;
+	});
+
+	for(auto r : expired)
+		removeRoute(routes.find(*r));
+	return result;
+}
+
+bool Ip6Packet::parse(arch::dma_buffer owner, arch::dma_buffer_view frame) {
+	buffer_ = std::move(owner);
+	data = frame;
+	if (data.size() < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, data.byte_data(), sizeof(header));
+	if ((header.versionClassFlow.load() >> 28) != 6) {
+		return false;
+	}
+
+	// ensure we only access the correct parts of the buffer
+	size_t length = sizeof(header) + header.payloadLength.load();
+	if (data.size() < length) {
+		return false;
+	}
+	data = data.subview(0, length);
+
+	// Unlike IPv4, there is no header checksum. Skip over the extension headers
+	// that we do not act upon; all of them start with the next header and their length.
+	protocol = header.nextHeader;
+	payloadOffset = sizeof(header);
+	while (protocol == hopByHopHeader || protocol == routingHeader
+			|| protocol == destinationOptionsHeader) {
+		if (data.size() < payloadOffset + 8) {
+			return false;
+		}
+		auto ext = reinterpret_cast<const uint8_t *>(data.data()) + payloadOffset;
+		// We do not forward packets, so we cannot process routing headers
+		// that still have segments left (RFC 8200, 4.4).
+		if (protocol == routingHeader && ext[3]) {
+			return false;
+		}
+		protocol = ext[0];
+		payloadOffset += (ext[1] + 1) * 8;
+	}
+
+	// TODO: reassembly
+	if (protocol == fragmentHeader) {
+		return false;
+	}
+
+	return payloadOffset <= data.size();
+}
+
+async::result<std::optional<Ip6TargetInfo>>
+Ip6::targetByRemote(const Ip6Address &remote, std::shared_ptr<nic::Link> link) {
+	auto oroute = ip6Router().resolveRoute(remote, link);
+	if (!oroute) {
+		std::cout << "netserver: net unreachable" << std::endl;
+		co_return std::nullopt;
+	}
+
+	auto target = oroute->link.lock();
+	if (!target) {
+		std::cout << "netserver: route link disappeared"
+			<< std::endl;
+		co_return std::nullopt;
+	}
+
+	auto source = oroute->source;
+	if (source.isUnspecified())
+		source = findLinkIp(remote, target.get()).value_or(Ip6Address{});
+	if (source.isUnspecified()) {
+		std::cout << "netserver: could not find source address for "
+			<< remote << std::endl;
+		co_return std::nullopt;
+	}
+
+	co_return Ip6TargetInfo { remote, source, *oroute, std::move(target) };
+}
+
+async::result<std::optional<Ip6TargetInfo>>
+Ip6RouteCache::lookup(const Ip6Address &remote, std::shared_ptr<nic::Link> link) {
+	auto generation = ip6Router().generation();
+	int linkFilter = link ? link->index() : 0;
+	if(info_ && generation_ == generation && remote_ == remote && linkFilter_ == linkFilter) {
+		if(auto target = link_.lock()) {
+			auto ti = *info_;
+			ti.link = std::move(target);
+			co_return ti;
+		}
+	}
+
+	auto ti = co_await ip6().targetByRemote(remote, std::move(link));
+	if(!ti) {
+		info_ = std::nullopt;
+		co_return std::nullopt;
+	}
+
+	// As for IPv4, sendFrame() resolves the neighbour if necessary,
+	// which bumps the generation.
+	if(!ti->link->rawIp() && !remote.isMulticast())
+		ti->nextHop = neigh6().lookup(ti->route.gateway.isUnspecified() ? remote : ti->route.gateway);
+
+	generation_ = generation;
+	remote_ = remote;
+	linkFilter_ = linkFilter;
+	link_ = ti->link;
+	info_ = *ti;
+	info_->link = nullptr;
+	co_return ti;
+}
+
+bool Ip6::hasIp(const Ip6Address &addr) {
+	return std::any_of(ips.cbegin(), ips.cend(),
+		[&] (auto &x) {
+			return x.first.ip == addr;
+		});
+}
+
+async::result<protocols::fs::Error> Ip6::sendFrame(Ip6TargetInfo ti,
+		const void *transportHeader, size_t transportHeaderLen,
+		const void *data, size_t dataLen, uint16_t proto, IpOffload offload) {
+	size_t len = transportHeaderLen + dataLen;
+
+	// We do not support jumbograms (RFC 2675).
+	if (len > 0xFFFF)
+		co_return protocols::fs::Error::messageSize;
+	size_t header_size = sizeof(Ip6Packet::Header);
+	size_t packet_size = len + header_size;
+
+	size_t wire_size = packet_size;
+	bool segmented = needsSegmentation(offload, len);
+	if (segmented) {
+		assert(offload.checksumOffset);
+		wire_size = header_size + offload.transportHeaderSize + offload.segmentSize;
+	}
+
+	// TODO: fragmentation
+	if (ti.route.mtu != 0 && ti.route.mtu < wire_size) {
+		std::cout << "netserver: cant fragment 1" << std::endl;
+		co_return protocols::fs::Error::messageSize;
+	}
+
+	auto &target = ti.link;
+	if (target->mtu < wire_size) {
+		std::cout << "netserver: cant fragment 2" << std::endl;
+		co_return protocols::fs::Error::messageSize;
+	}
+
+	Ip6Packet::Header hdr{
+		.versionClassFlow = uint32_t{6} << 28,
+		.payloadLength = static_cast<uint16_t>(len),
+		.nextHeader = static_cast<uint8_t>(proto),
+		.hopLimit = ti.hopLimit,
+		.source = ti.source,
+		.destination = ti.remote,
+	};
+
+	nic::Link::AllocatedBuffer fb;
+
+	if(!target->rawIp()) {
+		auto mac = ti.nextHop;
+		if (ti.remote.isMulticast()) {
+			mac = ti.remote.multicastMac();
+		} else if (!mac) {
+			auto macTarget = ti.route.gateway;
+			if (macTarget.isUnspecified())
+				macTarget = ti.remote;
+			mac = co_await neigh6().tryResolve(macTarget, ti.source, target);
+		}
+		if (!mac) {
+			co_return protocols::fs::Error::hostUnreachable;
+		}
+
+		fb = target->allocateFrame(*mac, nic::ETHER_TYPE_IP6, packet_size);
+	} else {
+		fb = target->allocateFrame(packet_size);
+	}
+
+	std::memcpy(fb.payload.data(), &hdr, sizeof(hdr));
+	std::memcpy(fb.payload.subview(header_size).byte_data(), transportHeader, transportHeaderLen);
+	if (dataLen)
+		std::memcpy(fb.payload.subview(header_size + transportHeaderLen).byte_data(), data, dataLen);
+
+	auto networkStart = fb.frame.size() - fb.payload.size();
+	co_await sendWithOffload(*target, fb.frame, networkStart, header_size, offload, segmented);
+	co_return protocols::fs::Error::none;
+}
+
+void Ip6::feedPacket(nic::MacAddress, nic::MacAddress,
+		arch::dma_buffer owner, arch::dma_buffer_view frame, std::weak_ptr<nic::Link> link,
+		bool checksumVerified) {
+	Ip6Packet hdr{};
+	hdr.link = link;
+	hdr.checksumVerified = checksumVerified;
+
+	if (!hdr.parse(std::move(owner), frame)) {
+		std::cout << "netserver: runt, or otherwise invalid, ip6 frame received"
+			<< std::endl;
+		return;
+	}
+
+	auto hdrs = smarter::make_shared<const Ip6Packet>(std::move(hdr));
+
+	switch (static_cast<IpProto>(hdrs->protocol)) {
+	case IpProto::icmp6: icmp.feedDatagram(hdrs); break;
+	case IpProto::udp: udp4().feedDatagram(InetPacket{hdrs}); break;
+	case IpProto::tcp: tcp4().feedDatagram(InetPacket{hdrs}); break;
+	default: break;
+	}
+}
+
+async::detached Ip6::configureLink(std::shared_ptr<nic::Link> link) {
+	// Without a MAC address, there is no interface identifier.
+	if (link->rawIp() || !link->deviceMac())
+		co_return;
+
+	// Multicast and link-local destinations are always on-link.
+	ip6Router().addRoute({ {multicastPrefix, 8}, link });
+	ip6Router().addRoute({ {linkLocalPrefix, 64}, link });
+
+	auto linkLocal = Ip6Address::fromPrefixAndMac(linkLocalPrefix, link->deviceMac());
+	if (co_await neigh6().detectDuplicate(linkLocal, link)) {
+		std::cout << "netserver: link-local address " << linkLocal
+			<< " is already in use on " << link->name() << std::endl;
+		co_return;
+	}
+	setLink({linkLocal, 64}, link);
+	std::cout << "netserver: configured " << linkLocal << " on " << link->name() << std::endl;
+
+	co_await neigh6().solicitRouters(link);
+}
+
+void Ip6::setLink(Ip6Cidr addr, std::weak_ptr<nic::Link> l) {
+	ips.emplace(addr, std::move(l));
+	ip6Router().invalidate();
+}
+
+std::shared_ptr<nic::Link> Ip6::getLink(const Ip6Address &addr) {
+	auto iter = std::find_if(ips.begin(), ips.end(),
+		[&] (const auto &e) { return e.first.ip == addr; });
+	if (iter == ips.end()) {
+		return {};
+	}
+	auto ptr = iter->second.lock();
+	if (!ptr) {
+		ips.erase(iter);
+		ip6Router().invalidate();
+		return {};
+	}
+	return ptr;
+}
+
+std::vector<Ip6Cidr> Ip6::getCidrsByIndex(int index) {
+	std::vector<Ip6Cidr> result;
+	for (auto &[cidr, link] : ips) {
+		auto ptr = link.lock();
+		if (ptr && ptr->index() == index)
+			result.push_back(cidr);
+	}
+	return result;
+}
+
+bool Ip6::deleteLink(Ip6Cidr addr) {
+	if(!ips.erase(addr))
+		return false;
+	ip6Router().invalidate();
+	return true;
+}
+
+std::optional<Ip6Address> Ip6::findLinkIp(const Ip6Address &remote, nic::Link *link) {
+	// Simplified source address selection (RFC 6724, 5): prefer addresses
+	// of the same scope, and among those, the longest matching prefix.
+	std::optional<Ip6Address> best;
+	int bestScore = -1;
+	for (auto &[cidr, l] : ips) {
+		auto o = l.lock();
+		if (o.get() != link)
+			continue;
+
+		int score = 0;
+		if (cidr.ip.isLinkLocal() == remote.isLinkLocal())
+			score += 2;
+		if (cidr.sameNet(remote))
+			score += 1;
+		if (score > bestScore) {
+			best = cidr.ip;
+			bestScore = score;
+		}
+	}
+	return best;
+}
+
+managarm::fs::Errors Ip6::serveSocket(helix::UniqueLane lane, int type, int proto, int flags,
+		size_t &statusSlot) {
+	statusSlot = 0;
+	switch (type) {
+	case SOCK_DGRAM:
+		switch(proto) {
+		case IPPROTO_ICMPV6:
+			// TODO: ICMPv6 sockets
+			return managarm::fs::Errors::ILLEGAL_ARGUMENT;
+		default:
+			statusSlot = udp4().serveSocket(AF_INET6, std::move(lane));
+			break;
+		}
+		return managarm::fs::Errors::SUCCESS;
+	case SOCK_STREAM:
+		statusSlot = tcp4().serveSocket(AF_INET6, flags, std::move(lane));
+		return managarm::fs::Errors::SUCCESS;
+	default:
+		return managarm::fs::Errors::ILLEGAL_ARGUMENT;
+	}
+}
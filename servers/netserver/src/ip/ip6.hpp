@@ -0,0 +1,227 @@
+#pragma once
+
+#include <arch/bit.hpp>
+#include <arch/dma_structs.hpp>
+#include <arch/variable.hpp>
+#include <async/result.hpp>
+#include <helix/ipc.hpp>
+#include <netserver/nic.hpp>
+#include <protocols/fs/common.hpp>
+#include <smarter.hpp>
+#include <array>
+#include <compare>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <set>
+#include <vector>
+
+#include "icmp6.hpp"
+#include "ip.hpp"
+#include "lpm-trie.hpp"
+
+#include "fs.bragi.hpp"
+
+// IPv6 address as an integer in host byte order.
+using Ip6Key = unsigned __int128;
+
+struct Ip6Address {
+	static Ip6Address fromKey(Ip6Key key);
+	// IPv4-mapped address (RFC 4291, 2.5.5.2) of a (host byte order) IPv4 address.
+	static Ip6Address fromIp4(uint32_t ip);
+	// Address in the /64 prefix with the modified EUI-64 interface identifier
+	// that is derived from mac (RFC 4291, 2.5.1 and appendix A).
+	static Ip6Address fromPrefixAndMac(const Ip6Address &prefix, nic::MacAddress mac);
+
+	Ip6Key key() const;
+
+	bool isUnspecified() const {
+		return *this == Ip6Address{};
+	}
+
+	bool isIp4Mapped() const;
+
+	// Host byte order IPv4 address of an IPv4-mapped address.
+	uint32_t ip4() const;
+
+	bool isMulticast() const {
+		return bytes[0] == 0xFF;
+	}
+
+	// Unicast or multicast address that is only valid on a single link.
+	bool isLinkLocal() const {
+		return (bytes[0] == 0xFE && (bytes[1] & 0xC0) == 0x80)
+			|| (isMulticast() && (bytes[1] & 0xF) == 2);
+	}
+
+	// Solicited-node multicast address (RFC 4291, 2.7.1).
+	Ip6Address solicitedNode() const;
+
+	// Ethernet address of a multicast address (RFC 2464, 7).
+	nic::MacAddress multicastMac() const;
+
+	friend auto operator<=>(const Ip6Address &, const Ip6Address &) = default;
+
+	std::array<uint8_t, 16> bytes = {};
+};
+
+static_assert(sizeof(Ip6Address) == 16);
+
+std::ostream &operator<<(std::ostream &os, const Ip6Address &addr);
+
+// ff02::1 and ff02::2.
+extern const Ip6Address ip6AllNodes;
+extern const Ip6Address ip6AllRouters;
+
+struct Ip6Cidr {
+	Ip6Address ip;
+	uint8_t prefix;
+
+	bool sameNet(const Ip6Address &other) const {
+		return (other.key() & mask()) == (ip.key() & mask());
+	}
+
+	Ip6Key mask() const {
+		return prefix ? ~Ip6Key{0} << (128 - prefix) : 0;
+	}
+
+	friend auto operator<=>(const Ip6Cidr &, const Ip6Cidr &) = default;
+};
+
+struct Ip6Router {
+	struct Route {
+		inline Route(Ip6Cidr net, std::weak_ptr<nic::Link> link)
+			: network(net), link(link) {}
+
+		Ip6Cidr network;
+		std::weak_ptr<nic::Link> link;
+		unsigned int mtu = 0;
+		Ip6Address gateway;
+		unsigned int metric = 0;
+		Ip6Address source;
+		uint8_t scope = 0;
+		uint8_t type = 0;
+		uint8_t protocol = 0;
+		uint32_t flags = 0;
+
+		friend std::weak_ordering operator<=>(const Route &, const Route &);
+		friend bool operator==(const Route &, const Route &);
+	};
+
+	// false if insertion fails
+	bool addRoute(Route r);
+	// Returns the preferred route of the longest prefix that contains ip.
+	std::optional<Route> resolveRoute(const Ip6Address &ip, std::shared_ptr<nic::Link> link = {});
+
+	inline const std::set<Route> &getRoutes() const {
+		return routes;
+	}
+
+	// Same as Ip4Router::generation(), see Ip6RouteCache.
+	uint64_t generation() const {
+		return generation_;
+	}
+
+	void invalidate() {
+		generation_++;
+	}
+
+private:
+	void removeRoute(std::set<Route>::iterator it);
+
+	std::set<Route> routes;
+	// Routes of each prefix, in the order of the set (i.e., by preference).
+	LpmTrie<std::vector<const Route *>, Ip6Key> trie_;
+	uint64_t generation_ = 1;
+};
+
+class Ip6Packet {
+	arch::dma_buffer buffer_;
+public:
+	struct Header {
+		arch::scalar_storage<uint32_t, arch::big_endian> versionClassFlow;
+		arch::scalar_storage<uint16_t, arch::big_endian> payloadLength;
+		uint8_t nextHeader;
+		uint8_t hopLimit;
+		Ip6Address source;
+		Ip6Address destination;
+	} header;
+	static_assert(sizeof(header) == 40, "bad header size");
+	// Upper layer protocol, i.e., the next header after the extension headers.
+	uint8_t protocol = 0;
+	// Offset of the upper layer header into data.
+	size_t payloadOffset = 0;
+	arch::dma_buffer_view data;
+	std::weak_ptr<nic::Link> link;
+	// The NIC has already verified the transport layer checksum.
+	bool checksumVerified = false;
+
+	inline arch::dma_buffer_view payload() const {
+		return data.subview(payloadOffset);
+	}
+
+	// assumes frame is a valid view into owner
+	bool parse(arch::dma_buffer owner, arch::dma_buffer_view frame);
+};
+
+struct Ip6TargetInfo {
+	Ip6Address remote;
+	Ip6Address source;
+	Ip6Router::Route route;
+	std::shared_ptr<nic::Link> link;
+	// MAC address of the next hop, if it is already known.
+	std::optional<nic::MacAddress> nextHop;
+	uint8_t hopLimit = 64;
+};
+
+// Per-socket cache of the routing decision, see Ip4RouteCache.
+struct Ip6RouteCache {
+	async::result<std::optional<Ip6TargetInfo>> lookup(const Ip6Address &remote,
+		std::shared_ptr<nic::Link> link = {});
+
+private:
+	uint64_t generation_ = 0;
+	Ip6Address remote_;
+	int linkFilter_ = 0;
+	// Stored without the link, which is only referenced weakly.
+	std::optional<Ip6TargetInfo> info_;
+	std::weak_ptr<nic::Link> link_;
+};
+
+struct Ip6 {
+	// statusSlot is set to the socket's status table slot (or to zero).
+	managarm::fs::Errors serveSocket(helix::UniqueLane lane, int type, int proto, int flags,
+			size_t &statusSlot);
+	// frame is a view into the owner buffer, stripping away eth bits
+	void feedPacket(nic::MacAddress dest, nic::MacAddress src,
+		arch::dma_buffer owner, arch::dma_buffer_view frame, std::weak_ptr<nic::Link> link,
+		bool checksumVerified = false);
+
+	// Assigns a link-local address to the link and solicits router advertisements
+	// such that global addresses are configured automatically (SLAAC).
+	async::detached configureLink(std::shared_ptr<nic::Link> link);
+
+	bool hasIp(const Ip6Address &ip);
+	std::shared_ptr<nic::Link> getLink(const Ip6Address &ip);
+	std::vector<Ip6Cidr> getCidrsByIndex(int index);
+	bool deleteLink(Ip6Cidr addr);
+	void setLink(Ip6Cidr addr, std::weak_ptr<nic::Link> link);
+	// Selects the source address for packets to remote that leave through link.
+	std::optional<Ip6Address> findLinkIp(const Ip6Address &remote, nic::Link *link);
+
+	async::result<std::optional<Ip6TargetInfo>> targetByRemote(const Ip6Address &remote,
+		std::shared_ptr<nic::Link> link = {});
+	async::result<protocols::fs::Error> sendFrame(Ip6TargetInfo,
+		const void *transportHeader, size_t transportHeaderLen,
+		const void *data, size_t dataLen,
+		uint16_t proto, IpOffload offload = {});
+private:
+	std::map<Ip6Cidr, std::weak_ptr<nic::Link>> ips;
+
+	Icmp6 icmp;
+};
+
+Ip6 &ip6();
+Ip6Router &ip6Router();
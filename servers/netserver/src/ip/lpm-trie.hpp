@@ -0,0 +1,168 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// Path-compressed binary trie for longest prefix matching on IP addresses.
+// Key is an unsigned integer that holds the address in host byte order
+// (uint32_t for IPv4, unsigned __int128 for IPv6).
+// Each node stores one prefix (and a value of type T); nodes without a value
+// only exist where two branches split.
+template<typename T, typename Key = uint32_t>
+struct LpmTrie {
+	static constexpr uint8_t keyBits = sizeof(Key) * 8;
+
+	// Returns the value of the given prefix, inserting a default constructed value if necessary.
+	T &insert(Key prefix, uint8_t length) {
+		assert(length <= keyBits);
+		prefix &= mask(length);
+
+		auto *slot = &root_;
+		while(true) {
+			auto node = slot->get();
+			if(!node) {
+				*slot = std::make_unique<Node>(prefix, length);
+				size_++;
+				return *(*slot)->value;
+			}
+
+			auto common = commonLength(node->prefix, prefix, std::min(node->length, length));
+			if(common == node->length && common == length) {
+				if(!node->value) {
+					node->value.emplace();
+					size_++;
+				}
+				return *node->value;
+			}
+
+			if(common == node->length) {
+				slot = &node->children[bit(prefix, node->length)];
+				continue;
+			}
+
+			// Split the edge to node at the first differing bit.
+			auto split = std::make_unique<Node>(prefix & mask(common), common);
+			split->value.reset();
+			split->children[bit(node->prefix, common)] = std::move(*slot);
+			*slot = std::move(split);
+			if(common == length) {
+				(*slot)->value.emplace();
+				size_++;
+				return *(*slot)->value;
+			}
+			slot = &(*slot)->children[bit(prefix, common)];
+		}
+	}
+
+	T *find(Key prefix, uint8_t length) {
+		prefix &= mask(length);
+		auto node = root_.get();
+		while(node && node->length <= length) {
+			if((prefix & mask(node->length)) != node->prefix)
+				return nullptr;
+			if(node->length == length)
+				return node->value ? &*node->value : nullptr;
+			node = node->children[bit(prefix, node->length)].get();
+		}
+		return nullptr;
+	}
+
+	void erase(Key prefix, uint8_t length) {
+		prefix &= mask(length);
+		erase_(root_, prefix, length);
+	}
+
+	// Calls f on the values of all prefixes that contain addr, from the longest
+	// to the shortest prefix, until f returns true. Returns whether f returned true.
+	template<typename F>
+	bool longestMatch(Key addr, F f) {
+		std::array<Node *, keyBits + 1> path;
+		size_t n = 0;
+		auto node = root_.get();
+		while(node && (addr & mask(node->length)) == node->prefix) {
+			if(node->value)
+				path[n++] = node;
+			if(node->length == keyBits)
+				break;
+			node = node->children[bit(addr, node->length)].get();
+		}
+
+		while(n) {
+			if(f(*path[--n]->value))
+				return true;
+		}
+		return false;
+	}
+
+	// Number of stored prefixes.
+	size_t size() const {
+		return size_;
+	}
+
+private:
+	struct Node {
+		Node(Key prefix, uint8_t length)
+		: prefix{prefix}, length{length}, value{std::in_place} { }
+
+		Key prefix;
+		uint8_t length;
+		std::optional<T> value;
+		std::unique_ptr<Node> children[2];
+	};
+
+	static Key mask(uint8_t length) {
+		return length ? ~Key{0} << (keyBits - length) : 0;
+	}
+
+	// Bit at position index, counting from the most significant bit.
+	static int bit(Key addr, uint8_t index) {
+		return (addr >> (keyBits - 1 - index)) & 1;
+	}
+
+	// Number of leading zero bits of a non-zero key.
+	static uint8_t leadingZeros(Key x) {
+		if constexpr (keyBits <= 64) {
+			return __builtin_clzll(x) - (64 - keyBits);
+		}else{
+			static_assert(keyBits == 128);
+			auto high = static_cast<uint64_t>(x >> 64);
+			if(high)
+				return __builtin_clzll(high);
+			return 64 + __builtin_clzll(static_cast<uint64_t>(x));
+		}
+	}
+
+	static uint8_t commonLength(Key a, Key b, uint8_t limit) {
+		auto diff = a ^ b;
+		uint8_t common = diff ? leadingZeros(diff) : keyBits;
+		return std::min(common, limit);
+	}
+
+	void erase_(std::unique_ptr<Node> &slot, Key prefix, uint8_t length) {
+		auto node = slot.get();
+		if(!node || node->length > length || (prefix & mask(node->length)) != node->prefix)
+			return;
+
+		if(node->length < length) {
+			erase_(node->children[bit(prefix, node->length)], prefix, length);
+		}else if(node->value) {
+			node->value.reset();
+			size_--;
+		}
+
+		// Remove nodes that neither store a value nor split two branches.
+		if(node->value)
+			return;
+		if(node->children[0] && node->children[1])
+			return;
+		auto child = std::move(node->children[node->children[0] ? 0 : 1]);
+		slot = std::move(child);
+	}
+
+	std::unique_ptr<Node> root_;
+	size_t size_ = 0;
+};
@@ -0,0 +1,379 @@
+#include "ndp.hpp"
+
+#include <helix/ipc.hpp>
+#include <helix/timer.hpp>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Neighbour discovery options (RFC 4861, 4.6).
+constexpr uint8_t sourceLinkLayerOption = 1;
+constexpr uint8_t targetLinkLayerOption = 2;
+constexpr uint8_t prefixInformationOption = 3;
+constexpr uint8_t mtuOption = 5;
+
+// Flags of neighbour advertisements.
+constexpr uint8_t solicitedFlag = 0x40;
+constexpr uint8_t overrideFlag = 0x20;
+
+// Flags of the prefix information option.
+constexpr uint8_t onLinkFlag = 0x80;
+constexpr uint8_t autonomousFlag = 0x40;
+
+// RetransTimer and the router solicitation constants (RFC 4861, 10).
+constexpr uint64_t retransTimerNs = 1'000'000'000;
+constexpr int maxRouterSolicitations = 3;
+constexpr uint64_t routerSolicitationIntervalNs = 4'000'000'000;
+
+uint32_t loadBig32(const uint8_t *p) {
+	return uint32_t{p[0]} << 24 | uint32_t{p[1]} << 16 | uint32_t{p[2]} << 8 | p[3];
+}
+
+template<typename F>
+void forEachOption(arch::dma_buffer_view options, F fn) {
+	auto p = reinterpret_cast<const uint8_t *>(options.data());
+	size_t size = options.size();
+	while (size >= 2) {
+		// The length is given in units of 8 bytes and includes the type and length.
+		size_t length = p[1] * 8;
+		if (!length || length > size)
+			return;
+		fn(p[0], p, length);
+		p += length;
+		size -= length;
+	}
+}
+
+std::optional<nic::MacAddress> linkLayerOption(arch::dma_buffer_view options, uint8_t which) {
+	std::optional<nic::MacAddress> mac;
+	forEachOption(options, [&] (uint8_t type, const uint8_t *opt, size_t length) {
+		if (type != which || length < 8)
+			return;
+		mac.emplace();
+		std::memcpy(mac->data(), opt + 2, 6);
+	});
+	return mac;
+}
+
+void appendLinkLayerOption(std::vector<uint8_t> &body, uint8_t type, nic::MacAddress mac) {
+	body.push_back(type);
+	body.push_back(1);
+	body.insert(body.end(), mac.data(), mac.data() + 6);
+}
+
+std::vector<uint8_t> makeSolicitation(const Ip6Address &target, std::optional<nic::MacAddress> mac) {
+	std::vector<uint8_t> body(4);
+	body.insert(body.end(), target.bytes.begin(), target.bytes.end());
+	if (mac)
+		appendLinkLayerOption(body, sourceLinkLayerOption, *mac);
+	return body;
+}
+
+std::vector<uint8_t> makeAdvertisement(const Ip6Address &target, bool solicited, nic::MacAddress mac) {
+	std::vector<uint8_t> body(4);
+	body[0] = overrideFlag | (solicited ? solicitedFlag : 0);
+	body.insert(body.end(), target.bytes.begin(), target.bytes.end());
+	appendLinkLayerOption(body, targetLinkLayerOption, mac);
+	return body;
+}
+
+// Neighbour discovery messages bypass routing: they are always sent through
+// the given link, and with a hop limit of 255 (RFC 4861, 7.1.1).
+async::result<void> sendNdp(std::shared_ptr<nic::Link> link, Ip6Address source,
+		Ip6Address remote, std::optional<nic::MacAddress> nextHop,
+		Icmp6Type type, std::vector<uint8_t> body) {
+	Ip6TargetInfo ti{
+		.remote = remote,
+		.source = source,
+		.route = Ip6Router::Route{{remote, 128}, link},
+		.link = link,
+		.nextHop = nextHop,
+		.hopLimit = 255,
+	};
+	auto error = co_await sendIcmp6(std::move(ti), type, 0, std::move(body));
+	if (error != protocols::fs::Error::none)
+		std::cout << "netserver: failed to send NDP message to " << remote << std::endl;
+}
+
+async::detached entryProber(Ip6Address ip, Ndp::Entry &e, Ip6Address sender,
+		std::shared_ptr<nic::Link> link) {
+	e.state = Ndp::State::probe;
+	auto group = ip.solicitedNode();
+	for (int i = 0; i < 3; i++) {
+		co_await sendNdp(link, sender, group, group.multicastMac(),
+			Icmp6Type::neighbourSolicitation, makeSolicitation(ip, link->deviceMac()));
+		std::cout << "netserver: sent neighbour solicitation" << std::endl;
+
+		async::cancellation_event ev;
+		helix::TimeoutCancellation timer { retransTimerNs, ev };
+		co_await e.change.async_wait(ev);
+		co_await timer.retire();
+
+		if (e.state != Ndp::State::probe) {
+			co_return;
+		}
+	}
+	e.state = Ndp::State::failed;
+	e.change.raise();
+	ip6Router().invalidate();
+}
+
+// Configures an address that was derived from a router advertisement.
+async::detached configureAddress(Ip6Address addr, std::shared_ptr<nic::Link> link) {
+	if (co_await neigh6().detectDuplicate(addr, link)) {
+		std::cout << "netserver: address " << addr << " is already in use on "
+			<< link->name() << std::endl;
+		co_return;
+	}
+	ip6().setLink({addr, 64}, link);
+	std::cout << "netserver: configured " << addr << " on " << link->name() << std::endl;
+}
+
+} // anonymous namespace
+
+void Ndp::feedNdp(Icmp6Type type, smarter::shared_ptr<const Ip6Packet> packet,
+		arch::dma_buffer_view body) {
+	// Messages that might have been forwarded by a router are invalid (RFC 4861, 6.1 and 7.1).
+	if (packet->header.hopLimit != 255) {
+		return;
+	}
+
+	switch (type) {
+	case Icmp6Type::neighbourSolicitation: handleSolicitation_(*packet, body); break;
+	case Icmp6Type::neighbourAdvertisement: handleAdvertisement_(*packet, body); break;
+	case Icmp6Type::routerAdvertisement: handleRouterAdvertisement_(*packet, body); break;
+	default: break;
+	}
+}
+
+void Ndp::handleSolicitation_(const Ip6Packet &packet, arch::dma_buffer_view body) {
+	// Reserved field and target address.
+	if (body.size() < 20) {
+		return;
+	}
+	Ip6Address target;
+	std::memcpy(target.bytes.data(), body.byte_data() + 4, 16);
+	if (target.isMulticast()) {
+		return;
+	}
+
+	auto &source = packet.header.source;
+	if (auto it = tentative_.find(target); it != tentative_.end()) {
+		// Another node performs duplicate address detection for the same address.
+		if (source.isUnspecified()) {
+			it->second = true;
+		}
+		return;
+	}
+
+	auto link = packet.link.lock();
+	if (!link || ip6().getLink(target) != link) {
+		return;
+	}
+
+	if (source.isUnspecified()) {
+		// Duplicate address detection; the answer goes to all nodes (RFC 4861, 7.2.4).
+		async::detach(sendNdp(link, target, ip6AllNodes, std::nullopt,
+			Icmp6Type::neighbourAdvertisement,
+			makeAdvertisement(target, false, link->deviceMac())));
+		return;
+	}
+
+	auto sourceMac = linkLayerOption(body.subview(20), sourceLinkLayerOption);
+	if (sourceMac) {
+		updateTable(source, *sourceMac, link);
+	}
+
+	async::detach(sendNdp(link, target, source, sourceMac,
+		Icmp6Type::neighbourAdvertisement,
+		makeAdvertisement(target, true, link->deviceMac())));
+}
+
+void Ndp::handleAdvertisement_(const Ip6Packet &packet, arch::dma_buffer_view body) {
+	// Flags and target address.
+	if (body.size() < 20) {
+		return;
+	}
+	Ip6Address target;
+	std::memcpy(target.bytes.data(), body.byte_data() + 4, 16);
+	if (target.isMulticast()) {
+		return;
+	}
+
+	if (auto it = tentative_.find(target); it != tentative_.end()) {
+		it->second = true;
+		return;
+	}
+
+	// Unsolicited advertisements do not create entries (RFC 4861, 7.2.5).
+	if (!table_.contains(target)) {
+		return;
+	}
+
+	auto targetMac = linkLayerOption(body.subview(20), targetLinkLayerOption);
+	if (targetMac) {
+		updateTable(target, *targetMac, packet.link);
+	}
+}
+
+void Ndp::handleRouterAdvertisement_(const Ip6Packet &packet, arch::dma_buffer_view body) {
+	// Hop limit, flags, router lifetime, reachable time and retransmission timer.
+	if (body.size() < 12) {
+		return;
+	}
+
+	auto &source = packet.header.source;
+	if (!source.isLinkLocal()) {
+		return;
+	}
+
+	auto link = packet.link.lock();
+	if (!link) {
+		return;
+	}
+	advertisedLinks_.insert(link->index());
+
+	auto p = reinterpret_cast<const uint8_t *>(body.data());
+	uint16_t routerLifetime = uint16_t(p[2]) << 8 | p[3];
+	auto options = body.subview(12);
+
+	if (auto sourceMac = linkLayerOption(options, sourceLinkLayerOption); sourceMac) {
+		updateTable(source, *sourceMac, link);
+	}
+
+	unsigned int mtu = 0;
+	forEachOption(options, [&] (uint8_t type, const uint8_t *opt, size_t length) {
+		if (type == mtuOption && length >= 8)
+			mtu = loadBig32(opt + 4);
+	});
+
+	// TODO: Expire prefixes and routers once their lifetime ends.
+	forEachOption(options, [&] (uint8_t type, const uint8_t *opt, size_t length) {
+		if (type != prefixInformationOption || length < 32)
+			return;
+
+		uint8_t prefixLength = opt[2];
+		uint8_t flags = opt[3];
+		uint32_t validLifetime = loadBig32(opt + 4);
+		Ip6Address prefix;
+		std::memcpy(prefix.bytes.data(), opt + 16, 16);
+		if (prefixLength > 128 || !validLifetime || prefix.isLinkLocal())
+			return;
+
+		Ip6Cidr network{prefix, prefixLength};
+		network.ip = Ip6Address::fromKey(prefix.key() & network.mask());
+
+		if (flags & onLinkFlag) {
+			Ip6Router::Route route{network, link};
+			route.mtu = mtu;
+			ip6Router().addRoute(std::move(route));
+		}
+
+		// Interface identifiers derived from MAC addresses are 64 bits long (RFC 4862, 5.5.3).
+		if ((flags & autonomousFlag) && prefixLength == 64) {
+			auto addr = Ip6Address::fromPrefixAndMac(network.ip, link->deviceMac());
+			if (!ip6().hasIp(addr) && !tentative_.contains(addr))
+				configureAddress(addr, link);
+		}
+	});
+
+	if (routerLifetime) {
+		Ip6Router::Route route{{Ip6Address{}, 0}, link};
+		route.gateway = source;
+		route.mtu = mtu;
+		ip6Router().addRoute(std::move(route));
+	}
+}
+
+async::result<bool> Ndp::detectDuplicate(Ip6Address addr, std::shared_ptr<nic::Link> link) {
+	tentative_[addr] = false;
+
+	// The solicitation is sent from the unspecified address and hence
+	// without a source link-layer address (RFC 4862, 5.4.2).
+	auto group = addr.solicitedNode();
+	co_await sendNdp(link, {}, group, group.multicastMac(),
+		Icmp6Type::neighbourSolicitation, makeSolicitation(addr, std::nullopt));
+	co_await helix::sleepFor(retransTimerNs);
+
+	auto duplicate = tentative_[addr];
+	tentative_.erase(addr);
+	co_return duplicate;
+}
+
+async::result<void> Ndp::solicitRouters(std::shared_ptr<nic::Link> link) {
+	auto source = ip6().findLinkIp(ip6AllRouters, link.get());
+	for (int i = 0; i < maxRouterSolicitations; i++) {
+		if (advertisedLinks_.contains(link->index()))
+			co_return;
+
+		std::vector<uint8_t> body(4);
+		if (source)
+			appendLinkLayerOption(body, sourceLinkLayerOption, link->deviceMac());
+		co_await sendNdp(link, source.value_or(Ip6Address{}), ip6AllRouters,
+			ip6AllRouters.multicastMac(), Icmp6Type::routerSolicitation, std::move(body));
+
+		co_await helix::sleepFor(routerSolicitationIntervalNs);
+	}
+}
+
+Ndp::Entry &Ndp::getEntry(const Ip6Address &ip) {
+	uint64_t time;
+	HEL_CHECK(helGetClock(&time));
+	if (auto f = table_.find(ip); f != table_.end()) {
+		if (f->second.mtime_ns + Neighbours::staleTimeMs * 1'000'000 <= time) {
+			f->second.state = State::stale;
+		}
+		return f->second;
+	}
+	auto &entry = table_.emplace(std::piecewise_construct,
+		std::make_tuple(ip), std::make_tuple()).first->second;
+	entry.mtime_ns = time;
+	return entry;
+}
+
+void Ndp::updateTable(const Ip6Address &ip, nic::MacAddress mac, std::weak_ptr<nic::Link> link) {
+	auto &entry = getEntry(ip);
+	if(entry.state != State::reachable || entry.mac != mac)
+		ip6Router().invalidate();
+	HEL_CHECK(helGetClock(&entry.mtime_ns));
+	entry.mac = mac;
+	entry.state = State::reachable;
+	entry.link = std::move(link);
+
+	entry.change.raise();
+}
+
+std::map<Ip6Address, Ndp::Entry> &Ndp::getTable() {
+	return table_;
+}
+
+async::result<std::optional<nic::MacAddress>> Ndp::tryResolve(const Ip6Address &ip,
+		const Ip6Address &sender, std::shared_ptr<nic::Link> link) {
+	auto &entry = getEntry(ip);
+	if (entry.state == State::reachable) {
+		co_return entry.mac;
+	}
+	if (entry.state != State::probe) {
+		entryProber(ip, entry, sender, std::move(link));
+	}
+	co_await entry.change.async_wait();
+	if (entry.state != State::reachable) {
+		co_return std::nullopt;
+	}
+	co_return entry.mac;
+}
+
+std::optional<nic::MacAddress> Ndp::lookup(const Ip6Address &ip) {
+	auto f = table_.find(ip);
+	if (f == table_.end() || f->second.state != State::reachable) {
+		return std::nullopt;
+	}
+	return f->second.mac;
+}
+
+Ndp &neigh6() {
+	static Ndp neigh;
+	return neigh;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <arch/dma_structs.hpp>
+#include <async/result.hpp>
+#include <memory>
+#include <netserver/nic.hpp>
+#include <map>
+#include <optional>
+#include <set>
+
+#include "arp.hpp"
+#include "ip6.hpp"
+
+// Neighbour discovery for IPv6 (RFC 4861) and stateless address
+// autoconfiguration (RFC 4862); the IPv6 counterpart of Neighbours.
+struct Ndp {
+	using State = Neighbours::State;
+	using Entry = Neighbours::Entry;
+
+	async::result<std::optional<nic::MacAddress>> tryResolve(const Ip6Address &addr,
+		const Ip6Address &sender, std::shared_ptr<nic::Link> link);
+	// Returns the MAC address of addr without probing if it is reachable.
+	std::optional<nic::MacAddress> lookup(const Ip6Address &addr);
+	// Duplicate address detection (RFC 4862, 5.4). Returns true if another node
+	// on the link already uses addr.
+	async::result<bool> detectDuplicate(Ip6Address addr, std::shared_ptr<nic::Link> link);
+	// Asks the routers on the link to send router advertisements.
+	async::result<void> solicitRouters(std::shared_ptr<nic::Link> link);
+	// body is the ICMPv6 message following the type, code and checksum fields.
+	void feedNdp(Icmp6Type type, smarter::shared_ptr<const Ip6Packet> packet,
+		arch::dma_buffer_view body);
+	void updateTable(const Ip6Address &addr, nic::MacAddress mac, std::weak_ptr<nic::Link> link);
+	std::map<Ip6Address, Entry> &getTable();
+private:
+	void handleSolicitation_(const Ip6Packet &packet, arch::dma_buffer_view body);
+	void handleAdvertisement_(const Ip6Packet &packet, arch::dma_buffer_view body);
+	void handleRouterAdvertisement_(const Ip6Packet &packet, arch::dma_buffer_view body);
+
+	Entry &getEntry(const Ip6Address &addr);
+	std::map<Ip6Address, Entry> table_;
+	// Addresses that are undergoing duplicate address detection,
+	// mapped to whether a duplicate was found.
+	std::map<Ip6Address, bool> tentative_;
+	// Indices of the links on which we received a router advertisement.
+	std::set<int> advertisedLinks_;
+};
+
+Ndp &neigh6();
@@ -4,6 +4,7 @@
 #include <arch/bit.hpp>
 #include <arch/variable.hpp>
 #include <protocols/fs/server.hpp>
+#include <cstddef>
 #include <cstring>
 #include <format>
 #include <iomanip>
@@ -18,13 +19,23 @@
 #include <bragi/helpers-std.hpp>
 
 #include "checksum.hpp"
-#include "ip4.hpp"
+#include "inet.hpp"
 #include "tcp4.hpp"
 
 namespace {
 
 constexpr bool debugTcp = false;
 
+// TODO: Perform path MTU discovery.
+constexpr size_t maxSegmentSize = 1280;
+// Largest amount of payload that we hand down to the IP layer at once; the link
+// splits it into segments of maxSegmentSize bytes (GSO).
+// This keeps the IPv4 total length (including IPv4 and TCP headers) and the
+// IPv6 payload length below 64 KiB.
+constexpr size_t maxSuperSegmentSize = 0xFFFF - 20 - 20;
+// Upper bound on the payload of segments that are coalesced on receive (GRO).
+constexpr size_t maxCoalescedSize = 0xFFFF;
+
 struct stl_allocator {
 	void *allocate(size_t size) {
 		return operator new(size);
@@ -35,16 +46,6 @@ struct stl_allocator {
 	}
 };
 
-struct PseudoHeader {
-	arch::scalar_storage<uint32_t, arch::big_endian> src;
-	arch::scalar_storage<uint32_t, arch::big_endian> dst;
-	uint8_t zero = 0;
-	uint8_t proto = static_cast<uint8_t>(IpProto::tcp);
-	arch::scalar_storage<uint16_t, arch::big_endian> len;
-};
-
-static_assert(sizeof(PseudoHeader) == 12);
-
 struct RingBuffer {
 	RingBuffer(int shift)
 	: storage_{reinterpret_cast<char *>(operator new (1 << shift))}, shift_{shift} { }
@@ -110,7 +111,9 @@ static std::mt19937 globalPrng;
 struct TcpHeader {
 	static constexpr arch::field<uint16_t, bool> finFlag{0, 1};
 	static constexpr arch::field<uint16_t, bool> synFlag{1, 1};
+	static constexpr arch::field<uint16_t, bool> rstFlag{2, 1};
 	static constexpr arch::field<uint16_t, bool> ackFlag{4, 1};
+	static constexpr arch::field<uint16_t, bool> urgFlag{5, 1};
 	static constexpr arch::field<uint16_t, unsigned int> headerWords{12, 4};
 
 	arch::scalar_storage<uint16_t, arch::big_endian> srcPort;
@@ -128,11 +131,11 @@ static_assert(sizeof(TcpHeader) == 20);
 struct TcpPacket {
 	arch::dma_buffer_view payload() {
 		auto words = header.flags.load() & TcpHeader::headerWords;
-		return packet->payload().subview(words * 4);
+		return packet.payload().subview(words * 4);
 	}
 
-	bool parse(smarter::shared_ptr<const Ip4Packet> packet) {
-		auto ipPayload = packet->payload();
+	bool parse(InetPacket packet) {
+		auto ipPayload = packet.payload();
 		if (ipPayload.size() < sizeof(TcpHeader))
 			return false;
 
@@ -143,58 +146,100 @@ struct TcpPacket {
 		if (ipPayload.size() < words * 4)
 			return false;
 
-		if (header.checksum.load()) {
-			PseudoHeader pseudo {
-				.src = packet->header.source,
-				.dst = packet->header.destination,
-				.proto = packet->header.protocol,
-				.len = ipPayload.size()
-			};
-			Checksum csum;
-			csum.update(&pseudo, sizeof(pseudo));
-			csum.update(ipPayload);
-			auto result = csum.finalize();
-			if (result && ~result)
-				return false;
-		}
+		if (header.checksum.load() && !packet.verifyChecksum(IpProto::tcp))
+			return false;
 
 		this->packet = std::move(packet);
 		return true;
 	}
 
+	// Size of the payload, including that of the coalesced segments.
+	size_t totalPayloadSize() {
+		auto size = payload().size();
+		for (auto &segment : coalesced)
+			size += segment.payload().size();
+		return size;
+	}
+
+	// Appends the payload of the next segment of the same flow (GRO).
+	// This only succeeds if the result is indistinguishable from receiving
+	// both segments individually.
+	bool tryCoalesce(TcpPacket &next) {
+		// Only plain ACK segments (optionally with PSH) are coalesced.
+		auto onlyAck = [] (TcpPacket &p) {
+			auto flags = p.header.flags.load();
+			return (flags & TcpHeader::ackFlag)
+				&& !(flags & TcpHeader::synFlag) && !(flags & TcpHeader::finFlag)
+				&& !(flags & TcpHeader::rstFlag) && !(flags & TcpHeader::urgFlag);
+		};
+		if (!onlyAck(*this) || !onlyAck(next))
+			return false;
+
+		auto words = header.flags.load() & TcpHeader::headerWords;
+		if ((next.header.flags.load() & TcpHeader::headerWords) != words)
+			return false;
+		if (next.header.ackNumber.load() != header.ackNumber.load())
+			return false;
+
+		// Options must match exactly.
+		auto options = packet.payload().subview(sizeof(TcpHeader), words * 4 - sizeof(TcpHeader));
+		auto nextOptions = next.packet.payload().subview(sizeof(TcpHeader), words * 4 - sizeof(TcpHeader));
+		if (std::memcmp(options.data(), nextOptions.data(), options.size()))
+			return false;
+
+		auto size = totalPayloadSize();
+		auto nextSize = next.payload().size();
+		if (!size || !nextSize || size + nextSize > maxCoalescedSize)
+			return false;
+		if (next.header.seqNumber.load() != header.seqNumber.load() + size)
+			return false;
+
+		// The window of the latest segment is the relevant one.
+		header.window.store(next.header.window.load());
+		coalesced.push_back(std::move(next));
+		return true;
+	}
+
+	bool sameFlow(const TcpPacket &other) const {
+		return packet.source == other.packet.source
+			&& packet.destination == other.packet.destination
+			&& header.srcPort.load() == other.header.srcPort.load()
+			&& header.destPort.load() == other.header.destPort.load();
+	}
+
 	TcpHeader header;
-	smarter::shared_ptr<const Ip4Packet> packet;
+	InetPacket packet;
+	// Directly following segments whose payload was coalesced into this packet.
+	std::vector<TcpPacket> coalesced;
 };
 
 namespace {
 
-protocols::fs::Error checkAddress(const void *addrPtr, size_t addrLength, TcpEndpoint &e) {
-	struct sockaddr_in sa;
-	if (addrLength < sizeof(sa))
-		return protocols::fs::Error::illegalArguments;
-
-	std::memcpy(&sa, addrPtr, sizeof(sa));
-	if (sa.sin_family != AF_INET)
-		return protocols::fs::Error::afNotSupported;
+// Segments that are held back until the end of the current receive batch,
+// such that consecutive segments of a flow can be coalesced (GRO).
+std::vector<TcpPacket> heldSegments;
 
-	e.port = arch::from_endian<arch::big_endian, uint16_t>(sa.sin_port);
-	e.ipAddress = arch::from_endian<arch::big_endian, uint32_t>(sa.sin_addr.s_addr);
-	return protocols::fs::Error::none;
+protocols::fs::Error checkAddress(int family, const void *addrPtr, size_t addrLength,
+		TcpEndpoint &e, int *scope = nullptr) {
+	return parseSockaddr(family, addrPtr, addrLength, e.ipAddress, e.port, scope);
 }
 
 } // anonymous namespace
 
 struct Tcp4Socket {
-	Tcp4Socket(Tcp4 *parent, bool nonBlock)
-	: parent_(parent), nonBlock_{nonBlock}, recvRing_{14}, sendRing_{14} {}
+	Tcp4Socket(Tcp4 *parent, int family, bool nonBlock)
+	: parent_(parent), family_{family}, nonBlock_{nonBlock}, recvRing_{14}, sendRing_{14} {
+		localEp_.ipAddress = anyAddress_();
+	}
 
 	~Tcp4Socket() {
 		parent_->unbind(localEp_);
 	}
 
-	static auto makeSocket(Tcp4 *parent, bool nonBlock) {
-		auto s = smarter::make_shared<Tcp4Socket>(parent, nonBlock);
+	static auto makeSocket(Tcp4 *parent, int family, bool nonBlock) {
+		auto s = smarter::make_shared<Tcp4Socket>(parent, family, nonBlock);
 		s->holder_ = s;
+		s->publishStatus_();
 		async::detach(s->flushOutPackets_());
 		return s;
 	}
@@ -211,16 +256,17 @@ struct Tcp4Socket {
 
 		// Validate the endpoint.
 		TcpEndpoint bindEp;
-		if (auto e = checkAddress(addrPtr, addrLength, bindEp); e != protocols::fs::Error::none)
+		if (auto e = checkAddress(self->family_, addrPtr, addrLength, bindEp);
+				e != protocols::fs::Error::none)
 			co_return e;
 
-		if (bindEp.ipAddress == INADDR_BROADCAST) {
+		if (bindEp.ipAddress == ip4Broadcast) {
 			std::cout << "netserver: TCP cannot broadcast" << std::endl;
 			co_return protocols::fs::Error::accessDenied;
 		}
 
-		if (bindEp.ipAddress != INADDR_ANY && !ip4().hasIp(bindEp.ipAddress)) {
-			std::cout << "netserver: IP address " << std::setw(8) << std::hex << bindEp.ipAddress << std::dec << " is not available" << std::endl;
+		if (!isWildcard(bindEp.ipAddress) && !inetHasIp(bindEp.ipAddress)) {
+			std::cout << "netserver: IP address " << bindEp.ipAddress << " is not available" << std::endl;
 			co_return protocols::fs::Error::addressNotAvailable;
 		}
 
@@ -239,13 +285,8 @@ struct Tcp4Socket {
 
 	static async::result<size_t> sockname(void *object, void *addr_ptr, size_t max_addr_length) {
 		auto self = static_cast<Tcp4Socket *>(object);
-		sockaddr_in sa{};
-		sa.sin_family = AF_INET;
-		sa.sin_port = htons(self->localEp_.port);
-		sa.sin_addr.s_addr = htonl(self->localEp_.ipAddress);
-		memcpy(addr_ptr, &sa, std::min(sizeof(sockaddr_in), max_addr_length));
-
-		co_return sizeof(sockaddr_in);
+		co_return writeSockaddr(self->family_, self->localEp_.ipAddress, self->localEp_.port,
+				self->scope_(), addr_ptr, max_addr_length);
 	}
 
 	static async::result<frg::expected<protocols::fs::Error, size_t>> peername(void *object, void *addr_ptr, size_t max_addr_length) {
@@ -253,13 +294,8 @@ struct Tcp4Socket {
 		if(self->connectState_ != ConnectState::connected) {
 			co_return protocols::fs::Error::notConnected;
 		}
-		sockaddr_in sa{};
-		sa.sin_family = AF_INET;
-		sa.sin_port = htons(self->remoteEp_.port);
-		sa.sin_addr.s_addr = htonl(self->remoteEp_.ipAddress);
-		memcpy(addr_ptr, &sa, std::min(sizeof(sockaddr_in), max_addr_length));
-
-		co_return sizeof(sockaddr_in);
+		co_return writeSockaddr(self->family_, self->remoteEp_.ipAddress, self->remoteEp_.port,
+				self->scope_(), addr_ptr, max_addr_length);
 	}
 
 	static async::result<void> ioctl(void *object, uint32_t id, helix_ng::RecvInlineResult msg, helix::UniqueLane conversation) {
@@ -315,16 +351,26 @@ struct Tcp4Socket {
 
 		// Validate the endpoint.
 		TcpEndpoint connectEp;
-		if (auto e = checkAddress(addrPtr, addrLength, connectEp); e != protocols::fs::Error::none)
+		int scope;
+		if (auto e = checkAddress(self->family_, addrPtr, addrLength, connectEp, &scope);
+				e != protocols::fs::Error::none)
 			co_return e;
 
-		if (connectEp.ipAddress == INADDR_BROADCAST) {
+		if (connectEp.ipAddress == ip4Broadcast) {
 			std::cout << "netserver: TCP cannot broadcast" << std::endl;
 			co_return protocols::fs::Error::accessDenied;
 		}
 
+		// Link-local remotes are only reachable through the given interface.
+		if (scope) {
+			auto nic = nic::Link::byIndex(scope);
+			if (!nic)
+				co_return protocols::fs::Error::addressNotAvailable;
+			self->boundInterface_ = nic;
+		}
+
 		// Bind the socket if necessary.
-		if (!self->localEp_.port && !self->bindAvailable()) {
+		if (!self->localEp_.port && !self->bindAvailable(self->anyAddress_())) {
 			std::cout << "netserver: No source port" << std::endl;
 			co_return protocols::fs::Error::addressNotAvailable;
 		}
@@ -387,15 +433,13 @@ struct Tcp4Socket {
 				break;
 			self->recvRing_.dequeueAdvance(chunk);
 			self->flushEvent_.raise();
+			self->publishStatus_();
 		}
 
-		struct sockaddr_in sa;
-		memset(&sa, 0, sizeof(struct sockaddr_in));
-		sa.sin_port = arch::to_endian<arch::big_endian, uint16_t>(self->remoteEp_.port);
-		sa.sin_addr.s_addr = arch::to_endian<arch::big_endian, uint32_t>(self->remoteEp_.ipAddress);
-		memcpy(addrPtr, &sa, std::min(sizeof(struct sockaddr_in), addrLength));
+		auto saLength = writeSockaddr(self->family_, self->remoteEp_.ipAddress, self->remoteEp_.port,
+				self->scope_(), addrPtr, addrLength);
 
-		co_return protocols::fs::RecvData{{}, progress, sizeof(struct sockaddr_in), 0};
+		co_return protocols::fs::RecvData{{}, progress, saLength, 0};
 	}
 
 	static async::result<frg::expected<protocols::fs::Error, size_t>> sendMsg(void *object,
@@ -427,6 +471,7 @@ struct Tcp4Socket {
 			size_t chunk = std::min(space, size - progress);
 			self->sendRing_.enqueue(p + progress, chunk);
 			self->flushEvent_.raise();
+			self->publishStatus_();
 			progress += chunk;
 		}
 
@@ -461,16 +506,7 @@ struct Tcp4Socket {
 	static async::result<frg::expected<protocols::fs::Error, protocols::fs::PollStatusResult>>
 	pollStatus(void *object) {
 		auto self = static_cast<Tcp4Socket *>(object);
-
-		int active = 0;
-		if(self->recvRing_.availableToDequeue())
-			active |= EPOLLIN;
-		if(self->sendRing_.spaceForEnqueue())
-			active |= EPOLLOUT;
-		if(self->remoteClosed_)
-			active |= EPOLLHUP;
-
-		co_return protocols::fs::PollStatusResult{self->currentSeq_, active};
+		co_return protocols::fs::PollStatusResult{self->currentSeq_, self->status_()};
 	}
 
 	static async::result<void> setFileFlags(void *object, int flags) {
@@ -537,7 +573,7 @@ struct Tcp4Socket {
 		.setSocketOption = &setSocketOption,
 	};
 
-	bool bindAvailable(uint32_t ipAddress = INADDR_ANY) {
+	bool bindAvailable(Ip6Address ipAddress) {
 		static std::uniform_int_distribution<uint16_t> dist {
 			32768, 60999
 		};
@@ -555,6 +591,32 @@ struct Tcp4Socket {
 private:
 	async::result<void> flushOutPackets_();
 
+	// Local address of unbound sockets.
+	Ip6Address anyAddress_() {
+		return family_ == AF_INET ? ip4Any : Ip6Address{};
+	}
+
+	// Scope ID that is reported for link-local addresses.
+	int scope_() {
+		return boundInterface_ ? boundInterface_->index() : 0;
+	}
+
+	int status_() {
+		int active = 0;
+		if(recvRing_.availableToDequeue())
+			active |= EPOLLIN;
+		if(sendRing_.spaceForEnqueue())
+			active |= EPOLLOUT;
+		if(remoteClosed_)
+			active |= EPOLLHUP;
+		return active;
+	}
+
+	// Must be called whenever the result of status_() or currentSeq_ changes.
+	void publishStatus_() {
+		statusSlot_.update(currentSeq_, status_());
+	}
+
 	void handleInPacket_(TcpPacket packet);
 
 private:
@@ -568,6 +630,7 @@ private:
 	};
 
 	Tcp4 *parent_;
+	int family_;
 	bool nonBlock_;
 	TcpEndpoint remoteEp_;
 	TcpEndpoint localEp_;
@@ -603,8 +666,10 @@ private:
 	uint64_t outSeq_ = 0;
 	uint64_t hupSeq_ = 1;
 	async::recurring_event pollEvent_;
+	protocols::fs::StatusTableSlot statusSlot_{&statusTable()};
 
 	std::shared_ptr<nic::Link> boundInterface_ = {};
+	InetRouteCache routeCache_;
 };
 
 async::result<void> Tcp4Socket::flushOutPackets_() {
@@ -626,7 +691,7 @@ async::result<void> Tcp4Socket::flushOutPackets_() {
 			localFlushedSn_ = randomSn;
 
 			// Construct and transmit the initial SYN packet.
-			auto targetInfo = co_await ip4().targetByRemote(remoteEp_.ipAddress, boundInterface_);
+			auto targetInfo = co_await inetTargetByRemote(remoteEp_.ipAddress, boundInterface_);
 			if (!targetInfo) {
 				// TODO: Return an error to users.
 				std::cout << "netserver: Destination unreachable" << std::endl;
@@ -650,13 +715,9 @@ async::result<void> Tcp4Socket::flushOutPackets_() {
 					| TcpHeader::synFlag(true));
 
 			// Fill in the checksum.
-			PseudoHeader pseudo {
-				.src = targetInfo->source,
-				.dst = remoteEp_.ipAddress,
-				.len = buf.size()
-			};
 			Checksum csum;
-			csum.update(&pseudo, sizeof(PseudoHeader));
+			addPseudoHeader(csum, targetInfo->source(), remoteEp_.ipAddress,
+					IpProto::tcp, buf.size());
 			csum.update(buf.data(), buf.size());
 			header->checksum = csum.finalize();
 
@@ -664,15 +725,15 @@ async::result<void> Tcp4Socket::flushOutPackets_() {
 
 			if(debugTcp)
 				std::cout << "netserver: Sending TCP SYN" << std::endl;
-			auto error = co_await ip4().sendFrame(std::move(*targetInfo),
-				buf.data(), buf.size(), static_cast<uint16_t>(IpProto::tcp));
+			auto error = co_await inetSendFrame(std::move(*targetInfo),
+				buf.data(), buf.size(), nullptr, 0, IpProto::tcp);
 			if (error != protocols::fs::Error::none) {
 				// TODO: Return an error to users.
 				std::cout << "netserver: Could not send TCP packet" << std::endl;
 				co_return;
 			}
 		}else{
-			auto targetInfo = co_await ip4().targetByRemote(remoteEp_.ipAddress);
+			auto targetInfo = co_await routeCache_.lookup(remoteEp_.ipAddress, boundInterface_);
 			if (!targetInfo) {
 				// TODO: Return an error to users.
 				std::cout << "netserver: Destination unreachable" << std::endl;
@@ -701,7 +762,7 @@ async::result<void> Tcp4Socket::flushOutPackets_() {
 			auto chunk = std::min({
 				bytesAvailable - flushPointer,
 				windowPointer - flushPointer,
-				size_t{1280} // TODO: Perform path MTU discovery.
+				maxSuperSegmentSize
 			});
 
 			std::vector<char> buf;
@@ -722,16 +783,11 @@ async::result<void> Tcp4Socket::flushOutPackets_() {
 
 			sendRing_.dequeueLookahead(flushPointer, buf.data() + sizeof(TcpHeader), chunk);
 
-			// Fill in the checksum.
-			PseudoHeader pseudo {
-				.src = targetInfo->source,
-				.dst = remoteEp_.ipAddress,
-				.len = buf.size()
-			};
+			// The link fills in the checksum; we only provide the pseudo header sum.
 			Checksum csum;
-			csum.update(&pseudo, sizeof(PseudoHeader));
-			csum.update(buf.data(), buf.size());
-			header->checksum = csum.finalize();
+			addPseudoHeader(csum, targetInfo->source(), remoteEp_.ipAddress,
+					IpProto::tcp, buf.size());
+			header->checksum = csum.fold();
 
 			localFlushedSn_ += chunk;
 			remoteAckedSn_ = remoteKnownSn_;
@@ -739,9 +795,13 @@ async::result<void> Tcp4Socket::flushOutPackets_() {
 
 			if(debugTcp)
 				std::cout << "netserver: Sending TCP data (" << chunk << " bytes)" << std::endl;
-			auto error = co_await ip4().sendFrame(std::move(*targetInfo),
-				buf.data(), buf.size(),
-				static_cast<uint16_t>(IpProto::tcp));
+			auto error = co_await inetSendFrame(std::move(*targetInfo),
+				buf.data(), buf.size(), nullptr, 0,
+				IpProto::tcp, {
+					.checksumOffset = offsetof(TcpHeader, checksum),
+					.segmentSize = maxSegmentSize,
+					.transportHeaderSize = sizeof(TcpHeader),
+				});
 			if (error != protocols::fs::Error::none) {
 				// TODO: Return an error to users.
 				std::cout << "netserver: Could not send TCP packet" << std::endl;
@@ -752,7 +812,7 @@ async::result<void> Tcp4Socket::flushOutPackets_() {
 }
 
 void Tcp4Socket::handleInPacket_(TcpPacket packet) {
-	if(boundInterface_ && boundInterface_->index() != packet.packet->link.lock()->index())
+	if(boundInterface_ && boundInterface_->index() != packet.packet.link.lock()->index())
 		return;
 
 	if(connectState_ == ConnectState::sendSyn) {
@@ -789,10 +849,17 @@ void Tcp4Socket::handleInPacket_(TcpPacket packet) {
 		if(packet.header.seqNumber.load() == remoteKnownSn_) {
 			bool gotUpdate = false;
 
-			auto payload = packet.payload();
-			size_t chunk = std::min(payload.size(), recvRing_.spaceForEnqueue());
+			size_t chunk = 0;
+			auto enqueuePayload = [&] (arch::dma_buffer_view payload) {
+				auto n = std::min(payload.size(), recvRing_.spaceForEnqueue());
+				recvRing_.enqueue(payload.data(), n);
+				chunk += n;
+			};
+			enqueuePayload(packet.payload());
+			for(auto &segment : packet.coalesced)
+				enqueuePayload(segment.payload());
+
 			if(chunk) {
-				recvRing_.enqueue(payload.data(), chunk);
 				remoteKnownSn_ += chunk;
 				if(announcedWindow_ < chunk) {
 					announcedWindow_ = 0;
@@ -816,6 +883,7 @@ void Tcp4Socket::handleInPacket_(TcpPacket packet) {
 				inEvent_.raise();
 				flushEvent_.raise();
 				pollEvent_.raise();
+				publishStatus_();
 			}
 		}
 
@@ -829,6 +897,7 @@ void Tcp4Socket::handleInPacket_(TcpPacket packet) {
 				outSeq_ = ++currentSeq_;
 				settleEvent_.raise();
 				pollEvent_.raise();
+				publishStatus_();
 			}else{
 				std::cout << "netserver: Rejecting ack-number outside of valid window"
 						<< std::endl;
@@ -837,7 +906,12 @@ void Tcp4Socket::handleInPacket_(TcpPacket packet) {
 	}
 }
 
-void Tcp4::feedDatagram(smarter::shared_ptr<const Ip4Packet> packet) {
+Tcp4 &tcp4() {
+	static Tcp4 inst;
+	return inst;
+}
+
+void Tcp4::feedDatagram(InetPacket packet) {
 	TcpPacket tcp;
 	if (!tcp.parse(std::move(packet))) {
 		std::cout << "netserver: Received broken TCP packet" << std::endl;
@@ -848,13 +922,33 @@ void Tcp4::feedDatagram(smarter::shared_ptr<const Ip4Packet> packet) {
 		std::cout << "netserver: Received TCP packet at port " << tcp.header.destPort.load()
 				<< " (" << tcp.payload().size() << " bytes)" << std::endl;
 
-	auto it = binds.lower_bound({ 0, tcp.header.destPort.load() });
-	for (; it != binds.end() && it->first.port == tcp.header.destPort.load(); it++) {
-		auto existingEp = it->first;
-		if (existingEp.ipAddress == tcp.packet->header.destination
-				|| existingEp.ipAddress == INADDR_ANY) {
-			it->second->handleInPacket_(std::move(tcp));
-			break;
+	// Try to append the segment to the latest held-back segment of its flow.
+	for (auto it = heldSegments.rbegin(); it != heldSegments.rend(); it++) {
+		if (!it->sameFlow(tcp))
+			continue;
+		if (it->tryCoalesce(tcp))
+			return;
+		break;
+	}
+	heldSegments.push_back(std::move(tcp));
+}
+
+void Tcp4::flushCoalesced() {
+	auto segments = std::move(heldSegments);
+	heldSegments.clear();
+
+	for (auto &tcp : segments) {
+		if(debugTcp && !tcp.coalesced.empty())
+			std::cout << "netserver: Coalesced " << tcp.coalesced.size() + 1
+					<< " TCP segments (" << tcp.totalPayloadSize() << " bytes)" << std::endl;
+
+		auto it = binds.lower_bound({ {}, tcp.header.destPort.load() });
+		for (; it != binds.end() && it->first.port == tcp.header.destPort.load(); it++) {
+			auto existingEp = it->first;
+			if (acceptsDestination(existingEp.ipAddress, tcp.packet.destination)) {
+				it->second->handleInPacket_(std::move(tcp));
+				break;
+			}
 		}
 	}
 }
@@ -863,8 +957,7 @@ bool Tcp4::tryBind(smarter::shared_ptr<Tcp4Socket> socket, TcpEndpoint wantedEp)
 	auto it = binds.lower_bound(wantedEp);
 	for (; it != binds.end() && it->first.port == wantedEp.port; it++) {
 		auto existingEp = it->first;
-		if (existingEp.ipAddress == INADDR_ANY || wantedEp.ipAddress == INADDR_ANY
-				|| existingEp.ipAddress == wantedEp.ipAddress) {
+		if (bindsOverlap(existingEp.ipAddress, wantedEp.ipAddress)) {
 			return false;
 		}
 	}
@@ -877,9 +970,11 @@ bool Tcp4::unbind(TcpEndpoint e) {
 	return binds.erase(e) != 0;
 }
 
-void Tcp4::serveSocket(int flags, helix::UniqueLane lane) {
+size_t Tcp4::serveSocket(int family, int flags, helix::UniqueLane lane) {
 	using protocols::fs::servePassthrough;
-	auto sock = Tcp4Socket::makeSocket(this, flags & SOCK_NONBLOCK);
+	auto sock = Tcp4Socket::makeSocket(this, family, flags & SOCK_NONBLOCK);
+	auto statusSlot = sock->statusSlot_.index();
 	async::detach(servePassthrough(std::move(lane), std::move(sock),
 			&Tcp4Socket::ops));
+	return statusSlot;
 }
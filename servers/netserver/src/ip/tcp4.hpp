@@ -4,25 +4,35 @@
 #include <smarter.hpp>
 #include <map>
 
-class Ip4Packet;
+#include "ip6.hpp"
 
+struct InetPacket;
+
+// IPv4 addresses are stored as IPv4-mapped addresses, see inet.hpp.
 struct TcpEndpoint {
 	friend bool operator<(const TcpEndpoint &l, const TcpEndpoint &r) {
 		return std::tie(l.port, l.ipAddress) < std::tie(r.port, r.ipAddress);
 	}
 
-	uint32_t ipAddress = 0;
+	Ip6Address ipAddress;
 	uint16_t port = 0;
 };
 
 struct Tcp4Socket;
 
+// Serves TCP sockets of both AF_INET and AF_INET6.
 struct Tcp4 {
-	void feedDatagram(smarter::shared_ptr<const Ip4Packet>);
+	// Segments are held back until flushCoalesced() is called,
+	// such that consecutive segments of a flow can be coalesced.
+	void feedDatagram(InetPacket packet);
+	void flushCoalesced();
 	bool tryBind(smarter::shared_ptr<Tcp4Socket> socket, TcpEndpoint ipAddress);
 	bool unbind(TcpEndpoint remote);
-	void serveSocket(int flags, helix::UniqueLane lane);
+	// Returns the status table slot of the socket (zero if there is none).
+	size_t serveSocket(int family, int flags, helix::UniqueLane lane);
 
 private:
 	std::map<TcpEndpoint, smarter::shared_ptr<Tcp4Socket>> binds;
 };
+
+Tcp4 &tcp4();
@@ -1,7 +1,7 @@
 #include "udp4.hpp"
 
-#include "ip4.hpp"
 #include "checksum.hpp"
+#include "inet.hpp"
 
 #include <async/basic.hpp>
 #include <async/recurring-event.hpp>
@@ -9,6 +9,7 @@
 #include <async/queue.hpp>
 #include <arch/bit.hpp>
 #include <protocols/fs/server.hpp>
+#include <cstddef>
 #include <cstring>
 #include <iomanip>
 #include <random>
@@ -18,6 +19,8 @@
 #include <netinet/ip.h>
 
 namespace {
+constexpr bool debugUdp = false;
+
 struct stl_allocator {
 	void *allocate(size_t size) {
 		return operator new(size);
@@ -32,22 +35,6 @@ template<typename T>
 void maybeFlip(T &x) {
 	x = arch::convert_endian<arch::endian::big, arch::endian::native>(x);
 }
-
-struct PseudoHeader {
-	uint32_t src;
-	uint32_t dst;
-
-	uint8_t zero = 0;
-	uint8_t proto = static_cast<uint8_t>(IpProto::udp);
-	uint16_t len;
-
-	void ensureEndian() {
-		maybeFlip(src);
-		maybeFlip(dst);
-		maybeFlip(proto);
-		maybeFlip(len);
-	}
-};
 } // namespace
 
 struct Udp {
@@ -67,12 +54,11 @@ struct Udp {
 	static_assert(sizeof(header) == 8, "udp header size wrong");
 
 	arch::dma_buffer_view payload() const {
-		return packet->payload().subview(sizeof(header));
+		return packet.payload().subview(sizeof(header));
 	}
 
-	bool parse(smarter::shared_ptr<const Ip4Packet> packet) {
-		Checksum chk;
-		auto payload = packet->payload();
+	bool parse(InetPacket packet) {
+		auto payload = packet.payload();
 		if (payload.size() < sizeof(header)) {
 			return false;
 		}
@@ -81,18 +67,9 @@ struct Udp {
 		if (payload.size() < header.len) {
 			return false;
 		}
-		if (header.chk != 0) {
-			PseudoHeader phdr;
-			phdr.src = packet->header.source;
-			phdr.dst = packet->header.destination;
-			phdr.proto = packet->header.protocol;
-			phdr.len = payload.size();
-			phdr.ensureEndian();
-
-			chk.update(&phdr, sizeof(phdr));
-			chk.update(payload);
-			auto fin = chk.finalize();
-			if (fin != 0 && ~fin != 0) {
+		// The checksum is optional for IPv4 only.
+		if (header.chk != 0 || !packet.isIp4()) {
+			if (!packet.verifyChecksum(IpProto::udp)) {
 				return false;
 			}
 		}
@@ -100,57 +77,35 @@ struct Udp {
 		return true;
 	}
 
-	smarter::shared_ptr<const Ip4Packet> packet;
-
-	std::weak_ptr<nic::Link> link;
+	InetPacket packet;
 };
 
-Endpoint &Endpoint::operator=(struct sockaddr_in sa) {
-	using arch::convert_endian;
-	using arch::endian;
-	port = convert_endian<endian::big, endian::native>(sa.sin_port);
-	addr = convert_endian<endian::big,
-	     endian::native>(sa.sin_addr.s_addr);
-	return *this;
-}
-
-void Endpoint::ensureEndian() {
-	maybeFlip(addr);
-	maybeFlip(port);
-}
-
-
 bool operator<(const Endpoint &l, const Endpoint &r) {
 	return std::tie(l.port, l.addr) < std::tie(r.port, r.addr);
 }
 
 namespace {
-auto checkAddress(const void *addr_ptr, size_t addr_len, Endpoint &e) {
-	struct sockaddr_in addr;
-	if (addr_len < sizeof(addr)) {
-		return protocols::fs::Error::illegalArguments;
-	}
-	std::memcpy(&addr, addr_ptr, sizeof(addr));
-	if (addr.sin_family != AF_INET) {
-		return protocols::fs::Error::afNotSupported;
-	}
-	e = addr;
-	return protocols::fs::Error::none;
+auto checkAddress(int family, const void *addr_ptr, size_t addr_len, Endpoint &e,
+		int *scope = nullptr) {
+	return parseSockaddr(family, addr_ptr, addr_len, e.addr, e.port, scope);
 }
 } // namespace
 
 using namespace protocols::fs;
 
 struct Udp4Socket {
-	Udp4Socket(Udp4 *parent) : parent_(parent) {}
+	Udp4Socket(Udp4 *parent, int family) : parent_(parent), family_{family} {
+		local_.addr = anyAddress_();
+	}
 
 	~Udp4Socket() {
 		parent_->unbind(local_);
 	}
 
-	static auto make_socket(Udp4 *parent) {
-		auto s = smarter::make_shared<Udp4Socket>(parent);
+	static auto make_socket(Udp4 *parent, int family) {
+		auto s = smarter::make_shared<Udp4Socket>(parent, family);
 		s->holder_ = s;
+		s->publishStatus_();
 		return s;
 	}
 
@@ -161,36 +116,33 @@ struct Udp4Socket {
 
 		auto self = static_cast<Udp4Socket *>(obj);
 		Endpoint remote;
+		int scope;
 
-		if (auto e = checkAddress(addr_ptr, addr_size, remote);
+		if (auto e = checkAddress(self->family_, addr_ptr, addr_size, remote, &scope);
 			e != protocols::fs::Error::none) {
 			co_return e;
 		}
 
 		if (self->local_.port == 0
-				&& !self->bindAvailable()) {
+				&& !self->bindAvailable(self->anyAddress_())) {
 			std::cout << "netserver: no source port" << std::endl;
 			co_return protocols::fs::Error::addressNotAvailable;
 		}
 
-		if (remote.addr == INADDR_BROADCAST) {
+		if (remote.addr == ip4Broadcast) {
 			std::cout << "netserver: broadcast" << std::endl;
 			co_return protocols::fs::Error::accessDenied;
 		}
 
 		self->remote_ = remote;
+		self->remoteScope_ = scope;
 		co_return protocols::fs::Error::none;
 	}
 
 	static async::result<size_t> sockname(void *object, void *addr_ptr, size_t max_addr_length) {
 		auto self = static_cast<Udp4Socket *>(object);
-		sockaddr_in sa{};
-		sa.sin_family = AF_INET;
-		sa.sin_port = htons(self->local_.port);
-		sa.sin_addr.s_addr = htonl(self->local_.addr);
-		memcpy(addr_ptr, &sa, std::min(sizeof(sockaddr_in), max_addr_length));
-
-		co_return sizeof(sockaddr_in);
+		co_return writeSockaddr(self->family_, self->local_.addr, self->local_.port, 0,
+				addr_ptr, max_addr_length);
 	}
 
 	static async::result<protocols::fs::Error> bind(void* obj,
@@ -205,18 +157,18 @@ struct Udp4Socket {
 			co_return protocols::fs::Error::illegalArguments;
 		}
 
-		if (auto e = checkAddress(addr_ptr, addr_size, local);
+		if (auto e = checkAddress(self->family_, addr_ptr, addr_size, local);
 			e != protocols::fs::Error::none) {
 			co_return e;
 		}
 
 		// TODO(arsen): check other broadcast addresses too
-		if (local.addr == INADDR_BROADCAST) {
+		if (local.addr == ip4Broadcast) {
 			std::cout << "netserver: broadcast" << std::endl;
 			co_return protocols::fs::Error::accessDenied;
 		}
 
-		if (local.addr != INADDR_ANY && !ip4().hasIp(local.addr)) {
+		if (!isWildcard(local.addr) && !inetHasIp(local.addr)) {
 			std::cout << "netserver: not local ip" << std::endl;
 			co_return protocols::fs::Error::addressNotAvailable;
 		}
@@ -239,41 +191,41 @@ struct Udp4Socket {
 			uint32_t flags, void *data, size_t len,
 			void *addr_buf, size_t addr_size, size_t max_ctrl_len) {
 		(void) creds;
-		(void) flags;
 
 		using arch::convert_endian;
 		using arch::endian;
 
 		auto self = static_cast<Udp4Socket *>(obj);
 
+		if ((flags & MSG_DONTWAIT) && self->queue_.empty()) {
+			co_return protocols::fs::Error::wouldBlock;
+		}
+
 		auto element = co_await self->queue_.async_get();
+		self->publishStatus_();
 		auto packet = element->payload();
 		auto copy_size = std::min(packet.size(), len);
 		std::memcpy(data, packet.data(), copy_size);
 
-		sockaddr_in addr {};
-		addr.sin_family = AF_INET;
-		addr.sin_port = convert_endian<endian::big>(element->header.src);
-		addr.sin_addr = {
-			convert_endian<endian::big>(element->packet->header.source)
-		};
-
-		std::memset(addr_buf, 0, addr_size);
-		std::memcpy(addr_buf, &addr, std::min(addr_size, sizeof(addr)));
+		auto link = element->packet.link.lock();
+		auto addrLength = writeSockaddr(self->family_, element->packet.source, element->header.src,
+				link ? link->index() : 0, addr_buf, addr_size);
 
 		protocols::fs::CtrlBuilder ctrl{max_ctrl_len};
 
-		if(self->ipPacketInfo_) {
+		// TODO: IPV6_PKTINFO
+		if(self->ipPacketInfo_ && element->packet.isIp4()) {
+			auto &ipHeader = element->packet.ip4Packet().header;
 			auto truncated = ctrl.message(IPPROTO_IP, IP_PKTINFO, sizeof(struct in_pktinfo));
 			if(!truncated)
 				ctrl.write<struct in_pktinfo>({
-					.ipi_ifindex = element->link.lock()->index(),
-					.ipi_spec_dst = { .s_addr = convert_endian<endian::big>(element->packet->header.destination) },
-					.ipi_addr = { .s_addr = convert_endian<endian::big>(element->packet->header.source) },
+					.ipi_ifindex = link ? link->index() : 0,
+					.ipi_spec_dst = { .s_addr = convert_endian<endian::big>(ipHeader.destination) },
+					.ipi_addr = { .s_addr = convert_endian<endian::big>(ipHeader.source) },
 				});
 		}
 
-		co_return RecvData{ctrl.buffer(), copy_size, sizeof(addr), 0};
+		co_return RecvData{ctrl.buffer(), copy_size, addrLength, 0};
 	}
 
 	static async::result<frg::expected<protocols::fs::Error, size_t>> sendmsg(void *obj,
@@ -289,18 +241,20 @@ struct Udp4Socket {
 		using arch::endian;
 		auto self = static_cast<Udp4Socket *>(obj);
 		Endpoint target;
+		int scope;
 		auto source = self->local_;
 		if (addr_size != 0) {
-			if (auto e = checkAddress(addr_ptr, addr_size, target);
+			if (auto e = checkAddress(self->family_, addr_ptr, addr_size, target, &scope);
 				e != protocols::fs::Error::none) {
 				std::cout << "netserver: trimmed sendmsg addr" << std::endl;
 				co_return e;
 			}
 		} else {
 			target = self->remote_;
+			scope = self->remoteScope_;
 		}
 
-		if (target.port == 0 || target.addr == 0) {
+		if (target.port == 0 || isWildcard(target.addr)) {
 			std::cout << "netserver: udp needs destination" << std::endl;
 			co_return protocols::fs::Error::destAddrRequired;
 		}
@@ -312,62 +266,45 @@ struct Udp4Socket {
 
 		source = self->local_;
 
-		if (target.addr == INADDR_BROADCAST) {
+		if (target.addr == ip4Broadcast) {
 			std::cout << "netserver: broadcast" << std::endl;
 			co_return protocols::fs::Error::accessDenied;
 		}
 
-		std::vector<char> buf;
-		buf.resize(sizeof(Udp::Header) + len);
+		if (len > 0xFFFF - sizeof(Udp::Header)) {
+			co_return protocols::fs::Error::messageSize;
+		}
+
 		Udp::Header header {
 			.src = source.port,
 			.dst = target.port,
 			.len = static_cast<uint16_t>(len + sizeof(Udp::Header)),
 			.chk = 0,
 		};
+		auto udpLength = header.len;
 		header.ensureEndian();
 
-		// native endian target IP
-		auto targetIpNe = target.addr;
-		source.ensureEndian();
-		target.ensureEndian();
+		std::shared_ptr<nic::Link> scopeLink;
+		if (scope) {
+			scopeLink = nic::Link::byIndex(scope);
+			if (!scopeLink)
+				co_return protocols::fs::Error::addressNotAvailable;
+		}
 
-		auto ti = co_await ip4().targetByRemote(targetIpNe);
+		auto ti = co_await self->routeCache_.lookup(target.addr, std::move(scopeLink));
 		if (!ti) {
 			co_return protocols::fs::Error::netUnreachable;
 		}
 
 		Checksum chk;
-		PseudoHeader psh {
-			.src = convert_endian<endian::big>(ti->source),
-			.dst = target.addr,
-			.len = header.len
-		};
-		chk.update(&psh, sizeof(psh));
-		chk.update(&header, sizeof(header));
-		chk.update(data, len);
-		header.chk = convert_endian<endian::big>(chk.finalize());
-
-		std::cout << "netserver:" << std::endl << std::hex
-			<< std::setw(8) << psh.src << std::endl
-			<< std::setw(8) << psh.dst << std::endl
-			<< std::setw(8) << psh.len << std::endl
-
-			<< std::setw(8) << header.src << std::endl
-			<< std::setw(8) << header.dst << std::endl
-			<< std::setw(8) << header.len << std::endl
-			<< std::setw(8) << header.chk << std::endl << std::dec;
-
-		if (header.chk == 0) {
-			header.chk = ~header.chk;
-		}
-
-		std::memcpy(buf.data(), &header, sizeof(header));
-		std::memcpy(buf.data() + sizeof(header), data, len);
-
-		auto error = co_await ip4().sendFrame(std::move(*ti),
-			buf.data(), buf.size(),
-			static_cast<uint16_t>(IpProto::udp));
+		addPseudoHeader(chk, ti->source(), target.addr, IpProto::udp, udpLength);
+		// The link fills in the checksum; we only provide the pseudo header sum.
+		header.chk = convert_endian<endian::big>(chk.fold());
+
+		auto error = co_await inetSendFrame(std::move(*ti),
+			&header, sizeof(header), data, len,
+			IpProto::udp,
+			{.checksumOffset = offsetof(Udp::Header, chk)});
 		if (error != protocols::fs::Error::none) {
 			co_return error;
 		}
@@ -394,11 +331,7 @@ struct Udp4Socket {
 	static async::result<frg::expected<protocols::fs::Error, protocols::fs::PollStatusResult>>
 	pollStatus(void *obj) {
 		auto self = static_cast<Udp4Socket *>(obj);
-		int events = EPOLLOUT;
-		if(!self->queue_.empty())
-			events |= EPOLLIN;
-
-		co_return protocols::fs::PollStatusResult(self->_currentSeq, events);
+		co_return protocols::fs::PollStatusResult(self->_currentSeq, self->status_());
 	}
 
 	static async::result<frg::expected<Error>> setSocketOption(void *obj,
@@ -431,7 +364,7 @@ struct Udp4Socket {
 		.setSocketOption = &setSocketOption,
 	};
 
-	bool bindAvailable(uint32_t addr = INADDR_ANY) {
+	bool bindAvailable(Ip6Address addr) {
 		static std::mt19937 rng;
 		static std::uniform_int_distribution<uint16_t> dist {
 			32768, 60999
@@ -459,36 +392,65 @@ struct Udp4Socket {
 private:
 	friend struct Udp4;
 
+	// Local address of unbound sockets.
+	Ip6Address anyAddress_() {
+		return family_ == AF_INET ? ip4Any : Ip6Address{};
+	}
+
+	int status_() {
+		// For now making sockets always writable is sufficient.
+		int events = EPOLLOUT;
+		if(!queue_.empty())
+			events |= EPOLLIN;
+		return events;
+	}
+
+	// Must be called whenever the result of status_() or _currentSeq changes.
+	void publishStatus_() {
+		statusSlot_.update(_currentSeq, status_());
+	}
+
 	async::queue<Udp, stl_allocator> queue_;
 	Endpoint remote_;
+	// Interface index of link-local remote addresses (or zero).
+	int remoteScope_ = 0;
 	Endpoint local_;
+	InetRouteCache routeCache_;
 	Udp4 *parent_;
+	int family_;
 	smarter::weak_ptr<Udp4Socket> holder_;
 
 	async::recurring_event _statusBell;
-	uint64_t _currentSeq;
-	uint64_t _inSeq;
+	uint64_t _currentSeq = 0;
+	uint64_t _inSeq = 0;
+	protocols::fs::StatusTableSlot statusSlot_{&statusTable()};
 
 	bool ipPacketInfo_ = false;
 };
 
-void Udp4::feedDatagram(smarter::shared_ptr<const Ip4Packet> packet, std::weak_ptr<nic::Link> link) {
-	Udp udp{ .link = link };
+Udp4 &udp4() {
+	static Udp4 inst;
+	return inst;
+}
+
+void Udp4::feedDatagram(InetPacket packet) {
+	Udp udp;
 	if (!udp.parse(std::move(packet))) {
 		std::cout << "netserver: broken udp received" << std::endl;
 		return;
 	}
 
-	std::cout << "received udp datagram to port " << udp.header.dst << std::endl;
+	if(debugUdp)
+		std::cout << "netserver: received udp datagram to port " << udp.header.dst << std::endl;
 
-	auto i = binds.lower_bound({ 0, udp.header.dst });
+	auto i = binds.lower_bound({ {}, udp.header.dst });
 	for (; i != binds.end() && i->first.port == udp.header.dst; i++) {
 		auto ep = i->first;
-		if (ep.addr == udp.packet->header.destination
-			|| ep.addr == INADDR_ANY) {
+		if (acceptsDestination(ep.addr, udp.packet.destination)) {
 			i->second->queue_.emplace(std::move(udp));
 			i->second->_inSeq = ++i->second->_currentSeq;
 			i->second->_statusBell.raise();
+			i->second->publishStatus_();
 			break;
 		}
 	}
@@ -498,8 +460,7 @@ bool Udp4::tryBind(smarter::shared_ptr<Udp4Socket> socket, Endpoint addr) {
 	auto i = binds.lower_bound(addr);
 	for (; i != binds.end() && i->first.port == addr.port; i++) {
 		auto ep = i->first;
-		if (ep.addr == INADDR_ANY || addr.addr == INADDR_ANY
-			|| ep.addr == addr.addr) {
+		if (bindsOverlap(ep.addr, addr.addr)) {
 			return false;
 		}
 	}
@@ -512,9 +473,11 @@ bool Udp4::unbind(Endpoint e) {
 	return binds.erase(e) != 0;
 }
 
-void Udp4::serveSocket(helix::UniqueLane lane) {
+size_t Udp4::serveSocket(int family, helix::UniqueLane lane) {
 	using protocols::fs::servePassthrough;
-	auto sock = Udp4Socket::make_socket(this);
+	auto sock = Udp4Socket::make_socket(this, family);
+	auto statusSlot = sock->statusSlot_.index();
 	async::detach(servePassthrough(std::move(lane), std::move(sock),
 			&Udp4Socket::ops));
+	return statusSlot;
 }
@@ -5,24 +5,28 @@
 #include <map>
 #include <netserver/nic.hpp>
 
-class Ip4Packet;
+#include "ip6.hpp"
 
+struct InetPacket;
+
+// IPv4 addresses are stored as IPv4-mapped addresses, see inet.hpp.
 struct Endpoint {
-	uint32_t addr = 0;
+	Ip6Address addr;
 	uint16_t port = 0;
-
-	Endpoint &operator=(struct sockaddr_in sa);
-	void ensureEndian();
 };
 
 bool operator<(const Endpoint &l, const Endpoint &r);
 
 struct Udp4Socket;
+// Serves UDP sockets of both AF_INET and AF_INET6.
 struct Udp4 {
-	void feedDatagram(smarter::shared_ptr<const Ip4Packet>, std::weak_ptr<nic::Link> link);
+	void feedDatagram(InetPacket packet);
 	bool tryBind(smarter::shared_ptr<Udp4Socket> socket, Endpoint addr);
 	bool unbind(Endpoint remote);
-	void serveSocket(helix::UniqueLane lane);
+	// Returns the status table slot of the socket (zero if there is none).
+	size_t serveSocket(int family, helix::UniqueLane lane);
 private:
 	std::map<Endpoint, smarter::shared_ptr<Udp4Socket>> binds;
 };
+
+Udp4 &udp4();
@@ -24,6 +24,7 @@
 #include "fs.bragi.hpp"
 
 #include "ip/ip4.hpp"
+#include "ip/ip6.hpp"
 #include "netlink/netlink.hpp"
 #include "raw.hpp"
 
@@ -436,6 +437,9 @@ async::result<protocols::svrctl::Error> bindDevice(int64_t base_id) {
 		ip4Router().addRoute(std::move(default_route));
 	}
 
+	// IPv6 does not need any configuration on the command line.
+	ip6().configureLink(device);
+
 	co_return protocols::svrctl::Error::success;
 }
 
@@ -563,9 +567,17 @@ async::detached serve(helix::UniqueLane lane) {
 				managarm::fs::SvrResponse resp;
 				resp.set_error(managarm::fs::Errors::SUCCESS);
 
+				size_t statusSlot = 0;
 				if(req.domain() == AF_INET) {
 					auto err = ip4().serveSocket(std::move(local_lane),
-							req.type(), req.protocol(), req.flags());
+							req.type(), req.protocol(), req.flags(), statusSlot);
+					if(err != managarm::fs::Errors::SUCCESS) {
+						co_await sendError(err);
+						continue;
+					}
+				} else if(req.domain() == AF_INET6) {
+					auto err = ip6().serveSocket(std::move(local_lane),
+							req.type(), req.protocol(), req.flags(), statusSlot);
 					if(err != managarm::fs::Errors::SUCCESS) {
 						co_await sendError(err);
 						continue;
@@ -587,17 +599,43 @@ async::detached serve(helix::UniqueLane lane) {
 					continue;
 				}
 
+				// Sockets that publish their status in the status table also
+				// receive the table, such that posix can poll them without IPC.
+				if(statusSlot) {
+					resp.set_caps(managarm::fs::FileCaps::FC_STATUS_TABLE);
+					resp.set_status_slot(statusSlot);
+				}
+
 				auto ser = resp.SerializeAsString();
-				auto [send_resp, push_socket] =
+				auto [send_resp, push_socket, push_table] =
 					co_await helix_ng::exchangeMsgs(
 						conversation,
 						helix_ng::sendBuffer(
 							ser.data(), ser.size()),
-						helix_ng::pushDescriptor(remote_lane)
+						helix_ng::pushDescriptor(remote_lane),
+						helix_ng::pushDescriptor(statusTable().getMemory())
 					);
 				HEL_CHECK(send_resp.error());
 				HEL_CHECK(push_socket.error());
+				HEL_CHECK(push_table.error());
 				logBragiSerializedReply(ser);
+			} else if (req.req_type() == managarm::fs::CntReqType::STATUS_TABLE_WAIT) {
+				// Waiting may take arbitrarily long; do not block other requests.
+				async::detach([] (helix::UniqueLane conversation, uint64_t sequence)
+						-> async::result<void> {
+					auto current = co_await statusTable().waitForChange(sequence);
+
+					managarm::fs::SvrResponse resp;
+					resp.set_error(managarm::fs::Errors::SUCCESS);
+					resp.set_sequence(current);
+
+					auto ser = resp.SerializeAsString();
+					auto [send_resp] = co_await helix_ng::exchangeMsgs(
+						conversation,
+						helix_ng::sendBuffer(ser.data(), ser.size())
+					);
+					HEL_CHECK(send_resp.error());
+				}(std::move(conversation), req.sequence()));
 			} else {
 				std::cout << "netserver: received unknown request type: "
 					<< (int32_t)req.req_type() << std::endl;
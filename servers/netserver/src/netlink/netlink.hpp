@@ -9,6 +9,7 @@
 
 #include "core/netlink.hpp"
 #include "ip/ip4.hpp"
+#include "ip/ip6.hpp"
 #include "ip/arp.hpp"
 
 #include <deque>
@@ -83,8 +84,10 @@ private:
 
 	void sendLinkPacket(std::shared_ptr<nic::Link> nic, void *h, uint16_t flags);
 	void sendAddrPacket(const struct nlmsghdr *hdr, const struct ifaddrmsg *msg, std::shared_ptr<nic::Link>);
-	void sendRoutePacket(const struct nlmsghdr *hdr, Ip4Router::Route &route);
+	void sendRoutePacket(const struct nlmsghdr *hdr, const Ip4Router::Route &route);
+	void sendRoutePacket(const struct nlmsghdr *hdr, const Ip6Router::Route &route);
 	void sendNeighPacket(const struct nlmsghdr *hdr, uint32_t addr, Neighbours::Entry &entry);
+	void sendNeighPacket(const struct nlmsghdr *hdr, const Ip6Address &addr, Neighbours::Entry &entry);
 
 	int flags;
 
@@ -1,6 +1,7 @@
 #include "netlink.hpp"
 #include "netserver/nic.hpp"
 #include "src/ip/arp.hpp"
+#include "src/ip/ip6.hpp"
 
 #include <abi-bits/socket.h>
 #include <arpa/inet.h>
@@ -68,35 +69,61 @@ void NetlinkSocket::sendLinkPacket(std::shared_ptr<nic::Link> nic, void *h, uint
 	b.rtattr(IFLA_OPERSTATE, (uint8_t) IF_OPER_UP);
 	b.rtattr(IFLA_NUM_TX_QUEUES, 1);
 
+	struct rtnl_link_stats64 stats{};
+	stats.rx_packets = nic->stats().rxPackets;
+	stats.rx_bytes = nic->stats().rxBytes;
+	stats.rx_dropped = nic->stats().rxDropped;
+	b.rtattr(IFLA_STATS64, stats);
+
 	deliver(b.packet());
 }
 
 void NetlinkSocket::sendAddrPacket(const struct nlmsghdr *hdr, const struct ifaddrmsg *msg, std::shared_ptr<nic::Link> nic) {
-	auto addr_check = ip4().getCidrByIndex(nic->index());
-
-	if(!addr_check)
-		return;
-
-	auto addr = addr_check.value();
-
-	NetlinkBuilder b;
-	b.header(RTM_NEWADDR, NLM_F_MULTI | NLM_F_DUMP_FILTERED, hdr->nlmsg_seq, 0);
-	b.message<struct ifaddrmsg>({
-		.ifa_family = AF_INET,
-		.ifa_prefixlen = addr.prefix,
-		.ifa_flags = msg->ifa_flags,
-		.ifa_scope = RT_SCOPE_UNIVERSE,
-		.ifa_index = static_cast<uint32_t>(nic->index()),
-	});
-
-	b.rtattr(IFA_ADDRESS, htonl(addr.ip));
-	b.rtattr(IFA_LOCAL, htonl(addr.ip));
-	b.rtattr(IFA_LABEL, nic->name());
+	auto family = msg->ifa_family;
+
+	if(family == AF_UNSPEC || family == AF_INET) {
+		if(auto addr_check = ip4().getCidrByIndex(nic->index())) {
+			auto addr = addr_check.value();
+
+			NetlinkBuilder b;
+			b.header(RTM_NEWADDR, NLM_F_MULTI | NLM_F_DUMP_FILTERED, hdr->nlmsg_seq, 0);
+			b.message<struct ifaddrmsg>({
+				.ifa_family = AF_INET,
+				.ifa_prefixlen = addr.prefix,
+				.ifa_flags = msg->ifa_flags,
+				.ifa_scope = RT_SCOPE_UNIVERSE,
+				.ifa_index = static_cast<uint32_t>(nic->index()),
+			});
+
+			b.rtattr(IFA_ADDRESS, htonl(addr.ip));
+			b.rtattr(IFA_LOCAL, htonl(addr.ip));
+			b.rtattr(IFA_LABEL, nic->name());
+
+			deliver(b.packet());
+		}
+	}
 
-	deliver(b.packet());
+	if(family == AF_UNSPEC || family == AF_INET6) {
+		for(auto &addr : ip6().getCidrsByIndex(nic->index())) {
+			NetlinkBuilder b;
+			b.header(RTM_NEWADDR, NLM_F_MULTI | NLM_F_DUMP_FILTERED, hdr->nlmsg_seq, 0);
+			b.message<struct ifaddrmsg>({
+				.ifa_family = AF_INET6,
+				.ifa_prefixlen = addr.prefix,
+				.ifa_flags = msg->ifa_flags,
+				.ifa_scope = static_cast<uint8_t>(addr.ip.isLinkLocal() ? RT_SCOPE_LINK : RT_SCOPE_UNIVERSE),
+				.ifa_index = static_cast<uint32_t>(nic->index()),
+			});
+
+			// Linux only reports IFA_ADDRESS for IPv6 addresses.
+			b.rtattr(IFA_ADDRESS, addr.ip.bytes);
+
+			deliver(b.packet());
+		}
+	}
 }
 
-void NetlinkSocket::sendRoutePacket(const struct nlmsghdr *hdr, Ip4Router::Route &route) {
+void NetlinkSocket::sendRoutePacket(const struct nlmsghdr *hdr, const Ip4Router::Route &route) {
 	NetlinkBuilder b;
 
 	b.header(RTM_NEWROUTE, NLM_F_MULTI, hdr->nlmsg_seq, 0);
@@ -126,6 +153,36 @@ void NetlinkSocket::sendRoutePacket(const struct nlmsghdr *hdr, Ip4Router::Route
 	deliver(b.packet());
 }
 
+void NetlinkSocket::sendRoutePacket(const struct nlmsghdr *hdr, const Ip6Router::Route &route) {
+	NetlinkBuilder b;
+
+	b.header(RTM_NEWROUTE, NLM_F_MULTI, hdr->nlmsg_seq, 0);
+	b.message<struct rtmsg>({
+		.rtm_family = AF_INET6,
+		.rtm_dst_len = route.network.prefix,
+		.rtm_src_len = 0,
+		.rtm_tos = 0,
+		.rtm_table = RT_TABLE_MAIN,
+		.rtm_protocol = route.protocol,
+		.rtm_scope = route.scope,
+		.rtm_type = route.type,
+		.rtm_flags = route.flags,
+	});
+
+	b.rtattr(RTA_TABLE, RT_TABLE_MAIN);
+	if(!route.network.ip.isUnspecified())
+		b.rtattr(RTA_DST, route.network.ip.bytes);
+	if(route.metric)
+		b.rtattr(RTA_PRIORITY, route.metric);
+	if(!route.gateway.isUnspecified())
+		b.rtattr(RTA_GATEWAY, route.gateway.bytes);
+	if(!route.source.isUnspecified())
+		b.rtattr(RTA_PREFSRC, route.source.bytes);
+	b.rtattr(RTA_OIF, (route.link.expired()) ? 0 : route.link.lock()->index());
+
+	deliver(b.packet());
+}
+
 void NetlinkSocket::sendNeighPacket(const struct nlmsghdr *hdr, uint32_t addr, Neighbours::Entry &entry) {
 	NetlinkBuilder b;
 	int index = 0;
@@ -151,4 +208,25 @@ void NetlinkSocket::sendNeighPacket(const struct nlmsghdr *hdr, uint32_t addr, N
 	deliver(b.packet());
 }
 
+void NetlinkSocket::sendNeighPacket(const struct nlmsghdr *hdr, const Ip6Address &addr, Neighbours::Entry &entry) {
+	NetlinkBuilder b;
+	int index = 0;
+
+	if(auto nic = entry.link.lock())
+		index = nic->index();
+
+	b.header(RTM_NEWNEIGH, NLM_F_MULTI | NLM_F_DUMP_FILTERED, hdr->nlmsg_seq, 0);
+	b.message<struct ndmsg>({
+		.ndm_family = AF_INET6,
+		.ndm_ifindex = index,
+		.ndm_state = mapArpStateToNetlink(entry.state),
+		.ndm_type = RTN_UNICAST,
+	});
+
+	b.rtattr(NDA_DST, addr.bytes);
+	b.rtattr<uint8_t[6]>(NDA_LLADDR, entry.mac.data());
+
+	deliver(b.packet());
+}
+
 } // namespace nl
@@ -1,6 +1,7 @@
 #include "core/netlink.hpp"
 #include "netlink.hpp"
 #include "src/ip/arp.hpp"
+#include "src/ip/ndp.hpp"
 
 #include <arpa/inet.h>
 #include <linux/neighbour.h>
@@ -189,14 +190,18 @@ void NetlinkSocket::getRoute(struct nlmsghdr *hdr) {
 		return;
 	}
 
-	assert(payload->rtgen_family == AF_UNSPEC || payload->rtgen_family == AF_INET);
+	auto family = payload->rtgen_family;
+	assert(family == AF_UNSPEC || family == AF_INET || family == AF_INET6);
 
 	// Loop over all ipv4 and ipv6 routes, and return them.
-	// TODO: also return ipv6 routes.
-	auto ipv4_router = ip4Router();
+	if(family == AF_UNSPEC || family == AF_INET) {
+		for(auto &route : ip4Router().getRoutes())
+			sendRoutePacket(hdr, route);
+	}
 
-	for(auto route : ipv4_router.getRoutes()) {
-		sendRoutePacket(hdr, route);
+	if(family == AF_UNSPEC || family == AF_INET6) {
+		for(auto &route : ip6Router().getRoutes())
+			sendRoutePacket(hdr, route);
 	}
 
 	if(hdr->nlmsg_flags & NLM_F_DUMP)
@@ -372,6 +377,9 @@ void NetlinkSocket::getNeighbor(struct nlmsghdr *hdr) {
 		sendNeighPacket(hdr, it->first, it->second);
 	}
 
+	for(auto &[addr, entry] : neigh6().getTable())
+		sendNeighPacket(hdr, addr, entry);
+
 	if(hdr->nlmsg_flags & NLM_F_DUMP)
 		sendDone(this, hdr);
 
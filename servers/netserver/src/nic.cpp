@@ -4,13 +4,18 @@
 
 #include <algorithm>
 #include <cstring>
+#include <vector>
+#include <async/recurring-event.hpp>
 #include <arch/bit.hpp>
 #include <frg/formatting.hpp>
 #include <frg/logging.hpp>
 #include <net/if.h>
 
 #include "ip/arp.hpp"
+#include "ip/checksum.hpp"
 #include "ip/ip4.hpp"
+#include "ip/ip6.hpp"
+#include "ip/tcp4.hpp"
 #include "raw.hpp"
 
 namespace {
@@ -126,6 +131,84 @@ Link::AllocatedBuffer Link::allocateFrame(MacAddress to, EtherType type,
 	return buf;
 }
 
+async::result<void> Link::sendWithChecksum(arch::dma_buffer_view frame, TxChecksum csum) {
+	using namespace arch;
+
+	Checksum chk;
+	chk.update(frame.subview(csum.start));
+	// For UDP, a zero checksum means that no checksum was computed;
+	// transmit the equivalent 0xFFFF instead.
+	uint16_t sum = chk.finalize();
+	if(!sum)
+		sum = 0xFFFF;
+	sum = convert_endian<endian::big>(sum);
+	std::memcpy(frame.subview(csum.start + csum.offset).data(), &sum, sizeof(sum));
+
+	co_await send(frame);
+}
+
+async::result<void> Link::sendSegmented(arch::dma_buffer_view frame, TxChecksum csum,
+		TxSegmentation seg) {
+	using namespace arch;
+
+	auto load16 = [] (const void *p) {
+		uint16_t v;
+		std::memcpy(&v, p, sizeof(v));
+		return convert_endian<endian::big>(v);
+	};
+	auto store16 = [] (void *p, uint16_t v) {
+		v = convert_endian<endian::big>(v);
+		std::memcpy(p, &v, sizeof(v));
+	};
+
+	auto headers = reinterpret_cast<const uint8_t *>(frame.data());
+	bool ip6 = (headers[seg.networkStart] >> 4) == 6;
+	auto ihl = (headers[seg.networkStart] & 0xF) * 4;
+	uint16_t ident = load16(headers + seg.networkStart + 4);
+	uint32_t sn;
+	std::memcpy(&sn, headers + csum.start + 4, sizeof(sn));
+	sn = convert_endian<endian::big>(sn);
+	// The pseudo header sum covers the TCP length of the entire frame.
+	uint16_t pseudoSum = load16(headers + csum.start + csum.offset);
+	uint16_t tcpLength = frame.size() - csum.start;
+
+	size_t payloadSize = frame.size() - seg.headerLength;
+	for(size_t offset = 0; offset < payloadSize; offset += seg.segmentSize) {
+		auto chunk = std::min(size_t{seg.segmentSize}, payloadSize - offset);
+		bool last = offset + chunk == payloadSize;
+
+		dma_buffer segment{dmaPool(), seg.headerLength + chunk};
+		auto p = reinterpret_cast<uint8_t *>(segment.data());
+		std::memcpy(p, headers, seg.headerLength);
+		std::memcpy(p + seg.headerLength, headers + seg.headerLength + offset, chunk);
+
+		// Fix up the IP header. IPv6 has neither an identification field nor a header checksum.
+		auto ip = p + seg.networkStart;
+		if(ip6) {
+			store16(ip + 4, seg.headerLength - seg.networkStart - 40 + chunk);
+		}else{
+			store16(ip + 2, seg.headerLength - seg.networkStart + chunk);
+			store16(ip + 4, ident++);
+			store16(ip + 10, 0);
+			Checksum ipSum;
+			ipSum.update(ip, ihl);
+			store16(ip + 10, ipSum.finalize());
+		}
+
+		// Fix up the TCP header. FIN and PSH are only set on the last segment.
+		auto tcp = p + csum.start;
+		auto segmentSn = convert_endian<endian::big>(static_cast<uint32_t>(sn + offset));
+		std::memcpy(tcp + 4, &segmentSn, sizeof(segmentSn));
+		if(!last)
+			tcp[13] &= ~(0x01 | 0x08);
+		uint16_t segmentLength = seg.headerLength - csum.start + chunk;
+		store16(tcp + csum.offset,
+			~Checksum::adjust(uint16_t(~pseudoSum), tcpLength, segmentLength));
+
+		co_await sendWithChecksum(segment, csum);
+	}
+}
+
 unsigned int Link::iff_flags() {
 	unsigned int flags = 0;
 
@@ -143,36 +226,152 @@ unsigned int Link::iff_flags() {
 	return flags;
 }
 
-async::detached runDevice(std::shared_ptr<nic::Link> dev) {
+namespace {
+
+// Keeps up to rxRingSize() receive buffers posted to one receive queue of a link
+// and hands out the received frames in the order that they were posted.
+struct RxRing {
+	// Size of the buffers that we post (an Ethernet frame without FCS).
+	static constexpr size_t bufferSize = 1514;
+
+	struct Frame {
+		arch::dma_buffer buffer;
+		RxFrame info;
+	};
+
+	RxRing(std::shared_ptr<Link> link, size_t queue)
+	: link_{std::move(link)}, queue_{queue},
+		slots_(std::max(link_->rxRingSize(), size_t{1})) { }
+
+	// Posts fresh buffers to all slots that are not owned by the device.
+	void refill() {
+		link_->rxBatchBegin(queue_);
+		while(posted_ < slots_.size()) {
+			post_(&slots_[(head_ + posted_) % slots_.size()]);
+			posted_++;
+		}
+		link_->rxBatchEnd(queue_);
+	}
+
+	// Waits until the oldest posted buffer is filled,
+	// then moves all consecutive completed frames into batch.
+	async::result<void> wait(std::vector<Frame> &batch) {
+		while(!slots_[head_].done)
+			co_await doorbell_.async_wait();
+
+		while(posted_ && slots_[head_].done) {
+			auto &slot = slots_[head_];
+			batch.push_back({std::move(slot.buffer), slot.info});
+			slot.done = false;
+			head_ = (head_ + 1) % slots_.size();
+			posted_--;
+		}
+	}
+
+private:
+	struct Slot {
+		arch::dma_buffer buffer;
+		RxFrame info{};
+		bool done = false;
+	};
+
+	async::detached post_(Slot *slot) {
+		slot->buffer = arch::dma_buffer{link_->dmaPool(), bufferSize};
+		slot->info = co_await link_->receiveFromQueue(queue_, slot->buffer);
+		slot->done = true;
+		doorbell_.raise();
+	}
+
+	std::shared_ptr<Link> link_;
+	size_t queue_;
+	std::vector<Slot> slots_;
+	// Index of the oldest posted slot and number of posted slots.
+	size_t head_ = 0;
+	size_t posted_ = 0;
+	async::recurring_event doorbell_;
+};
+
+void processFrame(std::shared_ptr<nic::Link> &dev, arch::dma_buffer frameBuffer, RxFrame info) {
 	using namespace arch;
-	while(true) {
-		dma_buffer frameBuffer { dev->dmaPool(), 1514 };
-		auto len = co_await dev->receive(frameBuffer);
-
-		if(!dev->rawIp()) {
-			auto capsule = frameBuffer.subview(14, len - 14);
-			auto data = reinterpret_cast<uint8_t*>(frameBuffer.data());
-			uint16_t ethertype = data[12] << 8 | data[13];
-			nic::MacAddress dstsrc[2];
-			std::memcpy(dstsrc, data, sizeof(dstsrc));
-
-			raw().feedPacket(frameBuffer.subview(0, len));
-
-			switch (ethertype) {
-			case ETHER_TYPE_IP4:
-				ip4().feedPacket(dstsrc[0], dstsrc[1],
-					std::move(frameBuffer), capsule, dev);
-				break;
-			case ETHER_TYPE_ARP:
-				neigh4().feedArp(dstsrc[0], capsule, dev);
-				break;
-			default:
-				break;
-			}
-		} else {
-			dma_buffer_view capsule = frameBuffer;
-			ip4().feedPacket({}, {}, std::move(frameBuffer), capsule, dev);
+
+	auto len = info.length;
+
+	// Drivers may complete a receive without a frame (e.g., for USB zero-length packets).
+	if(!len)
+		return;
+
+	auto &stats = dev->stats();
+	stats.rxPackets++;
+	stats.rxBytes += len;
+
+	if(!dev->rawIp()) {
+		if(len < 14) {
+			stats.rxDropped++;
+			return;
 		}
+
+		auto capsule = frameBuffer.subview(14, len - 14);
+		auto data = reinterpret_cast<uint8_t*>(frameBuffer.data());
+		uint16_t ethertype = data[12] << 8 | data[13];
+		nic::MacAddress dstsrc[2];
+		std::memcpy(dstsrc, data, sizeof(dstsrc));
+
+		raw().feedPacket(frameBuffer.subview(0, len));
+
+		switch (ethertype) {
+		case ETHER_TYPE_IP4:
+			ip4().feedPacket(dstsrc[0], dstsrc[1],
+				std::move(frameBuffer), capsule, dev, info.checksumVerified);
+			break;
+		case ETHER_TYPE_IP6:
+			ip6().feedPacket(dstsrc[0], dstsrc[1],
+				std::move(frameBuffer), capsule, dev, info.checksumVerified);
+			break;
+		case ETHER_TYPE_ARP:
+			neigh4().feedArp(dstsrc[0], capsule, dev);
+			break;
+		default:
+			break;
+		}
+	} else {
+		dma_buffer_view capsule = frameBuffer.subview(0, len);
+		// Without a link layer header, the IP version tells the protocols apart.
+		auto version = reinterpret_cast<uint8_t *>(frameBuffer.data())[0] >> 4;
+		if(version == 6)
+			ip6().feedPacket({}, {}, std::move(frameBuffer), capsule, dev, info.checksumVerified);
+		else
+			ip4().feedPacket({}, {}, std::move(frameBuffer), capsule, dev, info.checksumVerified);
+	}
+}
+
+async::detached runQueue(std::shared_ptr<nic::Link> dev, size_t queue) {
+	RxRing ring{dev, queue};
+	std::vector<RxRing::Frame> batch;
+
+	ring.refill();
+	while(true) {
+		co_await ring.wait(batch);
+
+		// Hand fresh buffers to the device before processing the batch
+		// such that it does not run out of buffers in the meantime.
+		ring.refill();
+
+		for(auto &frame : batch)
+			processFrame(dev, std::move(frame.buffer), frame.info);
+		batch.clear();
+		// Deliver the TCP segments that were held back for coalescing.
+		tcp4().flushCoalesced();
 	}
 }
+
+} // anonymous namespace
+
+void runDevice(std::shared_ptr<nic::Link> dev) {
+	// Since the device keeps each flow on one queue, the queues can be served
+	// independently: frames of one queue never wait for buffers of another queue.
+	// All loops share netserver's single dispatcher thread though, so the
+	// processing of received frames does not scale beyond one CPU.
+	for(size_t queue = 0; queue < dev->rxQueueCount(); queue++)
+		runQueue(dev, queue);
+}
 } // namespace nic
@@ -0,0 +1,112 @@
+#include <netserver/rss.hpp>
+
+#include <cassert>
+#include <cstring>
+#include <utility>
+
+namespace nic {
+
+namespace {
+
+// Key from Microsoft's RSS specification; also the default key of most NIC drivers.
+constexpr std::array<uint8_t, RssConfig::keySize> defaultKey = {
+	0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2,
+	0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3, 0x8f, 0xb0,
+	0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4,
+	0x77, 0xcb, 0x2d, 0xa3, 0x80, 0x30, 0xf2, 0x0c,
+	0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+};
+
+constexpr uint8_t protoTcp = 6;
+constexpr uint8_t protoUdp = 17;
+
+} // anonymous namespace
+
+RssConfig RssConfig::spread(size_t queueCount) {
+	RssConfig config;
+	config.key = defaultKey;
+	for(size_t i = 0; i < tableSize; i++)
+		config.indirection[i] = queueCount ? i % queueCount : 0;
+	return config;
+}
+
+uint32_t toeplitzHash(const uint8_t *key, size_t keySize, const uint8_t *data, size_t size) {
+	assert(keySize >= size + 4);
+
+	// For each set bit of the input, XOR in the 32 key bits that start at the same position.
+	uint32_t result = 0;
+	uint32_t window = (uint32_t(key[0]) << 24) | (uint32_t(key[1]) << 16)
+		| (uint32_t(key[2]) << 8) | key[3];
+	for(size_t i = 0; i < size; i++) {
+		for(int b = 7; b >= 0; b--) {
+			if(data[i] & (1 << b))
+				result ^= window;
+			window = (window << 1) | ((key[i + 4] >> b) & 1);
+		}
+	}
+	return result;
+}
+
+std::optional<uint32_t> flowHash(const RssConfig &config, arch::dma_buffer_view frame,
+		size_t networkStart, bool reverse) {
+	if(frame.size() <= networkStart)
+		return std::nullopt;
+	auto packet = reinterpret_cast<const uint8_t *>(frame.data()) + networkStart;
+	size_t size = frame.size() - networkStart;
+
+	// Source address, destination address, source port and destination port,
+	// as in Microsoft's RSS specification.
+	uint8_t input[36];
+	size_t addressSize;
+	size_t transportStart;
+	uint8_t proto;
+	bool fragment = false;
+	switch(packet[0] >> 4) {
+	case 4: {
+		transportStart = (packet[0] & 0xF) * 4;
+		if(transportStart < 20 || size < transportStart)
+			return std::nullopt;
+		addressSize = 4;
+		proto = packet[9];
+		// The ports are only present in the first fragment,
+		// so fragments of a datagram are hashed by their addresses alone.
+		fragment = ((packet[6] << 8) | packet[7]) & 0x3FFF;
+		std::memcpy(input, packet + 12, 8);
+		break;
+	}
+	case 6:
+		transportStart = 40;
+		if(size < transportStart)
+			return std::nullopt;
+		addressSize = 16;
+		// Packets with extension headers are hashed by their addresses.
+		proto = packet[6];
+		std::memcpy(input, packet + 8, 32);
+		break;
+	default:
+		return std::nullopt;
+	}
+
+	size_t length = 2 * addressSize;
+	if((proto == protoTcp || proto == protoUdp) && !fragment
+			&& size >= transportStart + 4) {
+		std::memcpy(input + length, packet + transportStart, 4);
+		length += 4;
+	}
+
+	if(reverse) {
+		uint8_t address[16];
+		std::memcpy(address, input, addressSize);
+		std::memcpy(input, input + addressSize, addressSize);
+		std::memcpy(input + addressSize, address, addressSize);
+		if(length > 2 * addressSize) {
+			auto ports = input + 2 * addressSize;
+			std::swap(ports[0], ports[2]);
+			std::swap(ports[1], ports[3]);
+		}
+	}
+
+	return toeplitzHash(config.key.data(), config.key.size(), input, length);
+}
+
+} // namespace nic
@@ -0,0 +1,263 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+// Block device throughput benchmarks and a queuing stress test.
+// To compare the USB storage transports, attach the same kind of disk
+// once via UAS and once via Bulk-Only Transport to an xHCI controller,
+// e.g., in QEMU:
+//     -device qemu-xhci,id=xhci
+//     -drive if=none,id=uas-disk,format=raw,file=uas.img
+//     -device usb-uas,id=uas,bus=xhci.0
+//     -device scsi-hd,bus=uas.0,scsi-id=0,lun=0,drive=uas-disk
+//     -drive if=none,id=bot-disk,format=raw,file=bot.img
+//     -device usb-storage,bus=xhci.0,drive=bot-disk
+// and run "block-bench compare /dev/sdX /dev/sdY". On the SuperSpeed ports
+// of the xHC, the UAS disk uses bulk streams.
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t sectorSize = 512;
+constexpr size_t mib = 1024 * 1024;
+
+struct Options {
+	size_t totalSize = 64 * mib;
+	size_t requestSize = 128 * 1024;
+	unsigned int queueDepth = 8;
+};
+
+// Each thread issues requests at offsets i * queueDepth + thread (in units of
+// the request size), such that up to queueDepth requests are in flight.
+template<typename F>
+void runThreads(unsigned int queueDepth, F functor) {
+	std::vector<std::thread> threads;
+	for(unsigned int t = 0; t < queueDepth; t++)
+		threads.emplace_back(functor, t);
+	for(auto &thread : threads)
+		thread.join();
+}
+
+// Returns the throughput in MiB/s.
+double measureRead(int fd, const Options &options) {
+	size_t numRequests = options.totalSize / options.requestSize;
+	std::atomic<bool> failed{false};
+
+	auto ref = Clock::now();
+	runThreads(options.queueDepth, [&] (unsigned int t) {
+		std::vector<char> buffer(options.requestSize);
+		for(size_t i = t; i < numRequests; i += options.queueDepth) {
+			auto offset = static_cast<off_t>(i * options.requestSize);
+			if(pread(fd, buffer.data(), options.requestSize, offset)
+					!= static_cast<ssize_t>(options.requestSize))
+				failed = true;
+		}
+	});
+	std::chrono::nanoseconds elapsed = Clock::now() - ref;
+
+	if(failed) {
+		std::cerr << "block-bench: pread() failed" << std::endl;
+		exit(1);
+	}
+	return static_cast<double>(numRequests * options.requestSize) / mib / (elapsed.count() / 1e9);
+}
+
+int openDevice(const char *path, int flags) {
+	int fd = open(path, flags);
+	if(fd < 0) {
+		std::cerr << "block-bench: Could not open " << path << ": "
+				<< strerror(errno) << std::endl;
+		exit(1);
+	}
+	return fd;
+}
+
+bool parseOptions(int argc, char **argv, Options &options) {
+	if(argc > 0)
+		options.totalSize = strtoul(argv[0], nullptr, 0) * mib;
+	if(argc > 1)
+		options.requestSize = strtoul(argv[1], nullptr, 0) * 1024;
+	if(argc > 2)
+		options.queueDepth = strtoul(argv[2], nullptr, 0);
+	return options.totalSize && options.requestSize
+			&& !(options.requestSize % sectorSize) && options.queueDepth;
+}
+
+int runRead(int argc, char **argv) {
+	Options options;
+	if(argc < 1 || !parseOptions(argc - 1, argv + 1, options))
+		return -1;
+
+	int fd = openDevice(argv[0], O_RDONLY);
+	std::cout << "block-bench: " << argv[0] << ": "
+			<< static_cast<uint64_t>(measureRead(fd, options)) << " MiB/s" << std::endl;
+	close(fd);
+	return 0;
+}
+
+int runCompare(int argc, char **argv) {
+	Options options;
+	if(argc < 2 || !parseOptions(argc - 2, argv + 2, options))
+		return -1;
+
+	int fds[2] = {openDevice(argv[0], O_RDONLY), openDevice(argv[1], O_RDONLY)};
+	std::vector<unsigned int> depths{1};
+	if(options.queueDepth > 1)
+		depths.push_back(options.queueDepth);
+	for(auto depth : depths) {
+		Options run = options;
+		run.queueDepth = depth;
+		double results[2];
+		for(int i = 0; i < 2; i++)
+			results[i] = measureRead(fds[i], run);
+		std::cout << "block-bench: queue depth " << depth << ": "
+				<< argv[0] << ": " << static_cast<uint64_t>(results[0]) << " MiB/s, "
+				<< argv[1] << ": " << static_cast<uint64_t>(results[1]) << " MiB/s ("
+				<< static_cast<uint64_t>(results[0] / results[1] * 100) << "%)" << std::endl;
+	}
+	close(fds[0]);
+	close(fds[1]);
+	return 0;
+}
+
+// Contents of a sector; depends on the run such that stale data is detected.
+void fillSector(char *p, uint64_t sector, uint32_t seed) {
+	for(size_t i = 0; i < sectorSize; i += 8) {
+		uint64_t word = (sector << 16) ^ (uint64_t{seed} << 32) ^ i;
+		memcpy(p + i, &word, 8);
+	}
+}
+
+// Writes and reads back the first part of the device using requests of varying
+// sizes, with many of them in flight at once. Devices that queue commands (UAS)
+// may complete those in any order; this checks that the data ends up in the right
+// place and that each completion is delivered to the right request.
+// This overwrites the contents of the device!
+int runVerify(int argc, char **argv) {
+	Options options;
+	options.queueDepth = 32;
+	if(argc < 1 || !parseOptions(argc - 1, argv + 1, options))
+		return -1;
+
+	int fd = openDevice(argv[0], O_RDWR);
+	auto seed = static_cast<uint32_t>(Clock::now().time_since_epoch().count());
+	size_t numSectors = options.totalSize / sectorSize;
+	std::atomic<bool> failed{false};
+
+	// Request sizes (in sectors) cycle through this list; the maximal request size
+	// is used as a stride, so that the requests of each thread stay apart.
+	const size_t requestSectors[] = {1, 8, 3, 64, 255, 256, 17};
+	size_t stride = options.requestSize / sectorSize;
+
+	auto forEachRequest = [&] (unsigned int t, size_t variant, auto functor) {
+		std::vector<char> buffer(stride * sectorSize);
+		for(size_t i = t; i * stride < numSectors; i += options.queueDepth) {
+			auto sector = i * stride;
+			for(size_t done = 0; done < stride && sector + done < numSectors; ) {
+				size_t n = std::min<size_t>({requestSectors[(i + done + variant) % std::size(requestSectors)],
+						stride - done, numSectors - sector - done});
+				functor(sector + done, n, buffer.data());
+				done += n;
+			}
+		}
+	};
+
+	runThreads(options.queueDepth, [&] (unsigned int t) {
+		forEachRequest(t, 0, [&] (uint64_t sector, size_t n, char *buffer) {
+			for(size_t k = 0; k < n; k++)
+				fillSector(buffer + k * sectorSize, sector + k, seed);
+			auto length = n * sectorSize;
+			if(pwrite(fd, buffer, length, sector * sectorSize) != static_cast<ssize_t>(length))
+				failed = true;
+		});
+	});
+	if(failed) {
+		std::cerr << "block-bench: pwrite() failed" << std::endl;
+		return 1;
+	}
+	fsync(fd);
+
+	// Read back with different request boundaries than we used for writing.
+	std::atomic<size_t> mismatches{0};
+	runThreads(options.queueDepth, [&] (unsigned int t) {
+		std::vector<char> expected(sectorSize);
+		forEachRequest(t, 3, [&] (uint64_t sector, size_t n, char *buffer) {
+			auto length = n * sectorSize;
+			if(pread(fd, buffer, length, sector * sectorSize) != static_cast<ssize_t>(length)) {
+				failed = true;
+				return;
+			}
+			for(size_t k = 0; k < n; k++) {
+				fillSector(expected.data(), sector + k, seed);
+				if(memcmp(buffer + k * sectorSize, expected.data(), sectorSize))
+					mismatches++;
+			}
+		});
+	});
+	close(fd);
+
+	if(failed) {
+		std::cerr << "block-bench: pread() failed" << std::endl;
+		return 1;
+	}
+	if(mismatches) {
+		std::cerr << "block-bench: " << mismatches << " of " << numSectors
+				<< " sectors do not match" << std::endl;
+		return 1;
+	}
+	std::cout << "block-bench: Verified " << numSectors << " sectors" << std::endl;
+	return 0;
+}
+
+struct Mode {
+	const char *name;
+	int (*run)(int argc, char **argv);
+	const char *usage;
+};
+
+constexpr Mode modes[] = {
+	{"read", runRead, "read <device> [MiB] [request KiB] [queue depth]"},
+	{"compare", runCompare, "compare <device> <device> [MiB] [request KiB] [queue depth]"},
+	{"verify", runVerify, "verify <device> [MiB] [max. request KiB] [queue depth] (destroys data!)"},
+};
+
+void usage() {
+	std::cerr << "usage:" << std::endl;
+	for(auto &mode : modes)
+		std::cerr << "    block-bench " << mode.usage << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		usage();
+		return 1;
+	}
+
+	for(auto &mode : modes) {
+		if(!strcmp(argv[1], mode.name)) {
+			auto res = mode.run(argc - 2, argv + 2);
+			if(res < 0) {
+				usage();
+				return 1;
+			}
+			return res;
+		}
+	}
+
+	usage();
+	return 1;
+}
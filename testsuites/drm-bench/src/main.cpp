@@ -0,0 +1,284 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+
+#include <core/drm/blit.hpp>
+
+namespace {
+
+struct Resolution {
+	uint32_t width;
+	uint32_t height;
+};
+
+constexpr Resolution resolutions[] = {
+	{1024, 768},
+	{1280, 720},
+	{1920, 1080},
+	{2560, 1440},
+	{3840, 2160},
+};
+
+constexpr drm_core::BlitIsa isas[] = {
+	drm_core::BlitIsa::scalar,
+	drm_core::BlitIsa::sse2,
+	drm_core::BlitIsa::avx2,
+};
+
+const char *isaName(drm_core::BlitIsa isa) {
+	switch(isa) {
+	case drm_core::BlitIsa::scalar: return "scalar";
+	case drm_core::BlitIsa::sse2: return "sse2";
+	case drm_core::BlitIsa::avx2: return "avx2";
+	}
+	return "?";
+}
+
+// Runs the functor repeatedly for (at least) one second
+// and prints the throughput in megapixels per second.
+template<typename F>
+void measure(const char *name, Resolution res, F functor) {
+	using clock = std::chrono::high_resolution_clock;
+
+	uint64_t n = 0;
+	auto ref = clock::now();
+	std::chrono::nanoseconds elapsed;
+	do {
+		functor();
+		++n;
+		elapsed = clock::now() - ref;
+	} while(elapsed.count() < 1'000'000'000);
+
+	double mpixels = static_cast<double>(n) * res.width * res.height / 1e6;
+	double seconds = elapsed.count() / 1e9;
+	std::cout << "    " << name << ": " << static_cast<uint64_t>(mpixels / seconds)
+			<< " MPix/s (" << static_cast<uint64_t>(n / seconds) << " frames/s)" << std::endl;
+}
+
+void runBenchmarks(Resolution res) {
+	using drm_core::BlitFormat;
+
+	size_t pitch = res.width * 4;
+	size_t pitch16 = res.width * 2;
+	std::vector<uint32_t> src(res.width * res.height);
+	std::vector<uint32_t> dst(res.width * res.height);
+	std::vector<uint16_t> dst16(res.width * res.height);
+	for(auto &p : src)
+		p = rand();
+
+	measure("copy XRGB8888", res, [&] {
+		drm_core::blitRect(dst.data(), pitch, BlitFormat::xrgb8888,
+				src.data(), pitch, BlitFormat::xrgb8888, res.width, res.height);
+	});
+	measure("copy XRGB8888 (non-temporal)", res, [&] {
+		drm_core::blitRect(dst.data(), pitch, BlitFormat::xrgb8888,
+				src.data(), pitch, BlitFormat::xrgb8888, res.width, res.height, true);
+	});
+	measure("XRGB8888 -> ARGB8888", res, [&] {
+		drm_core::blitRect(dst.data(), pitch, BlitFormat::argb8888,
+				src.data(), pitch, BlitFormat::xrgb8888, res.width, res.height, true);
+	});
+	measure("XRGB8888 -> RGB565", res, [&] {
+		drm_core::blitRect(dst16.data(), pitch16, BlitFormat::rgb565,
+				src.data(), pitch, BlitFormat::xrgb8888, res.width, res.height);
+	});
+	measure("RGB565 -> XRGB8888", res, [&] {
+		drm_core::blitRect(dst.data(), pitch, BlitFormat::xrgb8888,
+				dst16.data(), pitch16, BlitFormat::rgb565, res.width, res.height);
+	});
+	measure("ARGB8888 blend", res, [&] {
+		drm_core::blendRect(dst.data(), pitch, src.data(), pitch, res.width, res.height);
+	});
+}
+
+// ----------------------------------------------------------------
+// Comparison of the SIMD kernels against the scalar kernels.
+// ----------------------------------------------------------------
+
+using drm_core::BlitFormat;
+
+constexpr BlitFormat formats[] = {BlitFormat::xrgb8888, BlitFormat::argb8888, BlitFormat::rgb565};
+
+const char *formatName(BlitFormat format) {
+	switch(format) {
+	case BlitFormat::xrgb8888: return "XRGB8888";
+	case BlitFormat::argb8888: return "ARGB8888";
+	case BlitFormat::rgb565: return "RGB565";
+	}
+	return "?";
+}
+
+// Widths around the vector sizes (and the unrolled loops) of all kernels,
+// such that each kernel runs its head, main loop and tail in all combinations.
+constexpr uint32_t widths[] = {1, 2, 3, 4, 5, 7, 8, 9, 15, 16, 17, 23, 31, 32, 33,
+		47, 63, 64, 65, 127, 255, 257, 1023};
+constexpr uint32_t heights[] = {1, 3};
+// Offsets of the rectangles (in pixels) into the buffers; these vary the alignment
+// of the rows relative to the 16 and 32 byte vectors.
+constexpr size_t offsets[] = {0, 1, 3, 5};
+// Padding between the rows. Without padding, rows are copied as a single block.
+constexpr size_t paddings[] = {0, 7};
+
+uint32_t nextRandom(uint32_t &state) {
+	// xorshift32, so that runs are reproducible.
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	return state;
+}
+
+// Premultiplied ARGB8888: no channel exceeds the alpha value.
+// Fully transparent and fully opaque pixels are common in cursor images.
+uint32_t randomPremultiplied(uint32_t &state) {
+	uint32_t r = nextRandom(state);
+	uint32_t alpha;
+	switch(r & 3) {
+	case 0: alpha = 0; break;
+	case 1: alpha = 255; break;
+	default: alpha = (r >> 8) & 0xFF;
+	}
+	uint32_t p = alpha << 24;
+	for(int shift = 0; shift < 24; shift += 8)
+		p |= (nextRandom(state) % (alpha + 1)) << shift;
+	return p;
+}
+
+struct Case {
+	BlitFormat srcFormat;
+	BlitFormat dstFormat;
+	uint32_t width;
+	uint32_t height;
+	size_t srcOffset;
+	size_t dstOffset;
+	size_t padding;
+	// Blends instead of copying.
+	bool blend;
+	bool nonTemporal;
+};
+
+std::ostream &operator<<(std::ostream &os, const Case &c) {
+	if(c.blend) {
+		os << "blend";
+	}else{
+		os << formatName(c.srcFormat) << " -> " << formatName(c.dstFormat);
+		if(c.nonTemporal)
+			os << " (non-temporal)";
+	}
+	return os << ", " << c.width << "x" << c.height << ", offsets " << c.srcOffset
+			<< "/" << c.dstOffset << ", padding " << c.padding;
+}
+
+// Runs the case with the given instruction set. The buffers include the padding
+// and some space around the rectangle, such that stray stores are detected as well.
+std::vector<uint8_t> runCase(drm_core::BlitIsa isa, const Case &c, uint32_t seed) {
+	size_t srcBpp = drm_core::blitFormatBytes(c.srcFormat);
+	size_t dstBpp = drm_core::blitFormatBytes(c.dstFormat);
+	size_t srcPitch = (c.width + c.padding) * srcBpp;
+	size_t dstPitch = (c.width + c.padding) * dstBpp;
+
+	// Allocate in units of uint32_t to align the start of the buffers.
+	std::vector<uint32_t> src((c.srcOffset * srcBpp + c.height * srcPitch + 64) / 4 + 1);
+	std::vector<uint32_t> dst((c.dstOffset * dstBpp + c.height * dstPitch + 64) / 4 + 1);
+	uint32_t state = seed;
+	for(auto &p : src)
+		p = c.blend ? randomPremultiplied(state) : nextRandom(state);
+	for(auto &p : dst)
+		p = nextRandom(state);
+
+	auto srcRect = reinterpret_cast<const uint8_t *>(src.data()) + c.srcOffset * srcBpp;
+	auto dstRect = reinterpret_cast<uint8_t *>(dst.data()) + c.dstOffset * dstBpp;
+	drm_core::forceBlitIsa(isa);
+	if(c.blend) {
+		drm_core::blendRect(dstRect, dstPitch, srcRect, srcPitch, c.width, c.height);
+	}else if(!drm_core::blitRect(dstRect, dstPitch, c.dstFormat,
+			srcRect, srcPitch, c.srcFormat, c.width, c.height, c.nonTemporal)) {
+		std::cout << "    " << c << ": not supported" << std::endl;
+	}
+
+	auto bytes = reinterpret_cast<const uint8_t *>(dst.data());
+	return std::vector<uint8_t>(bytes, bytes + dst.size() * 4);
+}
+
+int verify() {
+	std::vector<Case> cases;
+	for(auto width : widths) {
+		for(auto height : heights) {
+			for(auto srcOffset : offsets) {
+				for(auto dstOffset : offsets) {
+					for(auto padding : paddings) {
+						Case c{BlitFormat::argb8888, BlitFormat::xrgb8888, width, height,
+								srcOffset, dstOffset, padding, true, false};
+						cases.push_back(c);
+						for(auto srcFormat : formats) {
+							for(auto dstFormat : formats) {
+								for(bool nonTemporal : {false, true})
+									cases.push_back({srcFormat, dstFormat, width, height,
+											srcOffset, dstOffset, padding, false, nonTemporal});
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	auto best = drm_core::bestBlitIsa();
+	int failures = 0;
+	for(auto isa : isas) {
+		if(isa == drm_core::BlitIsa::scalar)
+			continue;
+		if(static_cast<int>(isa) > static_cast<int>(best)) {
+			std::cout << isaName(isa) << ": not supported by the CPU" << std::endl;
+			continue;
+		}
+
+		int isaFailures = 0;
+		for(size_t i = 0; i < cases.size(); i++) {
+			auto seed = static_cast<uint32_t>(i + 1) * 2654435761u;
+			auto expected = runCase(drm_core::BlitIsa::scalar, cases[i], seed);
+			auto actual = runCase(isa, cases[i], seed);
+			if(actual == expected)
+				continue;
+
+			if(isaFailures++ < 20) {
+				size_t k = 0;
+				while(actual[k] == expected[k])
+					k++;
+				std::cout << "    " << isaName(isa) << ": " << cases[i]
+						<< ": first difference at byte " << k << std::endl;
+			}
+		}
+		std::cout << isaName(isa) << ": " << (cases.size() - isaFailures) << " of "
+				<< cases.size() << " cases match the scalar kernels" << std::endl;
+		failures += isaFailures;
+	}
+	drm_core::forceBlitIsa(best);
+	return failures ? 1 : 0;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+	if(argc > 1) {
+		if(!strcmp(argv[1], "verify"))
+			return verify();
+		std::cerr << "usage: drm-bench [verify]" << std::endl;
+		return 1;
+	}
+
+	auto best = drm_core::bestBlitIsa();
+	for(auto isa : isas) {
+		if(static_cast<int>(isa) > static_cast<int>(best))
+			break;
+		drm_core::forceBlitIsa(isa);
+
+		for(auto res : resolutions) {
+			std::cout << isaName(isa) << ", " << res.width << "x" << res.height << std::endl;
+			runBenchmarks(res);
+		}
+	}
+}
@@ -1,9 +1,13 @@
 #include <math.h>
+#include <unistd.h>
 
 #include <async/result.hpp>
 #include <async/algorithm.hpp>
 #include <helix/ipc.hpp>
 
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include <vector>
 
 namespace {
@@ -205,6 +209,62 @@ void doPageFaultBenchmark(size_t size) {
 	bench.finalizeStatistics();
 }
 
+// Measures the latency of the first write to freshly allocated memory.
+// Before each repetition, we sleep such that idle CPUs can refill the kernel's pool
+// of pre-zeroed pages. Mappings that are larger than the pool (4 MiB)
+// show the latency of zeroing pages synchronously.
+void doFirstTouchBenchmark(size_t size) {
+	std::cout << "first touch latency (mapping size = " << (size / (1024 * 1024)) << " MiB)"
+			<< std::endl;
+
+	std::vector<uint64_t> results;
+	for(int k = 0; k < 5; ++k) {
+		usleep(100'000);
+
+		HelHandle handle;
+		HEL_CHECK(helAllocateMemory(size, 0, nullptr, &handle));
+		void *window;
+		HEL_CHECK(helMapMemory(handle, kHelNullHandle, nullptr, 0, size,
+				kHelMapProtRead | kHelMapProtWrite, &window));
+
+		auto p = reinterpret_cast<volatile std::byte *>(window);
+		auto start = std::chrono::high_resolution_clock::now();
+		for(size_t progress = 0; progress < size; progress += 0x1000)
+			p[progress] = static_cast<std::byte>(0);
+		auto elapsed = duration_cast<std::chrono::nanoseconds>(
+					std::chrono::high_resolution_clock::now() - start);
+
+		uint64_t perPage = elapsed.count() / (size / 0x1000);
+		std::cout << "    " << perPage << " ns per page" << std::endl;
+		results.push_back(perPage);
+
+		HEL_CHECK(helUnmapMemory(kHelNullHandle, window, size));
+		HEL_CHECK(helCloseDescriptor(kHelThisUniverse, handle));
+	}
+
+	std::sort(results.begin(), results.end());
+	std::cout << "    median: " << results[results.size() / 2] << " ns per page" << std::endl;
+}
+
+async::result<void> exchangeBuffer(helix::UniqueLane &lane1, helix::UniqueLane &lane2,
+		std::byte *sBuf, std::byte *rBuf, size_t size) {
+	co_await async::when_all(
+		async::transform(
+			helix_ng::exchangeMsgs(lane1, helix_ng::sendBuffer(sBuf, size)
+		), [&] (auto result) {
+			auto [send] = std::move(result);
+			HEL_CHECK(send.error());
+		}),
+		async::transform(
+			helix_ng::exchangeMsgs(lane2, helix_ng::recvBuffer(rBuf, size)
+		), [&] (auto result) {
+			auto [recv] = std::move(result);
+			HEL_CHECK(recv.error());
+			assert(recv.actualLength() == size);
+		})
+	);
+}
+
 async::result<void> doSendRecvBufferBenchmark(size_t size) {
 	auto [lane1, lane2] = helix::createStream();
 	std::vector<std::byte> sBuf(size);
@@ -224,21 +284,7 @@ async::result<void> doSendRecvBufferBenchmark(size_t size) {
 		bench.launchRepetition();
 		while(!bench.isRepetitionDone()) {
 			for(int i = 0; i < 100; ++i) {
-				co_await async::when_all(
-					async::transform(
-						helix_ng::exchangeMsgs(lane1, helix_ng::sendBuffer(sBuf.data(), size)
-					), [&] (auto result) {
-						auto [send] = std::move(result);
-						HEL_CHECK(send.error());
-					}),
-					async::transform(
-						helix_ng::exchangeMsgs(lane2, helix_ng::recvBuffer(rBuf.data(), size)
-					), [&] (auto result) {
-						auto [recv] = std::move(result);
-						HEL_CHECK(recv.error());
-						assert(recv.actualLength() == size);
-					})
-				);
+				co_await exchangeBuffer(lane1, lane2, sBuf.data(), rBuf.data(), size);
 				++n;
 			}
 		}
@@ -247,6 +293,57 @@ async::result<void> doSendRecvBufferBenchmark(size_t size) {
 	bench.finalizeStatistics();
 }
 
+// Sends messages over a separate stream for one second; returns the number of messages.
+async::result<uint64_t> runSendRecvLoop(size_t size) {
+	auto [lane1, lane2] = helix::createStream();
+	std::vector<std::byte> sBuf(size);
+	std::vector<std::byte> rBuf(size);
+
+	IterationsPerSecondBenchmark bench;
+	uint64_t n = 0;
+	bench.launchRepetition();
+	while(!bench.isRepetitionDone()) {
+		for(int i = 0; i < 100; ++i) {
+			co_await exchangeBuffer(lane1, lane2, sBuf.data(), rBuf.data(), size);
+			++n;
+		}
+	}
+	co_return n;
+}
+
+// Runs the send/recv benchmark on 1, 2, 4, ... threads (up to the number of CPUs).
+// Each message allocates a couple of kernel objects (stream nodes, IPC items etc.);
+// as the threads do not share any kernel objects, the throughput should scale
+// with the number of threads unless the kernel heap is contended.
+void doParallelSendRecvBenchmark(size_t size) {
+	long numCpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if(numCpus < 1)
+		numCpus = 1;
+
+	for(long numThreads = 1; ; numThreads = std::min(2 * numThreads, numCpus)) {
+		std::cout << "parallel ipc, size = " << size
+				<< ", threads = " << numThreads << std::endl;
+
+		IterationsPerSecondBenchmark bench;
+		for(int k = 0; k < 5; ++k) {
+			std::atomic<uint64_t> n{0};
+			std::vector<std::thread> threads;
+			for(long i = 0; i < numThreads; ++i) {
+				threads.emplace_back([&] {
+					n += async::run(runSendRecvLoop(size), helix::currentDispatcher);
+				});
+			}
+			for(auto &thread : threads)
+				thread.join();
+			bench.announceIterations(n.load());
+		}
+		bench.finalizeStatistics();
+
+		if(numThreads == numCpus)
+			break;
+	}
+}
+
 } // anonymous namespace
 
 int main() {
@@ -257,6 +354,8 @@ int main() {
 	doMapBenchmark(1 << 20);
 	doMapPopulatedBenchmark(1 << 20);
 	doPageFaultBenchmark(1 << 20);
+	doFirstTouchBenchmark(1 << 20);
+	doFirstTouchBenchmark(16 << 20);
 	async::run(doSendRecvBufferBenchmark(1), helix::currentDispatcher);
 	async::run(doSendRecvBufferBenchmark(32), helix::currentDispatcher);
 	async::run(doSendRecvBufferBenchmark(128), helix::currentDispatcher);
@@ -264,4 +363,5 @@ int main() {
 	async::run(doSendRecvBufferBenchmark(16 * 1024), helix::currentDispatcher);
 	async::run(doSendRecvBufferBenchmark(64 * 1024), helix::currentDispatcher);
 	async::run(doSendRecvBufferBenchmark(1024 * 1024), helix::currentDispatcher);
+	doParallelSendRecvBenchmark(32);
 }
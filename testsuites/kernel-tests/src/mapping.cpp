@@ -49,3 +49,49 @@ DEFINE_TEST(unmapPartialPreserve, ([] {
 	HEL_CHECK(helUnmapMemory(kHelNullHandle, p, 0x1000));
 	HEL_CHECK(helUnmapMemory(kHelNullHandle, p + 0x2000, 0x1000));
 }))
+
+DEFINE_TEST(faultAroundCopyOnWrite, ([] {
+	constexpr size_t size = 0x20000;
+	HelHandle handle;
+	HEL_CHECK(helAllocateMemory(size, 0, nullptr, &handle));
+	void *window;
+	HEL_CHECK(helMapMemory(handle, kHelNullHandle, nullptr, 0, size,
+			kHelMapProtRead | kHelMapProtWrite, &window));
+
+	// Make all pages present in the original memory object.
+	auto p = reinterpret_cast<std::byte *>(window);
+	for(size_t offset = 0; offset < size; offset += 0x1000)
+		p[offset] = static_cast<std::byte>(offset >> 12);
+
+	// Map the memory privately, as posix does for private file mappings.
+	HelHandle cowHandle;
+	HEL_CHECK(helCopyOnWrite(handle, 0, size, &cowHandle));
+	void *cowWindow;
+	HEL_CHECK(helMapMemory(cowHandle, kHelNullHandle, nullptr, 0, size,
+			kHelMapProtRead | kHelMapProtWrite, &cowWindow));
+	auto q = reinterpret_cast<volatile std::byte *>(cowWindow);
+
+	// Reading a page that was not copied yet is a minor fault,
+	// and the pages around it are mapped, too.
+	HelSpaceStats before;
+	HEL_CHECK(helQuerySpaceStats(kHelNullHandle, &before));
+	assert(q[0x10000] == static_cast<std::byte>(0x10));
+	HelSpaceStats after;
+	HEL_CHECK(helQuerySpaceStats(kHelNullHandle, &after));
+	assert(after.minorFaults > before.minorFaults);
+	assert(after.prefaultedPages > before.prefaultedPages);
+
+	// Pages that were mapped around the fault are still copied on write.
+	for(size_t offset = 0; offset < size; offset += 0x1000)
+		q[offset] = static_cast<std::byte>(42);
+	for(size_t offset = 0; offset < size; offset += 0x1000) {
+		assert(p[offset] == static_cast<std::byte>(offset >> 12));
+		assert(q[offset] == static_cast<std::byte>(42));
+	}
+
+	// Clean up.
+	HEL_CHECK(helUnmapMemory(kHelNullHandle, cowWindow, size));
+	HEL_CHECK(helUnmapMemory(kHelNullHandle, window, size));
+	HEL_CHECK(helCloseDescriptor(kHelThisUniverse, cowHandle));
+	HEL_CHECK(helCloseDescriptor(kHelThisUniverse, handle));
+}))
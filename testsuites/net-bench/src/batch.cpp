@@ -0,0 +1,71 @@
+#include <errno.h>
+#include <sys/socket.h>
+
+#include "common.hpp"
+
+#ifdef NET_BENCH_FS_BATCH
+#include <map>
+
+#include <async/result.hpp>
+#include <hel.h>
+#include <hel-syscalls.h>
+#include <helix/ipc.hpp>
+#include <helix/passthrough-fd.hpp>
+#include <protocols/fs/client.hpp>
+#endif
+
+namespace bench {
+
+#ifdef NET_BENCH_FS_BATCH
+
+namespace {
+
+// Our own handles to the sockets' passthrough lanes (net-bench does not reuse fds).
+std::map<int, protocols::fs::File> files;
+
+protocols::fs::File &fileForFd(int fd) {
+	auto it = files.find(fd);
+	if(it == files.end()) {
+		HelHandle handle;
+		HEL_CHECK(helTransferDescriptor(helix::handleForFd(fd), kHelThisUniverse, &handle));
+		it = files.emplace(fd, protocols::fs::File{helix::UniqueDescriptor{handle}}).first;
+	}
+	return it->second;
+}
+
+int toResult(frg::expected<protocols::fs::Error, size_t> result) {
+	if(result)
+		return result.value();
+	switch(result.error()) {
+	case protocols::fs::Error::wouldBlock: errno = EAGAIN; break;
+	case protocols::fs::Error::illegalArguments: errno = EINVAL; break;
+	default: errno = EIO;
+	}
+	return -1;
+}
+
+} // anonymous namespace
+
+int sendBatch(int fd, mmsghdr *msgs, unsigned int count, int flags) {
+	return toResult(async::run(fileForFd(fd).sendMsgBatch(msgs, count, flags),
+			helix::currentDispatcher));
+}
+
+int receiveBatch(int fd, mmsghdr *msgs, unsigned int count, int flags) {
+	return toResult(async::run(fileForFd(fd).recvMsgBatch(msgs, count, flags),
+			helix::currentDispatcher));
+}
+
+#else
+
+int sendBatch(int fd, mmsghdr *msgs, unsigned int count, int flags) {
+	return sendmmsg(fd, msgs, count, flags);
+}
+
+int receiveBatch(int fd, mmsghdr *msgs, unsigned int count, int flags) {
+	return recvmmsg(fd, msgs, count, flags, nullptr);
+}
+
+#endif
+
+} // namespace bench
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/socket.h>
+
+#include <chrono>
+#include <iostream>
+
+namespace bench {
+
+using clock = std::chrono::steady_clock;
+
+// Prints the rate of packets (and payload bytes) over the given period.
+inline void reportRate(const char *name, uint64_t packets, uint64_t bytes,
+		std::chrono::nanoseconds elapsed) {
+	double seconds = elapsed.count() / 1e9;
+	std::cout << "net-bench: " << name << ": "
+			<< static_cast<uint64_t>(packets / seconds) << " packets/s, "
+			<< static_cast<uint64_t>(bytes * 8 / seconds / 1e6) << " Mbit/s" << std::endl;
+}
+
+// Prints the rate of payload bytes over the given period (for streams).
+inline void reportThroughput(const char *name, uint64_t bytes, std::chrono::nanoseconds elapsed) {
+	double seconds = elapsed.count() / 1e9;
+	std::cout << "net-bench: " << name << ": "
+			<< static_cast<uint64_t>(bytes * 8 / seconds / 1e6) << " Mbit/s" << std::endl;
+}
+
+// Parses "4" or "6" into AF_INET or AF_INET6.
+bool parseFamily(const char *arg, int &family);
+// Parses an IPv4 or IPv6 address. Link-local IPv6 addresses
+// need an interface, e.g., fe80::1%eth0.
+bool parseAddress(const char *address, int port, sockaddr_storage &ss, socklen_t &length);
+
+// Like sendmmsg() and recvmmsg(). On managarm, these send the fs protocol's batch
+// requests on the socket's passthrough lane since the libc does not issue them.
+// A batch can carry at most maxBatchBytes of payload (see protocols/fs/common.hpp).
+constexpr size_t maxBatchBytes = 4 * 1024 * 1024;
+int sendBatch(int fd, mmsghdr *msgs, unsigned int count, int flags);
+int receiveBatch(int fd, mmsghdr *msgs, unsigned int count, int flags);
+
+int udpReceive(int argc, char **argv);
+int udpTransmit(int argc, char **argv);
+int udpRoundTrip(int argc, char **argv);
+int tcpReceive(int argc, char **argv);
+int routeLookup(int argc, char **argv);
+int ndpCheck(int argc, char **argv);
+
+} // namespace bench
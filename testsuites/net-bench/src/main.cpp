@@ -0,0 +1,56 @@
+#include <string.h>
+
+#include <iostream>
+
+#include "common.hpp"
+
+// Network throughput benchmarks.
+// netserver has no loopback link; run the sending side on the host end of the
+// tap (or on a second machine) to measure the receive path of the NIC drivers.
+// Addresses may be IPv4 or IPv6. netserver configures a link-local IPv6 address
+// on its own; give the host end of the tap one as well (Linux does so by default)
+// and pass the interface along, e.g., fe80::1%eth0. For udp-rtt, run an echo
+// server on the host, e.g., socat UDP6-LISTEN:7777,fork PIPE (which also
+// accepts IPv4), and compare the results for both of its addresses.
+// ndp-check is not a benchmark: it runs on the host end of the tap (as root) and
+// checks the guest's answers to neighbour discovery and router advertisements.
+
+namespace {
+
+struct Mode {
+	const char *name;
+	int (*run)(int argc, char **argv);
+	const char *usage;
+};
+
+constexpr Mode modes[] = {
+	{"udp-rx", bench::udpReceive, "udp-rx <port> [seconds] [batch size] [4|6]"},
+	{"udp-tx", bench::udpTransmit, "udp-tx <address> <port> [payload size] [seconds] [batch size]"},
+	{"udp-rtt", bench::udpRoundTrip, "udp-rtt <address> <port> [count] [payload size]"},
+	{"tcp-rx", bench::tcpReceive, "tcp-rx <address> <port> <connections> [seconds]"},
+	{"route-lookup", bench::routeLookup, "route-lookup <interface> <gateway> [routes] [seconds]"},
+	{"ndp-check", bench::ndpCheck, "ndp-check <interface> <guest MAC>"},
+};
+
+void usage() {
+	std::cerr << "usage:" << std::endl;
+	for(auto &mode : modes)
+		std::cerr << "    net-bench " << mode.usage << std::endl;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv) {
+	if(argc < 2) {
+		usage();
+		return 1;
+	}
+
+	for(auto &mode : modes) {
+		if(!strcmp(argv[1], mode.name))
+			return mode.run(argc - 2, argv + 2);
+	}
+
+	usage();
+	return 1;
+}
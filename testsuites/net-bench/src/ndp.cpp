@@ -0,0 +1,436 @@
+#include <arpa/inet.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <array>
+#include <functional>
+#include <iostream>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "common.hpp"
+
+// Checks of netserver's neighbour discovery (RFC 4861) and stateless address
+// autoconfiguration (RFC 4862). This runs on the host end of the tap and plays
+// the part of the other nodes on the link: it sends hand-crafted ICMPv6 messages
+// through a packet socket and checks the answers of the managarm guest.
+
+namespace bench {
+
+namespace {
+
+using Mac = std::array<uint8_t, 6>;
+using Address = std::array<uint8_t, 16>;
+
+constexpr uint8_t icmp6Proto = 58;
+constexpr uint8_t echoRequest = 128;
+constexpr uint8_t echoReply = 129;
+constexpr uint8_t routerAdvertisement = 134;
+constexpr uint8_t neighbourSolicitation = 135;
+constexpr uint8_t neighbourAdvertisement = 136;
+
+constexpr uint8_t sourceLinkLayerOption = 1;
+constexpr uint8_t targetLinkLayerOption = 2;
+constexpr uint8_t prefixInformationOption = 3;
+
+constexpr uint8_t routerFlag = 0x80;
+constexpr uint8_t solicitedFlag = 0x40;
+constexpr uint8_t overrideFlag = 0x20;
+
+// netserver waits for one RetransTimer (1 second) during duplicate address detection.
+constexpr auto dadTime = std::chrono::milliseconds{1500};
+constexpr auto replyTimeout = std::chrono::seconds{2};
+
+const Address allNodes{0xFF, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1};
+
+bool parseMac(const char *str, Mac &mac) {
+	unsigned int b[6];
+	if(sscanf(str, "%x:%x:%x:%x:%x:%x", &b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 6)
+		return false;
+	for(int i = 0; i < 6; i++)
+		mac[i] = b[i];
+	return true;
+}
+
+// Modified EUI-64 interface identifier (RFC 4291, appendix A), as SLAAC derives it.
+Address fromPrefixAndMac(Address prefix, const Mac &mac) {
+	prefix[8] = mac[0] ^ 0x02;
+	prefix[9] = mac[1];
+	prefix[10] = mac[2];
+	prefix[11] = 0xFF;
+	prefix[12] = 0xFE;
+	prefix[13] = mac[3];
+	prefix[14] = mac[4];
+	prefix[15] = mac[5];
+	return prefix;
+}
+
+Address linkLocal(const Mac &mac) {
+	return fromPrefixAndMac(Address{0xFE, 0x80}, mac);
+}
+
+Address solicitedNode(const Address &addr) {
+	return Address{0xFF, 0x02, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0xFF, addr[13], addr[14], addr[15]};
+}
+
+Mac multicastMac(const Address &addr) {
+	return Mac{0x33, 0x33, addr[12], addr[13], addr[14], addr[15]};
+}
+
+std::string toString(const Address &addr) {
+	char str[INET6_ADDRSTRLEN];
+	inet_ntop(AF_INET6, addr.data(), str, sizeof(str));
+	return str;
+}
+
+uint16_t icmp6Checksum(const Address &source, const Address &destination,
+		const uint8_t *message, size_t length) {
+	uint32_t sum = 0;
+	auto add = [&] (const uint8_t *p, size_t n) {
+		for(size_t i = 0; i < n; i += 2)
+			sum += (uint32_t{p[i]} << 8) | (i + 1 < n ? p[i + 1] : 0);
+	};
+	add(source.data(), 16);
+	add(destination.data(), 16);
+	sum += length;
+	sum += icmp6Proto;
+	add(message, length);
+	while(sum >> 16)
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	return ~sum & 0xFFFF;
+}
+
+struct Message {
+	Mac ethDestination;
+	Address source;
+	Address destination;
+	uint8_t hopLimit;
+	uint8_t type;
+	uint8_t code;
+	// Message following the type, code and checksum fields.
+	std::vector<uint8_t> body;
+
+	// Target address of neighbour solicitations and advertisements.
+	Address target() const {
+		Address addr;
+		memcpy(addr.data(), body.data() + 4, 16);
+		return addr;
+	}
+
+	// Link-layer address option of neighbour solicitations and advertisements.
+	std::optional<Mac> linkLayerOption(uint8_t which) const {
+		for(size_t i = 20; i + 8 <= body.size() && body[i + 1]; i += body[i + 1] * 8) {
+			if(body[i] != which)
+				continue;
+			Mac mac;
+			memcpy(mac.data(), &body[i + 2], 6);
+			return mac;
+		}
+		return std::nullopt;
+	}
+};
+
+std::vector<uint8_t> neighbourMessage(uint8_t flags, const Address &target,
+		uint8_t option, std::optional<Mac> mac) {
+	std::vector<uint8_t> body(4);
+	body[0] = flags;
+	body.insert(body.end(), target.begin(), target.end());
+	if(mac) {
+		body.push_back(option);
+		body.push_back(1);
+		body.insert(body.end(), mac->begin(), mac->end());
+	}
+	return body;
+}
+
+struct Link {
+	int fd = -1;
+	int index = 0;
+	Mac mac;
+	Mac guestMac;
+	// We use the address that SLAAC would assign to the host end of the tap.
+	Address address;
+
+	bool open(const char *interface) {
+		fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL));
+		if(fd < 0) {
+			perror("net-bench: socket(AF_PACKET)");
+			return false;
+		}
+
+		ifreq ifr{};
+		strncpy(ifr.ifr_name, interface, IFNAMSIZ - 1);
+		if(ioctl(fd, SIOCGIFHWADDR, &ifr)) {
+			perror("net-bench: SIOCGIFHWADDR");
+			return false;
+		}
+		memcpy(mac.data(), ifr.ifr_hwaddr.sa_data, 6);
+		address = linkLocal(mac);
+
+		index = if_nametoindex(interface);
+		sockaddr_ll sll{};
+		sll.sll_family = AF_PACKET;
+		sll.sll_protocol = htons(ETH_P_ALL);
+		sll.sll_ifindex = index;
+		if(!index || bind(fd, reinterpret_cast<sockaddr *>(&sll), sizeof(sll))) {
+			perror("net-bench: bind(AF_PACKET)");
+			return false;
+		}
+		return true;
+	}
+
+	void send(Mac ethDestination, const Address &source, const Address &destination,
+			uint8_t hopLimit, uint8_t type, const std::vector<uint8_t> &body) {
+		std::vector<uint8_t> frame(14 + 40 + 4);
+		memcpy(&frame[0], ethDestination.data(), 6);
+		memcpy(&frame[6], mac.data(), 6);
+		frame[12] = ETH_P_IPV6 >> 8;
+		frame[13] = ETH_P_IPV6 & 0xFF;
+
+		auto length = 4 + body.size();
+		frame[14] = 0x60;
+		frame[18] = length >> 8;
+		frame[19] = length & 0xFF;
+		frame[20] = icmp6Proto;
+		frame[21] = hopLimit;
+		memcpy(&frame[22], source.data(), 16);
+		memcpy(&frame[38], destination.data(), 16);
+
+		frame[54] = type;
+		frame.insert(frame.end(), body.begin(), body.end());
+		auto checksum = icmp6Checksum(source, destination, &frame[54], length);
+		frame[56] = checksum >> 8;
+		frame[57] = checksum & 0xFF;
+
+		if(::send(fd, frame.data(), frame.size(), 0) != static_cast<ssize_t>(frame.size()))
+			perror("net-bench: send(AF_PACKET)");
+	}
+
+	// Waits for an ICMPv6 message from the guest that satisfies the predicate.
+	// Answers the guest's neighbour solicitations for our address in the meantime.
+	std::optional<Message> receive(std::function<bool(const Message &)> predicate,
+			std::chrono::nanoseconds timeout = replyTimeout) {
+		auto deadline = clock::now() + timeout;
+		std::vector<uint8_t> frame(2048);
+		while(true) {
+			auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+					deadline - clock::now());
+			if(remaining.count() <= 0)
+				return std::nullopt;
+			pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+			if(poll(&pfd, 1, remaining.count()) <= 0)
+				continue;
+
+			sockaddr_ll sll{};
+			socklen_t sllLength = sizeof(sll);
+			auto size = recvfrom(fd, frame.data(), frame.size(), 0,
+					reinterpret_cast<sockaddr *>(&sll), &sllLength);
+			if(size < 14 + 40 + 4 || sll.sll_pkttype == PACKET_OUTGOING)
+				continue;
+			if(memcmp(&frame[6], guestMac.data(), 6) || frame[12] != (ETH_P_IPV6 >> 8)
+					|| frame[13] != (ETH_P_IPV6 & 0xFF) || frame[20] != icmp6Proto)
+				continue;
+
+			size_t length = (frame[18] << 8) | frame[19];
+			if(length < 4 || 14 + 40 + length > static_cast<size_t>(size))
+				continue;
+
+			Message msg;
+			memcpy(msg.ethDestination.data(), &frame[0], 6);
+			memcpy(msg.source.data(), &frame[22], 16);
+			memcpy(msg.destination.data(), &frame[38], 16);
+			msg.hopLimit = frame[21];
+			msg.type = frame[54];
+			msg.code = frame[55];
+			msg.body.assign(frame.begin() + 58, frame.begin() + 54 + length);
+
+			if(icmp6Checksum(msg.source, msg.destination, &frame[54], length)) {
+				std::cerr << "net-bench: ICMPv6 message with bad checksum from "
+						<< toString(msg.source) << std::endl;
+				continue;
+			}
+
+			if(msg.type == neighbourSolicitation && msg.body.size() >= 20
+					&& msg.target() == address) {
+				if(auto sourceMac = msg.linkLayerOption(sourceLinkLayerOption); sourceMac)
+					send(*sourceMac, address, msg.source, 255, neighbourAdvertisement,
+							neighbourMessage(solicitedFlag | overrideFlag,
+								address, targetLinkLayerOption, mac));
+			}
+
+			if(predicate(msg))
+				return msg;
+		}
+	}
+
+	void solicit(const Address &target, uint8_t hopLimit = 255) {
+		auto group = solicitedNode(target);
+		send(multicastMac(group), address, group, hopLimit, neighbourSolicitation,
+				neighbourMessage(0, target, sourceLinkLayerOption, mac));
+	}
+
+	// Waits for the answer to solicit().
+	std::optional<Message> receiveAdvertisement(const Address &target,
+			std::chrono::nanoseconds timeout = replyTimeout) {
+		return receive([&] (const Message &msg) {
+			return msg.type == neighbourAdvertisement && msg.body.size() >= 20
+					&& msg.target() == target;
+		}, timeout);
+	}
+
+	// Advertises a prefix for autoconfiguration, without becoming the default router.
+	void advertisePrefix(const Address &prefix, uint8_t prefixLength) {
+		std::vector<uint8_t> body(12);
+		body[0] = 64;
+		body.insert(body.end(), {sourceLinkLayerOption, 1});
+		body.insert(body.end(), mac.begin(), mac.end());
+
+		// On-link and autonomous flags, valid and preferred lifetimes of one hour.
+		body.insert(body.end(), {prefixInformationOption, 4, prefixLength, 0xC0,
+				0, 0, 0x0E, 0x10, 0, 0, 0x0E, 0x10, 0, 0, 0, 0});
+		body.insert(body.end(), prefix.begin(), prefix.end());
+
+		send(multicastMac(allNodes), address, allNodes, 255, routerAdvertisement, body);
+	}
+
+	// Waits for the guest to start duplicate address detection on an address
+	// whose first eight bytes match the prefix.
+	std::optional<Message> receiveDadSolicitation(const Address &prefix,
+			std::chrono::nanoseconds timeout = std::chrono::seconds{5}) {
+		return receive([&] (const Message &msg) {
+			return msg.type == neighbourSolicitation && msg.body.size() >= 20
+					&& msg.source == Address{}
+					&& !memcmp(msg.target().data(), prefix.data(), 8);
+		}, timeout);
+	}
+};
+
+struct Checker {
+	int failures = 0;
+
+	void check(const char *name, bool condition, const std::string &detail = {}) {
+		std::cout << "net-bench: ndp-check: " << name << ": "
+				<< (condition ? "ok" : "FAILED") << std::endl;
+		if(!condition) {
+			if(!detail.empty())
+				std::cout << "    " << detail << std::endl;
+			failures++;
+		}
+	}
+};
+
+} // anonymous namespace
+
+int ndpCheck(int argc, char **argv) {
+	if(argc < 2) {
+		std::cerr << "net-bench: ndp-check needs an interface and the guest's MAC address"
+				<< std::endl;
+		return 1;
+	}
+
+	Link link;
+	if(!parseMac(argv[1], link.guestMac)) {
+		std::cerr << "net-bench: invalid MAC address " << argv[1] << std::endl;
+		return 1;
+	}
+	if(!link.open(argv[0]))
+		return 1;
+
+	Checker checker;
+	auto guestLinkLocal = linkLocal(link.guestMac);
+	std::cout << "net-bench: ndp-check: guest " << toString(guestLinkLocal)
+			<< ", host " << toString(link.address) << std::endl;
+
+	// Address resolution (RFC 4861, 7.2.4).
+	link.solicit(guestLinkLocal);
+	auto na = link.receiveAdvertisement(guestLinkLocal);
+	checker.check("advertisement for the link-local address", na.has_value(),
+			"is the link up and the guest's MAC address right?");
+	if(na) {
+		checker.check("advertisement is sent to the solicitor",
+				na->destination == link.address && na->ethDestination == link.mac,
+				"sent to " + toString(na->destination));
+		checker.check("advertisement has hop limit 255", na->hopLimit == 255);
+		checker.check("advertisement flags",
+				(na->body[0] & (routerFlag | solicitedFlag | overrideFlag))
+					== (solicitedFlag | overrideFlag));
+		checker.check("advertisement carries the target link-layer address",
+				na->linkLayerOption(targetLinkLayerOption) == link.guestMac);
+	}
+
+	// Solicitations that might have been forwarded by a router are invalid (RFC 4861, 7.1.1).
+	link.solicit(guestLinkLocal, 64);
+	checker.check("solicitation with hop limit 64 is ignored",
+			!link.receiveAdvertisement(guestLinkLocal, dadTime));
+
+	// Duplicate address detection by another node is answered to all nodes
+	// and without the solicited flag (RFC 4861, 7.2.4).
+	link.send(multicastMac(solicitedNode(guestLinkLocal)), Address{}, solicitedNode(guestLinkLocal),
+			255, neighbourSolicitation, neighbourMessage(0, guestLinkLocal, 0, std::nullopt));
+	na = link.receiveAdvertisement(guestLinkLocal);
+	checker.check("advertisement in answer to duplicate address detection",
+			na && na->destination == allNodes && na->ethDestination == multicastMac(allNodes)
+				&& !(na->body[0] & solicitedFlag));
+
+	// Stateless address autoconfiguration (RFC 4862, 5.5.3).
+	const Address prefix{0x20, 0x01, 0x0D, 0xB8, 0, 0, 0, 1};
+	auto global = fromPrefixAndMac(prefix, link.guestMac);
+	link.advertisePrefix(prefix, 64);
+	auto dad = link.receiveDadSolicitation(prefix);
+	checker.check("duplicate address detection for the autoconfigured address",
+			dad && dad->target() == global && dad->destination == solicitedNode(global)
+				&& dad->ethDestination == multicastMac(solicitedNode(global))
+				&& dad->hopLimit == 255 && !dad->linkLayerOption(sourceLinkLayerOption),
+			dad ? "target " + toString(dad->target()) + ", expected " + toString(global)
+				: std::string{"no solicitation"});
+
+	std::this_thread::sleep_for(dadTime);
+	link.solicit(global);
+	checker.check("advertisement for the autoconfigured address",
+			link.receiveAdvertisement(global).has_value());
+
+	// ICMPv6 echo to the autoconfigured address.
+	std::vector<uint8_t> echo{0x12, 0x34, 0, 1, 'n', 'e', 't', '-', 'b', 'e', 'n', 'c', 'h'};
+	link.send(link.guestMac, link.address, global, 64, echoRequest, echo);
+	auto reply = link.receive([&] (const Message &msg) {
+		return msg.type == echoReply && msg.source == global;
+	});
+	checker.check("echo reply from the autoconfigured address",
+			reply && reply->destination == link.address && reply->body == echo);
+
+	// The guest must not configure an address that another node defends (RFC 4862, 5.4.5).
+	const Address duplicatePrefix{0x20, 0x01, 0x0D, 0xB8, 0, 0, 0, 2};
+	auto duplicate = fromPrefixAndMac(duplicatePrefix, link.guestMac);
+	link.advertisePrefix(duplicatePrefix, 64);
+	dad = link.receiveDadSolicitation(duplicatePrefix);
+	checker.check("duplicate address detection for the second prefix", dad.has_value());
+	link.send(multicastMac(allNodes), duplicate, allNodes, 255, neighbourAdvertisement,
+			neighbourMessage(overrideFlag, duplicate, targetLinkLayerOption, link.mac));
+	std::this_thread::sleep_for(dadTime);
+	link.solicit(duplicate);
+	checker.check("duplicate address is not configured",
+			!link.receiveAdvertisement(duplicate, dadTime));
+
+	// Interface identifiers derived from MAC addresses need a /64 prefix.
+	const Address longPrefix{0x20, 0x01, 0x0D, 0xB8, 0, 3};
+	link.advertisePrefix(longPrefix, 48);
+	checker.check("no autoconfiguration for a /48 prefix",
+			!link.receiveDadSolicitation(longPrefix, dadTime));
+
+	if(checker.failures) {
+		std::cout << "net-bench: ndp-check: " << checker.failures << " checks failed" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+} // namespace bench
@@ -0,0 +1,182 @@
+#include <arpa/inet.h>
+#include <errno.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+
+namespace bench {
+
+namespace {
+
+// Routes are installed into the benchmarking range 198.18.0.0/15 (RFC 2544),
+// one /28 per route; this leaves room for 8192 routes.
+constexpr uint32_t routeBase = 0xC6120000;
+constexpr int routePrefix = 28;
+constexpr int maxRoutes = 1 << (32 - 15 - (32 - routePrefix));
+
+uint32_t routeNetwork(int i) {
+	return routeBase + (uint32_t(i) << (32 - routePrefix));
+}
+
+struct RouteRequest {
+	nlmsghdr hdr;
+	rtmsg msg;
+	char attrs[3 * RTA_SPACE(sizeof(uint32_t))];
+};
+
+void appendAttr(RouteRequest &req, unsigned short type, uint32_t value) {
+	auto rta = reinterpret_cast<rtattr *>(reinterpret_cast<char *>(&req) + NLMSG_ALIGN(req.hdr.nlmsg_len));
+	rta->rta_type = type;
+	rta->rta_len = RTA_LENGTH(sizeof(value));
+	memcpy(RTA_DATA(rta), &value, sizeof(value));
+	req.hdr.nlmsg_len = NLMSG_ALIGN(req.hdr.nlmsg_len) + RTA_SPACE(sizeof(value));
+}
+
+bool addRoute(int nl, uint32_t seq, uint32_t network, in_addr gateway, int ifindex) {
+	RouteRequest req{};
+	req.hdr.nlmsg_len = NLMSG_LENGTH(sizeof(rtmsg));
+	req.hdr.nlmsg_type = RTM_NEWROUTE;
+	req.hdr.nlmsg_flags = NLM_F_REQUEST | NLM_F_CREATE | NLM_F_ACK;
+	req.hdr.nlmsg_seq = seq;
+	req.msg.rtm_family = AF_INET;
+	req.msg.rtm_dst_len = routePrefix;
+	req.msg.rtm_protocol = RTPROT_STATIC;
+	req.msg.rtm_scope = RT_SCOPE_UNIVERSE;
+	req.msg.rtm_type = RTN_UNICAST;
+	appendAttr(req, RTA_DST, htonl(network));
+	appendAttr(req, RTA_GATEWAY, gateway.s_addr);
+	appendAttr(req, RTA_OIF, ifindex);
+
+	if(send(nl, &req, req.hdr.nlmsg_len, 0) < 0) {
+		perror("net-bench: send to netlink");
+		return false;
+	}
+
+	char buffer[4096];
+	auto res = recv(nl, buffer, sizeof(buffer), 0);
+	if(res < 0) {
+		perror("net-bench: recv from netlink");
+		return false;
+	}
+	auto hdr = reinterpret_cast<nlmsghdr *>(buffer);
+	if(hdr->nlmsg_type == NLMSG_ERROR) {
+		auto err = reinterpret_cast<nlmsgerr *>(NLMSG_DATA(hdr));
+		if(err->error && err->error != -EEXIST) {
+			std::cerr << "net-bench: RTM_NEWROUTE failed: " << strerror(-err->error) << std::endl;
+			return false;
+		}
+	}
+	return true;
+}
+
+// Sends small datagrams round-robin to the given destinations; returns datagrams per second.
+double sendRoundRobin(int fd, const std::vector<sockaddr_in> &targets, int duration) {
+	char payload[16] = {};
+	uint64_t packets = 0;
+	size_t next = 0;
+	auto start = clock::now();
+	std::chrono::nanoseconds elapsed;
+	do {
+		for(int i = 0; i < 64; i++) {
+			auto &target = targets[next];
+			if(++next == targets.size())
+				next = 0;
+			auto res = sendto(fd, payload, sizeof(payload), 0,
+					reinterpret_cast<const sockaddr *>(&target), sizeof(target));
+			if(res >= 0)
+				packets++;
+		}
+		elapsed = clock::now() - start;
+	} while(elapsed < std::chrono::seconds{duration});
+	return packets / (elapsed.count() / 1e9);
+}
+
+} // anonymous namespace
+
+// Installs many routes via netlink and measures the cost of routing decisions
+// on the UDP send path. Datagrams are sent to the discard port of addresses in
+// the installed prefixes; they all leave through the given gateway.
+int routeLookup(int argc, char **argv) {
+	if(argc < 2) {
+		std::cerr << "net-bench: missing interface or gateway" << std::endl;
+		return 1;
+	}
+	int numRoutes = argc >= 3 ? atoi(argv[2]) : 4096;
+	int duration = argc >= 4 ? atoi(argv[3]) : 5;
+	if(numRoutes < 1 || numRoutes > maxRoutes) {
+		std::cerr << "net-bench: number of routes must be in [1, " << maxRoutes << "]" << std::endl;
+		return 1;
+	}
+
+	int ifindex = if_nametoindex(argv[0]);
+	if(!ifindex) {
+		std::cerr << "net-bench: unknown interface " << argv[0] << std::endl;
+		return 1;
+	}
+	in_addr gateway;
+	if(inet_pton(AF_INET, argv[1], &gateway) != 1) {
+		std::cerr << "net-bench: invalid gateway " << argv[1] << std::endl;
+		return 1;
+	}
+
+	int nl = socket(AF_NETLINK, SOCK_RAW, NETLINK_ROUTE);
+	if(nl < 0) {
+		perror("net-bench: netlink socket");
+		return 1;
+	}
+
+	auto start = clock::now();
+	for(int i = 0; i < numRoutes; i++) {
+		if(!addRoute(nl, i + 1, routeNetwork(i), gateway, ifindex))
+			return 1;
+	}
+	auto elapsed = clock::now() - start;
+	std::cout << "net-bench: installed " << numRoutes << " routes in "
+			<< std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
+			<< " ms" << std::endl;
+	close(nl);
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if(fd < 0) {
+		perror("net-bench: socket");
+		return 1;
+	}
+
+	std::vector<sockaddr_in> targets;
+	for(int i = 0; i < numRoutes; i++) {
+		sockaddr_in addr{};
+		addr.sin_family = AF_INET;
+		addr.sin_port = htons(9);
+		addr.sin_addr.s_addr = htonl(routeNetwork(i) + 1);
+		targets.push_back(addr);
+	}
+
+	// A single destination hits the per-socket route cache on every send;
+	// alternating destinations require a full lookup for each datagram.
+	auto cached = sendRoundRobin(fd, {targets.front()}, duration);
+	auto uncached = sendRoundRobin(fd, targets, duration);
+	std::cout << "net-bench: route-lookup: " << static_cast<uint64_t>(cached)
+			<< " datagrams/s to a single destination" << std::endl;
+	std::cout << "net-bench: route-lookup: " << static_cast<uint64_t>(uncached)
+			<< " datagrams/s to " << numRoutes << " destinations" << std::endl;
+	if(uncached > 0)
+		std::cout << "net-bench: route-lookup: ~"
+				<< static_cast<int64_t>((1e9 / uncached) - (1e9 / cached))
+				<< " ns routing overhead per datagram" << std::endl;
+
+	close(fd);
+	return 0;
+}
+
+} // namespace bench
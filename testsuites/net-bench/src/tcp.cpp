@@ -0,0 +1,118 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+#include "common.hpp"
+
+namespace bench {
+
+namespace {
+
+constexpr size_t bufferSize = 64 * 1024;
+constexpr int maxConnections = 256;
+
+} // anonymous namespace
+
+// Opens a number of TCP connections to a sender on the host and receives from all
+// of them at the same time; prints the aggregate rate once per second. netserver
+// does not support listen() and accept(), so the host listens and we connect, e.g.,
+// socat -u TCP-LISTEN:<port>,fork,reuseaddr /dev/zero.
+// On a multi-queue NIC (e.g., QEMU's -netdev tap,queues=4 with -device
+// virtio-net-pci,mq=on,rss=on), the connections are spread over the receive queues.
+// This does not measure scaling across CPUs: netserver serves all queues on a single
+// thread. The aggregate rate is bounded by that thread; the per-connection totals
+// printed at the end show whether the queues share it fairly.
+int tcpReceive(int argc, char **argv) {
+	if(argc < 3) {
+		std::cerr << "net-bench: missing address, port or number of connections" << std::endl;
+		return 1;
+	}
+	int port = atoi(argv[1]);
+	int count = atoi(argv[2]);
+	int duration = argc >= 4 ? atoi(argv[3]) : 10;
+	if(count < 1 || count > maxConnections) {
+		std::cerr << "net-bench: number of connections must be in [1, "
+				<< maxConnections << "]" << std::endl;
+		return 1;
+	}
+
+	sockaddr_storage addr;
+	socklen_t addrLength;
+	if(!parseAddress(argv[0], port, addr, addrLength))
+		return 1;
+
+	std::vector<pollfd> pfds;
+	for(int i = 0; i < count; i++) {
+		int fd = socket(addr.ss_family, SOCK_STREAM, 0);
+		if(fd < 0) {
+			perror("net-bench: socket");
+			return 1;
+		}
+		if(connect(fd, reinterpret_cast<sockaddr *>(&addr), addrLength)) {
+			perror("net-bench: connect");
+			return 1;
+		}
+		pfds.push_back({.fd = fd, .events = POLLIN, .revents = 0});
+	}
+	std::cout << "net-bench: tcp-rx: opened " << count << " connections" << std::endl;
+
+	std::vector<char> buffer(bufferSize);
+	std::vector<uint64_t> received(count, 0);
+	int open = count;
+	uint64_t bytes = 0;
+	uint64_t totalBytes = 0;
+	auto start = clock::now();
+	auto ref = start;
+	while(open) {
+		// Wake up periodically even if no data arrives.
+		if(poll(pfds.data(), pfds.size(), 1000) < 0) {
+			perror("net-bench: poll");
+			return 1;
+		}
+		for(int i = 0; i < count; i++) {
+			if(pfds[i].fd < 0 || !pfds[i].revents)
+				continue;
+			auto res = recv(pfds[i].fd, buffer.data(), buffer.size(), 0);
+			if(res <= 0) {
+				close(pfds[i].fd);
+				pfds[i].fd = -1;
+				open--;
+				continue;
+			}
+			received[i] += res;
+			bytes += res;
+		}
+
+		auto now = clock::now();
+		if(now - ref >= std::chrono::seconds{1}) {
+			reportThroughput("tcp-rx", bytes, now - ref);
+			totalBytes += bytes;
+			bytes = 0;
+			ref = now;
+		}
+		if(now - start >= std::chrono::seconds{duration})
+			break;
+	}
+	totalBytes += bytes;
+
+	for(auto &pfd : pfds) {
+		if(pfd.fd >= 0)
+			close(pfd.fd);
+	}
+
+	reportThroughput("tcp-rx (total)", totalBytes, clock::now() - start);
+	auto [min, max] = std::minmax_element(received.begin(), received.end());
+	std::cout << "net-bench: tcp-rx: per connection: min " << *min / (1024 * 1024)
+			<< " MiB, max " << *max / (1024 * 1024) << " MiB" << std::endl;
+	return 0;
+}
+
+} // namespace bench
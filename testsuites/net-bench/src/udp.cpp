@@ -0,0 +1,341 @@
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <netinet/in.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "common.hpp"
+
+namespace bench {
+
+namespace {
+
+constexpr size_t maxPayload = 65507;
+// Same limit as UIO_MAXIOV on Linux.
+constexpr int maxBatch = 1024;
+
+// Buffers for recvmmsg() and sendmmsg().
+struct Batch {
+	Batch(int count, size_t size)
+	: buffers(count, std::vector<char>(size, 'x')), iovs(count), msgs(count) {
+		for(int i = 0; i < count; i++) {
+			iovs[i].iov_base = buffers[i].data();
+			iovs[i].iov_len = size;
+			msgs[i].msg_hdr.msg_iov = &iovs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+	}
+
+	std::vector<std::vector<char>> buffers;
+	std::vector<iovec> iovs;
+	std::vector<mmsghdr> msgs;
+};
+
+bool parseBatch(const char *arg, int &batch) {
+	batch = atoi(arg);
+	if(batch < 1 || batch > maxBatch) {
+		std::cerr << "net-bench: batch size must be in [1, " << maxBatch << "]" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+} // anonymous namespace
+
+bool parseAddress(const char *address, int port, sockaddr_storage &ss, socklen_t &length) {
+	ss = {};
+	auto sin = reinterpret_cast<sockaddr_in *>(&ss);
+	if(inet_pton(AF_INET, address, &sin->sin_addr) == 1) {
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(port);
+		length = sizeof(sockaddr_in);
+		return true;
+	}
+
+	std::string str{address};
+	std::string interface;
+	if(auto percent = str.find('%'); percent != std::string::npos) {
+		interface = str.substr(percent + 1);
+		str.resize(percent);
+	}
+
+	auto sin6 = reinterpret_cast<sockaddr_in6 *>(&ss);
+	if(inet_pton(AF_INET6, str.c_str(), &sin6->sin6_addr) != 1) {
+		std::cerr << "net-bench: invalid address " << address << std::endl;
+		return false;
+	}
+	sin6->sin6_family = AF_INET6;
+	sin6->sin6_port = htons(port);
+	if(!interface.empty()) {
+		sin6->sin6_scope_id = if_nametoindex(interface.c_str());
+		if(!sin6->sin6_scope_id) {
+			std::cerr << "net-bench: unknown interface " << interface << std::endl;
+			return false;
+		}
+	}
+	length = sizeof(sockaddr_in6);
+	return true;
+}
+
+bool parseFamily(const char *arg, int &family) {
+	if(!strcmp(arg, "4")) {
+		family = AF_INET;
+	}else if(!strcmp(arg, "6")) {
+		family = AF_INET6;
+	}else{
+		std::cerr << "net-bench: address family must be 4 or 6" << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Counts the UDP datagrams that arrive on a port; prints the rate once per second.
+// With a batch size larger than one, datagrams are received in batches (see receiveBatch()).
+int udpReceive(int argc, char **argv) {
+	if(argc < 1) {
+		std::cerr << "net-bench: missing port" << std::endl;
+		return 1;
+	}
+	int port = atoi(argv[0]);
+	int duration = argc >= 2 ? atoi(argv[1]) : 10;
+	int batchSize = 1;
+	if(argc >= 3 && !parseBatch(argv[2], batchSize))
+		return 1;
+	int family = AF_INET;
+	if(argc >= 4 && !parseFamily(argv[3], family))
+		return 1;
+
+	int fd = socket(family, SOCK_DGRAM, 0);
+	if(fd < 0) {
+		perror("net-bench: socket");
+		return 1;
+	}
+
+	sockaddr_storage addr{};
+	socklen_t addrLength;
+	if(family == AF_INET) {
+		auto sin = reinterpret_cast<sockaddr_in *>(&addr);
+		sin->sin_family = AF_INET;
+		sin->sin_port = htons(port);
+		sin->sin_addr.s_addr = htonl(INADDR_ANY);
+		addrLength = sizeof(sockaddr_in);
+	}else{
+		auto sin6 = reinterpret_cast<sockaddr_in6 *>(&addr);
+		sin6->sin6_family = AF_INET6;
+		sin6->sin6_port = htons(port);
+		sin6->sin6_addr = in6addr_any;
+		addrLength = sizeof(sockaddr_in6);
+	}
+	if(bind(fd, reinterpret_cast<sockaddr *>(&addr), addrLength)) {
+		perror("net-bench: bind");
+		return 1;
+	}
+
+	// Wake up periodically even if no datagrams arrive.
+	timeval timeout{.tv_sec = 1, .tv_usec = 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	std::vector<char> buffer(maxPayload);
+	// Shrink the buffers of large batches such that the batch fits into maxBatchBytes.
+	Batch batch{batchSize, std::min(maxPayload, maxBatchBytes / batchSize)};
+	uint64_t packets = 0, bytes = 0;
+	uint64_t totalPackets = 0, totalBytes = 0;
+	auto start = clock::now();
+	auto ref = start;
+	while(true) {
+		if(batchSize > 1) {
+			auto res = receiveBatch(fd, batch.msgs.data(), batchSize, MSG_WAITFORONE);
+			for(int i = 0; i < res; i++) {
+				packets++;
+				bytes += batch.msgs[i].msg_len;
+			}
+		}else{
+			auto res = recv(fd, buffer.data(), buffer.size(), 0);
+			if(res >= 0) {
+				packets++;
+				bytes += res;
+			}
+		}
+
+		auto now = clock::now();
+		if(now - ref >= std::chrono::seconds{1}) {
+			reportRate("udp-rx", packets, bytes, now - ref);
+			totalPackets += packets;
+			totalBytes += bytes;
+			packets = 0;
+			bytes = 0;
+			ref = now;
+		}
+		if(now - start >= std::chrono::seconds{duration})
+			break;
+	}
+
+	reportRate("udp-rx (total)", totalPackets, totalBytes, ref - start);
+	close(fd);
+	return 0;
+}
+
+// Sends UDP datagrams of a fixed size to the given address as fast as possible.
+// With a batch size larger than one, datagrams are sent in batches (see sendBatch()).
+int udpTransmit(int argc, char **argv) {
+	if(argc < 2) {
+		std::cerr << "net-bench: missing address or port" << std::endl;
+		return 1;
+	}
+	size_t size = argc >= 3 ? atoi(argv[2]) : 64;
+	int duration = argc >= 4 ? atoi(argv[3]) : 10;
+	int batchSize = 1;
+	if(argc >= 5 && !parseBatch(argv[4], batchSize))
+		return 1;
+	if(size > maxPayload) {
+		std::cerr << "net-bench: payload size too large" << std::endl;
+		return 1;
+	}
+	if(size * batchSize > maxBatchBytes) {
+		std::cerr << "net-bench: batch exceeds " << maxBatchBytes << " bytes" << std::endl;
+		return 1;
+	}
+
+	sockaddr_storage addr;
+	socklen_t addrLength;
+	if(!parseAddress(argv[0], atoi(argv[1]), addr, addrLength))
+		return 1;
+
+	int fd = socket(addr.ss_family, SOCK_DGRAM, 0);
+	if(fd < 0) {
+		perror("net-bench: socket");
+		return 1;
+	}
+	if(connect(fd, reinterpret_cast<sockaddr *>(&addr), addrLength)) {
+		perror("net-bench: connect");
+		return 1;
+	}
+
+	std::vector<char> buffer(size, 'x');
+	Batch batch{batchSize, size};
+	uint64_t packets = 0, bytes = 0;
+	auto start = clock::now();
+	std::chrono::nanoseconds elapsed;
+	do {
+		// Only check the clock once in a while to keep the overhead low.
+		for(int i = 0; i < 64; i++) {
+			if(batchSize > 1) {
+				auto res = sendBatch(fd, batch.msgs.data(), batchSize, 0);
+				for(int j = 0; j < res; j++) {
+					packets++;
+					bytes += batch.msgs[j].msg_len;
+				}
+				continue;
+			}
+
+			auto res = send(fd, buffer.data(), buffer.size(), 0);
+			if(res < 0)
+				continue;
+			packets++;
+			bytes += res;
+		}
+		elapsed = clock::now() - start;
+	} while(elapsed < std::chrono::seconds{duration});
+
+	reportRate("udp-tx", packets, bytes, elapsed);
+	close(fd);
+	return 0;
+}
+
+// Measures the round trip time of UDP datagrams to an echo server.
+// Running this against the IPv4 and the IPv6 address of the same server
+// compares the per-packet cost of both network layers.
+int udpRoundTrip(int argc, char **argv) {
+	if(argc < 2) {
+		std::cerr << "net-bench: missing address or port" << std::endl;
+		return 1;
+	}
+	int count = argc >= 3 ? atoi(argv[2]) : 10000;
+	size_t size = argc >= 4 ? atoi(argv[3]) : 64;
+	if(count < 1) {
+		std::cerr << "net-bench: count must be positive" << std::endl;
+		return 1;
+	}
+	if(size < sizeof(uint32_t) || size > maxPayload) {
+		std::cerr << "net-bench: payload size must be in [4, " << maxPayload << "]" << std::endl;
+		return 1;
+	}
+
+	sockaddr_storage addr;
+	socklen_t addrLength;
+	if(!parseAddress(argv[0], atoi(argv[1]), addr, addrLength))
+		return 1;
+
+	int fd = socket(addr.ss_family, SOCK_DGRAM, 0);
+	if(fd < 0) {
+		perror("net-bench: socket");
+		return 1;
+	}
+	if(connect(fd, reinterpret_cast<sockaddr *>(&addr), addrLength)) {
+		perror("net-bench: connect");
+		return 1;
+	}
+
+	// Treat datagrams that are not echoed within a second as lost.
+	timeval timeout{.tv_sec = 1, .tv_usec = 0};
+	setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	std::vector<char> buffer(size, 'x');
+	std::vector<char> reply(buffer.size());
+	std::vector<std::chrono::nanoseconds> samples;
+	samples.reserve(count);
+	int lost = 0;
+	for(uint32_t seq = 0; seq < uint32_t(count); seq++) {
+		// Tag each datagram such that late replies are not mistaken for the current one.
+		memcpy(buffer.data(), &seq, sizeof(seq));
+
+		auto before = clock::now();
+		if(send(fd, buffer.data(), size, 0) < 0) {
+			perror("net-bench: send");
+			return 1;
+		}
+		while(true) {
+			auto res = recv(fd, reply.data(), reply.size(), 0);
+			if(res < 0) {
+				lost++;
+				break;
+			}
+			uint32_t replySeq;
+			memcpy(&replySeq, reply.data(), sizeof(replySeq));
+			if(size_t(res) == size && replySeq == seq) {
+				samples.push_back(clock::now() - before);
+				break;
+			}
+		}
+	}
+
+	if(samples.empty()) {
+		std::cerr << "net-bench: no replies received" << std::endl;
+		return 1;
+	}
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&] (int p) {
+		return samples[(samples.size() - 1) * p / 100].count() / 1000.0;
+	};
+	std::chrono::nanoseconds total{0};
+	for(auto sample : samples)
+		total += sample;
+	std::cout << "net-bench: udp-rtt: " << samples.size() << " replies, " << lost << " lost, "
+			<< "min " << percentile(0) << " us, median " << percentile(50) << " us, "
+			<< "p99 " << percentile(99) << " us, mean "
+			<< total.count() / 1000.0 / samples.size() << " us" << std::endl;
+	close(fd);
+	return 0;
+}
+
+} // namespace bench
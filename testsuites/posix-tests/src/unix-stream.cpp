@@ -0,0 +1,178 @@
+#include <cassert>
+#include <cstring>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <vector>
+
+#include "testsuite.hpp"
+
+namespace {
+
+char patternAt(size_t offset) {
+	return static_cast<char>((offset * 7 + offset / 251) & 0xFF);
+}
+
+void writePattern(int fd, size_t offset, size_t length) {
+	std::vector<char> buffer(length);
+	for(size_t i = 0; i < length; i++)
+		buffer[i] = patternAt(offset + i);
+	size_t written = 0;
+	while(written < length) {
+		auto res = write(fd, buffer.data() + written, length - written);
+		assert_errno("write", res > 0);
+		written += res;
+	}
+}
+
+void readPattern(int fd, size_t offset, size_t length) {
+	std::vector<char> buffer(length);
+	size_t received = 0;
+	while(received < length) {
+		auto res = read(fd, buffer.data() + received, length - received);
+		assert_errno("read", res > 0);
+		received += res;
+	}
+	for(size_t i = 0; i < length; i++)
+		assert(buffer[i] == patternAt(offset + i));
+}
+
+} // anonymous namespace
+
+// Interleaves writes and partial reads such that the queued data wraps around
+// the end of the socket's buffer and the buffer grows while it holds data.
+DEFINE_TEST(unix_stream_wraparound, ([] {
+	int fds[2];
+	assert_errno("socketpair", !socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+	size_t writeOffset = 0;
+	size_t readOffset = 0;
+	// Keep the backlog well below the default socket buffer size on Linux.
+	const size_t writeSizes[] = {3000, 30000, 1, 16384, 50000, 4095};
+	for(int round = 0; round < 8; round++) {
+		for(auto size : writeSizes) {
+			writePattern(fds[0], writeOffset, size);
+			writeOffset += size;
+
+			// Leave some data queued to exercise wraparound.
+			auto chunk = (writeOffset - readOffset) * 2 / 3;
+			readPattern(fds[1], readOffset, chunk);
+			readOffset += chunk;
+		}
+	}
+	readPattern(fds[1], readOffset, writeOffset - readOffset);
+
+	close(fds[0]);
+	close(fds[1]);
+}))
+
+// Consecutive writes without ancillary data can be read in one call.
+DEFINE_TEST(unix_stream_coalesce, ([] {
+	int fds[2];
+	assert_errno("socketpair", !socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+	assert(write(fds[0], "abc", 3) == 3);
+	assert(write(fds[0], "def", 3) == 3);
+	assert(write(fds[0], "gh", 2) == 2);
+
+	int queued;
+	assert_errno("ioctl", !ioctl(fds[1], FIONREAD, &queued));
+	assert(queued == 8);
+
+	char buffer[16];
+	assert(read(fds[1], buffer, sizeof(buffer)) == 8);
+	assert(!memcmp(buffer, "abcdefgh", 8));
+
+	close(fds[0]);
+	close(fds[1]);
+}))
+
+// Reads do not cross the boundary of data that was sent with SCM_RIGHTS.
+DEFINE_TEST(unix_stream_rights_boundary, ([] {
+	int fds[2];
+	assert_errno("socketpair", !socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+	char data = 'a';
+	iovec iov{.iov_base = &data, .iov_len = 1};
+	alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+	msghdr msg{};
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = control;
+	msg.msg_controllen = sizeof(control);
+	auto cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+	int passed = fds[0];
+	memcpy(CMSG_DATA(cmsg), &passed, sizeof(int));
+	assert_errno("sendmsg", sendmsg(fds[0], &msg, 0) == 1);
+
+	assert(write(fds[0], "b", 1) == 1);
+	assert(write(fds[0], "c", 1) == 1);
+
+	auto receive = [&] (char *buffer, size_t length, int &fd) -> ssize_t {
+		iovec iov{.iov_base = buffer, .iov_len = length};
+		alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+		msghdr msg{};
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		auto res = recvmsg(fds[1], &msg, 0);
+		assert_errno("recvmsg", res >= 0);
+
+		fd = -1;
+		if(auto cmsg = CMSG_FIRSTHDR(&msg); cmsg) {
+			assert(cmsg->cmsg_level == SOL_SOCKET);
+			assert(cmsg->cmsg_type == SCM_RIGHTS);
+			memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+		}
+		return res;
+	};
+
+	char buffer[8];
+	int fd;
+
+	// The file arrives together with the byte that it was sent with,
+	// the following plain writes are not merged into the same read.
+	assert(receive(buffer, sizeof(buffer), fd) == 1);
+	assert(buffer[0] == 'a');
+	assert(fd >= 0);
+	close(fd);
+
+	assert(receive(buffer, sizeof(buffer), fd) == 2);
+	assert(!memcmp(buffer, "bc", 2));
+	assert(fd == -1);
+
+	close(fds[0]);
+	close(fds[1]);
+}))
+
+// Large writes to a socket with a blocked reader are delivered directly.
+DEFINE_TEST(unix_stream_blocked_reader, ([] {
+	int fds[2];
+	assert_errno("socketpair", !socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+	constexpr size_t length = 256 * 1024;
+	auto child = fork();
+	assert_errno("fork", child >= 0);
+	if(!child) {
+		close(fds[0]);
+		readPattern(fds[1], 0, length);
+		_exit(0);
+	}
+
+	close(fds[1]);
+	// Give the child time to block in read().
+	usleep(100000);
+	writePattern(fds[0], 0, 64 * 1024);
+	writePattern(fds[0], 64 * 1024, length - 64 * 1024);
+
+	int status;
+	assert_errno("waitpid", waitpid(child, &status, 0) == child);
+	assert(WIFEXITED(status) && !WEXITSTATUS(status));
+	close(fds[0]);
+}))
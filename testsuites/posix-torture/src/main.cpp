@@ -1,4 +1,6 @@
+#include <chrono>
 #include <iostream>
+#include <string.h>
 #include <vector>
 
 #include "testsuite.hpp"
@@ -12,14 +14,24 @@ void abstract_test_case::register_case(abstract_test_case *tcp) {
 	test_case_ptrs().push_back(tcp);
 }
 
-int main() {
+int main(int argc, char **argv) {
+	// Some tests re-execute posix-torture to measure program startup.
+	if(argc >= 2 && !strcmp(argv[1], "--exec-probe"))
+		return exec_probe_main(argc, argv);
+
 	for(int s = 10; s < 24; s++) {
 		int n = 1 << s;
 		for(abstract_test_case *tcp : test_case_ptrs()) {
 			std::cout << "posix-torture: Running " << tcp->name()
 					<< " for " << n << " iterations" << std::endl;
+			auto start = std::chrono::steady_clock::now();
 			for(int i = 0; i < n; i++)
 				tcp->run();
+			auto elapsed = std::chrono::steady_clock::now() - start;
+			std::cout << "posix-torture: " << tcp->name() << " took "
+					<< std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / n
+					<< " ns per iteration" << std::endl;
+			tcp->report();
 		}
 	}
 }
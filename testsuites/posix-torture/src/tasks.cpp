@@ -1,6 +1,17 @@
 #include <cassert>
+#include <errno.h>
+#include <fcntl.h>
+#include <hel.h>
+#include <hel-syscalls.h>
+#include <iostream>
+#include <protocols/posix/data.hpp>
+#include <protocols/posix/supercalls.hpp>
+#include <spawn.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "testsuite.hpp"
@@ -16,3 +27,347 @@ DEFINE_TEST(fork_exit_waitpid, ([] {
 		assert(res > 0);
 	}
 }))
+
+// The following tests compare the ways of starting a new program.
+
+namespace {
+
+char trueProgram[] = "/usr/bin/true";
+char *trueArgv[] = {trueProgram, nullptr};
+char *emptyEnvp[] = {nullptr};
+
+void waitForChild(int pid) {
+	int status;
+	auto res = waitpid(pid, &status, 0);
+	assert(res > 0);
+	assert(WIFEXITED(status) && !WEXITSTATUS(status));
+}
+
+} // anonymous namespace
+
+DEFINE_TEST(fork_exec_waitpid, ([] {
+	int pid = fork();
+	assert(pid >= 0);
+	if(!pid) {
+		execve(trueProgram, trueArgv, emptyEnvp);
+		_exit(127);
+	}
+	waitForChild(pid);
+}))
+
+DEFINE_TEST(vfork_exec_waitpid, ([] {
+	int pid = vfork();
+	assert(pid >= 0);
+	if(!pid) {
+		execve(trueProgram, trueArgv, emptyEnvp);
+		_exit(127);
+	}
+	waitForChild(pid);
+}))
+
+DEFINE_TEST(posix_spawn_waitpid, ([] {
+	pid_t pid;
+	auto e = posix_spawn(&pid, trueProgram, nullptr, nullptr, trueArgv, emptyEnvp);
+	assert(!e);
+	waitForChild(pid);
+}))
+
+// The following tests issue the vfork and spawn supercalls directly,
+// independently of whether the C library uses them.
+
+namespace {
+
+char missingProgram[] = "/usr/bin/posix-torture-does-not-exist";
+
+posix::ManagarmProcessData getProcessData() {
+	posix::ManagarmProcessData data;
+	HEL_CHECK(helSyscall1(kHelCallSuper + posix::superGetProcessData,
+			reinterpret_cast<HelWord>(&data)));
+	return data;
+}
+
+// Path and argument areas as expected by the execve and spawn supercalls.
+// The environment is empty.
+struct ExecAreas {
+	ExecAreas(const char *path, std::initializer_list<const char *> args)
+	: path{path} {
+		for(auto arg : args)
+			argsArea.append(arg, strlen(arg) + 1);
+	}
+
+	std::string path;
+	std::string argsArea;
+};
+
+// Returns an errno value; does not return on success.
+int superExecve(const ExecAreas &areas) {
+	HelWord error;
+	HEL_CHECK(helSyscall6_1(kHelCallSuper + posix::superExecve,
+			reinterpret_cast<HelWord>(areas.path.data()), areas.path.size(),
+			reinterpret_cast<HelWord>(areas.argsArea.data()), areas.argsArea.size(),
+			reinterpret_cast<HelWord>(areas.path.data()), 0, &error));
+	return error;
+}
+
+// Returns an errno value and stores the PID of the child on success.
+int superSpawn(const ExecAreas &areas, int &pid) {
+	HelWord error;
+	HelWord child;
+	HEL_CHECK(helSyscall6_2(kHelCallSuper + posix::superSpawn,
+			reinterpret_cast<HelWord>(areas.path.data()), areas.path.size(),
+			reinterpret_cast<HelWord>(areas.argsArea.data()), areas.argsArea.size(),
+			reinterpret_cast<HelWord>(areas.path.data()), 0, &error, &child));
+	if(!error)
+		pid = child;
+	return error;
+}
+
+[[noreturn]] void superExit(int code) {
+	HEL_CHECK(helSyscall1(kHelCallSuper + posix::superExit, code));
+	__builtin_unreachable();
+}
+
+// State that the child of vfork() shares with its parent. The child only uses
+// supercalls and does not allocate: the C library still refers to the parent's
+// thread page, file table and POSIX lane, which are not valid in the child.
+struct VforkState {
+	ExecAreas *missing = nullptr;
+	ExecAreas *exec = nullptr;
+	posix::ManagarmProcessData parentData;
+	posix::ManagarmProcessData childData;
+	int missingError = 0;
+	bool filesMatch = false;
+	bool ran = false;
+};
+
+VforkState vforkState;
+
+[[noreturn]] void vforkChild() {
+	auto &state = vforkState;
+	state.ran = true;
+	state.childData = getProcessData();
+
+	// The child's file table is a copy of the parent's, but it is mapped at a new
+	// address and refers to handles in the child's universe.
+	auto parentTable = state.parentData.fileTable;
+	state.filesMatch = state.childData.fileTable != nullptr;
+	for(size_t fd = 0; state.filesMatch && fd < 0x1000 / sizeof(HelHandle); fd++) {
+		if((state.childData.fileTable[fd] == kHelNullHandle)
+				!= (parentTable[fd] == kHelNullHandle))
+			state.filesMatch = false;
+	}
+
+	// A failed exec() keeps the parent suspended.
+	state.missingError = superExecve(*state.missing);
+
+	if(state.exec) {
+		superExecve(*state.exec);
+		superExit(127);
+	}
+	superExit(0);
+}
+
+// The child runs on our stack below the current frame, hence it calls
+// a separate function that does not return.
+[[gnu::noinline]] int superVfork(void (*child)()) {
+	HelWord pid;
+	HEL_CHECK(helSyscall0_1(kHelCallSuper + posix::superVfork, &pid));
+	if(!pid)
+		child();
+	return pid;
+}
+
+void runVforkSupercall(ExecAreas *exec) {
+	ExecAreas missing{missingProgram, {missingProgram}};
+	auto parentData = getProcessData();
+	vforkState = VforkState{};
+	vforkState.missing = &missing;
+	vforkState.exec = exec;
+	vforkState.parentData = parentData;
+
+	int pid = superVfork(vforkChild);
+	assert(pid > 0);
+
+	// We are resumed only after the child called exec() or exited.
+	assert(vforkState.ran);
+	assert(vforkState.missingError == ENOENT);
+	assert(vforkState.filesMatch);
+	assert(vforkState.childData.threadPage);
+	assert(vforkState.childData.threadPage != parentData.threadPage);
+	assert(vforkState.childData.fileTable != parentData.fileTable);
+
+	// Our own process data is unaffected.
+	auto data = getProcessData();
+	assert(data.threadPage == parentData.threadPage);
+	assert(data.fileTable == parentData.fileTable);
+	assert(data.posixLane == parentData.posixLane);
+
+	waitForChild(pid);
+}
+
+} // anonymous namespace
+
+DEFINE_TEST(vfork_supercall_exec_waitpid, ([] {
+	ExecAreas exec{trueProgram, {trueProgram}};
+	runVforkSupercall(&exec);
+}))
+
+DEFINE_TEST(vfork_supercall_exit_waitpid, ([] {
+	runVforkSupercall(nullptr);
+}))
+
+DEFINE_TEST(spawn_supercall_waitpid, ([] {
+	ExecAreas missing{missingProgram, {missingProgram}};
+	int pid = -1;
+	assert(superSpawn(missing, pid) == ENOENT);
+
+	ExecAreas exec{trueProgram, {trueProgram}};
+	assert(!superSpawn(exec, pid));
+	assert(pid > 0);
+	waitForChild(pid);
+}))
+
+// Measures the time from execve() until main() of the new program runs;
+// this includes loading the program, the dynamic loader and all libraries.
+
+namespace {
+
+char selfProgram[] = "/usr/bin/posix-torture";
+
+uint64_t monotonicNanos() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1'000'000'000 + ts.tv_nsec;
+}
+
+struct exec_to_main_test : abstract_test_case {
+	exec_to_main_test()
+	: abstract_test_case{"exec_to_main"} { }
+
+	void run() override {
+		int fds[2];
+		auto e = pipe(fds);
+		assert(!e);
+
+		int pid = fork();
+		assert(pid >= 0);
+		if(!pid) {
+			close(fds[0]);
+			char probeArg[] = "--exec-probe";
+			char startArg[32];
+			char fdArg[16];
+			snprintf(fdArg, sizeof(fdArg), "%d", fds[1]);
+			snprintf(startArg, sizeof(startArg), "%llu",
+					static_cast<unsigned long long>(monotonicNanos()));
+			char *argv[] = {selfProgram, probeArg, startArg, fdArg, nullptr};
+			execve(selfProgram, argv, emptyEnvp);
+			_exit(127);
+		}
+		close(fds[1]);
+
+		uint64_t latency;
+		auto res = read(fds[0], &latency, sizeof(uint64_t));
+		assert(res == sizeof(uint64_t));
+		close(fds[0]);
+		waitForChild(pid);
+
+		totalLatency_ += latency;
+		numSamples_++;
+	}
+
+	void report() override {
+		std::cout << "posix-torture: " << name() << " latency is "
+				<< totalLatency_ / numSamples_ << " ns" << std::endl;
+		totalLatency_ = 0;
+		numSamples_ = 0;
+	}
+
+private:
+	uint64_t totalLatency_ = 0;
+	uint64_t numSamples_ = 0;
+};
+
+exec_to_main_test execToMainTest;
+
+} // anonymous namespace
+
+int exec_probe_main(int argc, char **argv) {
+	auto now = monotonicNanos();
+	if(argc < 4)
+		return 1;
+	uint64_t latency = now - strtoull(argv[2], nullptr, 10);
+	int fd = atoi(argv[3]);
+	// Optionally, a descriptor that must have been closed on exec.
+	if(argc >= 5 && (fcntl(atoi(argv[4]), F_GETFD) != -1 || errno != EBADF))
+		return 1;
+	if(write(fd, &latency, sizeof(uint64_t)) != sizeof(uint64_t))
+		return 1;
+	return 0;
+}
+
+// The spawned program inherits descriptors, except for those that are close-on-exec.
+DEFINE_TEST(spawn_supercall_cloexec, ([] {
+	int fds[2];
+	auto e = pipe(fds);
+	assert(!e);
+	int cloexecFd = open("/dev/null", O_RDONLY | O_CLOEXEC);
+	assert(cloexecFd >= 0);
+
+	char startArg[32];
+	char fdArg[16];
+	char cloexecArg[16];
+	snprintf(startArg, sizeof(startArg), "%llu",
+			static_cast<unsigned long long>(monotonicNanos()));
+	snprintf(fdArg, sizeof(fdArg), "%d", fds[1]);
+	snprintf(cloexecArg, sizeof(cloexecArg), "%d", cloexecFd);
+	ExecAreas exec{selfProgram, {selfProgram, "--exec-probe", startArg, fdArg, cloexecArg}};
+	int pid = -1;
+	assert(!superSpawn(exec, pid));
+	close(fds[1]);
+	close(cloexecFd);
+
+	uint64_t latency;
+	auto res = read(fds[0], &latency, sizeof(uint64_t));
+	assert(res == sizeof(uint64_t));
+	close(fds[0]);
+	waitForChild(pid);
+}))
+
+namespace {
+
+constexpr int numForkMappings = 512;
+
+// Sets up a large number of separate mappings (separated by guard pages such that
+// they cannot be merged), as found in processes that use JITs or many shared libraries.
+void setupForkMappings() {
+	static bool done = false;
+	if(done)
+		return;
+	done = true;
+
+	auto base = static_cast<char *>(mmap(nullptr, 2 * numForkMappings * 0x1000, PROT_NONE,
+			MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+	assert(base != MAP_FAILED);
+	for(int i = 0; i < numForkMappings; i++) {
+		auto window = mmap(base + 2 * i * 0x1000, 0x1000, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0);
+		assert(window != MAP_FAILED);
+		*static_cast<volatile char *>(window) = 1;
+	}
+}
+
+} // anonymous namespace
+
+DEFINE_TEST(fork_exit_waitpid_many_mappings, ([] {
+	setupForkMappings();
+
+	int pid = fork();
+	assert(pid >= 0);
+	if(!pid) {
+		_exit(0);
+	}else{
+		int status;
+		auto res = waitpid(pid, &status, 0);
+		assert(res > 0);
+	}
+}))
@@ -27,10 +27,17 @@ public:
 
 	virtual void run() = 0;
 
+	// Called after each batch of iterations; tests that collect
+	// additional measurements print and reset them here.
+	virtual void report() { }
+
 private:
 	const char *name_;
 };
 
+// Entry point of posix-torture when it is executed as a child by the exec tests.
+int exec_probe_main(int argc, char **argv);
+
 template<typename F>
 struct test_case : abstract_test_case {
 	test_case(const char *name, F functor)
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cassert>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <linux/falloc.h>
+
+#include "testsuite.hpp"
+
+namespace {
+
+// The posix subsystem accesses tmpfs files through windows of this size;
+// the tests below place their accesses such that they cross window boundaries.
+constexpr size_t windowSize = 256 << 10;
+constexpr size_t pageSize = 4096;
+
+// Contents of the byte at a given file offset. The generation is changed
+// whenever a file is rewritten, such that stale data is detected.
+uint8_t patternAt(size_t offset, uint32_t generation) {
+	return static_cast<uint8_t>((offset ^ (offset >> 8) ^ (offset >> 16)) * 7 + generation);
+}
+
+void writePattern(int fd, size_t offset, size_t size, uint32_t generation) {
+	char buffer[pageSize];
+	for(size_t progress = 0; progress < size; ) {
+		auto chunk = std::min(size - progress, pageSize);
+		for(size_t i = 0; i < chunk; i++)
+			buffer[i] = patternAt(offset + progress + i, generation);
+		auto res = pwrite(fd, buffer, chunk, offset + progress);
+		assert(res == static_cast<ssize_t>(chunk));
+		progress += chunk;
+	}
+}
+
+// Checks that [offset, offset + size) contains the pattern of the given generation.
+void checkPattern(int fd, size_t offset, size_t size, uint32_t generation) {
+	char buffer[pageSize];
+	for(size_t progress = 0; progress < size; ) {
+		auto chunk = std::min(size - progress, pageSize);
+		auto res = pread(fd, buffer, chunk, offset + progress);
+		assert(res == static_cast<ssize_t>(chunk));
+		for(size_t i = 0; i < chunk; i++)
+			assert(static_cast<uint8_t>(buffer[i]) == patternAt(offset + progress + i, generation));
+		progress += chunk;
+	}
+}
+
+void checkZero(int fd, size_t offset, size_t size) {
+	char buffer[pageSize];
+	for(size_t progress = 0; progress < size; ) {
+		auto chunk = std::min(size - progress, pageSize);
+		auto res = pread(fd, buffer, chunk, offset + progress);
+		assert(res == static_cast<ssize_t>(chunk));
+		for(size_t i = 0; i < chunk; i++)
+			assert(!buffer[i]);
+		progress += chunk;
+	}
+}
+
+size_t fileSize(int fd) {
+	struct stat st;
+	auto e = fstat(fd, &st);
+	assert(!e);
+	return st.st_size;
+}
+
+int openTemporary(const char *path) {
+	int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	assert(fd >= 0);
+	unlink(path);
+	return fd;
+}
+
+// Appends in small records, as done by logs and build outputs; this exercises
+// the growth of tmpfs files. Files are truncated once they reach maxAppendSize.
+// The record size does not divide the window size, so some records straddle
+// window boundaries.
+constexpr size_t appendRecordSize = 120;
+constexpr size_t maxAppendSize = 64 << 20;
+
+int appendFd = -1;
+size_t appendSize = 0;
+uint32_t appendGeneration = 0;
+
+// Region around a window boundary that the hole punching and truncation tests operate on.
+constexpr size_t regionOffset = windowSize - 8 * pageSize;
+constexpr size_t regionSize = 16 * pageSize;
+
+int punchFd = -1;
+uint32_t punchIteration = 0;
+
+int regrowFd = -1;
+uint32_t regrowIteration = 0;
+
+} // anonymous namespace
+
+DEFINE_TEST(tmpfs_append, ([] {
+	if(appendFd < 0)
+		appendFd = openTemporary("/tmp/posix-torture-append");
+
+	char record[appendRecordSize];
+	for(size_t i = 0; i < appendRecordSize; i++)
+		record[i] = patternAt(appendSize + i, appendGeneration);
+	auto res = write(appendFd, record, appendRecordSize);
+	assert(res == appendRecordSize);
+	checkPattern(appendFd, appendSize, appendRecordSize, appendGeneration);
+	appendSize += appendRecordSize;
+
+	// After crossing into a new window, check the data on both sides of the boundary.
+	auto boundary = appendSize / windowSize * windowSize;
+	if(boundary >= pageSize && appendSize - boundary < appendRecordSize)
+		checkPattern(appendFd, boundary - pageSize, appendSize - boundary + pageSize,
+				appendGeneration);
+
+	if(appendSize >= maxAppendSize) {
+		auto e = ftruncate(appendFd, 0);
+		assert(!e);
+		auto offset = lseek(appendFd, 0, SEEK_SET);
+		assert(!offset);
+		appendSize = 0;
+		appendGeneration++;
+	}
+}))
+
+// Punches holes that cover partial pages at either end and full pages in between
+// (sometimes none, sometimes on both sides of a window boundary), and also holes
+// within a single page.
+DEFINE_TEST(tmpfs_punch_hole, ([] {
+	constexpr size_t size = regionOffset + regionSize + pageSize;
+	if(punchFd < 0) {
+		punchFd = openTemporary("/tmp/posix-torture-punch");
+		auto e = ftruncate(punchFd, size);
+		assert(!e);
+	}
+
+	auto generation = punchIteration++;
+	writePattern(punchFd, regionOffset, regionSize, generation);
+
+	auto start = (generation * 1237) % (regionSize / 2);
+	auto length = 1 + (generation * 3571) % (regionSize / 2);
+	if(generation % 4 == 0)
+		length = 1 + (generation * 13) % (pageSize - start % pageSize);
+	auto e = fallocate(punchFd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+			regionOffset + start, length);
+	assert(!e);
+	assert(fileSize(punchFd) == size);
+
+	checkPattern(punchFd, regionOffset, start, generation);
+	checkZero(punchFd, regionOffset + start, length);
+	checkPattern(punchFd, regionOffset + start + length, regionSize - start - length, generation);
+}))
+
+// Shrinks a file to a (usually unaligned) size below a window boundary and grows
+// it again, either by ftruncate() or by writing beyond the end of the file.
+// The old tail must read as zero afterwards.
+DEFINE_TEST(tmpfs_regrow, ([] {
+	constexpr size_t size = regionOffset + regionSize;
+	if(regrowFd < 0)
+		regrowFd = openTemporary("/tmp/posix-torture-regrow");
+
+	auto generation = regrowIteration++;
+	writePattern(regrowFd, regionOffset, regionSize, generation);
+
+	auto shrunk = regionOffset + (generation * 2053) % regionSize;
+	auto e = ftruncate(regrowFd, shrunk);
+	assert(!e);
+	assert(fileSize(regrowFd) == shrunk);
+
+	if(generation % 2) {
+		e = ftruncate(regrowFd, size);
+		assert(!e);
+		checkZero(regrowFd, shrunk, size - shrunk);
+	}else{
+		char last = 1;
+		auto res = pwrite(regrowFd, &last, 1, size - 1);
+		assert(res == 1);
+		checkZero(regrowFd, shrunk, size - shrunk - 1);
+	}
+	assert(fileSize(regrowFd) == size);
+	checkPattern(regrowFd, regionOffset, shrunk - regionOffset, generation);
+}))
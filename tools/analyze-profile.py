@@ -12,82 +12,177 @@ parser.add_argument('--aggregate-by',
 	help="aggregate samples by source line of code or by symbol inside the binary")
 parser.add_argument('--line', action='store_true')
 parser.add_argument('--isn', action='store_true')
+parser.add_argument('--kernel', type=str,
+	default='pkg-builds/managarm-kernel/kernel/thor/thor',
+	help="path to the thor binary")
+parser.add_argument('--user-image', type=str, action='append', default=[],
+	metavar='PATH[@BASE][:UNIVERSE]',
+	help="symbolize user samples against the given binary, loaded at BASE (hex);"
+		" if UNIVERSE (hex, as printed by --list-universes) is given,"
+		" only samples from that universe are considered")
+parser.add_argument('--list-universes', action='store_true',
+	help="print the number of user samples per universe and exit")
+parser.add_argument('--folded', action='store_true',
+	help="emit folded stacks (suitable for flamegraph.pl) instead of a flat profile")
 
 args = parser.parse_args()
 
-profile = dict()
+# Must match ProfileSampleHeader in thor-internal/profile.hpp.
+SAMPLE_MAGIC = 0x50524631
+SAMPLE_USER = 1
+header_struct = struct.Struct('<IHHIIQ')
 
-if args.aggregate_by == 'symbol':
-	nm = subprocess.check_output(
-		[
-			'nm', '-nC',
-			'pkg-builds/managarm-kernel/kernel/thor/thor'
-		],
-		encoding='ascii');
-
-	sym_table = []
-	for line in nm.splitlines():
-		start, attr, symbol = line.split(' ', 2)
-		sym_table.append((int(start, 16), symbol))
-	sym_index = [e[0] for e in sym_table]
-else:
-	addr2line = subprocess.Popen(
-		[
-			'addr2line', '-sfC',
-			'-e', 'pkg-builds/managarm-kernel/kernel/thor/thor'
-		],
-		encoding='ascii',
-		stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+class Image:
+	def __init__(self, name, path, base=0, universe=None):
+		self.name = name
+		self.path = path
+		self.base = base
+		self.universe = universe
+		self.addr2line = None
 
-n_user = 0
-n_kernel = 0
-n_resolved = 0
+		nm = subprocess.check_output(['nm', '-nC', path], encoding='ascii')
 
-with open(args.profile_path, 'rb') as f:
-	while True:
-		rec = f.read(8)
-		if not rec:
-			break
-		ip = struct.unpack('Q', rec)[0]
-		if ip < (1 << 63):
-			n_user += 1
-			continue
-		else:
-			n_kernel += 1
+		self.sym_table = []
+		for line in nm.splitlines():
+			start, attr, symbol = line.split(' ', 2)
+			if start.strip() == '':
+				continue
+			self.sym_table.append((base + int(start, 16), symbol))
+		self.sym_index = [e[0] for e in self.sym_table]
+
+	def contains(self, ip):
+		if not self.sym_index:
+			return False
+		return self.sym_index[0] <= ip <= self.sym_index[-1] + 0x10000
 
+	def resolve(self, ip):
 		if args.aggregate_by == 'symbol':
-			idx = bisect.bisect_right(sym_index, ip)
+			idx = bisect.bisect_right(self.sym_index, ip)
 			if idx == 0:
-				continue
-			start, symbol = sym_table[idx - 1];
+				return None
+			start, symbol = self.sym_table[idx - 1]
 			assert ip >= start
+			return symbol, self.name
 
-			loc = symbol, 0
+		if self.addr2line is None:
+			self.addr2line = subprocess.Popen(
+				[
+					'addr2line', '-sfC',
+					'-e', self.path
+				],
+				encoding='ascii',
+				stdin=subprocess.PIPE, stdout=subprocess.PIPE)
+		self.addr2line.stdin.write(hex(ip - self.base) + '\n')
+		self.addr2line.stdin.flush()
+		func = self.addr2line.stdout.readline().rstrip()
+		line = self.addr2line.stdout.readline().rstrip()
+		if args.line:
+			return (func, line)
+		elif args.isn:
+			return (func, line.split(':')[0] + ':' + hex(ip))
 		else:
-			addr2line.stdin.write(hex(ip) + '\n')
-			addr2line.stdin.flush()
-			func = addr2line.stdout.readline().rstrip()
-			line = addr2line.stdout.readline().rstrip()
-			if args.line:
-				loc = (func, line)
-			elif args.isn:
-				loc = (func, line.split(':')[0] + ':' + hex(ip))
-			else:
-				loc = (func, line.split(':')[0])
-
-		if loc in profile:
-			profile[loc] += 1
+			return (func, line.split(':')[0])
+
+def parse_user_image(spec):
+	universe = None
+	if ':' in spec:
+		spec, universe = spec.rsplit(':', 1)
+		universe = int(universe, 16)
+	base = 0
+	if '@' in spec:
+		spec, base = spec.rsplit('@', 1)
+		base = int(base, 16)
+	return Image(spec.split('/')[-1], spec, base, universe)
+
+def read_samples(path):
+	with open(path, 'rb') as f:
+		data = f.read()
+	offset = 0
+	while offset + header_struct.size <= len(data):
+		magic, flags, n_frames, cpu, _, universe = header_struct.unpack_from(data, offset)
+		if magic != SAMPLE_MAGIC:
+			# Resynchronize after truncated or lost records.
+			offset += 8
+			continue
+		offset += header_struct.size
+		frames = struct.unpack_from('<{}Q'.format(n_frames), data, offset)
+		offset += 8 * n_frames
+		yield flags, cpu, universe, frames
+
+samples = list(read_samples(args.profile_path))
+
+if args.list_universes:
+	per_universe = dict()
+	for flags, cpu, universe, frames in samples:
+		if flags & SAMPLE_USER:
+			per_universe[universe] = per_universe.get(universe, 0) + 1
+	for universe in sorted(per_universe.keys(), key=lambda u: per_universe[u]):
+		print("universe {:#x}: {} samples".format(universe, per_universe[universe]))
+	exit(0)
+
+kernel_image = Image('thor', args.kernel)
+user_images = [parse_user_image(spec) for spec in args.user_image]
+
+def find_image(flags, universe, ip):
+	if not (flags & SAMPLE_USER):
+		return kernel_image
+	for image in user_images:
+		if image.universe is not None and image.universe != universe:
+			continue
+		if image.contains(ip):
+			return image
+	return None
+
+profile = dict()
+
+n_user = 0
+n_kernel = 0
+n_resolved = 0
+
+for flags, cpu, universe, frames in samples:
+	if flags & SAMPLE_USER:
+		n_user += 1
+	else:
+		n_kernel += 1
+
+	if args.folded:
+		stack = []
+		for ip in reversed(frames):
+			image = find_image(flags, universe, ip)
+			loc = image.resolve(ip) if image else None
+			stack.append(loc[0] if loc else hex(ip))
+		if flags & SAMPLE_USER:
+			stack.insert(0, '[universe {:#x}]'.format(universe))
 		else:
-			profile[loc] = 1
-		n_resolved += 1
+			stack.insert(0, '[kernel]')
+		loc = ';'.join(s.replace(';', ':') for s in stack)
+	else:
+		image = find_image(flags, universe, frames[0])
+		if image is None:
+			continue
+		loc = image.resolve(frames[0])
+		if loc is None:
+			continue
+
+	if loc in profile:
+		profile[loc] += 1
+	else:
+		profile[loc] = 1
+	n_resolved += 1
+
+if args.folded:
+	for loc, count in profile.items():
+		print("{} {}".format(loc, count))
+	exit(0)
 
 n_all = n_user + n_kernel
 
 cumulative = 0
 out = sorted(profile.keys(), key=lambda loc: profile[loc])
 for loc in out:
-	print("{:.2f}% (cumulative: {:.2f}%) ({} samples) in:".format(profile[loc]/n_kernel*100, 100-cumulative/n_kernel*100, profile[loc]))
+	print("{:.2f}% (cumulative: {:.2f}%) ({} samples) in:".format(profile[loc]/n_all*100, 100-cumulative/n_all*100, profile[loc]))
 	print("    {} in {}".format(loc[0], loc[1]))
 	cumulative += profile[loc]
-print("{} (= {:.2f}% of all samples) in the kernel".format(n_kernel, n_kernel/(n_user + n_kernel)*100))
-print("{:.2f}% of all kernel samples could be resolved".format(n_resolved/n_kernel*100))
+print("{} (= {:.2f}% of all samples) in the kernel".format(n_kernel, n_kernel/n_all*100))
+print("{} (= {:.2f}% of all samples) in user space".format(n_user, n_user/n_all*100))
+print("{:.2f}% of all samples could be resolved".format(n_resolved/n_all*100))